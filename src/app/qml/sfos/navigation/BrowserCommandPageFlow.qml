@@ -8,6 +8,59 @@ CommandPageFlow {
 
     FileDetailsHelper { id: fileDetailsHelper }
 
+    // Directory whose page has been pushed before its listing completed
+    property string __earlyPushedPath : ""
+
+    function pushDirectoryPage(remotePath) {
+        // Complete pending PageStack animation
+        if (pageStack.busy)
+            pageStack.completeAnimation()
+
+        var nextDirectory = browserComponent.createObject(pageStack,
+                                                          {
+                                                              remotePath : remotePath,
+                                                              accountWorkers: accountWorkers,
+                                                              pageFlow: pageFlowItemRoot
+                                                          });
+
+        if (!nextDirectory) {
+            console.warn(browserComponent.errorString())
+            return false
+        }
+
+        nextDirectory.transientNotification.connect(transientNotificationRequest)
+
+        // Try to fetch the avatar which
+        // will only succeed if the server supports it.
+        if (remotePath === "/") {
+            userInfoUpdateRequest()
+            avatarFetchRequest()
+        }
+        pageStack.push(nextDirectory)
+        return true
+    }
+
+    // Show the first batch of entries of large directories
+    // while the rest of the listing is still being received
+    Connections {
+        target: accountWorkers.browserCommandQueue
+        onCommandStarted: {
+            if (command.info.property("type") !== "davList" ||
+                    command.info.property("refresh"))
+                return;
+
+            var remotePath = command.info.property("remotePath")
+            command.entriesReceived.connect(function(entries) {
+                if (remotePath !== targetRemotePath || __earlyPushedPath === remotePath)
+                    return;
+
+                directoryContents.insert(remotePath, entries)
+                if (pushDirectoryPage(remotePath))
+                    __earlyPushedPath = remotePath
+            })
+        }
+    }
+
     // Open files conditionally after download
     Connections {
         target: accountWorkers.transferCommandQueue
@@ -50,6 +103,7 @@ CommandPageFlow {
             if (!receipt.finished) {
                 console.warn("Receipt: unfinished")
                 if (isDavListCommand) {
+                    __earlyPushedPath = ""
                     notificationRequest(
                                 qsTr("Failed to get remote content"),
                                 qsTr("Please check your connection or try again later."))
@@ -74,6 +128,11 @@ CommandPageFlow {
 
                 directoryContents.insert(remotePath, dirContent);
 
+                // The page might have been shown with the first entries already
+                var pushedEarly = (__earlyPushedPath === remotePath)
+                if (pushedEarly)
+                    __earlyPushedPath = ""
+
                 if (remotePath !== targetRemotePath) {
                     console.log("remotePath !== targetRemotePath")
                     return;
@@ -91,32 +150,8 @@ CommandPageFlow {
                     return
                 }
 
-                // Complete pending PageStack animation
-                if (pageStack.busy)
-                    pageStack.completeAnimation()
-
-                var nextDirectory = browserComponent.createObject(pageStack,
-                                                                  {
-                                                                      remotePath : remotePath,
-                                                                      accountWorkers: accountWorkers,
-                                                                      pageFlow: pageFlowItemRoot
-                                                                  });
-
-                if (!nextDirectory) {
-                    console.warn(browserComponent.errorString())
-                    return
-                }
-
-                nextDirectory.transientNotification.connect(transientNotificationRequest)
-
-                // Try to fetch the avatar which
-                // will only succeed if the server supports it.
-                if (remotePath === "/") {
-                    userInfoUpdateRequest()
-                    avatarFetchRequest()
-                }
-                pageStack.push(nextDirectory)
-
+                if (!pushedEarly)
+                    pushDirectoryPage(remotePath)
                 return
             }
 
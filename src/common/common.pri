@@ -64,6 +64,7 @@ macx {
 
 ios {
     LIBS += $$OUT_PWD/../../3rdparty/qwebdavlib/qwebdavlib/libqwebdav.a
+    LIBS += -lz
     CONFIG(release, debug|release) {
         LIBS += $$OUT_PWD/../../src/common/libharbourowncloudcommon.a
     }
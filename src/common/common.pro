@@ -29,6 +29,10 @@ SOURCES += \
     $$PWD/src/util/shellcommand.cpp \
     $$PWD/src/util/webdav_utils.cpp \
     $$PWD/src/commands/webdav/fileuploadcommandentity.cpp \
+    $$PWD/src/commands/webdav/fileuploadcommandunit.cpp \
+    $$PWD/src/commands/webdav/ncchunkeduploadcommandentity.cpp \
+    $$PWD/src/commands/webdav/ncbulkuploadcommandentity.cpp \
+    $$PWD/src/commands/webdav/nccompressionprobecommandentity.cpp \
     $$PWD/src/commands/webdav/filedownloadcommandentity.cpp \
     $$PWD/src/commands/webdav/webdavcommandentity.cpp \
     $$PWD/src/commands/webdav/mkdavdircommandentity.cpp \
@@ -36,6 +40,8 @@ SOURCES += \
     $$PWD/src/commands/webdav/davcopycommandentity.cpp \
     $$PWD/src/commands/webdav/davmovecommandentity.cpp \
     $$PWD/src/commands/webdav/davlistcommandentity.cpp \
+    $$PWD/src/commands/webdav/davmultistatusparser.cpp \
+    $$PWD/src/commands/webdav/davtreelistcommandentity.cpp \
     $$PWD/src/commands/http/httpcommandentity.cpp \
     $$PWD/src/commands/http/httpgetcommandentity.cpp \
     $$PWD/src/provider/storage/webdavcommandqueue.cpp \
@@ -45,14 +51,20 @@ SOURCES += \
     $$PWD/src/auth/flowloginauthenticator.cpp \
     $$PWD/src/commands/ocs/ocscommandentity.cpp \
     $$PWD/src/commands/ocs/ocsuserinfocommandentity.cpp \
+    $$PWD/src/commands/ocs/ocscapabilitiescommandentity.cpp \
     $$PWD/src/provider/accountinfo/ocscommandqueue.cpp \
     $$PWD/src/commands/webdav/davproppatchcommandentity.cpp \
     $$PWD/src/net/avatarfetcher.cpp \
     $$PWD/src/commands/nopcommandentity.cpp \
+    $$PWD/src/commands/transferlanescommandentity.cpp \
     $$PWD/src/commands/sync/ncdirtreecommandunit.cpp \
     $$PWD/src/commands/sync/ncsynccommandunit.cpp \
+    $$PWD/src/commands/sync/ncsyncreconciler.cpp \
+    $$PWD/src/commands/sync/ncdircreationcommandentity.cpp \
+    $$PWD/src/commands/sync/ncsyncdedupcommandentity.cpp \
     $$PWD/src/cacheprovider.cpp \
     $$PWD/src/provider/storage/cloudstorageprovider.cpp \
+    $$PWD/src/provider/storage/remoteentry.cpp \
     $$PWD/src/settings/db/syncdb.cpp \
     $$PWD/src/settings/db/accountdb.cpp \
     $$PWD/src/provider/settingsbackedcommandqueue.cpp \
@@ -63,7 +75,15 @@ SOURCES += \
     $$PWD/src/provider/sharing/sharingprovider.cpp \
     $$PWD/src/provider/sharing/ocssharingcommandqueue.cpp \
     $$PWD/src/commands/ocs/ocssharelistcommandentity.cpp \
-    $$PWD/src/util/commandutil.cpp
+    $$PWD/src/util/commandutil.cpp \
+    $$PWD/src/util/filefingerprint.cpp \
+    $$PWD/src/util/filehasher.cpp \
+    $$PWD/src/util/filerangedevice.cpp \
+    $$PWD/src/util/gziputil.cpp \
+    $$PWD/src/util/blockmanifest.cpp \
+    $$PWD/src/util/transferratelimiter.cpp \
+    $$PWD/src/util/ratelimiteddevice.cpp \
+    $$PWD/src/util/filesnapshot.cpp
 
 HEADERS += \
     $$PWD/src/net/abstractfetcher.h \
@@ -75,6 +95,10 @@ HEADERS += \
     $$PWD/src/util/webdav_utils.h \
     $$PWD/src/ownclouddbusconsts.h \
     $$PWD/src/commands/webdav/fileuploadcommandentity.h \
+    $$PWD/src/commands/webdav/fileuploadcommandunit.h \
+    $$PWD/src/commands/webdav/ncchunkeduploadcommandentity.h \
+    $$PWD/src/commands/webdav/ncbulkuploadcommandentity.h \
+    $$PWD/src/commands/webdav/nccompressionprobecommandentity.h \
     $$PWD/src/commands/webdav/filedownloadcommandentity.h \
     $$PWD/src/commands/webdav/webdavcommandentity.h \
     $$PWD/src/commands/webdav/mkdavdircommandentity.h \
@@ -82,6 +106,8 @@ HEADERS += \
     $$PWD/src/commands/webdav/davcopycommandentity.h \
     $$PWD/src/commands/webdav/davmovecommandentity.h \
     $$PWD/src/commands/webdav/davlistcommandentity.h \
+    $$PWD/src/commands/webdav/davmultistatusparser.h \
+    $$PWD/src/commands/webdav/davtreelistcommandentity.h \
     $$PWD/src/commands/http/httpcommandentity.h \
     $$PWD/src/commands/http/httpgetcommandentity.h \
     $$PWD/src/provider/storage/webdavcommandqueue.h \
@@ -92,14 +118,20 @@ HEADERS += \
     $$PWD/src/auth/flowloginauthenticator.h \
     $$PWD/src/commands/ocs/ocscommandentity.h \
     $$PWD/src/commands/ocs/ocsuserinfocommandentity.h \
+    $$PWD/src/commands/ocs/ocscapabilitiescommandentity.h \
     $$PWD/src/provider/accountinfo/ocscommandqueue.h \
     $$PWD/src/commands/webdav/davproppatchcommandentity.h \
     $$PWD/src/net/avatarfetcher.h \
     $$PWD/src/commands/nopcommandentity.h \
+    $$PWD/src/commands/transferlanescommandentity.h \
     $$PWD/src/commands/sync/ncdirtreecommandunit.h \
     $$PWD/src/commands/sync/ncsynccommandunit.h \
+    $$PWD/src/commands/sync/ncsyncreconciler.h \
+    $$PWD/src/commands/sync/ncdircreationcommandentity.h \
+    $$PWD/src/commands/sync/ncsyncdedupcommandentity.h \
     $$PWD/src/cacheprovider.h \
     $$PWD/src/provider/storage/cloudstorageprovider.h \
+    $$PWD/src/provider/storage/remoteentry.h \
     $$PWD/src/settings/db/syncdb.h \
     $$PWD/src/settings/db/accountdb.h \
     $$PWD/src/provider/settingsbackedcommandqueue.h \
@@ -112,6 +144,14 @@ HEADERS += \
     $$PWD/src/provider/sharing/ocssharingcommandqueue.h \
     $$PWD/src/commands/ocs/ocssharelistcommandentity.h \
     $$PWD/src/util/commandutil.h \
+    $$PWD/src/util/filefingerprint.h \
+    $$PWD/src/util/filehasher.h \
+    $$PWD/src/util/filerangedevice.h \
+    $$PWD/src/util/gziputil.h \
+    $$PWD/src/util/blockmanifest.h \
+    $$PWD/src/util/transferratelimiter.h \
+    $$PWD/src/util/ratelimiteddevice.h \
+    $$PWD/src/util/filesnapshot.h \
     src/settings/db/accountsdbinterface.h
 
 include($$PWD/../../3rdparty/libqtcommandqueue/libqtcommandqueue.pri)
@@ -149,6 +189,9 @@ contains(CONFIG, quickcontrols) {
     qwebdavlib.path = $$LIBDIR
 }
 
+# zlib for compressed uploads
+LIBS += -lz
+
 # QWebDav
 android {
     LIBS += $$OUT_PWD/../../3rdparty/qwebdavlib/qwebdavlib/libqwebdav.so
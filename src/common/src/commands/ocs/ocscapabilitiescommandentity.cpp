@@ -0,0 +1,88 @@
+#include "ocscapabilitiescommandentity.h"
+
+#include <QVariant>
+#include <QStringList>
+#include <nextcloudendpointconsts.h>
+
+#include <QDebug>
+#include <QXmlSimpleReader>
+
+class CapabilitiesXmlHandler : public QXmlDefaultHandler {
+public:
+    bool startElement(const QString&, const QString&,
+                      const QString &name, const QXmlAttributes&)
+    {
+        this->m_elements.append(name);
+        return true;
+    }
+    bool endElement(const QString&, const QString&, const QString&)
+    {
+        if (!this->m_elements.isEmpty())
+            this->m_elements.removeLast();
+        return true;
+    }
+    bool characters(const QString & ch)
+    {
+        const QString value = ch.trimmed();
+        if (value.isEmpty() || this->m_elements.length() < 2)
+            return true;
+
+        // <dav><bulkupload>1.0</bulkupload></dav>
+        if (this->m_elements.last() == QStringLiteral("bulkupload") &&
+                this->m_elements.at(this->m_elements.length() - 2) == QStringLiteral("dav"))
+            this->m_bulkUploadVersion = value;
+        return true;
+    }
+
+    QString bulkUploadVersion() { return this->m_bulkUploadVersion; }
+
+private:
+    QStringList m_elements;
+    QString m_bulkUploadVersion;
+};
+
+OcsCapabilitiesCommandEntity::OcsCapabilitiesCommandEntity(QObject *parent,
+                                                           AccountBase* settings,
+                                                           QMap<QByteArray, QByteArray> headers) :
+    OcsCommandEntity(parent, NEXTCLOUD_ENDPOINT_OCS_CAPABILITIES, headers, settings)
+{
+    QMap<QString, QVariant> info;
+    info["type"] = QStringLiteral("capabilities");
+    this->m_commandInfo = CommandEntityInfo(info);
+
+    QObject::connect(this, &OcsCapabilitiesCommandEntity::contentReady,
+                     this, [=](){
+        QVariantMap resultMap = this->m_resultData;
+        const int statusCode = resultMap["statusCode"].toInt();
+        if (statusCode < 200 || statusCode >= 300)
+            return;
+
+        const QByteArray content = resultMap["content"].toByteArray();
+        if (content.isEmpty())
+            return;
+
+        QXmlSimpleReader xmlReader;
+        QXmlInputSource xmlInputSource;
+        CapabilitiesXmlHandler handler;
+        xmlInputSource.setData(content);
+        xmlReader.setContentHandler(&handler);
+        if (!xmlReader.parse(&xmlInputSource))
+            return;
+
+        qDebug() << "Bulk upload version:" << handler.bulkUploadVersion();
+        resultMap.insert("bulkUpload", !handler.bulkUploadVersion().isEmpty());
+        this->m_resultData = resultMap;
+    });
+}
+
+bool OcsCapabilitiesCommandEntity::startWork()
+{
+    const bool canContinue = OcsCommandEntity::startWork();
+    if (!canContinue) {
+        qWarning() << "Cannot request server capabilities";
+        abortWork();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef OCSCAPABILITIESCOMMANDENTITY_H
+#define OCSCAPABILITIESCOMMANDENTITY_H
+
+#include <QObject>
+#include "ocscommandentity.h"
+
+class OcsCapabilitiesCommandEntity : public OcsCommandEntity
+{
+    Q_OBJECT
+public:
+    explicit OcsCapabilitiesCommandEntity(
+            QObject* parent = Q_NULLPTR,
+            AccountBase* settings = Q_NULLPTR,
+            QMap<QByteArray, QByteArray> headers = prepareOcsHeaders());
+
+    bool startWork();
+};
+
+#endif // OCSCAPABILITIESCOMMANDENTITY_H
@@ -0,0 +1,118 @@
+#include "ncdircreationcommandentity.h"
+
+#include <QDebug>
+
+CommandEntityInfo dirCreationCommandInfo(const QStringList& remotePaths)
+{
+    QVariantMap info;
+    info.insert(QStringLiteral("type"), "dirCreation");
+    info.insert("remotePaths", remotePaths);
+    return CommandEntityInfo(info);
+}
+
+NcDirCreationCommandEntity::NcDirCreationCommandEntity(QObject* parent,
+                                                       CloudStorageProvider* client,
+                                                       QStringList remotePaths,
+                                                       int maxParallelRequests) :
+    CommandEntity(parent),
+    m_client(client),
+    m_pendingPaths(remotePaths),
+    m_maxParallelRequests(qMax(1, maxParallelRequests))
+{
+    this->m_commandInfo = dirCreationCommandInfo(remotePaths);
+}
+
+bool NcDirCreationCommandEntity::startWork()
+{
+    if (!CommandEntity::startWork())
+        return false;
+
+    if (!this->m_client) {
+        qWarning() << "No valid client available, aborting";
+        abortWork();
+        return false;
+    }
+
+    setState(RUNNING);
+    startPendingRequests();
+    return true;
+}
+
+bool NcDirCreationCommandEntity::abortWork()
+{
+    if (!CommandEntity::abortWork())
+        return false;
+
+    this->m_pendingPaths.clear();
+
+    // Detach first, aborting a request can emit signals synchronously
+    const QList<CommandEntity*> runningRequests = this->m_runningRequests.keys();
+    this->m_runningRequests.clear();
+    for (CommandEntity* mkdirCommand : runningRequests) {
+        QObject::disconnect(mkdirCommand, nullptr, this, nullptr);
+        mkdirCommand->abort();
+        mkdirCommand->deleteLater();
+    }
+
+    setState(ABORTED);
+    Q_EMIT aborted();
+    return true;
+}
+
+void NcDirCreationCommandEntity::startPendingRequests()
+{
+    while (this->m_runningRequests.size() < this->m_maxParallelRequests &&
+           !this->m_pendingPaths.isEmpty()) {
+        const QString remotePath = this->m_pendingPaths.takeFirst();
+
+        CommandEntity* mkdirCommand = this->m_client->makeDirectoryRequest(remotePath, false);
+        if (!mkdirCommand) {
+            qWarning() << "Failed to create MKCOL request for" << remotePath;
+            this->m_failedRequests++;
+            continue;
+        }
+
+        this->m_runningRequests.insert(mkdirCommand, remotePath);
+
+        QObject::connect(mkdirCommand, &CommandEntity::done, this, [=]() {
+            requestFinished(mkdirCommand, true);
+        });
+        QObject::connect(mkdirCommand, &CommandEntity::aborted, this, [=]() {
+            requestFinished(mkdirCommand, false);
+        });
+
+        mkdirCommand->run();
+    }
+
+    if (!this->m_runningRequests.isEmpty() || !this->m_pendingPaths.isEmpty())
+        return;
+
+    if (isFinished())
+        return;
+
+    QVariantMap result;
+    result.insert(QStringLiteral("success"), true);
+    result.insert(QStringLiteral("failedRequests"), this->m_failedRequests);
+    this->m_resultData = result;
+
+    setState(FINISHED);
+    Q_EMIT done();
+}
+
+void NcDirCreationCommandEntity::requestFinished(CommandEntity* mkdirCommand, bool finished)
+{
+    // Requests may report both an error and completion, handle only the first one
+    if (!this->m_runningRequests.contains(mkdirCommand))
+        return;
+
+    const QString remotePath = this->m_runningRequests.take(mkdirCommand);
+    QObject::disconnect(mkdirCommand, nullptr, this, nullptr);
+    mkdirCommand->deleteLater();
+
+    if (!finished) {
+        qDebug() << "Creating" << remotePath << "failed, it might exist already";
+        this->m_failedRequests++;
+    }
+
+    startPendingRequests();
+}
@@ -0,0 +1,45 @@
+#ifndef NCDIRCREATIONCOMMANDENTITY_H
+#define NCDIRCREATIONCOMMANDENTITY_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+#include <commandentity.h>
+#include <provider/storage/cloudstorageprovider.h>
+
+// Number of MKCOL requests kept in flight by default
+const int DIRCREATION_DEFAULT_PARALLEL_REQUESTS = 4;
+
+// Creates a set of remote directories which don't depend on each other,
+// e.g. all missing directories of the same depth, with up to
+// maxParallelRequests MKCOL requests in flight.
+// Failures are logged but don't fail the entity: an already existing
+// directory is reported as an error by the server as well, and transfers
+// into a directory which couldn't be created fail on their own.
+class NcDirCreationCommandEntity : public CommandEntity
+{
+    Q_OBJECT
+
+public:
+    NcDirCreationCommandEntity(QObject* parent = Q_NULLPTR,
+                               CloudStorageProvider* client = Q_NULLPTR,
+                               QStringList remotePaths = QStringList(),
+                               int maxParallelRequests = DIRCREATION_DEFAULT_PARALLEL_REQUESTS);
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+
+private:
+    void startPendingRequests();
+    void requestFinished(CommandEntity* mkdirCommand, bool finished);
+
+    CloudStorageProvider* m_client = Q_NULLPTR;
+    QStringList m_pendingPaths;
+    int m_maxParallelRequests;
+    int m_failedRequests = 0;
+
+    QHash<CommandEntity*, QString> m_runningRequests;
+};
+
+#endif // NCDIRCREATIONCOMMANDENTITY_H
@@ -2,11 +2,10 @@
 #include <QSharedPointer>
 
 #include <commands/webdav/davlistcommandentity.h>
+#include <commands/webdav/davtreelistcommandentity.h>
 
 // NcDirTreeCommandUnit builds a tree view of the cloud instance
 
-#define REACHED_END(node) (node->directory_iterator == node->directories.end())
-
 inline QVariantMap buildResultData(bool success, QSharedPointer<NcDirNode> tree)
 {
     QVariantMap result;
@@ -17,16 +16,51 @@ inline QVariantMap buildResultData(bool success, QSharedPointer<NcDirNode> tree)
     return result;
 }
 
+CommandEntity* listCommand(const QString& path,
+                           CloudStorageProvider* client)
+{
+    CommandEntity* davListCommand =
+            client->directoryListingRequest(path, false, false);
+
+    // The tree is built from the typed entries, skip QVariant conversion
+    DavListCommandEntity* davListEntity = qobject_cast<DavListCommandEntity*>(davListCommand);
+    if (davListEntity)
+        davListEntity->setVariantResultEnabled(false);
+
+    return davListCommand;
+}
+
+QString nodeNameFromPath(const QString& path)
+{
+    const QStringList splitPath = path.split(NODE_PATH_SEPARATOR, QString::SkipEmptyParts);
+    if (splitPath.isEmpty())
+        return NODE_PATH_SEPARATOR;
+    return splitPath.last();
+}
+
 CommandEntity* startingListCommand(const QString& rootPath,
-                                   CloudStorageProvider* client)
+                                   CloudStorageProvider* client,
+                                   int maxParallelListings,
+                                   bool preferTreeListing)
 {
     if (!client) {
         qWarning() << Q_FUNC_INFO << "client is null";
         return nullptr;
     }
-    CommandEntity* davListCommand =
-            client->directoryListingRequest(rootPath, false, false);
-    return davListCommand;
+
+    // Without a cached tree every directory has to be listed anyway,
+    // fetch all of them at once if the server allows it.
+    // Otherwise the ETag-pruned crawl is cheaper than a full listing.
+    if (preferTreeListing) {
+        CommandEntity* treeListCommand = client->treeListingRequest(rootPath, false);
+        if (treeListCommand)
+            return treeListCommand;
+    }
+
+    if (maxParallelListings > 1)
+        return new NcDirTreeCrawlCommandEntity(client, client, rootPath, maxParallelListings);
+
+    return listCommand(rootPath, client);
 }
 
 CommandEntityInfo defaultCommandInfo(const QString& rootPath)
@@ -40,10 +74,14 @@ CommandEntityInfo defaultCommandInfo(const QString& rootPath)
 NcDirTreeCommandUnit::NcDirTreeCommandUnit(QObject *parent,
                                            CloudStorageProvider *client,
                                            QString rootPath,
-                                           QSharedPointer<NcDirNode> cachedTree) :
-    CommandUnit(parent, {startingListCommand(rootPath, client)},
+                                           QSharedPointer<NcDirNode> cachedTree,
+                                           int maxParallelListings) :
+    CommandUnit(parent, {startingListCommand(rootPath, client, maxParallelListings,
+                                             cachedTree.isNull())},
                 defaultCommandInfo(rootPath)),
-    m_client(client)
+    m_client(client),
+    m_rootPath(rootPath),
+    m_maxParallelListings(maxParallelListings)
 {
     if (!this->queue()->front()) {
         qCritical() << "The CommandUnit is supposed to have an entity in the queue but doesn't. Bailing out.";
@@ -54,12 +92,57 @@ NcDirTreeCommandUnit::NcDirTreeCommandUnit(QObject *parent,
         this->m_rootNode = cachedTree;
     } else {
         this->m_rootNode = QSharedPointer<NcDirNode>(new NcDirNode);
-        this->m_rootNode->name = this->queue()->front()->info().property(QStringLiteral("name")).toString();
+        this->m_rootNode->name = nodeNameFromPath(rootPath);
         this->m_rootNode->parentNode = nullptr;
     }
 
     // Start content list retrieval at the root node
     this->m_currentNode = this->m_rootNode.data();
+    attachRootNode(this->queue()->front());
+}
+
+void NcDirTreeCommandUnit::attachRootNode(CommandEntity* listCommand)
+{
+    NcDirTreeCrawlCommandEntity* crawlCommand =
+            qobject_cast<NcDirTreeCrawlCommandEntity*>(listCommand);
+    if (crawlCommand)
+        crawlCommand->setRootNode(this->m_rootNode);
+}
+
+void NcDirTreeCommandUnit::applyTreeListing(DavTreeListCommandEntity* treeListCommand)
+{
+    const QHash<QString, QVector<RemoteEntry> >& listings = treeListCommand->listings();
+
+    QString rootPath = this->m_rootPath;
+    if (!rootPath.endsWith(NODE_PATH_SEPARATOR))
+        rootPath += NODE_PATH_SEPARATOR;
+
+    // Apply top-down so that unchanged subtrees are skipped the same way the crawl does
+    QVector<QPair<QString, NcDirNode*> > pendingNodes;
+    pendingNodes.append(qMakePair(QStringLiteral(""), this->m_rootNode.data()));
+
+    while (!pendingNodes.isEmpty()) {
+        const QPair<QString, NcDirNode*> pendingNode = pendingNodes.takeLast();
+
+        // A changed directory the server left out must not be emptied,
+        // it is listed on its own like the crawl would
+        if (!listings.contains(pendingNode.first)) {
+            const QString fullPath = rootPath + pendingNode.first;
+            pendingNode.second->invalidate();
+            this->queue()->push_front(listCommand(fullPath, this->m_client));
+            this->m_pendingNodes.push_back(pendingNode.second);
+            qDebug() << "Not part of the tree listing, DavListCommandEntity" << fullPath;
+            continue;
+        }
+
+        const QVector<NcDirNode*> changedDirectories =
+                pendingNode.second->applyListing(listings.value(pendingNode.first));
+
+        for (NcDirNode* node : changedDirectories) {
+            pendingNodes.append(qMakePair(pendingNode.first + node->name + NODE_PATH_SEPARATOR,
+                                          node));
+        }
+    }
 }
 
 void NcDirTreeCommandUnit::expand(CommandEntity* previousCommandEntity)
@@ -67,15 +150,50 @@ void NcDirTreeCommandUnit::expand(CommandEntity* previousCommandEntity)
     if (!previousCommandEntity)
         return;
 
-    // Command hasn't successfully finished
-    if (!previousCommandEntity->isFinished()) {
-        // iterating through child directories wouldn't be possible,
-        // so go back to the parent node if possible.
-        if (this->m_currentNode)
-            this->m_currentNode = this->m_currentNode->parentNode;
+    DavTreeListCommandEntity* treeListCommand =
+            qobject_cast<DavTreeListCommandEntity*>(previousCommandEntity);
+    if (treeListCommand) {
+        const bool success =
+                treeListCommand->resultData().value(QStringLiteral("success")).toBool();
+        if (success) {
+            applyTreeListing(treeListCommand);
+            if (!this->m_pendingNodes.isEmpty()) {
+                this->m_currentNode = this->m_pendingNodes.takeLast();
+                return;
+            }
+
+            this->m_resultData = buildResultData(true, this->m_rootNode);
+            this->m_currentNode = Q_NULLPTR;
+            return;
+        }
+
+        qInfo() << "Listing the whole tree failed, falling back to listing directory by directory";
+        CommandEntity* fallbackCommand = startingListCommand(this->m_rootPath,
+                                                             this->m_client,
+                                                             this->m_maxParallelListings,
+                                                             false);
+        if (!fallbackCommand) {
+            this->m_resultData = buildResultData(false, this->m_rootNode);
+            return;
+        }
+
+        attachRootNode(fallbackCommand);
+        this->queue()->push_front(fallbackCommand);
+        this->m_currentNode = this->m_rootNode.data();
+        return;
+    }
+
+    // The parallel crawl fills the whole tree by itself
+    if (qobject_cast<NcDirTreeCrawlCommandEntity*>(previousCommandEntity)) {
+        this->m_resultData = previousCommandEntity->resultData();
+        this->m_currentNode = Q_NULLPTR;
+        return;
     }
 
-    if (!this->m_currentNode) {
+    NcDirNode* listedNode = this->m_currentNode;
+    this->m_currentNode = Q_NULLPTR;
+
+    if (!listedNode) {
         qInfo() << "currentNode == nullptr, traversing remote tree should be complete.";
         return;
     }
@@ -83,84 +201,205 @@ void NcDirTreeCommandUnit::expand(CommandEntity* previousCommandEntity)
     const QVariantMap commandResult = previousCommandEntity->resultData();
     const int httpCode = commandResult.value(QStringLiteral("httpCode")).toInt();
     const bool success = (httpCode >= 200 && httpCode < 300);
+    const QString remotePath = previousCommandEntity->info().property(QStringLiteral("remotePath")).toString();
 
     if (!success) {
         qInfo() << "Parsing directory list failed, ignoring";
-        if (this->m_currentNode->name == NODE_PATH_SEPARATOR)
+        if (listedNode == this->m_rootNode.data()) {
             this->m_resultData = buildResultData(success, this->m_rootNode);
+            return;
+        }
+
+        // Make sure the stale subtree is listed again next time
+        listedNode->invalidate();
+    } else {
+        const QVector<RemoteEntry> directoryContent =
+                commandResult.value(QStringLiteral("entries")).value<QVector<RemoteEntry> >();
+
+        // Unchanged directories keep their cached subtree and aren't listed again
+        const QVector<NcDirNode*> changedDirectories =
+                listedNode->applyListing(directoryContent);
+
+        // NcDirNodes and the related DavListCommandEntities are pushed
+        // to the front of their respective stacks/queues in the same order
+        for (NcDirNode* node : changedDirectories) {
+            const QString fullPath = remotePath + node->name + NODE_PATH_SEPARATOR;
+            CommandEntity* additionalCommand = listCommand(fullPath, this->m_client);
+            this->queue()->push_front(additionalCommand);
+            this->m_pendingNodes.push_back(node);
+            qDebug() << "DavListCommandEntity" << fullPath;
+        }
+    }
+
+    qDebug() << "remotePath of command" << remotePath;
+    qDebug() << "listed node" << listedNode->name;
+
+    if (this->m_pendingNodes.isEmpty()) {
+        // At this point building the tree should be done
+        // as all changed directories have been listed.
+        // Point resultData to the root node as finalization step.
+        qDebug() << "Setting result" << this->m_rootNode;
+        this->m_resultData = buildResultData(true, this->m_rootNode);
         return;
     }
 
-    const QString remotePath = previousCommandEntity->info().property(QStringLiteral("remotePath")).toString();
-    const QVariantList directoryContent = commandResult.value(QStringLiteral("dirContent")).toList();
+    this->m_currentNode = this->m_pendingNodes.takeLast();
+    qDebug() << Q_FUNC_INFO << "done";
+}
 
-    for (const QVariant& tmpEntry : directoryContent) {
-        // Skip invalid variants
-        if (!tmpEntry.canConvert(QMetaType::QVariantMap))
-            continue;
+CommandEntityInfo crawlCommandInfo(const QString& rootPath)
+{
+    QVariantMap info;
+    info.insert(QStringLiteral("type"), "dirTreeCrawl");
+    info.insert("remotePath", rootPath);
+    info.insert("name", nodeNameFromPath(rootPath));
+    return CommandEntityInfo(info);
+}
+
+NcDirTreeCrawlCommandEntity::NcDirTreeCrawlCommandEntity(QObject* parent,
+                                                         CloudStorageProvider* client,
+                                                         QString rootPath,
+                                                         int maxParallelListings) :
+    CommandEntity(parent),
+    m_client(client),
+    m_rootPath(rootPath),
+    m_maxParallelListings(qMax(1, maxParallelListings))
+{
+    this->m_commandInfo = crawlCommandInfo(rootPath);
+}
+
+void NcDirTreeCrawlCommandEntity::setRootNode(QSharedPointer<NcDirNode> rootNode)
+{
+    this->m_rootNode = rootNode;
+}
 
-        const QVariantMap entry = tmpEntry.toMap();
-        const bool entryIsDirectory = entry.value(QStringLiteral("isDirectory")).toBool();
-        const QString entryName = entry.value(QStringLiteral("name")).toString();
-        const QString uniqueId = entry.value(QStringLiteral("uniqueId")).toString();
+bool NcDirTreeCrawlCommandEntity::startWork()
+{
+    if (!CommandEntity::startWork())
+        return false;
 
-        qDebug() << "entryName:" << entryName;
+    if (!this->m_client || this->m_rootNode.isNull()) {
+        qWarning() << "No valid client or root node available, aborting";
+        abortWork();
+        return false;
+    }
 
-        // Skip directory examination/file appendage in case the unique ID (entity tag) already exists
-        const bool uniqueIdsMatch = entryIsDirectory ?
-                    this->m_currentNode->containsDirWithUniqueId(uniqueId) :
-                    this->m_currentNode->containsFileWithUniqueId(uniqueId);
+    PendingDirectory root;
+    root.node = this->m_rootNode.data();
+    root.remotePath = this->m_rootPath;
+    this->m_pendingDirectories.enqueue(root);
 
-        if (uniqueIdsMatch)
-            continue;
+    setState(RUNNING);
+    startPendingListings();
+    return true;
+}
+
+bool NcDirTreeCrawlCommandEntity::abortWork()
+{
+    if (!CommandEntity::abortWork())
+        return false;
+
+    this->m_pendingDirectories.clear();
+
+    // Detach first, aborting a listing can emit signals synchronously
+    const QList<CommandEntity*> runningListings = this->m_runningListings.keys();
+    this->m_runningListings.clear();
+    for (CommandEntity* listCommand : runningListings) {
+        QObject::disconnect(listCommand, nullptr, this, nullptr);
+        listCommand->abort();
+        listCommand->deleteLater();
+    }
 
-        if (!entryIsDirectory) {
-            // Add to the list of files and
-            // continue with the next tmpEntry
-            this->m_currentNode->files.append(entry);
+    setState(ABORTED);
+    Q_EMIT aborted();
+    return true;
+}
+
+void NcDirTreeCrawlCommandEntity::startPendingListings()
+{
+    while (this->m_runningListings.size() < this->m_maxParallelListings &&
+           !this->m_pendingDirectories.isEmpty()) {
+        const PendingDirectory directory = this->m_pendingDirectories.dequeue();
+
+        CommandEntity* listCommand = ::listCommand(directory.remotePath, this->m_client);
+        if (!listCommand) {
+            qWarning() << "Failed to create listing for" << directory.remotePath;
             continue;
         }
 
-        // Prepare the necessary tree node
-        // NcDirNode and the related DavListCommandEntity are inserted
-        // into their respective lists/queues in the same order
-        NcDirNode* node = new NcDirNode;
-        node->name = entryName;
-        node->uniqueId = uniqueId ;
-        node->parentNode = this->m_currentNode;
-        this->m_currentNode->directories.prepend(node);
-
-        const QString fullPath = remotePath + entryName + NODE_PATH_SEPARATOR;
-
-        // then add required DavListCommandEntity
-        CommandEntity* additionalCommand = this->m_client->directoryListingRequest(fullPath, false, false);
-        this->queue()->push_front(additionalCommand);
-        qDebug() << "DavListCommandEntity" << fullPath;
+        this->m_runningListings.insert(listCommand, directory);
+
+        QObject::connect(listCommand, &CommandEntity::done, this, [=]() {
+            listingFinished(listCommand, true);
+        });
+        QObject::connect(listCommand, &CommandEntity::aborted, this, [=]() {
+            listingFinished(listCommand, false);
+        });
+
+        qDebug() << "DavListCommandEntity" << directory.remotePath
+                 << "in flight:" << this->m_runningListings.size();
+        listCommand->run();
     }
 
-    qDebug() << "remotePath of command" << remotePath;
-    qDebug() << "current node" << this->m_currentNode->name;
-    this->m_currentNode->directory_iterator = this->m_currentNode->directories.begin();
-
-    NcDirNode* potentialNode = this->m_currentNode;
-    while (potentialNode) {
-        if (REACHED_END(potentialNode)) {
-            potentialNode->directory_iterator = potentialNode->directories.begin();
-            potentialNode = potentialNode->parentNode;
-        } else {
-            this->m_currentNode = *potentialNode->directory_iterator++;
-            break;
+    if (this->m_runningListings.isEmpty() && this->m_pendingDirectories.isEmpty())
+        finish(true);
+}
+
+void NcDirTreeCrawlCommandEntity::listingFinished(CommandEntity* listCommand, bool finished)
+{
+    // Listings may report both an error and completion, handle only the first one
+    if (!this->m_runningListings.contains(listCommand))
+        return;
+
+    const PendingDirectory directory = this->m_runningListings.take(listCommand);
+    const QVariantMap commandResult = listCommand->resultData();
+    QObject::disconnect(listCommand, nullptr, this, nullptr);
+    listCommand->deleteLater();
+
+    const int httpCode = commandResult.value(QStringLiteral("httpCode")).toInt();
+    const bool success = finished && (httpCode >= 200 && httpCode < 300);
+
+    if (!success) {
+        qInfo() << "Listing" << directory.remotePath << "failed, ignoring";
+
+        // Without the root listing there is no tree to report
+        if (directory.node == this->m_rootNode.data()) {
+            this->m_pendingDirectories.clear();
+            if (this->m_runningListings.isEmpty())
+                finish(false);
+            return;
         }
+
+        // Make sure the stale subtree is listed again next time
+        directory.node->invalidate();
+        startPendingListings();
+        return;
     }
 
-    if (!potentialNode) {
-        // At this point building the tree should be done
-        // as all children of all nodes would be iterated.
-        // Point resultData to the root node as finalization step.
-        qDebug() << "Setting result" << this->m_rootNode;
-        this->m_resultData = buildResultData(success, this->m_rootNode);
-        this->m_currentNode = Q_NULLPTR;
+    const QVector<RemoteEntry> directoryContent =
+            commandResult.value(QStringLiteral("entries")).value<QVector<RemoteEntry> >();
+
+    // Nodes are created in listing order independent of which
+    // request completes first, resulting in the same tree as the serial crawl.
+    // Unchanged directories keep their cached subtree and aren't listed again.
+    const QVector<NcDirNode*> changedDirectories = directory.node->applyListing(directoryContent);
+    for (NcDirNode* node : changedDirectories) {
+        PendingDirectory childDirectory;
+        childDirectory.node = node;
+        childDirectory.remotePath = directory.remotePath + node->name + NODE_PATH_SEPARATOR;
+        this->m_pendingDirectories.enqueue(childDirectory);
     }
 
-    qDebug() << Q_FUNC_INFO << "done";
+    startPendingListings();
+}
+
+void NcDirTreeCrawlCommandEntity::finish(bool success)
+{
+    if (isFinished())
+        return;
+
+    qDebug() << "Parallel crawl of" << this->m_rootPath << "complete, success:" << success;
+    this->m_resultData = buildResultData(success, this->m_rootNode);
+    setState(FINISHED);
+    Q_EMIT done();
 }
@@ -4,13 +4,19 @@
 #include <QObject>
 #include <QVector>
 #include <QVectorIterator>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
 #include <QSharedPointer>
 #include <commandunit.h>
 #include <settings/nextcloudsettingsbase.h>
 #include <provider/storage/cloudstorageprovider.h>
+#include <provider/storage/remoteentry.h>
 
 const QString NODE_PATH_SEPARATOR = QStringLiteral("/");
 
+class DavTreeListCommandEntity;
+
 class NcDirNode : public QObject
 {
     Q_OBJECT
@@ -27,77 +33,196 @@ public:
         }
     }
 
-    bool containsDirWithUniqueId(const QString& uniqueId)
+    bool containsFileWithUniqueId(const RemoteEntry::EntityTag& uniqueId) const
     {
-        if (uniqueId.isEmpty())
+        if (uniqueId.isNull())
             return false;
+        return this->fileUniqueIds.contains(uniqueId);
+    }
 
-        for (const NcDirNode* directory : this->directories) {
-            if (directory->uniqueId == uniqueId)
-                return true;
-        }
-        return false;
+    // Child lookups by name are backed by hash indices which are
+    // maintained by addDirectory() and addFile(), so resolving a path
+    // costs O(path depth) instead of scanning every child on each level.
+    NcDirNode* directory(const QString& name) const
+    {
+        return this->directoryIndex.value(name, nullptr);
     }
 
-    bool containsFileWithUniqueId(const QString& uniqueId)
+    bool containsFile(const QString& name) const
     {
-        if (uniqueId.isEmpty())
-            return false;
+        return this->fileIndex.contains(name);
+    }
 
-        for (const QVariantMap& file : this->files) {
-            const QString fileUniqueId = file.value(QStringLiteral("uniqueId")).toString();
-            if (fileUniqueId.isEmpty())
-                continue;
-            if (uniqueId == fileUniqueId)
-                return true;
-        }
-        return false;
+    void addDirectory(NcDirNode* directory)
+    {
+        if (!directory)
+            return;
+
+        directory->parentNode = this;
+        this->directories.prepend(directory);
+        this->directoryIndex.insert(directory->name, directory);
     }
 
-    NcDirNode* getNode(const QString& path)
+    void removeDirectory(NcDirNode* directory)
     {
-        if (this->directories.empty())
-            return nullptr;
+        if (!directory)
+            return;
 
-        QStringList crumbs = path.split("/", QString::SkipEmptyParts);
-        if (crumbs.empty())
-            return nullptr;
+        this->directories.removeOne(directory);
+        if (this->directoryIndex.value(directory->name) == directory)
+            this->directoryIndex.remove(directory->name);
+        delete directory;
+    }
 
-        QVector<NcDirNode*>::iterator potentialNodeIterator = directories.begin();
-        NcDirNode* potentialNode = this;
-        while (potentialNode) {
-            if (potentialNode->name == crumbs.first()) {
-                crumbs.takeFirst();
+    void addFile(const RemoteEntry& file)
+    {
+        this->fileIndex.insert(file.name, this->files.size());
+        this->files.append(file);
+        if (!file.entityTag.isNull())
+            this->fileUniqueIds.insert(file.entityTag);
+    }
+
+    void clearFiles()
+    {
+        this->files.clear();
+        this->fileIndex.clear();
+        this->fileUniqueIds.clear();
+    }
+
+    // Forget the entity tag so that the directory gets listed
+    // again on the next refresh, e.g. after its listing failed.
+    // Unchanged ancestors would hide it, so they are forgotten as well.
+    void invalidate()
+    {
+        for (NcDirNode* node = this; node; node = node->parentNode)
+            node->uniqueId = RemoteEntry::EntityTag();
+    }
+
+    // Applies a directory listing to this node. The listing is authoritative
+    // for the immediate children: files are replaced and vanished directories
+    // are dropped. Nextcloud propagates entity tags up the tree, so child
+    // directories with an unchanged entity tag keep their cached subtree.
+    // Returns the new or changed child directories which need to be listed,
+    // in listing order.
+    QVector<NcDirNode*> applyListing(const QVector<RemoteEntry>& entries)
+    {
+        QVector<NcDirNode*> changedDirectories;
+        QSet<QString> listedDirectories;
+
+        clearFiles();
+        this->dirty = true;
+
+        for (const RemoteEntry& entry : entries) {
+            if (!entry.isDirectory()) {
+                addFile(entry);
+                continue;
             }
 
-            if (crumbs.empty())
-                break;
+            listedDirectories.insert(entry.name);
+
+            NcDirNode* node = directory(entry.name);
+            if (node) {
+                const bool unchanged = (!entry.entityTag.isNull() &&
+                                        node->uniqueId == entry.entityTag);
+                if (unchanged)
+                    continue;
 
-            if (potentialNodeIterator == directories.end()) {
-                potentialNode = nullptr;
-                break;
+                node->uniqueId = entry.entityTag;
+                changedDirectories.append(node);
+                continue;
             }
 
-            potentialNode = *(potentialNodeIterator++);
+            node = new NcDirNode;
+            node->name = entry.name;
+            node->uniqueId = entry.entityTag;
+            addDirectory(node);
+            changedDirectories.append(node);
         }
 
-        // If there are remaining crumbs the path couldn't be fully resolved
-        if (!crumbs.empty())
+        const QVector<NcDirNode*> existingDirectories = this->directories;
+        for (NcDirNode* node : existingDirectories) {
+            if (!listedDirectories.contains(node->name))
+                removeDirectory(node);
+        }
+
+        return changedDirectories;
+    }
+
+    NcDirNode* getNode(const QString& path)
+    {
+        const QStringList crumbs = path.split(NODE_PATH_SEPARATOR, QString::SkipEmptyParts);
+        if (crumbs.empty())
             return nullptr;
 
+        NcDirNode* potentialNode = this;
+        for (const QString& crumb : crumbs) {
+            potentialNode = potentialNode->directory(crumb);
+
+            // The path couldn't be fully resolved
+            if (!potentialNode)
+                return nullptr;
+        }
+
         return potentialNode;
     }
 
     NcDirNode* parentNode = nullptr;
 
     QString name;
-    QString uniqueId;
-    QVector<QVariantMap> files;
+    RemoteEntry::EntityTag uniqueId;
+    QVector<RemoteEntry> files;
     QVector<NcDirNode*> directories;
-    QVector<NcDirNode*>::iterator directory_iterator;
+
+    // Set whenever the content of this node changed since it has been persisted
+    bool dirty = false;
+
+    QHash<QString, NcDirNode*> directoryIndex;
+    QHash<QString, int> fileIndex;
+    QSet<RemoteEntry::EntityTag> fileUniqueIds;
 };
 Q_DECLARE_METATYPE(NcDirNode*)
 
+// Number of directory listings kept in flight by default.
+// A value of 1 selects the serial crawl.
+const int DIRTREE_DEFAULT_PARALLEL_LISTINGS = 4;
+
+// Crawls the remote tree breadth-first with a window of
+// up to maxParallelListings PROPFIND requests in flight.
+class NcDirTreeCrawlCommandEntity : public CommandEntity
+{
+    Q_OBJECT
+
+public:
+    NcDirTreeCrawlCommandEntity(QObject* parent = Q_NULLPTR,
+                                CloudStorageProvider* client = Q_NULLPTR,
+                                QString rootPath = NODE_PATH_SEPARATOR,
+                                int maxParallelListings = DIRTREE_DEFAULT_PARALLEL_LISTINGS);
+
+    void setRootNode(QSharedPointer<NcDirNode> rootNode);
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+
+private:
+    struct PendingDirectory {
+        NcDirNode* node = Q_NULLPTR;
+        QString remotePath;
+    };
+
+    void startPendingListings();
+    void listingFinished(CommandEntity* listCommand, bool finished);
+    void finish(bool success);
+
+    CloudStorageProvider* m_client = Q_NULLPTR;
+    QString m_rootPath;
+    int m_maxParallelListings;
+    QSharedPointer<NcDirNode> m_rootNode;
+
+    QQueue<PendingDirectory> m_pendingDirectories;
+    QHash<CommandEntity*, PendingDirectory> m_runningListings;
+};
+
 class NcDirTreeCommandUnit : public CommandUnit
 {
     Q_OBJECT
@@ -106,20 +231,33 @@ public:
     NcDirTreeCommandUnit(QObject* parent = Q_NULLPTR,
                          CloudStorageProvider* client = Q_NULLPTR,
                          QString rootPath = NODE_PATH_SEPARATOR,
-                         QSharedPointer<NcDirNode> cachedTree = QSharedPointer<NcDirNode>());
+                         QSharedPointer<NcDirNode> cachedTree = QSharedPointer<NcDirNode>(),
+                         int maxParallelListings = 1);
+
+    QSharedPointer<NcDirNode> rootNode() const { return this->m_rootNode; }
 
 protected:
     void expand(CommandEntity* previousCommandEntity) Q_DECL_OVERRIDE;
 
 private:
+    void attachRootNode(CommandEntity* listCommand);
+    void applyTreeListing(DavTreeListCommandEntity* treeListCommand);
+
     CloudStorageProvider* m_client;
     AccountBase* m_settings;
     QSharedPointer<NcDirNode> m_rootNode;
+    QString m_rootPath;
+    int m_maxParallelListings;
 
-    // As the list commands are run serially we can keep
+    // As the list commands are run serially in the default
+    // (non-parallel) mode we can keep
     // a pointer to the currently processed node to avoid
     // additional traversion of the whole tree.
     NcDirNode* m_currentNode = Q_NULLPTR;
+
+    // Nodes whose listings have been pushed to the front of the queue,
+    // the last element belongs to the next list command to be run.
+    QVector<NcDirNode*> m_pendingNodes;
 };
 
 #endif // NCDIRTREECOMMANDUNIT_H
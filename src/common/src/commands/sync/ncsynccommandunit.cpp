@@ -3,18 +3,40 @@
 #include <provider/storage/cloudstorageprovider.h>
 #include <commands/webdav/mkdavdircommandentity.h>
 #include <commands/webdav/fileuploadcommandentity.h>
+#include <commands/webdav/ncbulkuploadcommandentity.h>
 #include <commands/webdav/davproppatchcommandentity.h>
+#include <settings/db/syncdb.h>
+#include <commands/sync/ncsyncreconciler.h>
+#include <commands/sync/ncdircreationcommandentity.h>
+#include <commands/sync/ncsyncdedupcommandentity.h>
+#include <commands/transferlanescommandentity.h>
+#include <util/filefingerprint.h>
 
 #include <QDir>
+#include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
+#include <QMap>
+#include <QSet>
 
 CommandEntity* defaultCommandEntity(QObject* parent,
                                     CloudStorageProvider* client,
                                     QString remotePath,
-                                    QSharedPointer<NcDirNode> cachedTree)
+                                    QSharedPointer<NcDirNode> cachedTree,
+                                    int maxParallelListings)
 {
-    return new NcDirTreeCommandUnit(parent, client, remotePath, cachedTree);
+    return new NcDirTreeCommandUnit(parent, client, remotePath, cachedTree, maxParallelListings);
+}
+
+// Prefers the tree kept in memory, falls back to the one persisted in the SyncDb
+QSharedPointer<NcDirNode> initialTree(SyncDb* syncDb,
+                                      const QString& localPath,
+                                      const QString& remotePath,
+                                      QSharedPointer<NcDirNode> cachedTree)
+{
+    if (!cachedTree.isNull() || !syncDb)
+        return cachedTree;
+    return syncDb->loadTree(localPath, remotePath);
 }
 
 CommandEntityInfo defaultCommandInfo(const QString& localPath, const QString& remotePath)
@@ -30,15 +52,27 @@ NcSyncCommandUnit::NcSyncCommandUnit(QObject* parent,
                                      CloudStorageProvider* client,
                                      QString localPath,
                                      QString remotePath,
-                                     QSharedPointer<NcDirNode> cachedTree) :
-    CommandUnit(parent, {defaultCommandEntity(parent, client, remotePath, cachedTree)},
+                                     QSharedPointer<NcDirNode> cachedTree,
+                                     int maxParallelListings,
+                                     SyncDb* syncDb,
+                                     int maxParallelTransfers) :
+    CommandUnit(parent, {defaultCommandEntity(parent, client, remotePath,
+                                              initialTree(syncDb, localPath,
+                                                          remotePath, cachedTree),
+                                              maxParallelListings)},
                 defaultCommandInfo(localPath, remotePath)),
     m_client(client),
     m_localPath(localPath),
     m_remotePath(remotePath),
-    m_cachedTree(cachedTree)
+    m_cachedTree(cachedTree),
+    m_maxParallelListings(maxParallelListings),
+    m_syncDb(syncDb),
+    m_maxParallelTransfers(maxParallelTransfers)
 {
-
+    NcDirTreeCommandUnit* treeCommandUnit =
+            qobject_cast<NcDirTreeCommandUnit*>(this->queue()->front());
+    if (treeCommandUnit)
+        this->m_cachedTree = treeCommandUnit->rootNode();
 }
 
 QSharedPointer<NcDirNode> NcSyncCommandUnit::cachedTree()
@@ -46,52 +80,75 @@ QSharedPointer<NcDirNode> NcSyncCommandUnit::cachedTree()
     return this->m_cachedTree;
 }
 
-bool NcSyncCommandUnit::fileExistsRemotely(const QString& localFilePath,
-                                           QStringList& missingDirectories)
+bool NcSyncCommandUnit::startWork()
 {
-    const QString relativeFilePath = localFilePath.mid(this->m_localPath.length());
-    QStringList pathCrumbs = relativeFilePath.split("/", QString::SkipEmptyParts);
-    const QString fileName = pathCrumbs.takeLast();
-    NcDirNode* node = this->m_cachedTree.data();
+    // Small files are batched into bulk uploads and compressible ones are sent
+    // compressed if the server supports it, which is usually known by the
+    // time the tree listing is complete
+    CommandEntity* capabilitiesCommand =
+            this->m_client ? this->m_client->capabilitiesRequest(false) : Q_NULLPTR;
+    if (capabilitiesCommand) {
+        QObject::connect(capabilitiesCommand, &CommandEntity::done,
+                         capabilitiesCommand, &QObject::deleteLater);
+        QObject::connect(capabilitiesCommand, &CommandEntity::aborted,
+                         capabilitiesCommand, &QObject::deleteLater);
+        capabilitiesCommand->run();
+    }
+
+    return CommandUnit::startWork();
+}
 
-    qDebug() << "fileName" << fileName;
-    while (node && !pathCrumbs.isEmpty()) {
-        qDebug() << "node name" << node->name;
-        qDebug() << "crumb" << pathCrumbs[0];
+void NcSyncCommandUnit::planParentDirectory(const QString& relativeFilePath,
+                                            QSet<QString>& plannedDirectories,
+                                            QMap<int, QStringList>& directoriesByDepth)
+{
+    QStringList pathCrumbs = relativeFilePath.split(NODE_PATH_SEPARATOR, QString::SkipEmptyParts);
+    if (pathCrumbs.isEmpty())
+        return;
 
-        NcDirNode* nextNode = nullptr;
-        for (NcDirNode* potentialNode : node->directories) {
-            if (!potentialNode) {
-                qDebug() << "potentialNode is a nullptr";
-                continue;
-            }
+    pathCrumbs.takeLast();
+    NcDirNode* node = this->m_cachedTree.data();
+    QString directoryPath;
+    int depth = 0;
 
-            qDebug() << potentialNode->name;
-            if (potentialNode->name == pathCrumbs.first()) {
-                qDebug() << "next node:" << potentialNode->name;
-                nextNode = potentialNode;
-                pathCrumbs.takeFirst();
-                break;
-            }
-        }
+    // Resolve the existing part crumb by crumb through the node indices
+    while (node && depth < pathCrumbs.length()) {
+        NcDirNode* nextNode = node->directory(pathCrumbs.at(depth));
+        if (!nextNode)
+            break;
+
+        directoryPath += pathCrumbs.at(depth) + NODE_PATH_SEPARATOR;
         node = nextNode;
+        depth++;
     }
 
-    const bool isFile = (pathCrumbs.isEmpty());
-    bool fileFound = false;
-    if (isFile && node) {
-        // examine the node's list of files for the file name
-        for (QVariant file : node->files) {
-            QVariantMap fileInfo = file.toMap();
-            //qDebug() << "fileInfo" << fileInfo;
-            if (fileInfo.value("name").toString() == fileName) {
-                fileFound = true;
-            }
-        }
+    // The parent exists already
+    if (depth == pathCrumbs.length())
+        return;
+
+    // Every missing directory is planned exactly once, at its depth
+    for (; depth < pathCrumbs.length(); depth++) {
+        directoryPath += pathCrumbs.at(depth) + NODE_PATH_SEPARATOR;
+        if (plannedDirectories.contains(directoryPath))
+            continue;
+
+        plannedDirectories.insert(directoryPath);
+        directoriesByDepth[depth + 1].append(this->m_remotePath + directoryPath);
     }
+}
+
+bool NcSyncCommandUnit::remoteFileExists(const QString& relativeFilePath)
+{
+    if (!this->m_cachedTree)
+        return false;
+
+    const int separatorIndex = relativeFilePath.lastIndexOf(NODE_PATH_SEPARATOR);
+    const QString directoryPath = relativeFilePath.left(separatorIndex + 1);
+    const QString fileName = relativeFilePath.mid(separatorIndex + 1);
 
-    missingDirectories.append(pathCrumbs);
-    return fileFound;
+    NcDirNode* node = directoryPath.isEmpty() ? this->m_cachedTree.data()
+                                              : this->m_cachedTree->getNode(directoryPath);
+    return node && node->containsFile(fileName);
 }
 
 void NcSyncCommandUnit::expand(CommandEntity *previousCommandEntity)
@@ -108,6 +165,18 @@ void NcSyncCommandUnit::expand(CommandEntity *previousCommandEntity)
 
     const QString commandType = previousCommandEntity->info().property(QStringLiteral("type")).toString();
 
+    if (commandType == QStringLiteral("syncDedup")) {
+        NcSyncDedupCommandEntity* dedupCommand =
+                qobject_cast<NcSyncDedupCommandEntity*>(previousCommandEntity);
+        if (!dedupCommand) {
+            qWarning() << "NcSyncDedupCommandEntity couldn't be retrieved";
+            return;
+        }
+
+        planOperations(dedupCommand->operations(), dedupCommand);
+        return;
+    }
+
     if (commandType != QStringLiteral("dirTree")) {
         qWarning() << Q_FUNC_INFO << "command isn't of type 'dirTree' but" << commandType;
         return;
@@ -126,14 +195,23 @@ void NcSyncCommandUnit::expand(CommandEntity *previousCommandEntity)
             qInfo() << "trying to create target directory";
             this->m_directoryCreation = true;
 
-            CommandEntity* mkdirCommand =
-                    this->m_client->makeDirectoryRequest(this->m_remotePath, false);
+            // Parents first as MKCOL isn't recursive,
+            // existing ones are rejected by the server which is fine.
+            const QStringList crumbs = this->m_remotePath.split(NODE_PATH_SEPARATOR,
+                                                               QString::SkipEmptyParts);
+            QString directoryPath = NODE_PATH_SEPARATOR;
+            for (const QString& crumb : crumbs) {
+                directoryPath += crumb + NODE_PATH_SEPARATOR;
+                this->queue()->push_back(new NcDirCreationCommandEntity(parent(),
+                                                                        this->m_client,
+                                                                        {directoryPath}));
+            }
 
-            this->queue()->push_back(mkdirCommand);
             this->queue()->push_back(defaultCommandEntity(parent(),
                                                           this->m_client,
                                                           this->m_remotePath,
-                                                          this->m_cachedTree));
+                                                          this->m_cachedTree,
+                                                          this->m_maxParallelListings));
             return;
         } else {
             qWarning() << "Failed to create remote target directory. Bailing out.";
@@ -149,11 +227,12 @@ void NcSyncCommandUnit::expand(CommandEntity *previousCommandEntity)
         return;
     }
 
-    QDirIterator localIterator(this->m_localPath, QDirIterator::Subdirectories);
-
-    // Avoid duplicate creation of the same directory as this will break the unit
-    QStringList dirsToCreate;
+    if (this->m_syncDb)
+        this->m_syncDb->storeTree(this->m_localPath, this->m_remotePath, this->m_cachedTree);
 
+    // Current local state
+    QHash<QString, NcSyncJournalEntry> localFiles;
+    QDirIterator localIterator(this->m_localPath, QDirIterator::Subdirectories);
     while (localIterator.hasNext()) {
         const QString sourcePath = localIterator.next();
         QFileInfo fileInfo(sourcePath);
@@ -162,65 +241,158 @@ void NcSyncCommandUnit::expand(CommandEntity *previousCommandEntity)
         if (fileInfo.isDir())
             continue;
 
-        QStringList missingDirectories;
-        const bool exists = fileExistsRemotely(sourcePath, missingDirectories);
-        qDebug() << "file exists remotely?" << exists;
-
-        /*const QString remoteRelativeFilePath = localFilePath.mid(this->m_localPath.length());
-        const QString remoteRelativeDir = remoteRelativeFilePath.split('/', QString::SkipEmptyParts).join('/');
-        NcDirNode* node = this->m_cachedTree->getNode(remoteRelativeDir);
-        const bool uniqueIdExists = (node && node->containsFileWithUniqueId());*/
+        const QString relativePath =
+                sourcePath.mid(this->m_localPath.length())
+                .split(NODE_PATH_SEPARATOR, QString::SkipEmptyParts)
+                .join(NODE_PATH_SEPARATOR);
+        localFiles.insert(relativePath, NcSyncJournalEntry::fromFileInfo(relativePath, fileInfo));
+    }
 
-        // TODO: Remove files that don't exist remotely anymore
-        // Might need a 3-way comparison (local past, local now, server now)
-        // Policy: in case of doubt the server wins
+    // 3-way comparison (local past, local now, server now)
+    // Policy: in case of doubt the server wins
+    const QHash<QString, NcSyncJournalEntry> journal =
+            this->m_syncDb ? this->m_syncDb->loadJournal(this->m_localPath)
+                           : QHash<QString, NcSyncJournalEntry>();
+    NcSyncReconciler reconciler(journal, localFiles, this->m_cachedTree.data());
+    reconciler.reconcile();
+
+    if (this->m_syncDb) {
+        this->m_syncDb->storeJournalEntries(this->m_localPath,
+                                            reconciler.journalUpdates(),
+                                            reconciler.journalRemovals());
+    }
 
-        // Skip the file upload if it already exists remotely
-        if (exists)
-            continue;
+    // Checking uploads against the ones done before and confirming local copies
+    // reads the files, which happens step by step in a command of its own.
+    // Without a SyncDb there is neither, the journal is empty.
+    if (this->m_syncDb) {
+        this->queue()->push_back(new NcSyncDedupCommandEntity(parent(),
+                                                              this->m_syncDb,
+                                                              this->m_localPath,
+                                                              reconciler.operations(),
+                                                              journal,
+                                                              localFiles,
+                                                              [this](const QString& relativePath) {
+            return remoteFileExists(relativePath);
+        }));
+        return;
+    }
 
-        // Create missing directories first if any
-        if (missingDirectories.length() > 0) {
-            QString missingRelativeDir = this->m_remotePath;
-            for (QString remainingCrumb : missingDirectories) {
-                missingRelativeDir += remainingCrumb + NODE_PATH_SEPARATOR;
+    planOperations(reconciler.operations(), Q_NULLPTR);
+}
 
-                if (dirsToCreate.contains(missingRelativeDir))
+void NcSyncCommandUnit::planOperations(const QVector<NcSyncReconciler::Operation>& operations,
+                                       NcSyncDedupCommandEntity* dedupCommand)
+{
+    // Missing directories are created depth by depth with concurrent MKCOLs per depth.
+    // The directories are cheap to create, all of them are created before any
+    // transfer so that no depth has to wait for the uploads into the one above.
+    // Then all operations share the lanes, regardless of their depth.
+    QSet<QString> plannedDirectories;
+    QMap<int, QStringList> directoriesByDepth;
+    TransferLanesCommandEntity* transfers = Q_NULLPTR;
+    NcBulkUploadCommandEntity* bulkUpload = Q_NULLPTR;
+    const QString host = this->m_client->settings() ? this->m_client->settings()->hostname()
+                                                    : QStringLiteral("");
+
+    auto transferLanes = [&]() {
+        if (!transfers)
+            transfers = new TransferLanesCommandEntity(parent(), this->m_maxParallelTransfers);
+        return transfers;
+    };
+
+    for (const NcSyncReconciler::Operation& operation : operations) {
+        const FileFingerprint fingerprint = dedupCommand
+                ? dedupCommand->fingerprint(operation.relativePath) : FileFingerprint();
+
+        planParentDirectory(operation.relativePath, plannedDirectories, directoriesByDepth);
+
+        const QString targetFilePath = this->m_remotePath + operation.relativePath;
+        CommandEntity* command = Q_NULLPTR;
+        bool batched = false;
+
+        switch (operation.type) {
+        case NcSyncReconciler::Operation::Upload:
+        {
+            const QString sourcePath = QDir(this->m_localPath).filePath(operation.relativePath);
+            const QString targetPath = targetFilePath.left(targetFilePath.lastIndexOf(NODE_PATH_SEPARATOR) + 1);
+            qDebug() << "Uploading" << sourcePath << "to" << targetPath;
+
+            // Small files go into the current batch, which is sent once full
+            if (operation.journalEntry.size <= NCBULKUPLOAD_DEFAULT_MAX_FILE_SIZE) {
+                if (!bulkUpload)
+                    bulkUpload = this->m_client->bulkUploadRequest(false);
+
+                if (bulkUpload) {
+                    command = bulkUpload->addFile(sourcePath, targetFilePath,
+                                                  QFileInfo(sourcePath).lastModified());
+                    batched = true;
+
+                    if (bulkUpload->fileCount() >= NCBULKUPLOAD_DEFAULT_MAX_FILES) {
+                        transferLanes()->addTransfer(bulkUpload, host, bulkUpload->byteCount());
+                        bulkUpload = Q_NULLPTR;
+                    }
                     break;
-                dirsToCreate.append(missingRelativeDir);
-
-                CommandEntity* mkdirCommand =
-                        this->m_client->makeDirectoryRequest(missingRelativeDir, false);
-                this->queue()->push_back(mkdirCommand);
+                }
             }
-        }
 
-        // Upload the file
-        qDebug() << sourcePath;
-        qDebug() << this->m_localPath;
-
-        // Build target directory string
-        // Remove m_localPath from sourcePath and build list of directories
-        QStringList targetDirectory =
-                sourcePath.mid(this->m_localPath.length())
-                .split('/', QString::SkipEmptyParts);
+            command = this->m_client->fileUploadRequest(sourcePath, targetPath,
+                                                        QFileInfo(sourcePath).lastModified(), false);
+            break;
+        }
+        case NcSyncReconciler::Operation::Move:
+            qDebug() << "Moving" << operation.sourcePath << "to" << operation.relativePath;
+            command = this->m_client->moveRequest(this->m_remotePath + operation.sourcePath,
+                                                  targetFilePath, false);
+            break;
+        case NcSyncReconciler::Operation::Copy:
+            qDebug() << "Copying" << operation.sourcePath << "to" << operation.relativePath;
+            command = this->m_client->copyRequest(this->m_remotePath + operation.sourcePath,
+                                                  targetFilePath, false);
+            break;
+        }
 
-        QString relativeTargetDir;
+        if (!command)
+            continue;
 
-        // Join directories back together without the file name
-        if (!targetDirectory.isEmpty()) {
-            targetDirectory.takeLast();
-            relativeTargetDir = targetDirectory.join('/') + NODE_PATH_SEPARATOR;
+        // Record the new state once the server has it
+        if (this->m_syncDb) {
+            SyncDb* syncDb = this->m_syncDb;
+            const QString localPath = this->m_localPath;
+            const NcSyncJournalEntry journalEntry = operation.journalEntry;
+            const QStringList removedPaths = (operation.type == NcSyncReconciler::Operation::Move)
+                    ? QStringList(operation.sourcePath) : QStringList();
+            const QString relativePath = operation.relativePath;
+            QObject::connect(command, &CommandEntity::done, syncDb, [=]() {
+                syncDb->storeJournalEntries(localPath, {journalEntry}, removedPaths);
+                if (fingerprint.isValid())
+                    syncDb->storeFingerprint(localPath, relativePath, fingerprint);
+            });
         }
 
-        qDebug() << "relativeTargetDir" << relativeTargetDir;
+        // Batched files are transferred along with their batch
+        if (batched)
+            continue;
+
+        // Server side moves and copies hardly transfer anything, weigh them accordingly
+        const qint64 bytes = (operation.type == NcSyncReconciler::Operation::Upload)
+                ? qMax<qint64>(1, operation.journalEntry.size) : 1;
+        transferLanes()->addTransfer(command, host, bytes);
+    }
 
-        const QString targetPath = this->m_remotePath + relativeTargetDir;
-        CommandEntity* uploadCommand =
-                this->m_client->fileUploadRequest(sourcePath, targetPath, fileInfo.lastModified(), false);
+    // Send the batch which didn't fill up
+    if (bulkUpload)
+        transferLanes()->addTransfer(bulkUpload, host, bulkUpload->byteCount());
 
-        this->queue()->push_back(uploadCommand);
+    for (auto it = directoriesByDepth.constBegin(); it != directoriesByDepth.constEnd(); ++it) {
+        qDebug() << "Creating" << it.value().length() << "directories at depth" << it.key();
+        this->queue()->push_back(new NcDirCreationCommandEntity(parent(),
+                                                                this->m_client,
+                                                                it.value()));
     }
 
+    if (transfers)
+        this->queue()->push_back(transfers);
+
     qDebug() << "directories.length()" << this->m_cachedTree->directories.length();
 }
@@ -6,7 +6,14 @@
 #include <qwebdav.h>
 #include <settings/nextcloudsettingsbase.h>
 #include <commands/sync/ncdirtreecommandunit.h>
+#include <commands/transferlanescommandentity.h>
+#include <commands/sync/ncsyncreconciler.h>
 #include <QSharedPointer>
+#include <QMap>
+#include <QSet>
+
+class NcSyncDedupCommandEntity;
+class SyncDb;
 
 class NcSyncCommandUnit : public CommandUnit
 {
@@ -16,22 +23,36 @@ public:
                                CloudStorageProvider* client = Q_NULLPTR,
                                QString localPath = QStringLiteral(""),
                                QString remotePath = QStringLiteral(""),
-                               QSharedPointer<NcDirNode> cachedTree = QSharedPointer<NcDirNode>(Q_NULLPTR));
+                               QSharedPointer<NcDirNode> cachedTree = QSharedPointer<NcDirNode>(Q_NULLPTR),
+                               int maxParallelListings = DIRTREE_DEFAULT_PARALLEL_LISTINGS,
+                               SyncDb* syncDb = Q_NULLPTR,
+                               int maxParallelTransfers = TRANSFERLANES_DEFAULT_LANES);
 
     QSharedPointer<NcDirNode> cachedTree();
 
 protected:
+    bool startWork() Q_DECL_OVERRIDE;
     void expand(CommandEntity* previousCommandEntity);
 
 private:
-    bool fileExistsRemotely(const QString& localFilePath,
-                            QStringList& missingDirectories);
+    // Plans the transfers, the fingerprints of the uploads come from dedupCommand
+    void planOperations(const QVector<NcSyncReconciler::Operation>& operations,
+                        NcSyncDedupCommandEntity* dedupCommand);
+
+    // Plans the creation of the missing parent directories of relativeFilePath
+    void planParentDirectory(const QString& relativeFilePath,
+                             QSet<QString>& plannedDirectories,
+                             QMap<int, QStringList>& directoriesByDepth);
+    bool remoteFileExists(const QString& relativeFilePath);
 
     CloudStorageProvider* m_client = Q_NULLPTR;
     QString m_localPath;
     QString m_remotePath;
     QSharedPointer<NcDirNode> m_cachedTree;
     bool m_directoryCreation = false;
+    int m_maxParallelListings;
+    SyncDb* m_syncDb = Q_NULLPTR;
+    int m_maxParallelTransfers;
 
 };
 
@@ -0,0 +1,220 @@
+#include "ncsyncdedupcommandentity.h"
+
+#include <settings/db/syncdb.h>
+#include <util/filehasher.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QTimer>
+
+CommandEntityInfo syncDedupCommandInfo(const QString& localPath, int operationCount)
+{
+    QVariantMap info;
+    info.insert(QStringLiteral("type"), "syncDedup");
+    info.insert("localPath", localPath);
+    info.insert("operations", operationCount);
+    return CommandEntityInfo(info);
+}
+
+NcSyncDedupCommandEntity::NcSyncDedupCommandEntity(QObject* parent,
+                                                   SyncDb* syncDb,
+                                                   const QString& localPath,
+                                                   const QVector<NcSyncReconciler::Operation>& operations,
+                                                   const QHash<QString, NcSyncJournalEntry>& journal,
+                                                   const QHash<QString, NcSyncJournalEntry>& localFiles,
+                                                   RemoteFileCheck remoteFileExists) :
+    CommandEntity(parent),
+    m_syncDb(syncDb),
+    m_localPath(localPath),
+    m_pendingOperations(operations),
+    m_journal(journal),
+    m_localFiles(localFiles),
+    m_remoteFileExists(remoteFileExists)
+{
+    this->m_commandInfo = syncDedupCommandInfo(localPath, operations.size());
+    this->m_operations.reserve(operations.size());
+}
+
+const QVector<NcSyncReconciler::Operation>& NcSyncDedupCommandEntity::operations() const
+{
+    return this->m_operations;
+}
+
+FileFingerprint NcSyncDedupCommandEntity::fingerprint(const QString& relativePath) const
+{
+    return this->m_fingerprints.value(relativePath);
+}
+
+bool NcSyncDedupCommandEntity::startWork()
+{
+    if (!CommandEntity::startWork())
+        return false;
+
+    setState(RUNNING);
+    QTimer::singleShot(0, this, &NcSyncDedupCommandEntity::checkNextOperation);
+    return true;
+}
+
+bool NcSyncDedupCommandEntity::abortWork()
+{
+    if (!CommandEntity::abortWork())
+        return false;
+
+    this->m_stopped = true;
+    stopHashing();
+
+    setState(ABORTED);
+    Q_EMIT aborted();
+    return true;
+}
+
+void NcSyncDedupCommandEntity::checkNextOperation()
+{
+    if (this->m_stopped)
+        return;
+
+    // Operations which don't touch the file content pass through right away
+    while (this->m_nextOperation < this->m_pendingOperations.size()) {
+        const NcSyncReconciler::Operation operation =
+                this->m_pendingOperations.at(this->m_nextOperation++);
+        setProgress((qreal)this->m_nextOperation / (qreal)this->m_pendingOperations.size());
+
+        if (operation.verifyContent) {
+            this->m_comparedOperation = operation;
+            compareContent(operation.relativePath, operation.sourcePath);
+            return;
+        }
+        if (this->m_syncDb && operation.type == NcSyncReconciler::Operation::Upload) {
+            checkUpload(operation);
+            return;
+        }
+        this->m_operations.append(operation);
+    }
+
+    finish();
+}
+
+void NcSyncDedupCommandEntity::checkUpload(NcSyncReconciler::Operation operation)
+{
+    const QString sourcePath = QDir(this->m_localPath).filePath(operation.relativePath);
+    const FileFingerprint fingerprint = FileFingerprint::fromFile(sourcePath);
+    if (fingerprint.isValid())
+        this->m_fingerprints.insert(operation.relativePath, fingerprint);
+
+    const QString uploadedPath = this->m_syncDb->uploadedPath(this->m_localPath,
+                                                              operation.relativePath,
+                                                              fingerprint);
+
+    // Local edits are always uploaded, the fingerprint only samples the content
+    if (uploadedPath == operation.relativePath && !operation.modified) {
+        qInfo() << operation.relativePath << "has been uploaded already, skipping";
+        this->m_syncDb->storeJournalEntries(this->m_localPath, {operation.journalEntry});
+        QTimer::singleShot(0, this, &NcSyncDedupCommandEntity::checkNextOperation);
+        return;
+    }
+
+    // The server has the content of the other path as long as it is in sync
+    if (!uploadedPath.isEmpty() && uploadedPath != operation.relativePath &&
+            this->m_remoteFileExists(uploadedPath) &&
+            this->m_journal.contains(uploadedPath) && this->m_localFiles.contains(uploadedPath) &&
+            this->m_journal.value(uploadedPath).sameLocalState(this->m_localFiles.value(uploadedPath))) {
+        operation.sourcePath = uploadedPath;
+        this->m_comparedOperation = operation;
+        compareContent(operation.relativePath, uploadedPath);
+        return;
+    }
+
+    this->m_operations.append(operation);
+    QTimer::singleShot(0, this, &NcSyncDedupCommandEntity::checkNextOperation);
+}
+
+void NcSyncDedupCommandEntity::compareContent(const QString& relativePath,
+                                              const QString& otherPath)
+{
+    const QDir localDir(this->m_localPath);
+    this->m_filesToHash = QStringList({localDir.filePath(relativePath),
+                                       localDir.filePath(otherPath)});
+    this->m_firstHash.clear();
+
+    if (QFileInfo(this->m_filesToHash.first()).size() != QFileInfo(this->m_filesToHash.last()).size()) {
+        this->m_filesToHash.clear();
+        contentCompared(false);
+        return;
+    }
+
+    hashNextFile();
+}
+
+void NcSyncDedupCommandEntity::hashNextFile()
+{
+    this->m_hasher = new FileHasher(this->m_filesToHash.takeFirst(),
+                                    QCryptographicHash::Sha1,
+                                    FILEHASHER_DEFAULT_BLOCK_SIZE,
+                                    this);
+
+    QObject::connect(this->m_hasher, &FileHasher::finished, this, [=]() {
+        const QByteArray hash = this->m_hasher->result();
+        stopHashing();
+
+        if (hash.isEmpty()) {
+            this->m_filesToHash.clear();
+            contentCompared(false);
+        } else if (this->m_filesToHash.isEmpty()) {
+            contentCompared(hash == this->m_firstHash);
+        } else {
+            this->m_firstHash = hash;
+            hashNextFile();
+        }
+    });
+
+    this->m_hasher->start();
+}
+
+void NcSyncDedupCommandEntity::contentCompared(bool sameContent)
+{
+    NcSyncReconciler::Operation operation = this->m_comparedOperation;
+    this->m_comparedOperation = NcSyncReconciler::Operation();
+
+    operation.verifyContent = false;
+
+    if (sameContent) {
+        operation.type = NcSyncReconciler::Operation::Copy;
+    } else if (operation.type == NcSyncReconciler::Operation::Copy) {
+        // A local copy which has been changed since, its content is new
+        qInfo() << operation.relativePath << "differs from" << operation.sourcePath << ", uploading it";
+        operation.type = NcSyncReconciler::Operation::Upload;
+        operation.sourcePath.clear();
+        if (this->m_syncDb) {
+            checkUpload(operation);
+            return;
+        }
+    } else {
+        operation.sourcePath.clear();
+    }
+
+    this->m_operations.append(operation);
+    QTimer::singleShot(0, this, &NcSyncDedupCommandEntity::checkNextOperation);
+}
+
+void NcSyncDedupCommandEntity::stopHashing()
+{
+    if (!this->m_hasher)
+        return;
+
+    QObject::disconnect(this->m_hasher, nullptr, this, nullptr);
+    this->m_hasher->deleteLater();
+    this->m_hasher = Q_NULLPTR;
+}
+
+void NcSyncDedupCommandEntity::finish()
+{
+    this->m_stopped = true;
+
+    qInfo() << "Deduplicated" << this->m_pendingOperations.size() << "operations to"
+            << this->m_operations.size();
+
+    setProgress(1.0);
+    setState(FINISHED);
+    Q_EMIT done();
+}
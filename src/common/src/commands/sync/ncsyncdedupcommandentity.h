@@ -0,0 +1,80 @@
+#ifndef NCSYNCDEDUPCOMMANDENTITY_H
+#define NCSYNCDEDUPCOMMANDENTITY_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <functional>
+#include <commandentity.h>
+#include <commands/sync/ncsyncreconciler.h>
+#include <util/filefingerprint.h>
+
+class FileHasher;
+class SyncDb;
+
+// Never uploads the same content twice: drops uploads of files which have
+// been uploaded before and turns uploads of content the server has under
+// another path into remote copies. Local copies the reconciler found by
+// size and time only are confirmed, or uploaded if the content differs.
+// One upload is fingerprinted per event loop iteration and a candidate copy
+// is confirmed by hashing both files block by block, so that the file
+// content isn't read in one go on the event loop.
+class NcSyncDedupCommandEntity : public CommandEntity
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<bool(const QString& relativePath)> RemoteFileCheck;
+
+    NcSyncDedupCommandEntity(QObject* parent,
+                             SyncDb* syncDb,
+                             const QString& localPath,
+                             const QVector<NcSyncReconciler::Operation>& operations,
+                             const QHash<QString, NcSyncJournalEntry>& journal,
+                             const QHash<QString, NcSyncJournalEntry>& localFiles,
+                             RemoteFileCheck remoteFileExists);
+
+    // The operations left to carry out, complete once the entity is done
+    const QVector<NcSyncReconciler::Operation>& operations() const;
+
+    // Recorded for the uploads, to be stored once they succeeded
+    FileFingerprint fingerprint(const QString& relativePath) const;
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+
+private:
+    void checkNextOperation();
+    void checkUpload(NcSyncReconciler::Operation operation);
+
+    // Hashes relativePath and then otherPath, the result goes to contentCompared()
+    void compareContent(const QString& relativePath, const QString& otherPath);
+    void hashNextFile();
+    void contentCompared(bool sameContent);
+
+    void stopHashing();
+    void finish();
+
+    SyncDb* m_syncDb = Q_NULLPTR;
+    QString m_localPath;
+    QVector<NcSyncReconciler::Operation> m_pendingOperations;
+    QHash<QString, NcSyncJournalEntry> m_journal;
+    QHash<QString, NcSyncJournalEntry> m_localFiles;
+    RemoteFileCheck m_remoteFileExists;
+
+    int m_nextOperation = 0;
+    QVector<NcSyncReconciler::Operation> m_operations;
+    QHash<QString, FileFingerprint> m_fingerprints;
+
+    // The operation whose content is being compared
+    NcSyncReconciler::Operation m_comparedOperation;
+    QStringList m_filesToHash;
+    QByteArray m_firstHash;
+    FileHasher* m_hasher = Q_NULLPTR;
+
+    // Iterations scheduled before an abort find it stopped
+    bool m_stopped = false;
+};
+
+#endif // NCSYNCDEDUPCOMMANDENTITY_H
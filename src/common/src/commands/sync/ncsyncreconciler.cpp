@@ -0,0 +1,285 @@
+#include "ncsyncreconciler.h"
+#include "ncdirtreecommandunit.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+NcSyncJournalEntry NcSyncJournalEntry::fromFileInfo(const QString& relativePath,
+                                                    const QFileInfo& fileInfo)
+{
+    NcSyncJournalEntry entry;
+    entry.relativePath = relativePath;
+    entry.size = fileInfo.size();
+    entry.lastModified = fileInfo.lastModified().toMSecsSinceEpoch() / 1000;
+
+    // The inode survives renames within the same file system
+    struct stat fileStat;
+    if (stat(QFile::encodeName(fileInfo.absoluteFilePath()).constData(), &fileStat) == 0)
+        entry.inode = static_cast<quint64>(fileStat.st_ino);
+
+    return entry;
+}
+
+NcSyncReconciler::NcSyncReconciler(const QHash<QString, NcSyncJournalEntry>& journal,
+                                   const QHash<QString, NcSyncJournalEntry>& localFiles,
+                                   const NcDirNode* remoteTree) :
+    m_journal(journal),
+    m_localFiles(localFiles),
+    m_remoteTree(remoteTree)
+{
+}
+
+const QVector<NcSyncReconciler::Operation>& NcSyncReconciler::operations() const
+{
+    return this->m_operations;
+}
+
+const QVector<NcSyncJournalEntry>& NcSyncReconciler::journalUpdates() const
+{
+    return this->m_journalUpdates;
+}
+
+const QStringList& NcSyncReconciler::journalRemovals() const
+{
+    return this->m_journalRemovals;
+}
+
+void NcSyncReconciler::reconcile()
+{
+    if (this->m_remoteTree)
+        indexRemoteTree(this->m_remoteTree, QStringLiteral(""));
+    detectLocalMoves();
+
+    for (auto it = this->m_journal.constBegin(); it != this->m_journal.constEnd(); ++it) {
+        reconcileJournaled(it.key());
+    }
+
+    for (auto it = this->m_localFiles.constBegin(); it != this->m_localFiles.constEnd(); ++it) {
+        if (!this->m_journal.contains(it.key()))
+            reconcileNew(it.key());
+    }
+
+    qInfo() << "Reconciled" << this->m_localFiles.size() << "local files:"
+            << this->m_operations.size() << "remote operations,"
+            << this->m_journalUpdates.size() << "journal updates,"
+            << this->m_journalRemovals.size() << "journal removals";
+}
+
+NcSyncReconciler::Change NcSyncReconciler::localChange(const QString& relativePath) const
+{
+    const bool journaled = this->m_journal.contains(relativePath);
+    const bool existing = this->m_localFiles.contains(relativePath);
+
+    if (journaled && existing) {
+        const bool unchanged = this->m_journal.value(relativePath)
+                .sameLocalState(this->m_localFiles.value(relativePath));
+        return unchanged ? Unchanged : Modified;
+    }
+    if (existing)
+        return this->m_localMoves.contains(relativePath) ? Moved : New;
+    if (journaled)
+        return this->m_movedAway.contains(relativePath) ? Moved : Deleted;
+    return Deleted;
+}
+
+NcSyncReconciler::Change NcSyncReconciler::remoteChange(const QString& relativePath) const
+{
+    const bool journaled = this->m_journal.contains(relativePath);
+    const bool existing = this->m_remoteFiles.contains(relativePath);
+
+    if (!journaled)
+        return existing ? New : Deleted;
+
+    const NcSyncJournalEntry journalEntry = this->m_journal.value(relativePath);
+
+    if (existing) {
+        // Uploaded during the last sync but not seen remotely before
+        if (journalEntry.fileId == 0)
+            return Unchanged;
+
+        const RemoteEntry remoteEntry = this->m_remoteFiles.value(relativePath);
+        const bool sameFile = (remoteEntry.fileId == 0 || remoteEntry.fileId == journalEntry.fileId);
+        const bool unchanged = sameFile && (remoteEntry.entityTag == journalEntry.entityTag);
+        return unchanged ? Unchanged : Modified;
+    }
+
+    if (journalEntry.fileId != 0 && this->m_remoteFileIds.contains(journalEntry.fileId))
+        return Moved;
+    return Deleted;
+}
+
+void NcSyncReconciler::indexRemoteTree(const NcDirNode* node, const QString& parentPath)
+{
+    for (const RemoteEntry& file : node->files) {
+        const QString relativePath = parentPath + file.name;
+        this->m_remoteFiles.insert(relativePath, file);
+        if (file.fileId != 0)
+            this->m_remoteFileIds.insert(file.fileId, relativePath);
+    }
+
+    for (const NcDirNode* directory : node->directories) {
+        indexRemoteTree(directory, parentPath + directory->name + NODE_PATH_SEPARATOR);
+    }
+}
+
+void NcSyncReconciler::detectLocalMoves()
+{
+    // Journaled files which vanished locally might have been moved,
+    // unchanged ones might have been copied.
+    QHash<quint64, QString> vanishedByInode;
+    QHash<QPair<qint64, qint64>, QString> unchangedBySizeAndTime;
+
+    for (auto it = this->m_journal.constBegin(); it != this->m_journal.constEnd(); ++it) {
+        const NcSyncJournalEntry& journalEntry = it.value();
+
+        if (!this->m_localFiles.contains(it.key())) {
+            if (journalEntry.inode != 0)
+                vanishedByInode.insert(journalEntry.inode, it.key());
+            continue;
+        }
+
+        if (journalEntry.size > 0 &&
+                journalEntry.sameLocalState(this->m_localFiles.value(it.key()))) {
+            unchangedBySizeAndTime.insert(qMakePair(journalEntry.size, journalEntry.lastModified),
+                                          it.key());
+        }
+    }
+
+    for (auto it = this->m_localFiles.constBegin(); it != this->m_localFiles.constEnd(); ++it) {
+        if (this->m_journal.contains(it.key()))
+            continue;
+
+        const NcSyncJournalEntry& localEntry = it.value();
+
+        const QString movedFrom = vanishedByInode.value(localEntry.inode);
+        if (localEntry.inode != 0 && !movedFrom.isEmpty() &&
+                this->m_journal.value(movedFrom).sameLocalState(localEntry)) {
+            vanishedByInode.remove(localEntry.inode);
+            this->m_localMoves.insert(it.key(), movedFrom);
+            this->m_movedAway.insert(movedFrom, it.key());
+            continue;
+        }
+
+        // Only a candidate, size and time alone match unrelated files,
+        // e.g. burst shots, the content is compared before copying
+        const QString copiedFrom =
+                unchangedBySizeAndTime.value(qMakePair(localEntry.size, localEntry.lastModified));
+        if (!copiedFrom.isEmpty())
+            this->m_localCopies.insert(it.key(), copiedFrom);
+    }
+}
+
+void NcSyncReconciler::reconcileJournaled(const QString& relativePath)
+{
+    const Change local = localChange(relativePath);
+    const Change remote = remoteChange(relativePath);
+
+    switch (local) {
+    case Unchanged:
+        if (remote == Unchanged || remote == Modified) {
+            if (remote == Modified)
+                qInfo() << relativePath << "changed remotely, keeping the server version";
+            adopt(relativePath);
+        }
+
+        // Removed or moved away remotely: keep the journal entry
+        // so that the file isn't uploaded again.
+        break;
+    case Modified:
+        if (remote == Unchanged) {
+            Operation upload;
+            upload.type = Operation::Upload;
+            upload.relativePath = relativePath;
+            upload.journalEntry = this->m_localFiles.value(relativePath);
+            upload.modified = true;
+            this->m_operations.append(upload);
+        } else {
+            qInfo() << relativePath << "changed on both sides, keeping the server version";
+        }
+        break;
+    case Deleted:
+        this->m_journalRemovals.append(relativePath);
+        break;
+    case New:
+    case Moved:
+        // Handled along with the new location in reconcileNew()
+        break;
+    }
+}
+
+void NcSyncReconciler::reconcileNew(const QString& relativePath)
+{
+    const NcSyncJournalEntry localEntry = this->m_localFiles.value(relativePath);
+    const bool existsRemotely = this->m_remoteFiles.contains(relativePath);
+
+    // Renames and copies of files which are still in sync remotely
+    // are replayed on the server instead of uploading the content again.
+    const QString movedFrom = this->m_localMoves.value(relativePath);
+    const QString copiedFrom = this->m_localCopies.value(relativePath);
+    const QString sourcePath = movedFrom.isEmpty() ? copiedFrom : movedFrom;
+
+    if (!sourcePath.isEmpty()) {
+        const bool sourceInSync = this->m_remoteFiles.contains(sourcePath) &&
+                remoteChange(sourcePath) == Unchanged;
+
+        if (sourceInSync && !existsRemotely) {
+            const NcSyncJournalEntry sourceEntry = this->m_journal.value(sourcePath);
+
+            Operation operation;
+            operation.type = movedFrom.isEmpty() ? Operation::Copy : Operation::Move;
+            operation.relativePath = relativePath;
+            operation.sourcePath = sourcePath;
+            operation.journalEntry = localEntry;
+            operation.verifyContent = (operation.type == Operation::Copy);
+
+            // A move keeps the remote identity, a copy gets a new one
+            if (operation.type == Operation::Move) {
+                operation.journalEntry.fileId = sourceEntry.fileId;
+                operation.journalEntry.entityTag = sourceEntry.entityTag;
+            }
+
+            this->m_operations.append(operation);
+            return;
+        }
+
+        if (!movedFrom.isEmpty())
+            this->m_journalRemovals.append(movedFrom);
+    }
+
+    // Existing remote files win, just start tracking them
+    if (existsRemotely) {
+        adopt(relativePath);
+        return;
+    }
+
+    Operation upload;
+    upload.type = Operation::Upload;
+    upload.relativePath = relativePath;
+    upload.journalEntry = localEntry;
+    this->m_operations.append(upload);
+}
+
+void NcSyncReconciler::adopt(const QString& relativePath)
+{
+    NcSyncJournalEntry entry = this->m_localFiles.value(relativePath);
+    const RemoteEntry remoteEntry = this->m_remoteFiles.value(relativePath);
+    entry.fileId = remoteEntry.fileId;
+    entry.entityTag = remoteEntry.entityTag;
+
+    // Avoid rewriting journal entries which are up to date already
+    if (this->m_journal.contains(relativePath)) {
+        const NcSyncJournalEntry journalEntry = this->m_journal.value(relativePath);
+        if (journalEntry.sameLocalState(entry) &&
+                journalEntry.fileId == entry.fileId &&
+                journalEntry.entityTag == entry.entityTag) {
+            return;
+        }
+    }
+
+    this->m_journalUpdates.append(entry);
+}
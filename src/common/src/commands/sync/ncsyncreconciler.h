@@ -0,0 +1,121 @@
+#ifndef NCSYNCRECONCILER_H
+#define NCSYNCRECONCILER_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <provider/storage/remoteentry.h>
+
+class NcDirNode;
+class QFileInfo;
+
+// State of a file at the time it has last been in sync on both sides.
+// Also used for the current local state, leaving the remote fields empty.
+struct NcSyncJournalEntry
+{
+    QString relativePath;
+
+    // Local side
+    quint64 inode = 0;
+    qint64 size = 0;
+    qint64 lastModified = 0; // seconds since epoch
+
+    // Remote side, a fileId of 0 means it hasn't been seen remotely yet
+    quint64 fileId = 0;
+    RemoteEntry::EntityTag entityTag;
+
+    bool sameLocalState(const NcSyncJournalEntry& other) const
+    {
+        return this->inode == other.inode &&
+                this->size == other.size &&
+                this->lastModified == other.lastModified;
+    }
+
+    static NcSyncJournalEntry fromFileInfo(const QString& relativePath,
+                                           const QFileInfo& fileInfo);
+};
+Q_DECLARE_TYPEINFO(NcSyncJournalEntry, Q_MOVABLE_TYPE);
+
+// Three-way comparison of the journal (local and remote state at the
+// last sync), the local directory now and the remote tree now.
+// Every file is classified per side, the resulting operations are the
+// minimal set needed to bring the remote side up to date.
+// Policy: in case of doubt the server wins, local deletions are never
+// propagated as the daemon is an uploader (e.g. for the camera roll).
+class NcSyncReconciler
+{
+public:
+    enum Change {
+        Unchanged,
+        New,
+        Modified,
+        Deleted,
+        Moved
+    };
+
+    struct Operation
+    {
+        enum Type {
+            Upload,
+            Move, // sourcePath -> relativePath on the remote side
+            Copy  // sourcePath -> relativePath on the remote side
+        };
+
+        Type type = Upload;
+        QString relativePath;
+        QString sourcePath;
+
+        // Uploads of journaled files which changed locally
+        bool modified = false;
+
+        // Copies found by size and modification time, to be replaced by
+        // an upload unless the content of both files matches
+        bool verifyContent = false;
+
+        // To be recorded in the journal once the operation succeeded
+        NcSyncJournalEntry journalEntry;
+    };
+
+    NcSyncReconciler(const QHash<QString, NcSyncJournalEntry>& journal,
+                     const QHash<QString, NcSyncJournalEntry>& localFiles,
+                     const NcDirNode* remoteTree);
+
+    void reconcile();
+
+    const QVector<Operation>& operations() const;
+
+    // Journal changes which don't depend on any remote operation
+    const QVector<NcSyncJournalEntry>& journalUpdates() const;
+    const QStringList& journalRemovals() const;
+
+private:
+    Change localChange(const QString& relativePath) const;
+    Change remoteChange(const QString& relativePath) const;
+
+    void indexRemoteTree(const NcDirNode* node, const QString& parentPath);
+    void detectLocalMoves();
+
+    void reconcileJournaled(const QString& relativePath);
+    void reconcileNew(const QString& relativePath);
+    void adopt(const QString& relativePath);
+
+    const QHash<QString, NcSyncJournalEntry>& m_journal;
+    const QHash<QString, NcSyncJournalEntry>& m_localFiles;
+    const NcDirNode* m_remoteTree;
+
+    QHash<QString, RemoteEntry> m_remoteFiles;
+    QHash<quint64, QString> m_remoteFileIds;
+
+    // New local path -> journal path it has been moved or copied from
+    QHash<QString, QString> m_localMoves;
+    QHash<QString, QString> m_localCopies;
+    QHash<QString, QString> m_movedAway;
+
+    QVector<Operation> m_operations;
+    QVector<NcSyncJournalEntry> m_journalUpdates;
+    QStringList m_journalRemovals;
+};
+
+#endif // NCSYNCRECONCILER_H
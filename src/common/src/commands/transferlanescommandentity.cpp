@@ -0,0 +1,203 @@
+#include "transferlanescommandentity.h"
+
+#include <QDebug>
+
+TransferLanesCommandEntity::TransferLanesCommandEntity(QObject* parent,
+                                                       int maxLanes,
+                                                       int maxTransfersPerHost) :
+    CommandEntity(parent),
+    m_maxLanes(qMax(1, maxLanes)),
+    m_maxTransfersPerHost(qMax(1, maxTransfersPerHost))
+{
+    updateInfo();
+}
+
+bool TransferLanesCommandEntity::addTransfer(CommandEntity* transfer,
+                                             const QString& host,
+                                             qint64 bytes)
+{
+    if (!transfer)
+        return false;
+
+    if (isFinished()) {
+        qWarning() << "Transfer lanes finished already, not adding transfer";
+        return false;
+    }
+
+    transfer->setParent(this);
+
+    Transfer pendingTransfer;
+    pendingTransfer.command = transfer;
+    pendingTransfer.host = host;
+    pendingTransfer.bytes = (bytes > 0) ? bytes : TRANSFERLANES_UNKNOWN_SIZE;
+
+    this->m_pendingTransfers[host].enqueue(pendingTransfer);
+    this->m_totalBytes += pendingTransfer.bytes;
+    this->m_transferCount++;
+    updateInfo();
+
+    // Lanes which are running already pull it in right away
+    if (this->m_started)
+        startPendingTransfers();
+    return true;
+}
+
+int TransferLanesCommandEntity::transferCount() const
+{
+    return this->m_transferCount;
+}
+
+bool TransferLanesCommandEntity::startWork()
+{
+    if (!CommandEntity::startWork())
+        return false;
+
+    this->m_started = true;
+    setState(RUNNING);
+    startPendingTransfers();
+    return true;
+}
+
+bool TransferLanesCommandEntity::abortWork()
+{
+    if (!CommandEntity::abortWork())
+        return false;
+
+    for (const QQueue<Transfer>& hostTransfers : this->m_pendingTransfers) {
+        for (const Transfer& transfer : hostTransfers) {
+            transfer.command->deleteLater();
+        }
+    }
+    this->m_pendingTransfers.clear();
+
+    // Detach first, aborting a transfer can emit signals synchronously
+    const QList<CommandEntity*> runningTransfers = this->m_runningTransfers.keys();
+    this->m_runningTransfers.clear();
+    this->m_runningTransfersPerHost.clear();
+    for (CommandEntity* transfer : runningTransfers) {
+        QObject::disconnect(transfer, nullptr, this, nullptr);
+        transfer->abort();
+        transfer->deleteLater();
+    }
+
+    setState(ABORTED);
+    Q_EMIT aborted();
+    return true;
+}
+
+QString TransferLanesCommandEntity::nextHost() const
+{
+    QString selectedHost;
+    qint64 selectedBytes = -1;
+
+    for (auto it = this->m_pendingTransfers.constBegin();
+         it != this->m_pendingTransfers.constEnd(); ++it) {
+        if (it.value().isEmpty())
+            continue;
+        if (this->m_runningTransfersPerHost.value(it.key()) >= this->m_maxTransfersPerHost)
+            continue;
+
+        const qint64 bytesStarted = this->m_bytesStartedPerHost.value(it.key());
+        if (selectedBytes < 0 || bytesStarted < selectedBytes) {
+            selectedHost = it.key();
+            selectedBytes = bytesStarted;
+        }
+    }
+
+    return selectedHost;
+}
+
+void TransferLanesCommandEntity::startPendingTransfers()
+{
+    while (this->m_runningTransfers.size() < this->m_maxLanes) {
+        const QString host = nextHost();
+        if (!this->m_pendingTransfers.contains(host) ||
+                this->m_pendingTransfers.value(host).isEmpty()) {
+            break;
+        }
+
+        const Transfer transfer = this->m_pendingTransfers[host].dequeue();
+        if (this->m_pendingTransfers.value(host).isEmpty())
+            this->m_pendingTransfers.remove(host);
+
+        this->m_runningTransfers.insert(transfer.command, transfer);
+        this->m_runningTransfersPerHost[host]++;
+        this->m_bytesStartedPerHost[host] += transfer.bytes;
+
+        CommandEntity* command = transfer.command;
+        QObject::connect(command, &CommandEntity::done, this, [=]() {
+            transferFinished(command, true);
+        });
+        QObject::connect(command, &CommandEntity::aborted, this, [=]() {
+            transferFinished(command, false);
+        });
+        QObject::connect(command, &CommandEntity::progressChanged,
+                         this, &TransferLanesCommandEntity::updateProgress);
+
+        command->run();
+    }
+
+    if (!this->m_runningTransfers.isEmpty() || !this->m_pendingTransfers.isEmpty())
+        return;
+
+    if (isFinished())
+        return;
+
+    QVariantMap result;
+    result.insert(QStringLiteral("success"), true);
+    result.insert(QStringLiteral("transfers"), this->m_transferCount);
+    result.insert(QStringLiteral("failedTransfers"), this->m_failedTransfers);
+    this->m_resultData = result;
+
+    setProgress(1.0);
+    setState(FINISHED);
+    Q_EMIT done();
+}
+
+void TransferLanesCommandEntity::transferFinished(CommandEntity* command, bool finished)
+{
+    // Transfers may report both an error and completion, handle only the first one
+    if (!this->m_runningTransfers.contains(command))
+        return;
+
+    const Transfer transfer = this->m_runningTransfers.take(command);
+    QObject::disconnect(command, nullptr, this, nullptr);
+    command->deleteLater();
+
+    if (--this->m_runningTransfersPerHost[transfer.host] <= 0)
+        this->m_runningTransfersPerHost.remove(transfer.host);
+
+    this->m_finishedBytes += transfer.bytes;
+
+    if (!finished) {
+        qWarning() << "Transfer" << command->info().property(QStringLiteral("remoteFile")).toString()
+                   << "failed";
+        this->m_failedTransfers++;
+    }
+
+    updateProgress();
+    startPendingTransfers();
+}
+
+void TransferLanesCommandEntity::updateProgress()
+{
+    if (this->m_totalBytes <= 0)
+        return;
+
+    // Weighted by size, finished transfers count fully whether they succeeded or not
+    qreal transferredBytes = this->m_finishedBytes;
+    for (const Transfer& transfer : this->m_runningTransfers) {
+        transferredBytes += transfer.command->progress() * transfer.bytes;
+    }
+
+    setProgress(qMin<qreal>(1.0, transferredBytes / this->m_totalBytes));
+}
+
+void TransferLanesCommandEntity::updateInfo()
+{
+    QVariantMap info;
+    info.insert(QStringLiteral("type"), "transferLanes");
+    info.insert("transfers", this->m_transferCount);
+    info.insert("lanes", this->m_maxLanes);
+    this->m_commandInfo = CommandEntityInfo(info);
+}
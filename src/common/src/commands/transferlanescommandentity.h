@@ -0,0 +1,79 @@
+#ifndef TRANSFERLANESCOMMANDENTITY_H
+#define TRANSFERLANESCOMMANDENTITY_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QQueue>
+#include <commandentity.h>
+
+// Number of transfers kept in flight by default
+const int TRANSFERLANES_DEFAULT_LANES = 4;
+
+// Number of transfers kept in flight per host by default. An account talks
+// to a single host, the per host limit only bites when hosts are mixed.
+const int TRANSFERLANES_DEFAULT_PER_HOST = TRANSFERLANES_DEFAULT_LANES;
+
+// Weight of transfers with an unknown size, e.g. downloads
+const qint64 TRANSFERLANES_UNKNOWN_SIZE = 1024 * 1024;
+
+// Runs transfers on up to maxLanes concurrent lanes, with at most
+// maxTransfersPerHost of them talking to the same host.
+// Each transfer is a single job: a CommandUnit (e.g. an upload followed by
+// its PROPPATCH) runs on one lane, so its commands keep their order.
+// Whenever a lane becomes free the host which has been served the fewest
+// bytes so far goes next, which splits the bandwidth fairly between hosts
+// instead of letting one long backlog starve the others.
+// Transfers can be added while the lanes are running, the entity finishes
+// once all of them are done. Failed transfers are counted but don't fail
+// the entity, like in a serial queue the remaining ones still run.
+class TransferLanesCommandEntity : public CommandEntity
+{
+    Q_OBJECT
+
+public:
+    TransferLanesCommandEntity(QObject* parent = Q_NULLPTR,
+                               int maxLanes = TRANSFERLANES_DEFAULT_LANES,
+                               int maxTransfersPerHost = TRANSFERLANES_DEFAULT_PER_HOST);
+
+    // Takes ownership of transfer. Returns false once the lanes finished.
+    bool addTransfer(CommandEntity* transfer,
+                     const QString& host = QStringLiteral(""),
+                     qint64 bytes = -1);
+
+    int transferCount() const;
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+
+private:
+    struct Transfer
+    {
+        CommandEntity* command = Q_NULLPTR;
+        QString host;
+        qint64 bytes = 0;
+    };
+
+    QString nextHost() const;
+    void startPendingTransfers();
+    void transferFinished(CommandEntity* transfer, bool finished);
+    void updateProgress();
+    void updateInfo();
+
+    int m_maxLanes;
+    int m_maxTransfersPerHost;
+
+    QMap<QString, QQueue<Transfer> > m_pendingTransfers;
+    QHash<CommandEntity*, Transfer> m_runningTransfers;
+    QHash<QString, int> m_runningTransfersPerHost;
+    QHash<QString, qint64> m_bytesStartedPerHost;
+
+    bool m_started = false;
+    int m_transferCount = 0;
+    int m_failedTransfers = 0;
+    qint64 m_totalBytes = 0;
+    qint64 m_finishedBytes = 0;
+};
+
+#endif // TRANSFERLANESCOMMANDENTITY_H
@@ -11,6 +11,25 @@ const QString getDirNameFromPath(const QString& path)
     return splitPath[splitPath.length()-1];
 }
 
+QVariantMap entryToVariantMap(const DavMultistatusEntry& entry, const QString& path)
+{
+    QVariantMap info;
+    info.insert("path", path);
+    info.insert("name", entry.name());
+    info.insert("isDirectory", entry.isDirectory);
+    info.insert("size", entry.size);
+    info.insert("createdAt", entry.createdAt);
+    info.insert("entityTag", entry.entityTag);
+    info.insert("uniqueId", entry.entityTag);
+    info.insert("fileId", entry.fileId);
+    if(!entry.isDirectory) {
+        info.insert("isExecutable", entry.isExecutable);
+        info.insert("mimeType", entry.mimeType);
+        info.insert("lastModified", entry.lastModified);
+    }
+    return info;
+}
+
 DavListCommandEntity::DavListCommandEntity(QObject *parent,
                                            QString remotePath,
                                            bool refresh,
@@ -29,48 +48,6 @@ DavListCommandEntity::DavListCommandEntity(QObject *parent,
 
 bool DavListCommandEntity::startWork()
 {
-    QObject::connect(&this->m_parser, &QWebdavDirParser::errorChanged,
-                     this, [=](QString errorStr){
-        qWarning() << "Error occured while parsing directory content for" << this->m_remotePath;
-        qWarning() << this->m_parser.httpCode() << this->m_parser.error() << errorStr;
-        this->m_parser.abort();
-    });
-
-    QObject::connect(&this->m_parser, &QWebdavDirParser::finished, this, [=]() {
-        qInfo() << "Listing remote directory content" << this->m_remotePath << "complete.";
-        qInfo() << "DIRECTORY SIZE" << this->m_parser.getList().size();
-
-        QVariantMap result;
-        const int httpCode = this->m_parser.httpCode();
-        const bool success = (httpCode >= 200 && httpCode < 300);
-
-        result.insert(QStringLiteral("success"), success && (this->m_parser.error() == QNetworkReply::NoError));
-        result.insert(QStringLiteral("httpCode"), httpCode);
-
-        QVariantList directoryContent;
-
-        for(const QWebdavItem& item : this->m_parser.getList()) {
-            QVariantMap info;
-            info.insert("path", item.path());
-            info.insert("name", item.name());
-            info.insert("isDirectory", item.isDir());
-            info.insert("size", item.size());
-            info.insert("createdAt", item.createdAt());
-            info.insert("entityTag", item.entityTag());
-            info.insert("uniqueId", item.entityTag());
-            info.insert("fileId", item.fileId());
-            if(!item.isDir()) {
-                info.insert("isExecutable", item.isExecutable());
-                info.insert("mimeType", item.mimeType());
-                info.insert("lastModified", item.lastModified());
-            }
-            directoryContent.append(info);
-        }
-        result.insert(QStringLiteral("dirContent"), directoryContent);
-        this->m_resultData = result;
-        Q_EMIT done();
-    });
-
     const bool canStart = WebDavCommandEntity::startWork();
     if (!canStart) {
         qWarning() << "Cannot startWork due to !WebDavCommandEntity::startWork()";
@@ -78,9 +55,123 @@ bool DavListCommandEntity::startWork()
     }
 
     qDebug() << Q_FUNC_INFO;
-    this->m_parser.listDirectory(this->m_client, this->m_remotePath);
+
+    // The response is parsed while it arrives instead of after completion
+    this->m_reply = this->m_client->propfind(this->m_remotePath,
+                                             DavMultistatusParser::propfindQuery(),
+                                             1);
+
+    QObject::connect(this->m_reply, &QNetworkReply::readyRead,
+                     this, &DavListCommandEntity::readAvailableData);
+    QObject::connect(this->m_reply, &QNetworkReply::finished,
+                     this, &DavListCommandEntity::listingFinished);
 
     setState(RUNNING);
     qDebug() << Q_FUNC_INFO << "done";
     return true;
 }
+
+bool DavListCommandEntity::abortWork()
+{
+    // A listing cut short is neither parsed any further nor reported as done
+    if (this->m_reply)
+        QObject::disconnect(this->m_reply, nullptr, this, nullptr);
+    this->m_pendingContent.clear();
+
+    return WebDavCommandEntity::abortWork();
+}
+
+void DavListCommandEntity::readAvailableData()
+{
+    if (!this->m_reply || this->m_parseError)
+        return;
+
+    // Error pages aren't multistatus documents
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (httpCode != 207) {
+        this->m_reply->readAll();
+        return;
+    }
+
+    this->m_parser.addData(this->m_reply->readAll());
+
+    QVector<DavMultistatusEntry> entries;
+    if (!this->m_parser.readEntries(entries)) {
+        qWarning() << "Error occured while parsing directory content for" << this->m_remotePath;
+        qWarning() << httpCode << this->m_parser.errorString();
+        this->m_parseError = true;
+    }
+
+    for (const DavMultistatusEntry& entry : entries) {
+        // The listed directory itself comes first, its href tells
+        // which part of the following hrefs belongs to the server.
+        if (this->m_basePath.isNull()) {
+            const QString listedPath = this->m_remotePath.endsWith(QStringLiteral("/"))
+                    ? this->m_remotePath : this->m_remotePath + QStringLiteral("/");
+            const QString listedHref = entry.path.endsWith(QStringLiteral("/"))
+                    ? entry.path : entry.path + QStringLiteral("/");
+            this->m_basePath = listedHref.endsWith(listedPath)
+                    ? listedHref.left(listedHref.length() - listedPath.length())
+                    : QStringLiteral("");
+            continue;
+        }
+
+        this->m_entries.append(entry.toRemoteEntry());
+
+        if (this->m_variantResult) {
+            const QString path = entry.path.startsWith(this->m_basePath)
+                    ? entry.path.mid(this->m_basePath.length()) : entry.path;
+            this->m_pendingContent.append(entryToVariantMap(entry, path));
+        }
+    }
+
+    if (this->m_pendingContent.size() >= DAVLIST_BATCH_SIZE)
+        emitPendingEntries();
+}
+
+void DavListCommandEntity::emitPendingEntries()
+{
+    if (this->m_pendingContent.isEmpty())
+        return;
+
+    this->m_directoryContent.append(this->m_pendingContent);
+    const QVariantList batch = this->m_pendingContent;
+    this->m_pendingContent.clear();
+    Q_EMIT entriesReceived(batch);
+}
+
+void DavListCommandEntity::listingFinished()
+{
+    if (!this->m_reply)
+        return;
+
+    readAvailableData();
+    emitPendingEntries();
+
+    qInfo() << "Listing remote directory content" << this->m_remotePath << "complete.";
+    qInfo() << "DIRECTORY SIZE" << this->m_entries.size();
+
+    QVariantMap result;
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const bool success = (httpCode >= 200 && httpCode < 300);
+
+    if (this->m_reply->error() != QNetworkReply::NoError) {
+        qWarning() << "Error occured while listing directory content for" << this->m_remotePath;
+        qWarning() << httpCode << this->m_reply->error() << this->m_reply->errorString();
+    }
+
+    result.insert(QStringLiteral("success"),
+                  success && (this->m_reply->error() == QNetworkReply::NoError) && !this->m_parseError);
+    result.insert(QStringLiteral("httpCode"), httpCode);
+    result.insert(QStringLiteral("entries"), QVariant::fromValue(this->m_entries));
+
+    if (this->m_variantResult)
+        result.insert(QStringLiteral("dirContent"), this->m_directoryContent);
+
+    this->m_resultData = result;
+
+    this->m_reply->deleteLater();
+    this->m_reply = Q_NULLPTR;
+
+    Q_EMIT done();
+}
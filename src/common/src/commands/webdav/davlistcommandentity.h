@@ -3,8 +3,12 @@
 
 #include <QObject>
 #include "webdavcommandentity.h"
+#include "davmultistatusparser.h"
 
-#include <qwebdavdirparser.h>
+#include <provider/storage/remoteentry.h>
+
+// Number of parsed entries handed out per entriesReceived() signal
+const int DAVLIST_BATCH_SIZE = 256;
 
 class DavListCommandEntity : public WebDavCommandEntity
 {
@@ -17,9 +21,32 @@ public:
 
     bool startWork();
 
+    // The QVariantList based "dirContent" result is only required
+    // by QML consumers. Internal users read the typed "entries" result.
+    void setVariantResultEnabled(bool enabled) { this->m_variantResult = enabled; }
+
+signals:
+    // Emitted while the response is still being received,
+    // the complete listing is available as "dirContent" when done.
+    void entriesReceived(QVariantList entries);
+
+protected:
+    bool abortWork() Q_DECL_OVERRIDE;
+
 private:
-    QWebdavDirParser m_parser;
+    void readAvailableData();
+    void listingFinished();
+    void emitPendingEntries();
+
+    DavMultistatusParser m_parser;
     QString m_remotePath;
+    QString m_basePath;
+    bool m_variantResult = true;
+    bool m_parseError = false;
+
+    QVector<RemoteEntry> m_entries;
+    QVariantList m_directoryContent;
+    QVariantList m_pendingContent;
 };
 
 #endif // DAVLISTCOMMANDENTITY_H
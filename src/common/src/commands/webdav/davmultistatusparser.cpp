@@ -0,0 +1,157 @@
+#include "davmultistatusparser.h"
+
+#include <QLocale>
+#include <QUrl>
+
+const QString DAV_NAMESPACE = QStringLiteral("DAV:");
+const QString OWNCLOUD_NAMESPACE = QStringLiteral("http://owncloud.org/ns");
+const QString APACHE_NAMESPACE = QStringLiteral("http://apache.org/dav/props/");
+
+QDateTime parseHttpDate(const QString& value)
+{
+    // RFC 1123, e.g. "Tue, 15 Nov 1994 12:45:26 GMT"
+    QDateTime dateTime =
+            QLocale::c().toDateTime(value.trimmed(),
+                                    QStringLiteral("ddd, dd MMM yyyy HH:mm:ss 'GMT'"));
+    dateTime.setTimeSpec(Qt::UTC);
+    return dateTime;
+}
+
+QString DavMultistatusEntry::name() const
+{
+    const QStringList crumbs = this->path.split(QStringLiteral("/"), QString::SkipEmptyParts);
+    if (crumbs.isEmpty())
+        return QStringLiteral("/");
+    return crumbs.last();
+}
+
+RemoteEntry DavMultistatusEntry::toRemoteEntry() const
+{
+    RemoteEntry entry;
+    entry.name = name();
+    entry.entityTag = RemoteEntry::EntityTag::fromString(this->entityTag);
+    entry.fileId = this->fileId.toULongLong();
+    entry.size = this->size;
+    entry.mimeType = this->isDirectory ? RemoteEntry::MimeDirectory
+                                       : RemoteEntry::mimeTypeFromString(this->mimeType);
+    if (!this->isDirectory && this->lastModified.isValid())
+        entry.lastModified = this->lastModified.toMSecsSinceEpoch() / 1000;
+    return entry;
+}
+
+QByteArray DavMultistatusParser::propfindQuery()
+{
+    return QByteArrayLiteral("<?xml version=\"1.0\" encoding=\"utf-8\" ?>"
+                             "<d:propfind xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\""
+                             " xmlns:a=\"http://apache.org/dav/props/\">"
+                             "<d:prop>"
+                             "<d:resourcetype/>"
+                             "<d:getetag/>"
+                             "<d:getcontentlength/>"
+                             "<d:getcontenttype/>"
+                             "<d:getlastmodified/>"
+                             "<d:creationdate/>"
+                             "<oc:fileid/>"
+                             "<a:executable/>"
+                             "</d:prop>"
+                             "</d:propfind>");
+}
+
+void DavMultistatusParser::addData(const QByteArray& data)
+{
+    this->m_reader.addData(data);
+}
+
+bool DavMultistatusParser::readEntries(QVector<DavMultistatusEntry>& entries)
+{
+    while (!this->m_reader.atEnd()) {
+        const QXmlStreamReader::TokenType token = this->m_reader.readNext();
+
+        switch (token) {
+        case QXmlStreamReader::StartElement:
+            startElement();
+            break;
+        case QXmlStreamReader::EndElement:
+            endElement(entries);
+            break;
+        case QXmlStreamReader::Characters:
+            this->m_text += this->m_reader.text();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Running out of data only means the rest hasn't arrived yet
+    return !hasError();
+}
+
+bool DavMultistatusParser::hasError() const
+{
+    return this->m_reader.hasError() &&
+            this->m_reader.error() != QXmlStreamReader::PrematureEndOfDocumentError;
+}
+
+QString DavMultistatusParser::errorString() const
+{
+    return this->m_reader.errorString();
+}
+
+bool DavMultistatusParser::atEnd() const
+{
+    return this->m_reader.atEnd() && !this->m_reader.hasError();
+}
+
+void DavMultistatusParser::startElement()
+{
+    this->m_text.clear();
+
+    const QStringRef name = this->m_reader.name();
+    const QStringRef namespaceUri = this->m_reader.namespaceUri();
+    if (namespaceUri != DAV_NAMESPACE)
+        return;
+
+    if (name == QLatin1String("response")) {
+        this->m_inResponse = true;
+        this->m_entry = DavMultistatusEntry();
+    } else if (name == QLatin1String("collection") && this->m_inResponse) {
+        this->m_entry.isDirectory = true;
+    }
+}
+
+void DavMultistatusParser::endElement(QVector<DavMultistatusEntry>& entries)
+{
+    if (!this->m_inResponse)
+        return;
+
+    const QStringRef name = this->m_reader.name();
+    const QStringRef namespaceUri = this->m_reader.namespaceUri();
+    const QString text = this->m_text.trimmed();
+    this->m_text.clear();
+
+    if (namespaceUri == DAV_NAMESPACE) {
+        if (name == QLatin1String("response")) {
+            this->m_inResponse = false;
+            entries.append(this->m_entry);
+        } else if (text.isEmpty()) {
+            // Properties unknown to the server are returned empty
+            return;
+        } else if (name == QLatin1String("href")) {
+            this->m_entry.path = QUrl::fromPercentEncoding(text.toUtf8());
+        } else if (name == QLatin1String("getetag")) {
+            this->m_entry.entityTag = text;
+        } else if (name == QLatin1String("getcontentlength")) {
+            this->m_entry.size = text.toLongLong();
+        } else if (name == QLatin1String("getcontenttype")) {
+            this->m_entry.mimeType = text;
+        } else if (name == QLatin1String("getlastmodified")) {
+            this->m_entry.lastModified = parseHttpDate(text);
+        } else if (name == QLatin1String("creationdate")) {
+            this->m_entry.createdAt = QDateTime::fromString(text, Qt::ISODate);
+        }
+    } else if (namespaceUri == OWNCLOUD_NAMESPACE && name == QLatin1String("fileid")) {
+        this->m_entry.fileId = text;
+    } else if (namespaceUri == APACHE_NAMESPACE && name == QLatin1String("executable")) {
+        this->m_entry.isExecutable = (text == QLatin1String("T"));
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef DAVMULTISTATUSPARSER_H
+#define DAVMULTISTATUSPARSER_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+#include <QXmlStreamReader>
+
+#include <provider/storage/remoteentry.h>
+
+// A single <d:response> of a PROPFIND multistatus body.
+struct DavMultistatusEntry
+{
+    QString path; // percent-decoded href
+    bool isDirectory = false;
+    bool isExecutable = false;
+    qint64 size = 0;
+    QString entityTag;
+    QString fileId;
+    QString mimeType;
+    QDateTime lastModified;
+    QDateTime createdAt;
+
+    QString name() const;
+    RemoteEntry toRemoteEntry() const;
+};
+Q_DECLARE_TYPEINFO(DavMultistatusEntry, Q_MOVABLE_TYPE);
+
+// Incremental parser for PROPFIND responses. Data can be fed in
+// arbitrary chunks as it arrives from the network, complete responses
+// are handed out right away so neither the XML body nor the full
+// list of entries has to be kept in memory.
+class DavMultistatusParser
+{
+public:
+    // PROPFIND body requesting the properties understood by the parser
+    static QByteArray propfindQuery();
+
+    void addData(const QByteArray& data);
+
+    // Appends all responses which have been completely received so far.
+    // Returns false in case the document is malformed.
+    bool readEntries(QVector<DavMultistatusEntry>& entries);
+
+    bool hasError() const;
+    QString errorString() const;
+    bool atEnd() const;
+
+private:
+    void startElement();
+    void endElement(QVector<DavMultistatusEntry>& entries);
+
+    QXmlStreamReader m_reader;
+    QString m_text;
+
+    bool m_inResponse = false;
+    DavMultistatusEntry m_entry;
+};
+
+#endif // DAVMULTISTATUSPARSER_H
@@ -0,0 +1,174 @@
+#include "davtreelistcommandentity.h"
+
+// Depth value QWebdav translates into "Depth: infinity"
+const int DAV_DEPTH_INFINITY = 2;
+
+QString parentPathOf(const QString& relativePath)
+{
+    QString path = relativePath;
+    if (path.endsWith(QStringLiteral("/")))
+        path.chop(1);
+    return path.left(path.lastIndexOf(QStringLiteral("/")) + 1);
+}
+
+// Entries directly below the root have depth 1
+int entryDepthOf(const QString& relativePath)
+{
+    QString path = relativePath;
+    if (path.endsWith(QStringLiteral("/")))
+        path.chop(1);
+    return path.count(QLatin1Char('/')) + 1;
+}
+
+// Servers which don't allow infinite depth answer with one of these
+bool isRefusal(int httpCode)
+{
+    return httpCode == 400 || httpCode == 403 ||
+            httpCode == 405 || httpCode == 501;
+}
+
+DavTreeListCommandEntity::DavTreeListCommandEntity(QObject* parent,
+                                                   QString remotePath,
+                                                   QWebdav* client) :
+    WebDavCommandEntity(parent, client)
+{
+    this->m_remotePath = remotePath;
+
+    QMap<QString, QVariant> info;
+    info["type"] = QStringLiteral("davTreeList");
+    info["remotePath"] = remotePath;
+    this->m_commandInfo = CommandEntityInfo(info);
+}
+
+const QHash<QString, QVector<RemoteEntry> >& DavTreeListCommandEntity::listings() const
+{
+    return this->m_listings;
+}
+
+bool DavTreeListCommandEntity::startWork()
+{
+    // The reply is handled here instead of WebDavCommandEntity so that
+    // a refused request finishes regularly and the caller can fall back.
+    const bool canStart = WebDavCommandEntity::startWork();
+    if (!canStart) {
+        qWarning() << "Cannot startWork due to !WebDavCommandEntity::startWork()";
+        return false;
+    }
+
+    this->m_reply = this->m_client->propfind(this->m_remotePath,
+                                             DavMultistatusParser::propfindQuery(),
+                                             DAV_DEPTH_INFINITY);
+
+    QObject::connect(this->m_reply, &QNetworkReply::readyRead,
+                     this, &DavTreeListCommandEntity::readAvailableData);
+    QObject::connect(this->m_reply, &QNetworkReply::finished,
+                     this, &DavTreeListCommandEntity::listingFinished);
+
+    setState(RUNNING);
+    return true;
+}
+
+void DavTreeListCommandEntity::readAvailableData()
+{
+    if (!this->m_reply || this->m_parseError)
+        return;
+
+    // Error pages aren't multistatus documents
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (httpCode != 207) {
+        this->m_reply->readAll();
+        return;
+    }
+
+    this->m_parser.addData(this->m_reply->readAll());
+
+    QVector<DavMultistatusEntry> entries;
+    if (!this->m_parser.readEntries(entries)) {
+        qWarning() << "Failed to parse tree listing of" << this->m_remotePath
+                   << this->m_parser.errorString();
+        this->m_parseError = true;
+    }
+
+    for (const DavMultistatusEntry& entry : entries) {
+        // The listed root is reported first, everything else is below it
+        if (this->m_rootHref.isEmpty()) {
+            this->m_rootHref = entry.path.endsWith(QStringLiteral("/"))
+                    ? entry.path : entry.path + QStringLiteral("/");
+            this->m_listings.insert(QStringLiteral(""), QVector<RemoteEntry>());
+            continue;
+        }
+
+        if (!entry.path.startsWith(this->m_rootHref))
+            continue;
+
+        const QString relativePath = entry.path.mid(this->m_rootHref.length());
+        if (relativePath.isEmpty())
+            continue;
+
+        const QString parentPath = parentPathOf(relativePath);
+        this->m_listings[parentPath].append(entry.toRemoteEntry());
+        this->m_entryCount++;
+
+        const int depth = entryDepthOf(relativePath);
+        this->m_maxDepth = qMax(this->m_maxDepth, depth);
+        if (relativePath.endsWith(QStringLiteral("/")))
+            this->m_directories.append(qMakePair(relativePath, depth));
+    }
+}
+
+bool DavTreeListCommandEntity::abortWork()
+{
+    // A listing cut short is neither parsed any further nor reported as done
+    if (this->m_reply)
+        QObject::disconnect(this->m_reply, nullptr, this, nullptr);
+    this->m_listings.clear();
+
+    return WebDavCommandEntity::abortWork();
+}
+
+void DavTreeListCommandEntity::listingFinished()
+{
+    if (!this->m_reply)
+        return;
+
+    readAvailableData();
+
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // Empty directories have no entries of their own. Only those above the
+    // deepest entry are known to be empty, the server may have stopped
+    // descending below that and the rest is left to be listed separately.
+    for (const QPair<QString, int>& directory : this->m_directories) {
+        if (directory.second < this->m_maxDepth && !this->m_listings.contains(directory.first))
+            this->m_listings.insert(directory.first, QVector<RemoteEntry>());
+    }
+
+    // Sabre answers "Depth: infinity" with depth 1 unless enabled explicitly.
+    // Subdirectories without any entry below them look the same; listing
+    // those directory by directory is merely slower.
+    const bool depthOneOnly = !this->m_directories.isEmpty() && this->m_maxDepth <= 1;
+    if (httpCode == 207 && depthOneOnly)
+        qInfo() << "Tree listing of" << this->m_remotePath << "only returned depth 1";
+
+    const bool success = (httpCode == 207) && !depthOneOnly &&
+            (this->m_reply->error() == QNetworkReply::NoError) &&
+            !this->m_parseError && this->m_parser.atEnd();
+
+    qInfo() << "Tree listing of" << this->m_remotePath << "complete, http code"
+            << httpCode << "entries" << this->m_entryCount;
+
+    QVariantMap result;
+    result.insert(QStringLiteral("success"), success);
+    result.insert(QStringLiteral("httpCode"), httpCode);
+    result.insert(QStringLiteral("refused"), isRefusal(httpCode) || (httpCode == 207 && depthOneOnly));
+    this->m_resultData = result;
+
+    if (!success)
+        this->m_listings.clear();
+
+    this->m_reply->deleteLater();
+    this->m_reply = Q_NULLPTR;
+
+    setState(FINISHED);
+    Q_EMIT done();
+}
@@ -0,0 +1,47 @@
+#ifndef DAVTREELISTCOMMANDENTITY_H
+#define DAVTREELISTCOMMANDENTITY_H
+
+#include <QObject>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include "webdavcommandentity.h"
+#include "davmultistatusparser.h"
+
+#include <provider/storage/remoteentry.h>
+
+// Lists a whole remote tree with a single "Depth: infinity" PROPFIND.
+// The response is parsed while it is being received, only the compact
+// entries grouped by their parent directory are kept.
+class DavTreeListCommandEntity : public WebDavCommandEntity
+{
+    Q_OBJECT
+public:
+    explicit DavTreeListCommandEntity(QObject* parent = Q_NULLPTR,
+                                      QString remotePath = QStringLiteral(""),
+                                      QWebdav* client = Q_NULLPTR);
+
+    // Directory contents keyed by their path relative to the listed root,
+    // e.g. "" for the root itself and "Photos/2019/" for a subdirectory.
+    // Directories the server didn't descend into have no entry at all.
+    const QHash<QString, QVector<RemoteEntry> >& listings() const;
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+
+private:
+    void readAvailableData();
+    void listingFinished();
+
+    QString m_remotePath;
+    QString m_rootHref;
+    DavMultistatusParser m_parser;
+    QHash<QString, QVector<RemoteEntry> > m_listings;
+    int m_entryCount = 0;
+    QVector<QPair<QString, int> > m_directories;
+    int m_maxDepth = 0;
+    bool m_parseError = false;
+};
+
+#endif // DAVTREELISTCOMMANDENTITY_H
@@ -1,7 +1,62 @@
 #include "filedownloadcommandentity.h"
 
+#include <QFileInfo>
+#include <QTimer>
 #include <qwebdavitem.h>
 
+#include <util/webdav_utils.h>
+
+const QString PART_FILE_SUFFIX = QStringLiteral(".part");
+const QString ENTITYTAG_FILE_SUFFIX = QStringLiteral(".part.etag");
+
+// Failures of the connection rather than of the request, worth resuming after
+bool isTransientNetworkError(QNetworkReply::NetworkError error)
+{
+    switch (error) {
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+QVector<QPair<qint64, qint64> > splitByteRanges(qint64 size, int count)
+{
+    QVector<QPair<qint64, qint64> > ranges;
+    if (size <= 0 || count <= 0)
+        return ranges;
+
+    const qint64 rangeLength = (size + count - 1) / count;
+    for (qint64 offset = 0; offset < size; offset += rangeLength) {
+        ranges.append(qMakePair(offset, qMin(rangeLength, size - offset)));
+    }
+    return ranges;
+}
+
+bool parseContentRange(const QByteArray& contentRange,
+                       qint64* first, qint64* last, qint64* total)
+{
+    const QByteArray unit = QByteArrayLiteral("bytes ");
+    const int dashIndex = contentRange.indexOf('-', unit.size());
+    const int slashIndex = contentRange.indexOf('/', dashIndex + 1);
+    if (!contentRange.startsWith(unit) || dashIndex < 0 || slashIndex < 0)
+        return false;
+
+    bool firstValid = false;
+    bool lastValid = false;
+    bool totalValid = false;
+    *first = contentRange.mid(unit.size(), dashIndex - unit.size()).toLongLong(&firstValid);
+    *last = contentRange.mid(dashIndex + 1, slashIndex - dashIndex - 1).toLongLong(&lastValid);
+    *total = contentRange.mid(slashIndex + 1).toLongLong(&totalValid);
+
+    return firstValid && lastValid && totalValid &&
+            *first >= 0 && *first <= *last && *last < *total;
+}
+
 FileDownloadCommandEntity::FileDownloadCommandEntity(QObject* parent,
                                                      QString remotePath,
                                                      QString localPath,
@@ -10,6 +65,8 @@ FileDownloadCommandEntity::FileDownloadCommandEntity(QObject* parent,
 {
     this->m_remotePath = remotePath;
     this->m_localFile = new QFile(localPath, this);
+    this->m_partFile = new QFile(localPath + PART_FILE_SUFFIX, this);
+    this->m_entityTagFile.setFileName(localPath + ENTITYTAG_FILE_SUFFIX);
     const QString localDir = localPath.left(localPath.lastIndexOf(QDir::separator())+1);
     this->m_localDir = QDir(localDir);
     const QString fileName = QFileInfo(*this->m_localFile).fileName();
@@ -34,7 +91,7 @@ FileDownloadCommandEntity::~FileDownloadCommandEntity()
 
 bool FileDownloadCommandEntity::startWork()
 {
-    if (!CommandEntity::startWork())
+    if (!WebDavCommandEntity::startWork())
         return false;
 
     setState(RUNNING);
@@ -47,51 +104,543 @@ bool FileDownloadCommandEntity::startWork()
         }
     }
 
-    // Remove existing file before download
-    if (this->m_localFile->exists()) {
-        const bool removeSuccess = this->m_localFile->remove();
-        if (!removeSuccess) {
-            qWarning() << "Failed to remove existing file" << this->m_localFile->fileName() << ", aborting.";
+    const bool isOpen = this->m_partFile->open(QFile::ReadWrite);
+    if (!isOpen) {
+        qWarning() << "Failed to open" << this->m_partFile->fileName() << ", aborting.";
+        abortWork();
+        return false;
+    }
+
+    // Without the entity tag a changed remote file couldn't be detected
+    this->m_entityTag = storedEntityTag();
+    this->m_resumeOffset = this->m_entityTag.isEmpty() ? 0 : this->m_partFile->size();
+
+    if (this->m_rateLimiter) {
+        QObject::connect(this->m_rateLimiter, &TransferRateLimiter::tokensAvailable,
+                         this, &FileDownloadCommandEntity::readAvailable);
+    }
+
+    startRequest();
+    return true;
+}
+
+bool FileDownloadCommandEntity::abortWork()
+{
+    detachReply();
+    clearSegments();
+
+    // Keep the partial file, the next attempt continues where this one stopped
+    if (this->m_partFile && this->m_partFile->isOpen())
+        this->m_partFile->close();
+
+    return WebDavCommandEntity::abortWork();
+}
+
+void FileDownloadCommandEntity::startRequest()
+{
+    this->m_receivedBytes = 0;
+
+    if (this->m_resumeOffset > 0) {
+        qInfo() << "Resuming download of" << this->m_remotePath
+                << "at" << this->m_resumeOffset << "bytes";
+        this->m_partFile->seek(this->m_resumeOffset);
+    } else {
+        this->m_partFile->resize(0);
+        this->m_partFile->seek(0);
+    }
+    this->m_reply = getFrom(this->m_resumeOffset);
+
+    QObject::connect(this->m_reply, &QNetworkReply::metaDataChanged,
+                     this, &FileDownloadCommandEntity::verifyResponse);
+    QObject::connect(this->m_reply, &QNetworkReply::readyRead, this, [=]() {
+        readStream(false);
+    });
+    QObject::connect(this->m_reply, &QNetworkReply::finished,
+                     this, &FileDownloadCommandEntity::requestFinished);
+    QObject::connect(this->m_reply, &QNetworkReply::downloadProgress,
+                     this, [=](qint64 bytesReceived, qint64 bytesTotal) {
+        this->m_receivedBytes = bytesReceived;
+        if (bytesTotal < 1)
+            return;
+        const qreal newProgress = ((qreal)(this->m_resumeOffset + bytesReceived) /
+                                   (qreal)(this->m_resumeOffset + bytesTotal));
+        setProgress(newProgress);
+    });
+}
+
+void FileDownloadCommandEntity::restartFromScratch()
+{
+    qInfo() << this->m_remotePath << "changed since the partial download, starting over";
+
+    detachReply();
+    this->m_resumeOffset = 0;
+    this->m_entityTag.clear();
+    this->m_entityTagFile.remove();
+    startRequest();
+}
+
+void FileDownloadCommandEntity::verifyResponse()
+{
+    if (!this->m_reply)
+        return;
+
+    // Checked before the first data arrives, i.e. before it is written to the partial file
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QByteArray entityTag = this->m_reply->rawHeader(QByteArrayLiteral("ETag"));
+
+    if (this->m_resumeOffset > 0) {
+        if (httpCode == 206 && entityTag == this->m_entityTag)
+            return;
+
+        // A different version of the file or one which shrunk
+        if (httpCode == 206 || httpCode == 416) {
+            restartFromScratch();
+            return;
+        }
+
+        // The server ignored the range, the whole file follows
+        if (httpCode == 200) {
+            this->m_partFile->resize(0);
+            this->m_partFile->seek(0);
+            this->m_resumeOffset = 0;
+        }
+    }
+
+    if (shouldSegment()) {
+        startSegments();
+        return;
+    }
+
+    if (httpCode >= 200 && httpCode < 300 &&
+            !entityTag.isEmpty() && entityTag != this->m_entityTag) {
+        storeEntityTag(entityTag);
+    }
+}
+
+void FileDownloadCommandEntity::requestFinished()
+{
+    if (!this->m_reply)
+        return;
+
+    const QNetworkReply::NetworkError error = this->m_reply->error();
+    const QString errorString = this->m_reply->errorString();
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // Whatever is still buffered is part of the file, also if the connection dropped
+    if (httpCode >= 200 && httpCode < 300) {
+        readStream(true);
+        if (!this->m_reply)
+            return;
+    }
+
+    detachReply();
+    this->m_partFile->flush();
+
+    if (error == QNetworkReply::NoError && httpCode >= 200 && httpCode < 300) {
+        if (!finishDownload()) {
             abortWork();
-            return false;
+            return;
         }
+
+        qInfo() << "File download" << this->m_remotePath << "complete.";
+        Q_EMIT done();
+        return;
     }
 
-    const bool isOpen = this->m_localFile->open(QFile::ReadWrite);
-    if (!isOpen) {
-        qWarning() << "Failed to create local file, aborting.";
-        abortWork();
+    // Links which drop regularly still make progress with every attempt,
+    // only give up once the retries ran out without getting any further.
+    if (this->m_receivedBytes > 0)
+        this->m_retries = 0;
+
+    if (isTransientNetworkError(error) && this->m_retries < FILEDOWNLOAD_MAX_RETRIES) {
+        this->m_retries++;
+        this->m_resumeOffset = this->m_entityTag.isEmpty() ? 0 : this->m_partFile->size();
+        qWarning() << "Download of" << this->m_remotePath << "interrupted:" << errorString
+                   << ", retry" << this->m_retries << "of" << FILEDOWNLOAD_MAX_RETRIES;
+
+        QTimer::singleShot(this->m_retries * 1000, this, [=]() {
+            // Aborted in the meantime
+            if (!this->m_partFile->isOpen())
+                return;
+            startRequest();
+        });
+        return;
+    }
+
+    qWarning() << "Download of" << this->m_remotePath << "failed, HTTP" << httpCode << errorString;
+    abortWork();
+}
+
+bool FileDownloadCommandEntity::finishDownload()
+{
+    this->m_partFile->close();
+
+    if (this->m_localFile->exists() && !this->m_localFile->remove()) {
+        qWarning() << "Failed to remove existing file" << this->m_localFile->fileName();
         return false;
     }
 
-    if (!this->m_client) {
-        qWarning() << "No valid client object available, aborting";
-        abortWork();
+    if (!QFile::rename(this->m_partFile->fileName(), this->m_localFile->fileName())) {
+        qWarning() << "Failed to move" << this->m_partFile->fileName()
+                   << "to" << this->m_localFile->fileName();
         return false;
     }
 
-    this->m_reply = this->m_client->get(this->m_remotePath, this->m_localFile);
-    QObject::connect(this->m_reply, &QNetworkReply::finished, this, [=]() {
-        qInfo() << "File download" << this->m_remotePath << "complete.";
-    });
+    this->m_entityTagFile.remove();
+    return true;
+}
+
+QByteArray FileDownloadCommandEntity::storedEntityTag()
+{
+    if (!this->m_entityTagFile.open(QFile::ReadOnly))
+        return QByteArray();
+
+    const QByteArray entityTag = this->m_entityTagFile.readAll().trimmed();
+    this->m_entityTagFile.close();
+    return entityTag;
+}
+
+void FileDownloadCommandEntity::storeEntityTag(const QByteArray& entityTag)
+{
+    this->m_entityTag = entityTag;
 
-    const bool canStart = WebDavCommandEntity::startWork();
-    if (!canStart) {
+    if (!this->m_entityTagFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "Failed to store entity tag of" << this->m_partFile->fileName();
+        return;
+    }
+    this->m_entityTagFile.write(entityTag);
+    this->m_entityTagFile.close();
+}
+
+void FileDownloadCommandEntity::detachReply()
+{
+    if (!this->m_reply)
+        return;
+
+    QNetworkReply* reply = this->m_reply;
+    this->m_reply = Q_NULLPTR;
+
+    QObject::disconnect(reply, nullptr, this, nullptr);
+    if (!reply->isFinished())
+        reply->abort();
+    reply->deleteLater();
+}
+
+bool FileDownloadCommandEntity::shouldSegment() const
+{
+    if (!this->m_segmentingAllowed || !this->m_reply || this->m_resumeOffset > 0)
         return false;
+
+    // Ranges are only combined if they are known to belong to the same version
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const qint64 size = this->m_reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    const bool acceptsRanges =
+            this->m_reply->rawHeader(QByteArrayLiteral("Accept-Ranges")).contains("bytes");
+    const bool hasEntityTag = !this->m_reply->rawHeader(QByteArrayLiteral("ETag")).isEmpty();
+
+    return httpCode == 200 && acceptsRanges && hasEntityTag &&
+            size >= FILEDOWNLOAD_SEGMENTED_THRESHOLD;
+}
+
+void FileDownloadCommandEntity::startSegments()
+{
+    this->m_entityTag = this->m_reply->rawHeader(QByteArrayLiteral("ETag"));
+    this->m_size = this->m_reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    qInfo() << "Downloading" << this->m_remotePath << "in" << FILEDOWNLOAD_SEGMENTS << "segments";
+
+    // The ranges are requested separately, the first one included
+    detachReply();
+
+    // A partial file with holes can't be resumed
+    this->m_entityTagFile.remove();
+
+    // Preallocated but sparse until the ranges arrive
+    this->m_partFile->flush();
+    if (!this->m_partFile->resize(this->m_size)) {
+        qWarning() << "Failed to allocate" << this->m_partFile->fileName() << ", aborting.";
+        abortWork();
+        return;
     }
 
-    setState(RUNNING);
-    return true;
+    const QVector<QPair<qint64, qint64> > ranges = splitByteRanges(this->m_size, FILEDOWNLOAD_SEGMENTS);
+    for (const QPair<qint64, qint64>& range : ranges) {
+        Segment segment;
+        segment.offset = range.first;
+        segment.length = range.second;
+
+        // Every range writes through its own handle, positioned at its offset
+        segment.file = new QFile(this->m_partFile->fileName(), this);
+        if (!segment.file->open(QFile::ReadWrite)) {
+            qWarning() << "Failed to open" << segment.file->fileName() << ", aborting.";
+            delete segment.file;
+            abortWork();
+            return;
+        }
+        this->m_segments.append(segment);
+    }
+
+    for (int index = 0; index < this->m_segments.size(); index++) {
+        startSegment(index);
+    }
 }
 
-bool FileDownloadCommandEntity::abortWork()
+void FileDownloadCommandEntity::startSegment(int index)
+{
+    Segment& segment = this->m_segments[index];
+    const qint64 position = segment.offset + segment.received;
+
+    // Ranges are open ended, the request is cancelled once the segment is complete
+    segment.requestStart = segment.received;
+    segment.file->seek(position);
+    segment.reply = getFrom(position);
+
+    QObject::connect(segment.reply, &QNetworkReply::metaDataChanged, this, [=]() {
+        verifySegment(index);
+    });
+    QObject::connect(segment.reply, &QNetworkReply::readyRead, this, [=]() {
+        readSegment(index, false);
+    });
+    QObject::connect(segment.reply, &QNetworkReply::finished, this, [=]() {
+        segmentFinished(index);
+    });
+}
+
+void FileDownloadCommandEntity::verifySegment(int index)
+{
+    const Segment& segment = this->m_segments.at(index);
+    if (!segment.reply)
+        return;
+
+    const int httpCode = segment.reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QByteArray entityTag = segment.reply->rawHeader(QByteArrayLiteral("ETag"));
+    const qint64 position = segment.offset + segment.requestStart;
+
+    bool valid = (entityTag == this->m_entityTag);
+    if (position > 0) {
+        qint64 first = 0;
+        qint64 last = 0;
+        qint64 total = 0;
+        valid = valid && httpCode == 206 &&
+                parseContentRange(segment.reply->rawHeader(QByteArrayLiteral("Content-Range")),
+                                  &first, &last, &total) &&
+                first == position && total == this->m_size;
+    } else {
+        const qint64 size = segment.reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        valid = valid && httpCode == 200 && size == this->m_size;
+    }
+
+    if (!valid) {
+        qWarning() << "Range" << index << "of" << this->m_remotePath << "doesn't match, HTTP" << httpCode;
+        fallBackToSingleStream();
+    }
+}
+
+void FileDownloadCommandEntity::readSegment(int index, bool drain)
+{
+    Segment& segment = this->m_segments[index];
+    if (!segment.reply || segment.complete)
+        return;
+
+    // The remaining bytes belong to the following segments
+    const qint64 written = readReply(segment.reply, segment.file,
+                                     segment.length - segment.received, drain);
+    if (written < 0) {
+        qWarning() << "Failed to write range" << index << "of" << this->m_partFile->fileName();
+        abortWork();
+        return;
+    }
+    if (written == 0)
+        return;
+
+    segment.received += written;
+
+    qint64 receivedBytes = 0;
+    for (const Segment& currentSegment : this->m_segments) {
+        receivedBytes += currentSegment.received;
+    }
+    setProgress((qreal)receivedBytes / (qreal)this->m_size);
+
+    if (segment.received >= segment.length)
+        completeSegment(index);
+}
+
+void FileDownloadCommandEntity::segmentFinished(int index)
 {
-    const bool success = WebDavCommandEntity::abortWork();
+    Segment& segment = this->m_segments[index];
+    if (!segment.reply)
+        return;
+
+    const QNetworkReply::NetworkError error = segment.reply->error();
+    const QString errorString = segment.reply->errorString();
+    const int httpCode = segment.reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (httpCode >= 200 && httpCode < 300) {
+        readSegment(index, true);
+
+        // Completed by the remaining data, or aborted
+        if (index >= this->m_segments.size() || !this->m_segments.at(index).reply)
+            return;
+    }
+
+    detachSegment(index);
 
-    // Don't keep stale files around in case of command abortion
-    if (this->m_localFile && this->m_localFile->exists()) {
-        this->m_localFile->remove();
+    if (error == QNetworkReply::NoError && httpCode >= 200 && httpCode < 300 &&
+            segment.received >= segment.length) {
+        completeSegment(index);
+        return;
     }
 
-    return success;
+    if (segment.received > segment.requestStart)
+        segment.retries = 0;
+
+    // A range which ended early is resumed just like a dropped connection
+    const bool resumable = (error == QNetworkReply::NoError || isTransientNetworkError(error));
+    if (resumable && segment.retries < FILEDOWNLOAD_MAX_RETRIES) {
+        segment.retries++;
+        qWarning() << "Range" << index << "of" << this->m_remotePath << "interrupted:" << errorString
+                   << ", retry" << segment.retries << "of" << FILEDOWNLOAD_MAX_RETRIES;
+
+        segment.file->open(QFile::ReadWrite);
+        QTimer::singleShot(segment.retries * 1000, this, [=]() {
+            // Aborted or fallen back in the meantime
+            if (index >= this->m_segments.size() || !this->m_segments.at(index).file->isOpen())
+                return;
+            startSegment(index);
+        });
+        return;
+    }
+
+    qWarning() << "Range" << index << "of" << this->m_remotePath << "failed, HTTP"
+               << httpCode << errorString;
+    abortWork();
+}
+
+void FileDownloadCommandEntity::completeSegment(int index)
+{
+    detachSegment(index);
+    this->m_segments[index].complete = true;
+
+    for (const Segment& segment : this->m_segments) {
+        if (!segment.complete)
+            return;
+    }
+
+    clearSegments();
+
+    if (QFileInfo(this->m_partFile->fileName()).size() != this->m_size) {
+        qWarning() << "Size of" << this->m_partFile->fileName() << "doesn't match, aborting.";
+        abortWork();
+        return;
+    }
+
+    if (!finishDownload()) {
+        abortWork();
+        return;
+    }
+
+    qInfo() << "File download" << this->m_remotePath << "complete.";
+    Q_EMIT done();
+}
+
+void FileDownloadCommandEntity::detachSegment(int index)
+{
+    Segment& segment = this->m_segments[index];
+
+    if (segment.reply) {
+        QNetworkReply* reply = segment.reply;
+        segment.reply = Q_NULLPTR;
+
+        QObject::disconnect(reply, nullptr, this, nullptr);
+        if (!reply->isFinished())
+            reply->abort();
+        reply->deleteLater();
+    }
+
+    // Flushes whatever has been written for the segment
+    if (segment.file && segment.file->isOpen())
+        segment.file->close();
+}
+
+void FileDownloadCommandEntity::fallBackToSingleStream()
+{
+    qWarning() << "Downloading" << this->m_remotePath << "as a single stream instead";
+
+    clearSegments();
+    this->m_segmentingAllowed = false;
+    this->m_size = -1;
+    restartFromScratch();
+}
+
+void FileDownloadCommandEntity::clearSegments()
+{
+    for (int index = 0; index < this->m_segments.size(); index++) {
+        detachSegment(index);
+        this->m_segments[index].file->deleteLater();
+    }
+    this->m_segments.clear();
+}
+
+QNetworkReply* FileDownloadCommandEntity::getFrom(qint64 offset)
+{
+    QNetworkRequest request(webdavUrl(this->m_client, this->m_remotePath));
+    if (offset > 0) {
+        request.setRawHeader(QByteArrayLiteral("Range"),
+                             QByteArrayLiteral("bytes=") + QByteArray::number(offset) + '-');
+    }
+
+    QNetworkReply* reply = static_cast<QNetworkAccessManager*>(this->m_client)->get(request);
+
+    // Data which isn't read yet stays in the socket, the sender slows down
+    // to the rate it is read at
+    if (this->m_rateLimiter)
+        reply->setReadBufferSize(FILEDOWNLOAD_READ_BUFFER_SIZE);
+    return reply;
+}
+
+qint64 FileDownloadCommandEntity::readReply(QNetworkReply* reply, QFile* file,
+                                            qint64 maxBytes, bool drain)
+{
+    qint64 written = 0;
+
+    while (reply->bytesAvailable() > 0 && (maxBytes < 0 || written < maxBytes)) {
+        qint64 wanted = reply->bytesAvailable();
+        if (maxBytes >= 0)
+            wanted = qMin(wanted, maxBytes - written);
+
+        // A finished reply has nothing more in flight, its buffer is taken as is
+        const qint64 granted = (this->m_rateLimiter && !drain)
+                ? this->m_rateLimiter->take(wanted) : wanted;
+        if (granted <= 0)
+            break;
+
+        const QByteArray data = reply->read(granted);
+        if (data.isEmpty())
+            break;
+        if (file->write(data) != data.size())
+            return -1;
+        written += data.size();
+    }
+
+    return written;
+}
+
+void FileDownloadCommandEntity::readStream(bool drain)
+{
+    if (!this->m_reply)
+        return;
+
+    if (readReply(this->m_reply, this->m_partFile, -1, drain) < 0) {
+        qWarning() << "Failed to write" << this->m_partFile->fileName() << ", aborting.";
+        abortWork();
+    }
+}
+
+void FileDownloadCommandEntity::readAvailable()
+{
+    readStream(false);
+
+    // Reading a segment might complete the download and clear the segments
+    for (int index = 0; index < this->m_segments.size(); index++) {
+        readSegment(index, false);
+    }
 }
@@ -4,9 +4,42 @@
 #include <QObject>
 #include <QFile>
 #include <QDir>
+#include <QPair>
+#include <QVector>
 #include "webdavcommandentity.h"
 #include <settings/nextcloudsettingsbase.h>
 
+// Number of times a dropped connection is resumed without any progress in between
+const int FILEDOWNLOAD_MAX_RETRIES = 5;
+
+// Files of at least this size are fetched as several byte ranges at once
+const qint64 FILEDOWNLOAD_SEGMENTED_THRESHOLD = 32 * 1024 * 1024;
+const int FILEDOWNLOAD_SEGMENTS = 4;
+
+// Data buffered per request with a rate limiter, beyond it the socket isn't read
+const qint64 FILEDOWNLOAD_READ_BUFFER_SIZE = 64 * 1024;
+
+// Splits size bytes into at most count ranges of equal length, the last
+// one taking the remainder. Every range is returned as (offset, length).
+QVector<QPair<qint64, qint64> > splitByteRanges(qint64 size, int count);
+
+// Parses a Content-Range header of the form "bytes <first>-<last>/<total>".
+// Returns false for anything else, including unsatisfied ranges.
+bool parseContentRange(const QByteArray& contentRange,
+                       qint64* first, qint64* last, qint64* total);
+
+// Downloads into "<localPath>.part", which is moved into place once complete.
+// The partial file and the entity tag it belongs to are kept when the
+// download is interrupted or aborted; the next attempt only requests the
+// missing range and starts over in case the remote file has changed.
+// Large files are split into FILEDOWNLOAD_SEGMENTS byte ranges which are
+// fetched concurrently into the preallocated partial file, each range
+// through its own file handle positioned at its offset. Every range has
+// to come from the same version of the file; otherwise the download
+// falls back to a single stream. Segmented downloads aren't resumed
+// across attempts as their partial file has holes.
+// With a rate limiter every request only reads what the limiter grants,
+// so all segments and downloads together stay within the limit.
 class FileDownloadCommandEntity : public WebDavCommandEntity
 {
     Q_OBJECT
@@ -27,7 +60,54 @@ protected:
     QDir m_localDir;
 
 private:
-    bool m_running = false;
+    struct Segment
+    {
+        qint64 offset = 0;
+        qint64 length = 0;
+        qint64 received = 0;
+        qint64 requestStart = 0; // received when the current request started
+        int retries = 0;
+        bool complete = false;
+        QFile* file = Q_NULLPTR;
+        QNetworkReply* reply = Q_NULLPTR;
+    };
+
+    QNetworkReply* getFrom(qint64 offset);
+    qint64 readReply(QNetworkReply* reply, QFile* file, qint64 maxBytes, bool drain);
+    void readStream(bool drain);
+    void readAvailable();
+
+    void startRequest();
+    void restartFromScratch();
+    void verifyResponse();
+    void requestFinished();
+    bool finishDownload();
+
+    QByteArray storedEntityTag();
+    void storeEntityTag(const QByteArray& entityTag);
+    void detachReply();
+
+    bool shouldSegment() const;
+    void startSegments();
+    void startSegment(int index);
+    void verifySegment(int index);
+    void readSegment(int index, bool drain);
+    void segmentFinished(int index);
+    void completeSegment(int index);
+    void detachSegment(int index);
+    void fallBackToSingleStream();
+    void clearSegments();
+
+    QFile* m_partFile = Q_NULLPTR;
+    QFile m_entityTagFile;
+    QByteArray m_entityTag;
+    qint64 m_resumeOffset = 0;
+    qint64 m_receivedBytes = 0;
+    int m_retries = 0;
+
+    bool m_segmentingAllowed = true;
+    qint64 m_size = -1;
+    QVector<Segment> m_segments;
 };
 
 #endif // FILEDOWNLOADCOMMANDENTITY_H
@@ -1,5 +1,11 @@
 #include "fileuploadcommandentity.h"
 
+#include <util/gziputil.h>
+#include <util/filerangedevice.h>
+#include <util/webdav_utils.h>
+
+#include <QTemporaryFile>
+
 #ifdef Q_OS_IOS
 #include <QUrlQuery>
 #endif
@@ -7,9 +13,15 @@
 FileUploadCommandEntity::FileUploadCommandEntity(QObject* parent,
                                                  QString localPath,
                                                  QString remotePath,
-                                                 QWebdav* client) :
+                                                 QWebdav* client,
+                                                 QDateTime lastModified,
+                                                 bool compress,
+                                                 bool createOnly) :
     WebDavCommandEntity(parent, client),
-    m_localFile(new QFile(localPath, this))
+    m_localFile(new QFile(localPath, this)),
+    m_lastModified(lastModified),
+    m_compress(compress),
+    m_createOnly(createOnly)
 {
 #ifdef Q_OS_IOS
     // On iOS we need to resolve the URL before use
@@ -48,7 +60,17 @@ bool FileUploadCommandEntity::startWork()
         return false;
     }
 
-    const bool isOpen = this->m_localFile->open(QFile::ReadOnly);
+    // Stream the body in large slices where possible
+    FileRangeDevice* rangeFile = new FileRangeDevice(this->m_localFile->fileName(), 0, -1, this);
+    if (rangeFile->open(QIODevice::ReadOnly)) {
+        this->m_uploadDevice = rangeFile;
+    } else {
+        rangeFile->deleteLater();
+        this->m_uploadDevice = this->m_localFile;
+    }
+
+    const bool isOpen = this->m_uploadDevice->isOpen() ||
+            this->m_localFile->open(QFile::ReadOnly);
     if (!isOpen) {
         qWarning() << "Failed to open" << this->m_localFile->fileName() << ", aborting.";
         abortWork();
@@ -60,12 +82,111 @@ bool FileUploadCommandEntity::startWork()
         abortWork();
         return false;
     }
-    this->m_reply = this->m_client->put(this->m_remotePath, this->m_localFile);
 
-    const bool canStart = WebDavCommandEntity::startWork();
-    if (!canStart)
+    if (!WebDavCommandEntity::startWork())
         return false;
 
     setState(RUNNING);
+
+    // Compressed into a temporary file first, so the request has a known length
+    // and can be resent; the local file isn't needed afterwards
+    if (this->m_compress && this->m_uploadDevice->size() <= FILEUPLOAD_MAX_COMPRESS_SIZE &&
+            isCompressibleFile(this->m_localFile->fileName())) {
+        QTemporaryFile* compressedFile = new QTemporaryFile(this);
+        if (compressedFile->open()) {
+            this->m_compressor = new GzipCompressor(this->m_uploadDevice, compressedFile,
+                                                    GZIP_DEFAULT_LEVEL, this);
+            QObject::connect(this->m_compressor, &GzipCompressor::finished, this, [=]() {
+                compressionFinished(compressedFile);
+            });
+            this->m_compressor->start();
+            return true;
+        }
+        compressedFile->deleteLater();
+    }
+
+    sendRequest(false);
     return true;
 }
+
+bool FileUploadCommandEntity::abortWork()
+{
+    if (this->m_compressor) {
+        QObject::disconnect(this->m_compressor, nullptr, this, nullptr);
+        this->m_compressor->deleteLater();
+        this->m_compressor = Q_NULLPTR;
+    }
+
+    return WebDavCommandEntity::abortWork();
+}
+
+void FileUploadCommandEntity::compressionFinished(QTemporaryFile* compressedFile)
+{
+    const bool compressed = this->m_compressor->succeeded() && compressedFile->seek(0);
+    this->m_compressor->deleteLater();
+    this->m_compressor = Q_NULLPTR;
+
+    if (compressed) {
+        qDebug() << "Compressed" << this->m_uploadDevice->size() << "to"
+                 << compressedFile->size() << "bytes";
+        this->m_uploadDevice->close();
+        this->m_uploadDevice = compressedFile;
+    } else {
+        qWarning() << "Failed to compress" << this->m_localFile->fileName()
+                   << ", uploading it as is";
+        compressedFile->deleteLater();
+        this->m_uploadDevice->seek(0);
+    }
+
+    sendRequest(compressed);
+}
+
+void FileUploadCommandEntity::sendRequest(bool compressed)
+{
+    // Read only as fast as the shared limit allows, also when it changes later on
+    QIODevice* body = rateLimitedDevice(this->m_uploadDevice);
+
+    if (this->m_lastModified.isValid() || compressed || this->m_createOnly) {
+        QNetworkRequest request(webdavUrl(this->m_client, this->m_remotePath));
+
+        // Nextcloud and ownCloud apply the modification time of the PUT body,
+        // saving the PROPPATCH round trip afterwards
+        if (this->m_lastModified.isValid()) {
+            request.setRawHeader(QByteArrayLiteral("X-OC-Mtime"),
+                                 QByteArray::number(this->m_lastModified.toMSecsSinceEpoch() / 1000));
+        }
+        if (compressed)
+            request.setRawHeader(QByteArrayLiteral("Content-Encoding"), QByteArrayLiteral("gzip"));
+        if (this->m_createOnly)
+            request.setRawHeader(QByteArrayLiteral("If-None-Match"), QByteArrayLiteral("*"));
+
+        this->m_reply = static_cast<QNetworkAccessManager*>(this->m_client)->put(request, body);
+    } else {
+        this->m_reply = this->m_client->put(this->m_remotePath, body);
+    }
+
+    // Reported before the reply is aborted on the error, so that it is known along with it
+    QObject::connect(this->m_reply,
+                     static_cast<void(QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error),
+                     this, [=]() {
+        const int httpCode =
+                this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (this->m_createOnly && httpCode == 412) {
+            qInfo() << this->m_remotePath << "exists remotely already, not replacing it";
+            QVariantMap result;
+            result.insert(QStringLiteral("exists"), true);
+            this->m_resultData = result;
+        }
+    });
+
+    QObject::connect(this->m_reply, &QNetworkReply::finished, this, [=]() {
+        const bool mtimeAccepted =
+                this->m_reply->rawHeader(QByteArrayLiteral("X-OC-MTime")) == QByteArrayLiteral("accepted");
+        QVariantMap result = this->m_resultData;
+        result.insert(QStringLiteral("mtimeAccepted"), mtimeAccepted);
+        result.insert(QStringLiteral("compressed"), compressed);
+        this->m_resultData = result;
+    });
+
+    connectReply();
+}
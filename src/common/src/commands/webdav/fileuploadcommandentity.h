@@ -3,8 +3,16 @@
 
 #include <QObject>
 #include <QFile>
+#include <QDateTime>
+#include <QTemporaryFile>
 #include "webdavcommandentity.h"
 #include <settings/nextcloudsettingsbase.h>
+#include <util/gziputil.h>
+
+// Larger files are sent as they are: the request only starts once the file
+// is compressed, and the compressed copy takes up memory where the
+// temporary directory is a tmpfs, as on Sailfish OS
+const qint64 FILEUPLOAD_MAX_COMPRESS_SIZE = 4 * 1024 * 1024;
 
 class FileUploadCommandEntity : public WebDavCommandEntity
 {
@@ -14,16 +22,34 @@ public:
     explicit FileUploadCommandEntity(QObject* parent = Q_NULLPTR,
                                      QString localPath = QStringLiteral(""),
                                      QString remotePath = QStringLiteral(""),
-                                     QWebdav* client = Q_NULLPTR);
+                                     QWebdav* client = Q_NULLPTR,
+                                     QDateTime lastModified = QDateTime(),
+                                     bool compress = false,
+                                     bool createOnly = false);
 
 protected:
     bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
     bool staticProgress() const Q_DECL_OVERRIDE { return false; }
 
 private:
+    void compressionFinished(QTemporaryFile* compressedFile);
+    void sendRequest(bool compressed);
+
     bool m_running = false;
     QFile* m_localFile = Q_NULLPTR;
+    QIODevice* m_uploadDevice = Q_NULLPTR;
     QString m_remotePath;
+
+    // Sent along as X-OC-Mtime, the result tells whether the server applied it
+    QDateTime m_lastModified;
+
+    // Send compressible files gzip encoded, the server has to decode them
+    bool m_compress = false;
+    GzipCompressor* m_compressor = Q_NULLPTR;
+
+    // Fail with 412 instead of replacing a file which exists remotely already
+    bool m_createOnly = false;
 };
 
 #endif // FILEUPLOADCOMMANDENTITY_H
@@ -0,0 +1,43 @@
+#include "fileuploadcommandunit.h"
+
+#include <QDebug>
+
+FileUploadCommandUnit::FileUploadCommandUnit(QObject* parent,
+                                             CommandEntity* uploadCommand,
+                                             CommandEntity* lastModifiedCommand,
+                                             CommandEntityInfo info) :
+    CommandUnit(parent, {uploadCommand}, info),
+    m_uploadCommand(uploadCommand),
+    m_lastModifiedCommand(lastModifiedCommand)
+{
+    if (!uploadCommand)
+        return;
+
+    // The PROPPATCH hardly takes any time, the transfer is what's worth showing
+    QObject::connect(uploadCommand, &CommandEntity::progressChanged, this, [=]() {
+        setProgress(uploadCommand->progress());
+    });
+    QObject::connect(uploadCommand, &CommandEntity::done, this, [=]() {
+        this->m_resultData = uploadCommand->resultData();
+    });
+    QObject::connect(uploadCommand, &CommandEntity::aborted, this, [=]() {
+        this->m_resultData = uploadCommand->resultData();
+    });
+}
+
+void FileUploadCommandUnit::expand(CommandEntity* previousCommandEntity)
+{
+    if (previousCommandEntity != this->m_uploadCommand || !this->m_lastModifiedCommand)
+        return;
+
+    CommandEntity* lastModifiedCommand = this->m_lastModifiedCommand;
+    this->m_lastModifiedCommand = Q_NULLPTR;
+
+    if (previousCommandEntity->resultData().value(QStringLiteral("mtimeAccepted")).toBool()) {
+        qDebug() << "Server applied the modification time along with the upload";
+        lastModifiedCommand->deleteLater();
+        return;
+    }
+
+    this->queue()->push_back(lastModifiedCommand);
+}
@@ -0,0 +1,31 @@
+#ifndef FILEUPLOADCOMMANDUNIT_H
+#define FILEUPLOADCOMMANDUNIT_H
+
+#include <QObject>
+#include <commandunit.h>
+
+// Uploads a file and makes sure its modification time is set remotely.
+// The upload sends the time along already; lastModifiedCommand (e.g. a
+// PROPPATCH) only runs if the server didn't confirm having applied it.
+// Stands in for the upload towards callers: it reports the progress and
+// the result data of the upload itself, e.g. "exists" of a createOnly one.
+class FileUploadCommandUnit : public CommandUnit
+{
+    Q_OBJECT
+
+public:
+    explicit FileUploadCommandUnit(QObject* parent = Q_NULLPTR,
+                                   CommandEntity* uploadCommand = Q_NULLPTR,
+                                   CommandEntity* lastModifiedCommand = Q_NULLPTR,
+                                   CommandEntityInfo info = CommandEntityInfo());
+
+protected:
+    void expand(CommandEntity* previousCommandEntity) Q_DECL_OVERRIDE;
+    bool staticProgress() const Q_DECL_OVERRIDE { return false; }
+
+private:
+    CommandEntity* m_uploadCommand = Q_NULLPTR;
+    CommandEntity* m_lastModifiedCommand = Q_NULLPTR;
+};
+
+#endif // FILEUPLOADCOMMANDUNIT_H
@@ -0,0 +1,385 @@
+#include "ncbulkuploadcommandentity.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHttpMultiPart>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QUuid>
+
+#include <util/filehasher.h>
+#include <util/webdav_utils.h>
+#include <nextcloudendpointconsts.h>
+
+NcBulkUploadReceipt::NcBulkUploadReceipt(QObject* parent, CommandEntityInfo info) :
+    CommandEntity(parent)
+{
+    this->m_commandInfo = info;
+}
+
+bool NcBulkUploadReceipt::startWork()
+{
+    if (!CommandEntity::startWork())
+        return false;
+
+    // Nothing to do, the batch resolves it
+    setState(RUNNING);
+    return true;
+}
+
+bool NcBulkUploadReceipt::isResolved() const
+{
+    return this->m_resolved;
+}
+
+void NcBulkUploadReceipt::resolve(bool success, const QVariantMap& result)
+{
+    if (this->m_resolved)
+        return;
+
+    this->m_resolved = true;
+    this->m_resultData = result;
+
+    if (!success) {
+        setState(ABORTED);
+        Q_EMIT aborted();
+        return;
+    }
+
+    setProgress(1.0);
+    setState(FINISHED);
+    Q_EMIT done();
+}
+
+NcBulkUploadCommandEntity::NcBulkUploadCommandEntity(QObject* parent, QWebdav* client) :
+    WebDavCommandEntity(parent, client)
+{
+    updateInfo();
+}
+
+CommandEntity* NcBulkUploadCommandEntity::addFile(const QString& localPath,
+                                                  const QString& remoteFile,
+                                                  const QDateTime& lastModified)
+{
+    if (this->m_started) {
+        qWarning() << "Bulk upload started already, not adding" << localPath;
+        return Q_NULLPTR;
+    }
+
+    const QString fileName = remoteFile.mid(remoteFile.lastIndexOf('/') + 1);
+    QMap<QString, QVariant> info;
+    info["type"] = QStringLiteral("fileUpload");
+    info["localPath"] = localPath;
+    info["remotePath"] = remoteFile.left(remoteFile.length() - fileName.length());
+    info["fileName"] = fileName;
+    info["remoteFile"] = remoteFile;
+
+    BulkFile bulkFile;
+    bulkFile.localPath = localPath;
+    bulkFile.remoteFile = remoteFile;
+    bulkFile.lastModified = lastModified;
+    bulkFile.receipt = new NcBulkUploadReceipt(this, CommandEntityInfo(info));
+
+    this->m_files.append(bulkFile);
+    this->m_byteCount += QFileInfo(localPath).size();
+    updateInfo();
+
+    return bulkFile.receipt;
+}
+
+int NcBulkUploadCommandEntity::fileCount() const
+{
+    return this->m_files.length();
+}
+
+qint64 NcBulkUploadCommandEntity::byteCount() const
+{
+    return this->m_byteCount;
+}
+
+bool NcBulkUploadCommandEntity::startWork()
+{
+    this->m_started = true;
+
+    if (!this->m_client) {
+        qWarning() << "No valid client object available, aborting";
+        abortWork();
+        return false;
+    }
+
+    if (!WebDavCommandEntity::startWork())
+        return false;
+
+    setState(RUNNING);
+
+    // Parts stream straight out of the files, the checksums have to be known upfront
+    hashNextFile();
+    return true;
+}
+
+bool NcBulkUploadCommandEntity::abortWork()
+{
+    this->m_stopped = true;
+    if (this->m_hasher) {
+        QObject::disconnect(this->m_hasher, nullptr, this, nullptr);
+        this->m_hasher->deleteLater();
+        this->m_hasher = Q_NULLPTR;
+    }
+
+    failPendingFiles(QStringLiteral("Bulk upload aborted"));
+    return WebDavCommandEntity::abortWork();
+}
+
+void NcBulkUploadCommandEntity::hashNextFile()
+{
+    if (this->m_stopped)
+        return;
+
+    if (this->m_nextFile >= this->m_files.length()) {
+        sendParts();
+        return;
+    }
+
+    const BulkFile& bulkFile = this->m_files.at(this->m_nextFile);
+    this->m_hasher = new FileHasher(bulkFile.localPath, QCryptographicHash::Md5,
+                                    NCBULKUPLOAD_SPOOL_BLOCK_SIZE, this);
+    QObject::connect(this->m_hasher, &FileHasher::finished,
+                     this, &NcBulkUploadCommandEntity::fileHashed);
+    this->m_hasher->start();
+}
+
+void NcBulkUploadCommandEntity::fileHashed()
+{
+    const QByteArray md5 = this->m_hasher->result();
+    this->m_hasher->deleteLater();
+    this->m_hasher = Q_NULLPTR;
+
+    const BulkFile& bulkFile = this->m_files.at(this->m_nextFile++);
+    QFile* localFile = new QFile(bulkFile.localPath, this);
+    if (md5.isEmpty() || !localFile->open(QFile::ReadOnly)) {
+        delete localFile;
+        resolveFile(bulkFile, false, QVariantMap());
+        hashNextFile();
+        return;
+    }
+
+    const QDateTime lastModified = bulkFile.lastModified.isValid()
+            ? bulkFile.lastModified : QFileInfo(*localFile).lastModified();
+
+    BulkPart part;
+    part.headers.append(qMakePair(QByteArrayLiteral("X-File-Path"),
+                                  bulkFile.remoteFile.toUtf8()));
+    part.headers.append(qMakePair(QByteArrayLiteral("X-File-MD5"),
+                                  md5.toHex()));
+    part.headers.append(qMakePair(QByteArrayLiteral("X-File-Mtime"),
+                                  QByteArray::number(lastModified.toMSecsSinceEpoch() / 1000)));
+    part.headers.append(qMakePair(QByteArrayLiteral("Content-Length"),
+                                  QByteArray::number(localFile->size())));
+    part.file = localFile;
+    this->m_parts.append(part);
+
+    hashNextFile();
+}
+
+void NcBulkUploadCommandEntity::sendParts()
+{
+    if (this->m_parts.isEmpty()) {
+        qWarning() << "None of the files of the bulk upload could be read";
+
+        QVariantMap result;
+        result.insert(QStringLiteral("success"), true);
+        result.insert(QStringLiteral("files"), this->m_files.length());
+        result.insert(QStringLiteral("failedFiles"), this->m_failedFiles);
+        this->m_resultData = result;
+
+        setState(FINISHED);
+        Q_EMIT done();
+        return;
+    }
+
+    qDebug() << "Uploading" << this->m_parts.length() << "files in a single request";
+
+    if (this->m_rateLimiter) {
+        // QHttpMultiPart can't wait for the limit, the parts are spooled
+        // into a temporary file which is read at the limited rate instead
+        this->m_boundary = QByteArrayLiteral("boundary_") +
+                QUuid::createUuid().toRfc4122().toHex();
+        this->m_spoolFile = new QTemporaryFile(this);
+        if (!this->m_spoolFile->open()) {
+            spoolFailed();
+            return;
+        }
+        spoolNextBlock();
+        return;
+    }
+
+    QHttpMultiPart* multiPart = new QHttpMultiPart(QHttpMultiPart::RelatedType);
+    for (const BulkPart& bulkPart : this->m_parts) {
+        QHttpPart part;
+        for (const QPair<QByteArray, QByteArray>& header : bulkPart.headers) {
+            part.setRawHeader(header.first, header.second);
+        }
+        bulkPart.file->setParent(multiPart);
+        part.setBodyDevice(bulkPart.file);
+        multiPart->append(part);
+    }
+
+    QNetworkRequest request(webdavUrl(this->m_client, NEXTCLOUD_ENDPOINT_DAV_BULK));
+    this->m_reply = static_cast<QNetworkAccessManager*>(this->m_client)->post(request, multiPart);
+    multiPart->setParent(this->m_reply);
+    this->m_parts.clear();
+
+    connectRequest();
+}
+
+void NcBulkUploadCommandEntity::spoolNextBlock()
+{
+    if (this->m_stopped)
+        return;
+
+    // Same layout as QHttpMultiPart produces, one block per event loop iteration
+    if (this->m_parts.isEmpty()) {
+        const QByteArray closingBoundary = QByteArrayLiteral("--") + this->m_boundary +
+                QByteArrayLiteral("--\r\n");
+        if (this->m_spoolFile->write(closingBoundary) != closingBoundary.size() ||
+                !this->m_spoolFile->flush() || !this->m_spoolFile->seek(0)) {
+            spoolFailed();
+            return;
+        }
+        sendSpooled();
+        return;
+    }
+
+    BulkPart& part = this->m_parts.first();
+    bool spooled = true;
+
+    if (!this->m_partHeadSpooled) {
+        QByteArray partHead = QByteArrayLiteral("--") + this->m_boundary + QByteArrayLiteral("\r\n");
+        for (const QPair<QByteArray, QByteArray>& header : part.headers) {
+            partHead += header.first + QByteArrayLiteral(": ") + header.second + QByteArrayLiteral("\r\n");
+        }
+        partHead += QByteArrayLiteral("\r\n");
+        spooled = (this->m_spoolFile->write(partHead) == partHead.size());
+        this->m_partHeadSpooled = true;
+    }
+
+    if (spooled && !part.file->atEnd()) {
+        const QByteArray block = part.file->read(NCBULKUPLOAD_SPOOL_BLOCK_SIZE);
+        spooled = !block.isEmpty() && this->m_spoolFile->write(block) == block.size();
+    }
+
+    if (spooled && part.file->atEnd()) {
+        spooled = this->m_spoolFile->write(QByteArrayLiteral("\r\n")) == 2;
+        delete part.file;
+        this->m_parts.removeFirst();
+        this->m_partHeadSpooled = false;
+    }
+
+    if (!spooled) {
+        spoolFailed();
+        return;
+    }
+    QTimer::singleShot(0, this, &NcBulkUploadCommandEntity::spoolNextBlock);
+}
+
+void NcBulkUploadCommandEntity::spoolFailed()
+{
+    qWarning() << "Failed to spool the bulk upload:" << this->m_spoolFile->errorString();
+    failPendingFiles(QStringLiteral("Failed to spool the bulk upload"));
+    abortWork();
+}
+
+void NcBulkUploadCommandEntity::sendSpooled()
+{
+    QNetworkRequest request(webdavUrl(this->m_client, NEXTCLOUD_ENDPOINT_DAV_BULK));
+    request.setHeader(QNetworkRequest::ContentTypeHeader,
+                      QByteArrayLiteral("multipart/related; boundary=") + this->m_boundary);
+    this->m_reply = static_cast<QNetworkAccessManager*>(this->m_client)->post(request,
+                                                                             rateLimitedDevice(this->m_spoolFile));
+    this->m_spoolFile->setParent(this->m_reply);
+    this->m_spoolFile = Q_NULLPTR;
+
+    connectRequest();
+}
+
+void NcBulkUploadCommandEntity::connectRequest()
+{
+    // Receipts are resolved before the batch reports being done
+    QObject::connect(this->m_reply, &QNetworkReply::finished,
+                     this, &NcBulkUploadCommandEntity::requestFinished);
+    connectReply();
+}
+
+void NcBulkUploadCommandEntity::requestFinished()
+{
+    if (!this->m_reply)
+        return;
+
+    const int httpCode = this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (this->m_reply->error() != QNetworkReply::NoError || httpCode < 200 || httpCode >= 300) {
+        failPendingFiles(QStringLiteral("HTTP %1: %2").arg(httpCode)
+                         .arg(this->m_reply->errorString()));
+        return;
+    }
+
+    // {"<X-File-Path>": {"error": false, "etag": "..."}, ...}
+    const QJsonObject fileResults = QJsonDocument::fromJson(this->m_reply->readAll()).object();
+
+    for (const BulkFile& bulkFile : this->m_files) {
+        const QJsonObject fileResult = fileResults.value(bulkFile.remoteFile).toObject();
+        const bool success = !fileResult.isEmpty() &&
+                !fileResult.value(QStringLiteral("error")).toBool(true);
+
+        QVariantMap result;
+        if (success) {
+            result.insert(QStringLiteral("etag"), fileResult.value(QStringLiteral("etag")).toString());
+        } else {
+            result.insert(QStringLiteral("message"),
+                          fileResult.value(QStringLiteral("message")).toString());
+        }
+        resolveFile(bulkFile, success, result);
+    }
+
+    QVariantMap result;
+    result.insert(QStringLiteral("success"), true);
+    result.insert(QStringLiteral("files"), this->m_files.length());
+    result.insert(QStringLiteral("failedFiles"), this->m_failedFiles);
+    this->m_resultData = result;
+}
+
+void NcBulkUploadCommandEntity::resolveFile(const BulkFile& bulkFile,
+                                            bool success,
+                                            QVariantMap result)
+{
+    if (bulkFile.receipt->isResolved())
+        return;
+
+    if (!success) {
+        qWarning() << "Bulk upload of" << bulkFile.localPath << "failed:"
+                   << result.value(QStringLiteral("message")).toString();
+        this->m_failedFiles++;
+    }
+
+    result.insert(QStringLiteral("success"), success);
+    bulkFile.receipt->resolve(success, result);
+}
+
+void NcBulkUploadCommandEntity::failPendingFiles(const QString& reason)
+{
+    QVariantMap result;
+    result.insert(QStringLiteral("message"), reason);
+
+    for (const BulkFile& bulkFile : this->m_files) {
+        resolveFile(bulkFile, false, result);
+    }
+}
+
+void NcBulkUploadCommandEntity::updateInfo()
+{
+    QVariantMap info;
+    info.insert(QStringLiteral("type"), "bulkUpload");
+    info.insert("files", this->m_files.length());
+    this->m_commandInfo = CommandEntityInfo(info);
+}
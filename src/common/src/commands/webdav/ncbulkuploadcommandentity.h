@@ -0,0 +1,124 @@
+#ifndef NCBULKUPLOADCOMMANDENTITY_H
+#define NCBULKUPLOADCOMMANDENTITY_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QFile>
+#include <QList>
+#include <QPair>
+#include <QTemporaryFile>
+#include "webdavcommandentity.h"
+
+class FileHasher;
+
+// Files up to this size are worth batching, larger ones are dominated
+// by their transfer time rather than by the per-request overhead
+const qint64 NCBULKUPLOAD_DEFAULT_MAX_FILE_SIZE = 1024 * 1024;
+
+// Number of files sent in a single bulk request by default
+const int NCBULKUPLOAD_DEFAULT_MAX_FILES = 100;
+
+// Block size used when hashing files and copying them into a spooled
+// request body, one block is handled per event loop iteration
+const qint64 NCBULKUPLOAD_SPOOL_BLOCK_SIZE = 64 * 1024;
+
+// Stands in for the upload of a single file of a bulk upload.
+// It isn't run by itself, it finishes or aborts along with its batch
+// depending on what the server reported for this particular file.
+class NcBulkUploadReceipt : public CommandEntity
+{
+    Q_OBJECT
+
+    friend class NcBulkUploadCommandEntity;
+
+public:
+    explicit NcBulkUploadReceipt(QObject* parent = Q_NULLPTR,
+                                 CommandEntityInfo info = CommandEntityInfo());
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+
+private:
+    bool isResolved() const;
+    void resolve(bool success, const QVariantMap& result);
+
+    bool m_resolved = false;
+};
+
+// Uploads many small files in one multipart/related POST to the
+// Nextcloud bulk upload endpoint, each part carrying its own path,
+// modification time and MD5 checksum.
+// The client is expected to be rooted at remote.php/dav and the server
+// to advertise the "bulkupload" DAV capability.
+// With a rate limiter the body is spooled into a temporary file first,
+// QHttpMultiPart reads its parts without ever waiting for more data.
+// The checksums are computed and the body is spooled block by block
+// before the request is sent, the files are small but a batch isn't.
+class NcBulkUploadCommandEntity : public WebDavCommandEntity
+{
+    Q_OBJECT
+
+public:
+    explicit NcBulkUploadCommandEntity(QObject* parent = Q_NULLPTR,
+                                       QWebdav* client = Q_NULLPTR);
+
+    // remoteFile is the full path of the file below the user's root.
+    // Returns the receipt of this file or Q_NULLPTR once the upload started.
+    CommandEntity* addFile(const QString& localPath,
+                           const QString& remoteFile,
+                           const QDateTime& lastModified = QDateTime());
+
+    int fileCount() const;
+    qint64 byteCount() const;
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+    bool staticProgress() const Q_DECL_OVERRIDE { return false; }
+
+private:
+    struct BulkFile
+    {
+        QString localPath;
+        QString remoteFile;
+        QDateTime lastModified;
+        NcBulkUploadReceipt* receipt = Q_NULLPTR;
+    };
+
+    struct BulkPart
+    {
+        QList<QPair<QByteArray, QByteArray> > headers;
+        QFile* file = Q_NULLPTR;
+    };
+
+    void hashNextFile();
+    void fileHashed();
+    void sendParts();
+    void spoolNextBlock();
+    void spoolFailed();
+    void sendSpooled();
+    void connectRequest();
+
+    void requestFinished();
+    void resolveFile(const BulkFile& bulkFile, bool success, QVariantMap result);
+    void failPendingFiles(const QString& reason);
+    void updateInfo();
+
+    QList<BulkFile> m_files;
+    qint64 m_byteCount = 0;
+    int m_failedFiles = 0;
+    bool m_started = false;
+
+    // Preparation of the request body
+    int m_nextFile = 0;
+    FileHasher* m_hasher = Q_NULLPTR;
+    QList<BulkPart> m_parts;
+    QTemporaryFile* m_spoolFile = Q_NULLPTR;
+    QByteArray m_boundary;
+    bool m_partHeadSpooled = false;
+
+    // Iterations scheduled before an abort find it stopped
+    bool m_stopped = false;
+};
+
+#endif // NCBULKUPLOADCOMMANDENTITY_H
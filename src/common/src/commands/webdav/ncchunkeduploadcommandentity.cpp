@@ -0,0 +1,507 @@
+#include "ncchunkeduploadcommandentity.h"
+
+#include <QBuffer>
+#include <QFileInfo>
+#include <QUuid>
+
+#include <settings/db/syncdb.h>
+#include <util/filerangedevice.h>
+#include <util/webdav_utils.h>
+#include <nextcloudendpointconsts.h>
+
+NcChunkedUploadCommandEntity::NcChunkedUploadCommandEntity(QObject* parent,
+                                                           QString localPath,
+                                                           QString remotePath,
+                                                           QString userName,
+                                                           QWebdav* client,
+                                                           SyncDb* syncDb,
+                                                           QDateTime lastModified,
+                                                           qint64 chunkSize,
+                                                           int maxParallelChunks,
+                                                           bool createOnly) :
+    WebDavCommandEntity(parent, client),
+    m_localFile(localPath),
+    m_userName(userName),
+    m_syncDb(syncDb),
+    m_lastModified(lastModified),
+    m_chunkSize(qMax<qint64>(1, chunkSize)),
+    m_maxParallelChunks(qMax(1, maxParallelChunks)),
+    m_createOnly(createOnly)
+{
+    const QString fileName = QFileInfo(this->m_localFile).fileName();
+    this->m_remoteFile = remotePath + fileName;
+
+    QMap<QString, QVariant> info;
+    info["type"] = QStringLiteral("davChunkedPut");
+    info["localPath"] = localPath;
+    info["remotePath"] = remotePath;
+    info["fileName"] = fileName;
+    info["remoteFile"] = remotePath + fileName;
+    this->m_commandInfo = CommandEntityInfo(info);
+}
+
+QString NcChunkedUploadCommandEntity::uploadPath() const
+{
+    return NEXTCLOUD_ENDPOINT_DAV_UPLOADS.arg(this->m_userName)
+            + QStringLiteral("/") + this->m_state.transferId;
+}
+
+QString NcChunkedUploadCommandEntity::chunkPath(int chunkNumber) const
+{
+    // Chunks are assembled in the order of their names
+    return uploadPath() + QStringLiteral("/%1").arg(chunkNumber, 5, 10, QChar('0'));
+}
+
+int NcChunkedUploadCommandEntity::chunkCount() const
+{
+    // The reused start of the file is a chunk of its own
+    const int reusedChunks = (this->m_state.reusedBytes > 0) ? 1 : 0;
+    const qint64 remainingBytes = this->m_state.size - this->m_state.reusedBytes;
+    return reusedChunks + static_cast<int>((remainingBytes + this->m_chunkSize - 1) / this->m_chunkSize);
+}
+
+qint64 NcChunkedUploadCommandEntity::chunkOffset(int chunkNumber) const
+{
+    if (this->m_state.reusedBytes <= 0)
+        return (chunkNumber - 1) * this->m_chunkSize;
+    if (chunkNumber == 1)
+        return 0;
+    return this->m_state.reusedBytes + (chunkNumber - 2) * this->m_chunkSize;
+}
+
+qint64 NcChunkedUploadCommandEntity::chunkLength(int chunkNumber) const
+{
+    if (isReusedChunk(chunkNumber))
+        return this->m_state.reusedBytes;
+    return qMin(this->m_chunkSize, this->m_state.size - chunkOffset(chunkNumber));
+}
+
+bool NcChunkedUploadCommandEntity::isReusedChunk(int chunkNumber) const
+{
+    return chunkNumber == 1 && this->m_state.reusedBytes > 0;
+}
+
+bool NcChunkedUploadCommandEntity::startWork()
+{
+    if (!WebDavCommandEntity::startWork())
+        return false;
+
+    if (!this->m_localFile.exists()) {
+        qWarning() << "Local file" << this->m_localFile.fileName() << "does not exist, aborting.";
+        abortWork();
+        return false;
+    }
+
+    if (!this->m_localFile.open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open" << this->m_localFile.fileName() << ", aborting.";
+        abortWork();
+        return false;
+    }
+
+    const QFileInfo localFileInfo(this->m_localFile);
+    const qint64 size = localFileInfo.size();
+    const qint64 lastModified = localFileInfo.lastModified().toMSecsSinceEpoch() / 1000;
+
+    BlockManifest previousManifest;
+    if (this->m_syncDb) {
+        previousManifest = this->m_syncDb->loadBlockManifest(this->m_localFile.fileName(),
+                                                             this->m_remoteFile);
+        this->m_previousEntityTag = previousManifest.remoteEntityTag;
+
+        this->m_manifestBuilder = new BlockManifestBuilder(this->m_localFile.fileName(),
+                                                           BLOCKMANIFEST_DEFAULT_BLOCK_SIZE,
+                                                           this);
+        this->m_manifestBuilder->start();
+    }
+
+    // Continue a previous attempt only if the file is still the same
+    if (this->m_syncDb) {
+        const NcChunkedUploadState storedState =
+                this->m_syncDb->loadChunkedUpload(this->m_localFile.fileName(), this->m_remoteFile);
+        const bool canCopyPreviousVersion = storedState.uploadedChunks.contains(1) ||
+                !this->m_previousEntityTag.isEmpty();
+        if (storedState.isValid() &&
+                storedState.size == size &&
+                storedState.lastModified == lastModified &&
+                storedState.chunkSize == this->m_chunkSize &&
+                (storedState.reusedBytes <= 0 || canCopyPreviousVersion)) {
+            this->m_state = storedState;
+            this->m_resuming = true;
+        }
+    }
+
+    if (!this->m_resuming) {
+        this->m_state.transferId = QUuid::createUuid().toString().mid(1, 36);
+        this->m_state.size = size;
+        this->m_state.lastModified = lastModified;
+        this->m_state.chunkSize = this->m_chunkSize;
+
+        // Only appended to since the previous upload? Tells once the file is hashed.
+        if (this->m_manifestBuilder && !this->m_previousEntityTag.isEmpty() &&
+                previousManifest.size < size) {
+            QObject::connect(this->m_manifestBuilder, &BlockManifestBuilder::finished, this, [=]() {
+                if (previousManifest.isPrefixOf(this->m_localFile.fileName(),
+                                                this->m_manifestBuilder->manifest())) {
+                    this->m_state.reusedBytes = previousManifest.size;
+                }
+                createUploadFolder();
+            });
+            setState(RUNNING);
+            return true;
+        }
+    }
+
+    createUploadFolder();
+    setState(RUNNING);
+    return true;
+}
+
+void NcChunkedUploadCommandEntity::createUploadFolder()
+{
+    if (this->m_state.reusedBytes > 0) {
+        qInfo() << "Reusing" << this->m_state.reusedBytes << "of" << this->m_state.size
+                << "bytes of the previous upload";
+    }
+
+    qInfo() << (this->m_resuming ? "Resuming" : "Starting") << "chunked upload of"
+            << this->m_localFile.fileName() << "with"
+            << this->m_state.uploadedChunks.size() << "of" << chunkCount() << "chunks done";
+
+    QNetworkReply* reply = this->m_client->mkdir(uploadPath());
+    this->m_runningChunks.insert(reply, 0);
+    QObject::connect(reply, &QNetworkReply::finished, this, [=]() {
+        if (!this->m_runningChunks.contains(reply))
+            return;
+        this->m_runningChunks.remove(reply);
+        reply->deleteLater();
+
+        const int httpCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+        // 405: the folder of the interrupted attempt still exists
+        if (httpCode == 405 && this->m_resuming) {
+            uploadFolderCreated();
+            return;
+        }
+
+        if (httpCode != 201) {
+            fail(QStringLiteral("Failed to create upload folder, HTTP %1").arg(httpCode));
+            return;
+        }
+
+        // The server discarded the previous attempt, start over
+        if (this->m_resuming) {
+            qInfo() << "Upload folder of" << this->m_remoteFile << "has expired, starting over";
+            this->m_state.uploadedChunks.clear();
+            if (this->m_previousEntityTag.isEmpty())
+                this->m_state.reusedBytes = 0;
+        }
+        uploadFolderCreated();
+    });
+}
+
+bool NcChunkedUploadCommandEntity::abortWork()
+{
+    // Detach first, aborting a request emits signals synchronously
+    const QList<QNetworkReply*> runningReplies = this->m_runningChunks.keys();
+    this->m_runningChunks.clear();
+    this->m_chunkBytesSent.clear();
+    this->m_pendingChunks.clear();
+    for (QNetworkReply* reply : runningReplies) {
+        QObject::disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+
+    for (QIODevice* chunkDevice : this->m_chunkDevices) {
+        chunkDevice->deleteLater();
+    }
+    this->m_chunkDevices.clear();
+
+    if (this->m_manifestBuilder) {
+        QObject::disconnect(this->m_manifestBuilder, nullptr, this, nullptr);
+        this->m_manifestBuilder->deleteLater();
+        this->m_manifestBuilder = Q_NULLPTR;
+    }
+
+    return WebDavCommandEntity::abortWork();
+}
+
+void NcChunkedUploadCommandEntity::uploadFolderCreated()
+{
+    if (this->m_syncDb) {
+        this->m_syncDb->storeChunkedUpload(this->m_localFile.fileName(),
+                                           this->m_remoteFile,
+                                           this->m_state);
+    }
+
+    this->m_uploadedBytes = 0;
+    for (int chunkNumber = 1; chunkNumber <= chunkCount(); chunkNumber++) {
+        if (!this->m_state.uploadedChunks.contains(chunkNumber)) {
+            this->m_pendingChunks.append(chunkNumber);
+            continue;
+        }
+
+        this->m_uploadedBytes += chunkLength(chunkNumber);
+    }
+
+    updateProgress();
+    startPendingChunks();
+}
+
+void NcChunkedUploadCommandEntity::startPendingChunks()
+{
+    while (this->m_runningChunks.size() < this->m_maxParallelChunks &&
+           !this->m_pendingChunks.isEmpty()) {
+        const int chunkNumber = this->m_pendingChunks.takeFirst();
+        const qint64 offset = chunkOffset(chunkNumber);
+        const qint64 chunkSize = chunkLength(chunkNumber);
+
+        if (isReusedChunk(chunkNumber)) {
+            this->m_runningChunks.insert(copyPreviousVersion(), chunkNumber);
+            continue;
+        }
+
+        // Each chunk is streamed out of the file slice by slice, read into memory otherwise
+        QIODevice* chunkDevice = Q_NULLPTR;
+        FileRangeDevice* fileChunk =
+                new FileRangeDevice(this->m_localFile.fileName(), offset, chunkSize, this);
+        if (fileChunk->open(QIODevice::ReadOnly)) {
+            chunkDevice = fileChunk;
+        } else {
+            fileChunk->deleteLater();
+
+            if (!this->m_localFile.seek(offset)) {
+                fail(QStringLiteral("Failed to seek to chunk %1").arg(chunkNumber));
+                return;
+            }
+
+            QBuffer* bufferedChunk = new QBuffer(this);
+            bufferedChunk->setData(this->m_localFile.read(chunkSize));
+            if (bufferedChunk->data().isEmpty() || !bufferedChunk->open(QIODevice::ReadOnly)) {
+                bufferedChunk->deleteLater();
+                fail(QStringLiteral("Failed to read chunk %1").arg(chunkNumber));
+                return;
+            }
+            chunkDevice = bufferedChunk;
+        }
+
+        // All chunks in flight draw from the same limit
+        QNetworkReply* reply = this->m_client->put(chunkPath(chunkNumber),
+                                                   rateLimitedDevice(chunkDevice));
+        this->m_chunkDevices.insert(reply, chunkDevice);
+        this->m_runningChunks.insert(reply, chunkNumber);
+
+        QObject::connect(reply, &QNetworkReply::uploadProgress,
+                         this, [=](qint64 bytesSent, qint64 bytesTotal) {
+            Q_UNUSED(bytesTotal);
+            if (!this->m_runningChunks.contains(reply))
+                return;
+            this->m_chunkBytesSent.insert(reply, bytesSent);
+            updateProgress();
+        });
+        QObject::connect(reply, &QNetworkReply::finished, this, [=]() {
+            chunkFinished(reply);
+        });
+    }
+
+    if (this->m_runningChunks.isEmpty() && this->m_pendingChunks.isEmpty())
+        assembleFile();
+}
+
+void NcChunkedUploadCommandEntity::chunkFinished(QNetworkReply* reply)
+{
+    if (!this->m_runningChunks.contains(reply))
+        return;
+
+    const int chunkNumber = this->m_runningChunks.take(reply);
+    this->m_chunkBytesSent.remove(reply);
+    reply->deleteLater();
+    if (this->m_chunkDevices.contains(reply))
+        this->m_chunkDevices.take(reply)->deleteLater();
+
+    const int httpCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // The remote file changed since it has been uploaded, start over without reusing it
+    if (isReusedChunk(chunkNumber) && httpCode == 412) {
+        if (this->m_syncDb) {
+            this->m_syncDb->removeChunkedUpload(this->m_localFile.fileName(), this->m_remoteFile,
+                                                this->m_state.transferId);
+            this->m_syncDb->removeBlockManifest(this->m_localFile.fileName(), this->m_remoteFile);
+        }
+        fail(QStringLiteral("Remote file changed since the previous upload"));
+        return;
+    }
+
+    if (reply->error() != QNetworkReply::NoError || httpCode < 200 || httpCode >= 300) {
+        fail(QStringLiteral("Chunk %1 failed, HTTP %2: %3")
+             .arg(chunkNumber).arg(httpCode).arg(reply->errorString()));
+        return;
+    }
+
+    this->m_state.uploadedChunks.insert(chunkNumber);
+    if (this->m_syncDb)
+        this->m_syncDb->storeUploadedChunk(this->m_state.transferId, chunkNumber);
+
+    this->m_uploadedBytes += chunkLength(chunkNumber);
+    updateProgress();
+
+    startPendingChunks();
+}
+
+QNetworkReply* NcChunkedUploadCommandEntity::copyPreviousVersion()
+{
+    const QString source = NEXTCLOUD_ENDPOINT_DAV_FILES.arg(this->m_userName) + this->m_remoteFile;
+    qDebug() << "Copying previous version of" << source << "into the upload";
+
+    // Only the version the manifest has been taken of, anything else would corrupt the file
+    QNetworkRequest request(webdavUrl(this->m_client, source));
+    request.setRawHeader(QByteArrayLiteral("Destination"),
+                         webdavUrl(this->m_client, chunkPath(1)).toEncoded());
+    request.setRawHeader(QByteArrayLiteral("If-Match"), this->m_previousEntityTag.toUtf8());
+    request.setRawHeader(QByteArrayLiteral("Overwrite"), QByteArrayLiteral("T"));
+
+    QNetworkReply* reply =
+            static_cast<QNetworkAccessManager*>(this->m_client)->sendCustomRequest(request,
+                                                                                   QByteArrayLiteral("COPY"));
+    QObject::connect(reply, &QNetworkReply::finished, this, [=]() {
+        chunkFinished(reply);
+    });
+    return reply;
+}
+
+void NcChunkedUploadCommandEntity::assembleFile()
+{
+    if (isFinished())
+        return;
+
+    this->m_localFile.close();
+
+    const QString destination =
+            NEXTCLOUD_ENDPOINT_DAV_FILES.arg(this->m_userName) + this->m_remoteFile;
+    qDebug() << "Assembling" << chunkCount() << "chunks into" << destination;
+
+    // The modification time is applied along with the assembly, which keeps
+    // the entity tag the server returns valid for the next upload
+    QNetworkRequest request(webdavUrl(this->m_client, uploadPath() + QStringLiteral("/.file")));
+    request.setRawHeader(QByteArrayLiteral("Destination"),
+                         webdavUrl(this->m_client, destination).toEncoded());
+    request.setRawHeader(QByteArrayLiteral("Overwrite"),
+                         this->m_createOnly ? QByteArrayLiteral("F") : QByteArrayLiteral("T"));
+    if (this->m_lastModified.isValid()) {
+        request.setRawHeader(QByteArrayLiteral("X-OC-Mtime"),
+                             QByteArray::number(this->m_lastModified.toMSecsSinceEpoch() / 1000));
+    }
+
+    QNetworkReply* reply =
+            static_cast<QNetworkAccessManager*>(this->m_client)->sendCustomRequest(request,
+                                                                                   QByteArrayLiteral("MOVE"));
+    this->m_runningChunks.insert(reply, 0);
+    QObject::connect(reply, &QNetworkReply::finished, this, [=]() {
+        if (!this->m_runningChunks.contains(reply))
+            return;
+        this->m_runningChunks.remove(reply);
+        reply->deleteLater();
+
+        const int httpCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+        // Created meanwhile by someone else, the uploaded chunks are of no use anymore
+        if (this->m_createOnly && httpCode == 412) {
+            if (this->m_syncDb) {
+                this->m_syncDb->removeChunkedUpload(this->m_localFile.fileName(), this->m_remoteFile,
+                                                    this->m_state.transferId);
+            }
+            QVariantMap result;
+            result.insert(QStringLiteral("exists"), true);
+            this->m_resultData = result;
+            fail(QStringLiteral("Remote file exists already"));
+            return;
+        }
+
+        if (reply->error() != QNetworkReply::NoError || httpCode < 200 || httpCode >= 300) {
+            fail(QStringLiteral("Failed to assemble chunks, HTTP %1").arg(httpCode));
+            return;
+        }
+
+        const QByteArray entityTag = reply->hasRawHeader(QByteArrayLiteral("OC-ETag"))
+                ? reply->rawHeader(QByteArrayLiteral("OC-ETag"))
+                : reply->rawHeader(QByteArrayLiteral("ETag"));
+        const bool mtimeAccepted =
+                reply->rawHeader(QByteArrayLiteral("X-OC-MTime")) == QByteArrayLiteral("accepted");
+        fileAssembled(QString::fromUtf8(entityTag), mtimeAccepted);
+    });
+}
+
+void NcChunkedUploadCommandEntity::fileAssembled(const QString& entityTag, bool mtimeAccepted)
+{
+    qInfo() << "Chunked upload of" << this->m_remoteFile << "complete,"
+            << this->m_state.size - this->m_state.reusedBytes << "bytes sent,"
+            << this->m_state.reusedBytes << "bytes reused.";
+
+    if (this->m_syncDb) {
+        this->m_syncDb->removeChunkedUpload(this->m_localFile.fileName(),
+                                            this->m_remoteFile,
+                                            this->m_state.transferId);
+    }
+
+    // Hashing is usually done long before the upload, otherwise wait for it
+    if (this->m_manifestBuilder && !this->m_manifestBuilder->isFinished()) {
+        QObject::connect(this->m_manifestBuilder, &BlockManifestBuilder::finished, this, [=]() {
+            finishAssembly(entityTag, mtimeAccepted);
+        });
+        return;
+    }
+
+    finishAssembly(entityTag, mtimeAccepted);
+}
+
+void NcChunkedUploadCommandEntity::finishAssembly(const QString& entityTag, bool mtimeAccepted)
+{
+    if (this->m_syncDb) {
+        BlockManifest manifest = this->m_manifestBuilder ? this->m_manifestBuilder->manifest()
+                                                         : BlockManifest();
+
+        // Without an entity tag there's no telling whether the remote file is still this one
+        manifest.remoteEntityTag = entityTag;
+        if (entityTag.isEmpty() || !manifest.isValid() ||
+                manifest.size != this->m_state.size) {
+            this->m_syncDb->removeBlockManifest(this->m_localFile.fileName(), this->m_remoteFile);
+        } else {
+            this->m_syncDb->storeBlockManifest(this->m_localFile.fileName(),
+                                               this->m_remoteFile,
+                                               manifest);
+        }
+    }
+
+    QVariantMap result;
+    result.insert(QStringLiteral("success"), true);
+    result.insert(QStringLiteral("chunks"), chunkCount());
+    result.insert(QStringLiteral("mtimeAccepted"), mtimeAccepted);
+    result.insert(QStringLiteral("bytesSent"), this->m_state.size - this->m_state.reusedBytes);
+    result.insert(QStringLiteral("bytesReused"), this->m_state.reusedBytes);
+    this->m_resultData = result;
+
+    setProgress(1.0);
+    setState(FINISHED);
+    Q_EMIT done();
+}
+
+void NcChunkedUploadCommandEntity::updateProgress()
+{
+    if (this->m_state.size <= 0)
+        return;
+
+    qint64 sentBytes = this->m_uploadedBytes;
+    for (const qint64 chunkBytesSent : this->m_chunkBytesSent) {
+        sentBytes += chunkBytesSent;
+    }
+
+    setProgress(qMin<qreal>(1.0, (qreal)sentBytes / (qreal)this->m_state.size));
+}
+
+void NcChunkedUploadCommandEntity::fail(const QString& reason)
+{
+    qWarning() << "Chunked upload of" << this->m_remoteFile << "failed:" << reason;
+    if (this->m_syncDb)
+        qInfo() << "Completed chunks have been kept, the next attempt resumes the upload";
+    abortWork();
+}
@@ -0,0 +1,114 @@
+#ifndef NCCHUNKEDUPLOADCOMMANDENTITY_H
+#define NCCHUNKEDUPLOADCOMMANDENTITY_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include "webdavcommandentity.h"
+#include <util/blockmanifest.h>
+
+class SyncDb;
+
+// Size of a single chunk, Nextcloud requires at least 5 MiB except for the last one
+const qint64 NCCHUNKEDUPLOAD_DEFAULT_CHUNK_SIZE = 10 * 1024 * 1024;
+
+// Number of chunk PUT requests kept in flight by default
+const int NCCHUNKEDUPLOAD_DEFAULT_PARALLEL_CHUNKS = 3;
+
+// Progress of a chunked upload, persisted in the SyncDb for resuming
+struct NcChunkedUploadState
+{
+    QString transferId;
+    qint64 size = 0;
+    qint64 lastModified = 0; // seconds since epoch
+    qint64 chunkSize = 0;
+    qint64 reusedBytes = 0; // start of the file copied from the previous upload
+    QSet<int> uploadedChunks;
+
+    bool isValid() const
+    {
+        return !this->transferId.isEmpty();
+    }
+};
+
+// Uploads a file through the Nextcloud chunking v2 API:
+// MKCOL uploads/<user>/<transferId>, PUT each chunk into it
+// (several in parallel), then MOVE the assembled .file into place.
+// The client is expected to be rooted at remote.php/dav.
+// With a SyncDb, completed chunks are recorded so that an interrupted
+// upload of the unchanged file continues where it stopped; the server
+// side upload folder is kept on failure for the same reason.
+// A block manifest of every uploaded version is kept as well. If the file
+// only grew since, the previous version is copied into the upload folder
+// on the server as the first chunk and only the appended data is sent.
+// The server can't assemble a file from ranges of another one, changes
+// anywhere else still upload the whole file.
+class NcChunkedUploadCommandEntity : public WebDavCommandEntity
+{
+    Q_OBJECT
+
+public:
+    explicit NcChunkedUploadCommandEntity(QObject* parent = Q_NULLPTR,
+                                          QString localPath = QStringLiteral(""),
+                                          QString remotePath = QStringLiteral(""),
+                                          QString userName = QStringLiteral(""),
+                                          QWebdav* client = Q_NULLPTR,
+                                          SyncDb* syncDb = Q_NULLPTR,
+                                          QDateTime lastModified = QDateTime(),
+                                          qint64 chunkSize = NCCHUNKEDUPLOAD_DEFAULT_CHUNK_SIZE,
+                                          int maxParallelChunks = NCCHUNKEDUPLOAD_DEFAULT_PARALLEL_CHUNKS,
+                                          bool createOnly = false);
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+    bool staticProgress() const Q_DECL_OVERRIDE { return false; }
+
+private:
+    QString uploadPath() const;
+    QString chunkPath(int chunkNumber) const;
+    int chunkCount() const;
+    qint64 chunkOffset(int chunkNumber) const;
+    qint64 chunkLength(int chunkNumber) const;
+    bool isReusedChunk(int chunkNumber) const;
+    QNetworkReply* copyPreviousVersion();
+
+    void createUploadFolder();
+    void uploadFolderCreated();
+    void startPendingChunks();
+    void chunkFinished(QNetworkReply* reply);
+    void assembleFile();
+    void fileAssembled(const QString& entityTag, bool mtimeAccepted);
+    void finishAssembly(const QString& entityTag, bool mtimeAccepted);
+    void updateProgress();
+    void fail(const QString& reason);
+
+    QFile m_localFile;
+    QString m_remoteFile;
+    QString m_userName;
+    SyncDb* m_syncDb = Q_NULLPTR;
+    QDateTime m_lastModified;
+    qint64 m_chunkSize;
+    int m_maxParallelChunks;
+
+    // Fail with 412 instead of replacing a file which exists remotely already
+    bool m_createOnly = false;
+
+    NcChunkedUploadState m_state;
+    bool m_resuming = false;
+
+    // Built while the upload runs, stored along with the
+    // entity tag of the assembled file once both are complete
+    BlockManifestBuilder* m_manifestBuilder = Q_NULLPTR;
+    QString m_previousEntityTag;
+
+    QList<int> m_pendingChunks;
+    QHash<QNetworkReply*, int> m_runningChunks;
+    QHash<QNetworkReply*, qint64> m_chunkBytesSent;
+    QHash<QNetworkReply*, QIODevice*> m_chunkDevices;
+    qint64 m_uploadedBytes = 0;
+};
+
+#endif // NCCHUNKEDUPLOADCOMMANDENTITY_H
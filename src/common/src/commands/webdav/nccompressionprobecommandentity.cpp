@@ -0,0 +1,156 @@
+#include "nccompressionprobecommandentity.h"
+
+#include <QUuid>
+#include <QVector>
+
+#include <commands/webdav/davmultistatusparser.h>
+#include <util/gziputil.h>
+#include <util/webdav_utils.h>
+#include <nextcloudendpointconsts.h>
+
+bool isSuccessfulReply(QNetworkReply* reply)
+{
+    const int httpCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return reply->error() == QNetworkReply::NoError && httpCode >= 200 && httpCode < 300;
+}
+
+NcCompressionProbeCommandEntity::NcCompressionProbeCommandEntity(QObject* parent,
+                                                                 QString userName,
+                                                                 QWebdav* client) :
+    WebDavCommandEntity(parent, client)
+{
+    this->m_folderPath = NEXTCLOUD_ENDPOINT_DAV_UPLOADS.arg(userName) + QStringLiteral("/")
+            + QUuid::createUuid().toString().mid(1, 36);
+
+    // Compresses well, so a server storing it as sent is easy to tell apart
+    this->m_probeData = QByteArrayLiteral("GhostCloud compression probe\n").repeated(256);
+
+    QMap<QString, QVariant> info;
+    info["type"] = QStringLiteral("compressionProbe");
+    this->m_commandInfo = CommandEntityInfo(info);
+}
+
+QNetworkReply* NcCompressionProbeCommandEntity::takeReply()
+{
+    QNetworkReply* reply = this->m_reply;
+    this->m_reply = Q_NULLPTR;
+    if (reply)
+        reply->deleteLater();
+    return reply;
+}
+
+QString NcCompressionProbeCommandEntity::probePath() const
+{
+    return this->m_folderPath + QStringLiteral("/probe");
+}
+
+bool NcCompressionProbeCommandEntity::startWork()
+{
+    if (!WebDavCommandEntity::startWork())
+        return false;
+
+    this->m_reply = this->m_client->mkdir(this->m_folderPath);
+    QObject::connect(this->m_reply, &QNetworkReply::finished,
+                     this, &NcCompressionProbeCommandEntity::folderCreated);
+
+    setState(RUNNING);
+    return true;
+}
+
+bool NcCompressionProbeCommandEntity::abortWork()
+{
+    // Otherwise the aborted request's handler would start the next step of the probe
+    if (this->m_reply)
+        QObject::disconnect(this->m_reply, nullptr, this, nullptr);
+
+    return WebDavCommandEntity::abortWork();
+}
+
+void NcCompressionProbeCommandEntity::folderCreated()
+{
+    QNetworkReply* reply = takeReply();
+    if (!reply)
+        return;
+
+    if (!isSuccessfulReply(reply)) {
+        qWarning() << "Failed to create compression probe folder:" << reply->errorString();
+        abortWork();
+        return;
+    }
+
+    QNetworkRequest request(webdavUrl(this->m_client, probePath()));
+    request.setRawHeader(QByteArrayLiteral("Content-Encoding"), QByteArrayLiteral("gzip"));
+    this->m_reply = static_cast<QNetworkAccessManager*>(this->m_client)->put(request,
+                                                                            gzipCompress(this->m_probeData));
+    QObject::connect(this->m_reply, &QNetworkReply::finished,
+                     this, &NcCompressionProbeCommandEntity::probeUploaded);
+}
+
+void NcCompressionProbeCommandEntity::probeUploaded()
+{
+    QNetworkReply* reply = takeReply();
+    if (!reply)
+        return;
+
+    // A server which can't make sense of the encoding rejects the upload
+    if (!isSuccessfulReply(reply)) {
+        qInfo() << "Server refused gzip encoded upload:" << reply->errorString();
+        finish(false);
+        return;
+    }
+
+    this->m_reply = this->m_client->propfind(probePath(), DavMultistatusParser::propfindQuery(), 0);
+    QObject::connect(this->m_reply, &QNetworkReply::finished,
+                     this, &NcCompressionProbeCommandEntity::probeListed);
+}
+
+void NcCompressionProbeCommandEntity::probeListed()
+{
+    QNetworkReply* reply = takeReply();
+    if (!reply)
+        return;
+
+    if (!isSuccessfulReply(reply)) {
+        qWarning() << "Failed to look up compression probe:" << reply->errorString();
+        finish(false);
+        return;
+    }
+
+    DavMultistatusParser parser;
+    QVector<DavMultistatusEntry> entries;
+    parser.addData(reply->readAll());
+    if (!parser.readEntries(entries) || entries.isEmpty()) {
+        qWarning() << "Invalid response looking up compression probe:" << parser.errorString();
+        finish(false);
+        return;
+    }
+
+    // Stored as sent if the server didn't decode it
+    qDebug() << "Compression probe stored with" << entries.first().size << "of"
+             << this->m_probeData.size() << "bytes";
+    finish(entries.first().size == this->m_probeData.size());
+}
+
+void NcCompressionProbeCommandEntity::finish(bool compressionSupported)
+{
+    this->m_compressionSupported = compressionSupported;
+
+    this->m_reply = this->m_client->remove(this->m_folderPath);
+    QObject::connect(this->m_reply, &QNetworkReply::finished, this, [=]() {
+        QNetworkReply* reply = takeReply();
+        if (!reply)
+            return;
+
+        // Expires on the server side anyway
+        if (!isSuccessfulReply(reply))
+            qWarning() << "Failed to remove compression probe folder:" << reply->errorString();
+
+        QVariantMap result;
+        result.insert(QStringLiteral("success"), true);
+        result.insert(QStringLiteral("compressionSupported"), this->m_compressionSupported);
+        this->m_resultData = result;
+
+        setState(FINISHED);
+        Q_EMIT done();
+    });
+}
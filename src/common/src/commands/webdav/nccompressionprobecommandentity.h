@@ -0,0 +1,42 @@
+#ifndef NCCOMPRESSIONPROBECOMMANDENTITY_H
+#define NCCOMPRESSIONPROBECOMMANDENTITY_H
+
+#include <QObject>
+#include "webdavcommandentity.h"
+
+// Finds out whether the server decodes gzip encoded upload bodies.
+// WebDAV doesn't advertise that, it depends on the web server in front of
+// Nextcloud (e.g. an Apache DEFLATE input filter). A small gzip encoded
+// probe is PUT into a throw-away chunked upload folder and the stored size
+// is compared to the raw one; the folder is removed afterwards.
+// Finishes with "compressionSupported" in its result, aborts if the
+// server couldn't be asked at all.
+// The client is expected to be rooted at remote.php/dav.
+class NcCompressionProbeCommandEntity : public WebDavCommandEntity
+{
+    Q_OBJECT
+
+public:
+    explicit NcCompressionProbeCommandEntity(QObject* parent = Q_NULLPTR,
+                                             QString userName = QStringLiteral(""),
+                                             QWebdav* client = Q_NULLPTR);
+
+protected:
+    bool startWork() Q_DECL_OVERRIDE;
+    bool abortWork() Q_DECL_OVERRIDE;
+
+private:
+    QNetworkReply* takeReply();
+    QString probePath() const;
+
+    void folderCreated();
+    void probeUploaded();
+    void probeListed();
+    void finish(bool compressionSupported);
+
+    QString m_folderPath;
+    QByteArray m_probeData;
+    bool m_compressionSupported = false;
+};
+
+#endif // NCCOMPRESSIONPROBECOMMANDENTITY_H
@@ -1,5 +1,7 @@
 #include "webdavcommandentity.h"
 
+#include <util/ratelimiteddevice.h>
+
 WebDavCommandEntity::WebDavCommandEntity(QObject* parent,
                                          QWebdav* client) :
     CommandEntity(parent), m_client(client)
@@ -14,6 +16,24 @@ WebDavCommandEntity::~WebDavCommandEntity()
     }
 }
 
+void WebDavCommandEntity::setRateLimiter(TransferRateLimiter* rateLimiter)
+{
+    this->m_rateLimiter = rateLimiter;
+}
+
+QIODevice* WebDavCommandEntity::rateLimitedDevice(QIODevice* source)
+{
+    if (!this->m_rateLimiter || !source)
+        return source;
+
+    RateLimitedDevice* limitedDevice = new RateLimitedDevice(source, this->m_rateLimiter, source);
+    if (!limitedDevice->open(QIODevice::ReadOnly)) {
+        delete limitedDevice;
+        return source;
+    }
+    return limitedDevice;
+}
+
 bool WebDavCommandEntity::startWork()
 {
     if (!CommandEntity::startWork()) {
@@ -27,46 +47,8 @@ bool WebDavCommandEntity::startWork()
         return false;
     }
 
-    if (this->m_reply) {
-        QObject::connect(this->m_reply, &QNetworkReply::destroyed, this, [=](){
-            QObject::disconnect(this->m_reply, 0, 0, 0);
-            this->m_reply = Q_NULLPTR;
-        });
-
-        QObject::connect(this->m_reply,
-                         static_cast<void(QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error), this,
-                         [=](QNetworkReply::NetworkError error) {
-            qWarning() << "Aborting due to network error:" << error;
-            // TODO: stale files when aborting?
-            // Aborting due to network error: QNetworkReply::ContentNotFoundError
-            // abortWork();
-            Q_EMIT aborted();
-        });
-
-        QObject::connect(this->m_reply, &QNetworkReply::finished, this, [=]() {
-            qDebug() << "WebDav request complete:" << this->m_reply->url().toString();
-            qDebug() << this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-            if (this->m_reply->error() != QNetworkReply::NoError)
-                return;
-
-            Q_EMIT done();
-        });
-
-        QObject::connect(this->m_reply, &QNetworkReply::downloadProgress,
-                         this, [=](qint64 bytesReceived, qint64 bytesTotal) {
-            if (bytesTotal < 1)
-                return;
-            const qreal newProgress = ((qreal)bytesReceived/(qreal)bytesTotal);
-            setProgress(newProgress);
-        });
-        QObject::connect(this->m_reply, &QNetworkReply::uploadProgress,
-                         this, [=](qint64 bytesSent, qint64 bytesTotal) {
-            if (bytesTotal < 1)
-                return;
-            const qreal newProgress = ((qreal)bytesSent/(qreal)bytesTotal);
-            setProgress(newProgress);
-        });
-    }
+    if (this->m_reply)
+        connectReply();
 
     QObject::connect(this->m_client, &QWebdav::checkSslCertifcate,
                      this, [=](const QList<QSslError> &errors) {
@@ -85,17 +67,63 @@ bool WebDavCommandEntity::startWork()
     return true;
 }
 
+void WebDavCommandEntity::connectReply()
+{
+    QObject::connect(this->m_reply, &QNetworkReply::destroyed, this, [=](){
+        QObject::disconnect(this->m_reply, 0, 0, 0);
+        this->m_reply = Q_NULLPTR;
+    });
+
+    QObject::connect(this->m_reply,
+                     static_cast<void(QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error), this,
+                     [=](QNetworkReply::NetworkError error) {
+        qWarning() << "Aborting due to network error:" << error;
+        // TODO: stale files when aborting?
+        // Aborting due to network error: QNetworkReply::ContentNotFoundError
+        // abortWork();
+        Q_EMIT aborted();
+    });
+
+    QObject::connect(this->m_reply, &QNetworkReply::finished, this, [=]() {
+        qDebug() << "WebDav request complete:" << this->m_reply->url().toString();
+        qDebug() << this->m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (this->m_reply->error() != QNetworkReply::NoError)
+            return;
+
+        Q_EMIT done();
+    });
+
+    QObject::connect(this->m_reply, &QNetworkReply::downloadProgress,
+                     this, [=](qint64 bytesReceived, qint64 bytesTotal) {
+        if (bytesTotal < 1)
+            return;
+        const qreal newProgress = ((qreal)bytesReceived/(qreal)bytesTotal);
+        setProgress(newProgress);
+    });
+    QObject::connect(this->m_reply, &QNetworkReply::uploadProgress,
+                     this, [=](qint64 bytesSent, qint64 bytesTotal) {
+        if (bytesTotal < 1)
+            return;
+        const qreal newProgress = ((qreal)bytesSent/(qreal)bytesTotal);
+        setProgress(newProgress);
+    });
+}
+
 bool WebDavCommandEntity::abortWork()
 {
     qDebug() << Q_FUNC_INFO;
     if (!CommandEntity::abortWork())
         return false;
 
-    if (this->m_reply) {
-        if (!this->m_reply->isFinished())
-            this->m_reply->abort();
-        this->m_reply->deleteLater();
-        this->m_reply = Q_NULLPTR;
+    // Detach first, aborting a request emits finished() synchronously
+    // and the handlers mustn't report the command as done meanwhile
+    QNetworkReply* reply = this->m_reply;
+    this->m_reply = Q_NULLPTR;
+    if (reply) {
+        QObject::disconnect(reply, nullptr, this, nullptr);
+        if (!reply->isFinished())
+            reply->abort();
+        reply->deleteLater();
     }
 
     setState(ABORTED);
@@ -2,9 +2,11 @@
 #define WEBDAVCOMMANDENTITY_H
 
 #include <QObject>
+#include <QPointer>
 #include <commandentity.h>
 #include <settings/nextcloudsettingsbase.h>
 #include <qwebdav.h>
+#include <util/transferratelimiter.h>
 
 class WebDavCommandEntity : public CommandEntity
 {
@@ -14,12 +16,24 @@ public:
                                  QWebdav* client = Q_NULLPTR);
     ~WebDavCommandEntity();
 
+    // Shared by the transfers of one direction, set before the command starts
+    void setRateLimiter(TransferRateLimiter* rateLimiter);
+
 protected:
     bool startWork() Q_DECL_OVERRIDE;
     bool abortWork() Q_DECL_OVERRIDE;
 
+    // Wraps an open upload body so that it is read at the limited rate.
+    // Returns source itself without a limiter, the wrapper is a child of source.
+    QIODevice* rateLimitedDevice(QIODevice* source);
+
+    // Reports m_reply as the outcome of the command, startWork() does so for
+    // a reply which exists already, later requests have to be connected here
+    void connectReply();
+
     QWebdav* m_client = Q_NULLPTR;
     QNetworkReply* m_reply = Q_NULLPTR;
+    QPointer<TransferRateLimiter> m_rateLimiter;
 
 signals:
     void sslErrorOccured(QString md5Digest, QString sha1Digest);
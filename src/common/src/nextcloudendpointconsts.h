@@ -5,10 +5,15 @@
 #include <QString>
 
 const QString NEXTCLOUD_ENDPOINT_WEBDAV = QStringLiteral("remote.php/webdav");
+const QString NEXTCLOUD_ENDPOINT_DAV = QStringLiteral("remote.php/dav");
+const QString NEXTCLOUD_ENDPOINT_DAV_FILES = QStringLiteral("/files/%1");
+const QString NEXTCLOUD_ENDPOINT_DAV_UPLOADS = QStringLiteral("/uploads/%1");
+const QString NEXTCLOUD_ENDPOINT_DAV_BULK = QStringLiteral("/bulk");
 const QString NEXTCLOUD_ENDPOINT_LOGIN_FLOW = QStringLiteral("index.php/login/flow");
 const QString NEXTCLOUD_ENDPOINT_THUMBNAIL = QStringLiteral("index.php/apps/files/api/v1/thumbnail");
 const QString NEXTCLOUD_ENDPOINT_AVATAR = QStringLiteral("index.php/avatar/%1/%2");
 const QString NEXTCLOUD_ENDPOINT_OCS_USERINFO = QStringLiteral("ocs/v2.php/cloud/users/");
+const QString NEXTCLOUD_ENDPOINT_OCS_CAPABILITIES = QStringLiteral("ocs/v2.php/cloud/capabilities");
 const QString NEXTCLOUD_ENDPOINT_OCS_SETTINGS = QStringLiteral("index.php/settings/user");
 const QString NEXTCLOUD_ENDPOINT_OCS_SHARE = QStringLiteral("ocs/v2.php/apps/files_sharing/api/v1");
 const QString NEXTCLOUD_ENDPOINT_OCS_SHARE_LIST = NEXTCLOUD_ENDPOINT_OCS_SHARE + QStringLiteral("/shares");
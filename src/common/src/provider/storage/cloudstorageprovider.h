@@ -7,6 +7,8 @@
 #include <settings/nextcloudsettingsbase.h>
 #include <QDateTime>
 
+class NcBulkUploadCommandEntity;
+
 class CloudStorageProvider : public SettingsBackedCommandQueue
 {
     Q_OBJECT
@@ -32,12 +34,14 @@ public:
     virtual CommandEntity* fileUploadRequest(const QString from,
                                              const QString to,
                                              const QDateTime lastModified = QDateTime(),
-                                             const bool enqueue = false)
+                                             const bool enqueue = false,
+                                             const bool createOnly = false)
     {
         Q_UNUSED(from);
         Q_UNUSED(to);
         Q_UNUSED(lastModified);
         Q_UNUSED(enqueue);
+        Q_UNUSED(createOnly);
         return Q_NULLPTR;
     }
 
@@ -87,6 +91,34 @@ public:
         return Q_NULLPTR;
     }
 
+    // Lists the whole tree below path with a single request.
+    // Returns Q_NULLPTR if the provider or server can't do that,
+    // callers are expected to list directory by directory instead.
+    virtual CommandEntity* treeListingRequest(const QString path,
+                                              const bool enqueue = false)
+    {
+        Q_UNUSED(path);
+        Q_UNUSED(enqueue);
+        return Q_NULLPTR;
+    }
+
+    // Fetches what the server supports, e.g. bulk uploads.
+    // Returns Q_NULLPTR if there is nothing to fetch (anymore).
+    virtual CommandEntity* capabilitiesRequest(const bool enqueue = false)
+    {
+        Q_UNUSED(enqueue);
+        return Q_NULLPTR;
+    }
+
+    // Uploads the files added to it in a single request.
+    // Returns Q_NULLPTR if the server isn't known to support that,
+    // callers are expected to upload file by file instead.
+    virtual NcBulkUploadCommandEntity* bulkUploadRequest(const bool enqueue = false)
+    {
+        Q_UNUSED(enqueue);
+        return Q_NULLPTR;
+    }
+
     virtual bool supportsQFile()
     {
         return false;
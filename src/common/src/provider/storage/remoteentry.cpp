@@ -0,0 +1,94 @@
+#include "remoteentry.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QVariant>
+
+#include <qwebdavitem.h>
+
+QString RemoteEntry::EntityTag::toString() const
+{
+    return QString::fromLatin1(toByteArray().toHex());
+}
+
+QByteArray RemoteEntry::EntityTag::toByteArray() const
+{
+    return QByteArray(reinterpret_cast<const char*>(this->digest), sizeof(this->digest));
+}
+
+RemoteEntry::EntityTag RemoteEntry::EntityTag::fromByteArray(const QByteArray& digest)
+{
+    EntityTag tag;
+    if (digest.length() == sizeof(tag.digest))
+        std::memcpy(tag.digest, digest.constData(), sizeof(tag.digest));
+    return tag;
+}
+
+RemoteEntry::EntityTag RemoteEntry::EntityTag::fromString(const QString& entityTag)
+{
+    EntityTag tag;
+
+    // Strip weak validator prefix and surrounding quotes
+    QString bareTag = entityTag.trimmed();
+    if (bareTag.startsWith(QStringLiteral("W/")))
+        bareTag = bareTag.mid(2);
+    if (bareTag.startsWith('"') && bareTag.endsWith('"') && bareTag.length() >= 2)
+        bareTag = bareTag.mid(1, bareTag.length() - 2);
+
+    if (bareTag.isEmpty())
+        return tag;
+
+    QByteArray digest;
+    const QByteArray latinTag = bareTag.toLatin1();
+    if (latinTag.length() == 32) {
+        digest = QByteArray::fromHex(latinTag);
+    }
+    if (digest.length() != sizeof(tag.digest)) {
+        digest = QCryptographicHash::hash(bareTag.toUtf8(), QCryptographicHash::Md5);
+    }
+
+    std::memcpy(tag.digest, digest.constData(), sizeof(tag.digest));
+    return tag;
+}
+
+RemoteEntry RemoteEntry::fromWebdavItem(const QWebdavItem& item)
+{
+    RemoteEntry entry;
+    entry.name = item.name();
+    entry.entityTag = EntityTag::fromString(item.entityTag());
+    entry.fileId = QVariant(item.fileId()).toULongLong();
+    entry.size = static_cast<qint64>(item.size());
+    entry.mimeType = item.isDir() ? MimeDirectory : mimeTypeFromString(item.mimeType());
+    if (!item.isDir() && item.lastModified().isValid())
+        entry.lastModified = item.lastModified().toMSecsSinceEpoch() / 1000;
+    return entry;
+}
+
+RemoteEntry::MimeType RemoteEntry::mimeTypeFromString(const QString& mimeType)
+{
+    if (mimeType.isEmpty())
+        return MimeUnknown;
+
+    if (mimeType.startsWith(QStringLiteral("image/")))
+        return MimeImage;
+    if (mimeType.startsWith(QStringLiteral("video/")))
+        return MimeVideo;
+    if (mimeType.startsWith(QStringLiteral("audio/")))
+        return MimeAudio;
+    if (mimeType.startsWith(QStringLiteral("text/")))
+        return MimeText;
+    if (mimeType == QStringLiteral("application/pdf"))
+        return MimePdf;
+    if (mimeType == QStringLiteral("application/zip") ||
+            mimeType == QStringLiteral("application/gzip") ||
+            mimeType == QStringLiteral("application/x-tar") ||
+            mimeType == QStringLiteral("application/x-7z-compressed") ||
+            mimeType == QStringLiteral("application/x-rar-compressed"))
+        return MimeArchive;
+    if (mimeType.startsWith(QStringLiteral("application/vnd.oasis.opendocument")) ||
+            mimeType.startsWith(QStringLiteral("application/vnd.openxmlformats")) ||
+            mimeType == QStringLiteral("application/msword"))
+        return MimeDocument;
+
+    return MimeUnknown;
+}
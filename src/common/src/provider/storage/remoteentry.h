@@ -0,0 +1,78 @@
+#ifndef REMOTEENTRY_H
+#define REMOTEENTRY_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QMetaType>
+#include <cstring>
+
+class QWebdavItem;
+
+// Compact value type describing a single remote directory entry.
+// Used wherever directory listings are processed internally (e.g. while
+// building the sync tree), conversion to QVariant only happens for QML.
+struct RemoteEntry
+{
+    enum MimeType : quint8 {
+        MimeUnknown = 0,
+        MimeDirectory,
+        MimeImage,
+        MimeVideo,
+        MimeAudio,
+        MimeText,
+        MimePdf,
+        MimeArchive,
+        MimeDocument
+    };
+
+    // Entity tags are stored as a fixed 16 byte digest.
+    // MD5-style tags are decoded as-is, any other tag gets hashed.
+    struct EntityTag
+    {
+        quint8 digest[16] = {};
+
+        bool isNull() const
+        {
+            static const quint8 nullDigest[16] = {};
+            return std::memcmp(this->digest, nullDigest, sizeof(this->digest)) == 0;
+        }
+        bool operator==(const EntityTag& other) const
+        {
+            return std::memcmp(this->digest, other.digest, sizeof(this->digest)) == 0;
+        }
+        bool operator!=(const EntityTag& other) const
+        {
+            return !(*this == other);
+        }
+        QString toString() const;
+        QByteArray toByteArray() const;
+
+        static EntityTag fromString(const QString& entityTag);
+        static EntityTag fromByteArray(const QByteArray& digest);
+    };
+
+    QString name;
+    EntityTag entityTag;
+    quint64 fileId = 0;
+    qint64 size = 0;
+    qint64 lastModified = 0; // seconds since epoch
+    MimeType mimeType = MimeUnknown;
+
+    bool isDirectory() const { return this->mimeType == MimeDirectory; }
+
+    static RemoteEntry fromWebdavItem(const QWebdavItem& item);
+    static MimeType mimeTypeFromString(const QString& mimeType);
+};
+Q_DECLARE_TYPEINFO(RemoteEntry::EntityTag, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(RemoteEntry, Q_MOVABLE_TYPE);
+Q_DECLARE_METATYPE(RemoteEntry)
+Q_DECLARE_METATYPE(QVector<RemoteEntry>)
+
+inline uint qHash(const RemoteEntry::EntityTag& entityTag, uint seed = 0)
+{
+    return qHashBits(entityTag.digest, sizeof(entityTag.digest), seed);
+}
+
+#endif // REMOTEENTRY_H
@@ -8,12 +8,19 @@
 #include <commands/ubuntutouch/utfiledownloadcommandentity.h>
 #endif
 #include <commands/webdav/fileuploadcommandentity.h>
+#include <commands/webdav/fileuploadcommandunit.h>
+#include <commands/webdav/ncchunkeduploadcommandentity.h>
+#include <commands/webdav/ncbulkuploadcommandentity.h>
+#include <commands/webdav/nccompressionprobecommandentity.h>
 #include <commands/webdav/mkdavdircommandentity.h>
 #include <commands/webdav/davrmcommandentity.h>
 #include <commands/webdav/davcopycommandentity.h>
 #include <commands/webdav/davmovecommandentity.h>
 #include <commands/webdav/davlistcommandentity.h>
+#include <commands/webdav/davtreelistcommandentity.h>
 #include <commands/webdav/davproppatchcommandentity.h>
+#include <commands/ocs/ocscapabilitiescommandentity.h>
+#include <commands/transferlanescommandentity.h>
 #include <commandunit.h>
 #include <stdfunctioncommandentity.h>
 
@@ -31,12 +38,35 @@
 #include <QtAndroid>
 #endif
 
+// Like the daemon's NetworkMonitor, anything but an active WLAN
+// or Ethernet connection is treated as cellular
+bool isCellularConnection(const QNetworkConfigurationManager& configManager)
+{
+    for (const QNetworkConfiguration& config : configManager.allConfigurations()) {
+        if ((config.bearerType() == QNetworkConfiguration::BearerWLAN ||
+             config.bearerType() == QNetworkConfiguration::BearerEthernet) &&
+                config.state() == QNetworkConfiguration::Active) {
+            return false;
+        }
+    }
+    return true;
+}
+
 WebDavCommandQueue::WebDavCommandQueue(QObject* parent, AccountBase* settings) :
     CloudStorageProvider(parent, settings)
 {
+    this->m_uploadLimiter = new TransferRateLimiter(this);
+    this->m_downloadLimiter = new TransferRateLimiter(this);
+
     updateConnectionSettings();
     QObject::connect(this, &WebDavCommandQueue::settingsChanged,
                      this, &WebDavCommandQueue::updateConnectionSettings);
+
+    // Running transfers switch over to the limits of the new bearer
+    QObject::connect(&this->m_configManager, &QNetworkConfigurationManager::configurationChanged,
+                     this, &WebDavCommandQueue::updateTransferLimits);
+    QObject::connect(&this->m_configManager, &QNetworkConfigurationManager::onlineStateChanged,
+                     this, &WebDavCommandQueue::updateTransferLimits);
 }
 
 void WebDavCommandQueue::updateConnectionSettings()
@@ -46,11 +76,20 @@ void WebDavCommandQueue::updateConnectionSettings()
 
     QObject::disconnect(this->settings(), nullptr, nullptr, nullptr);
 
+    // A different server might allow listing whole trees
+    this->m_treeListingRefused = false;
+    this->m_capabilitiesKnown = false;
+    this->m_bulkUploadSupported = false;
+    this->m_compressionProbed = false;
+    this->m_compressionSupported = false;
+
     // Apply new settings to existing QWebdav object
     if (!this->m_client) {
         this->m_client = getNewWebDav(this->settings(), this);
+        this->m_davClient = getNewWebDav(this->settings(), this, NEXTCLOUD_ENDPOINT_DAV);
     } else {
         applySettingsToWebdav(this->settings(), this->m_client);
+        applySettingsToWebdav(this->settings(), this->m_davClient, NEXTCLOUD_ENDPOINT_DAV);
     }
 
     // Connect to changes of credentials, certificate, hostname and provider settings
@@ -64,6 +103,96 @@ void WebDavCommandQueue::updateConnectionSettings()
                      this, &WebDavCommandQueue::updateConnectionSettings);
     QObject::connect(this->settings(), &AccountBase::customCertChanged,
                      this, &WebDavCommandQueue::updateConnectionSettings);
+
+    // Limits apply to the running transfers as well, no need to reconnect
+    QObject::connect(this->settings(), &AccountBase::transferLimitsChanged,
+                     this, &WebDavCommandQueue::updateTransferLimits);
+    updateTransferLimits();
+}
+
+void WebDavCommandQueue::updateTransferLimits()
+{
+    if (!this->settings() || !this->m_uploadLimiter || !this->m_downloadLimiter)
+        return;
+
+    const bool cellular = isCellularConnection(this->m_configManager);
+    const int uploadLimit = cellular ? this->settings()->uploadLimitCellular()
+                                     : this->settings()->uploadLimitWlan();
+    const int downloadLimit = cellular ? this->settings()->downloadLimitCellular()
+                                       : this->settings()->downloadLimitWlan();
+
+    this->m_uploadLimiter->setRate(qint64(uploadLimit) * 1024);
+    this->m_downloadLimiter->setRate(qint64(downloadLimit) * 1024);
+}
+
+void WebDavCommandQueue::setTransferLanes(int lanes, int maxTransfersPerHost)
+{
+    this->m_transferLanes = qMax(1, lanes);
+    this->m_maxTransfersPerHost = qMax(1, maxTransfersPerHost);
+
+    // Start over with the next transfer
+    this->m_currentTransferLanes.clear();
+}
+
+int WebDavCommandQueue::transferLanes() const
+{
+    return this->m_transferLanes;
+}
+
+void WebDavCommandQueue::setSyncDb(SyncDb* syncDb)
+{
+    this->m_syncDb = syncDb;
+}
+
+void WebDavCommandQueue::setUploadCompression(bool enabled)
+{
+    this->m_uploadCompression = enabled;
+}
+
+bool WebDavCommandQueue::uploadCompression() const
+{
+    return this->m_uploadCompression;
+}
+
+TransferRateLimiter* WebDavCommandQueue::uploadRateLimiter() const
+{
+    return this->m_uploadLimiter;
+}
+
+TransferRateLimiter* WebDavCommandQueue::downloadRateLimiter() const
+{
+    return this->m_downloadLimiter;
+}
+
+void WebDavCommandQueue::enqueueCommand(CommandEntity* command)
+{
+    // Transfers requested afterwards have to wait for this command,
+    // so they mustn't join the lanes queued before it.
+    this->m_currentTransferLanes.clear();
+    this->enqueue(command);
+}
+
+void WebDavCommandQueue::enqueueTransfer(CommandEntity* transfer, qint64 bytes)
+{
+    if (this->m_transferLanes <= 1) {
+        enqueueCommand(transfer);
+        return;
+    }
+
+    const QString host = this->settings() ? this->settings()->hostname() : QStringLiteral("");
+
+    // Consecutive transfers share the lanes, also while they are running
+    if (this->m_currentTransferLanes &&
+            this->m_currentTransferLanes->addTransfer(transfer, host, bytes)) {
+        return;
+    }
+
+    TransferLanesCommandEntity* transferLanes =
+            new TransferLanesCommandEntity(this, this->m_transferLanes,
+                                           this->m_maxTransfersPerHost);
+    transferLanes->addTransfer(transfer, host, bytes);
+    this->enqueue(transferLanes);
+    this->m_currentTransferLanes = transferLanes;
 }
 
 CommandEntity* WebDavCommandQueue::makeDirectoryRequest(const QString dirName,
@@ -73,7 +202,7 @@ CommandEntity* WebDavCommandQueue::makeDirectoryRequest(const QString dirName,
             new MkDavDirCommandEntity(this, dirName, this->getWebdav());
 
     if (enqueue)
-        this->enqueue(command);
+        enqueueCommand(command);
     return command;
 }
 
@@ -84,7 +213,7 @@ CommandEntity* WebDavCommandQueue::removeRequest(const QString name,
             new DavRmCommandEntity(this, name, this->getWebdav());
 
     if (enqueue)
-        this->enqueue(command);
+        enqueueCommand(command);
     return command;
 }
 
@@ -96,7 +225,7 @@ CommandEntity* WebDavCommandQueue::moveRequest(const QString from,
             new DavMoveCommandEntity(this, from, to, this->getWebdav());
 
     if (enqueue)
-        this->enqueue(command);
+        enqueueCommand(command);
     return command;
 }
 
@@ -108,7 +237,7 @@ CommandEntity* WebDavCommandQueue::copyRequest(const QString from,
             new DavCopyCommandEntity(this, from, to, this->getWebdav());
 
     if (enqueue)
-        this->enqueue(command);
+        enqueueCommand(command);
     return command;
 }
 
@@ -121,7 +250,92 @@ CommandEntity* WebDavCommandQueue::directoryListingRequest(const QString path,
             new DavListCommandEntity(this, path, refresh, this->getWebdav());
 
     if (enqueue)
-        this->enqueue(command);
+        enqueueCommand(command);
+    return command;
+}
+
+CommandEntity* WebDavCommandQueue::treeListingRequest(const QString path,
+                                                      const bool enqueue)
+{
+    if (this->m_treeListingRefused)
+        return Q_NULLPTR;
+
+    DavTreeListCommandEntity* command =
+            new DavTreeListCommandEntity(this, path, this->getWebdav());
+
+    // Don't retry on every sync once the server said no
+    QObject::connect(command, &CommandEntity::done, this, [=]() {
+        if (command->resultData().value(QStringLiteral("refused")).toBool()) {
+            qInfo() << "Server refused listing the tree at once, disabling tree listings";
+            this->m_treeListingRefused = true;
+        }
+    });
+
+    if (enqueue)
+        enqueueCommand(command);
+    return command;
+}
+
+CommandEntity* WebDavCommandQueue::capabilitiesRequest(const bool enqueue)
+{
+    if (!this->settings() || this->settings()->providerType() != AccountBase::Nextcloud)
+        return Q_NULLPTR;
+
+    OcsCapabilitiesCommandEntity* capabilitiesCommand = Q_NULLPTR;
+    if (!this->m_capabilitiesKnown) {
+        capabilitiesCommand = new OcsCapabilitiesCommandEntity(this, this->settings());
+        QObject::connect(capabilitiesCommand, &CommandEntity::done, this, [=]() {
+            this->m_capabilitiesKnown = true;
+            this->m_bulkUploadSupported =
+                    capabilitiesCommand->resultData().value(QStringLiteral("bulkUpload")).toBool();
+            qInfo() << "Server supports bulk uploads:" << this->m_bulkUploadSupported;
+        });
+    }
+
+    // Decoding compressed uploads isn't advertised, it has to be tried
+    NcCompressionProbeCommandEntity* probeCommand = Q_NULLPTR;
+    if (this->m_uploadCompression && !this->m_compressionProbed) {
+        probeCommand = new NcCompressionProbeCommandEntity(this, this->settings()->username(),
+                                                           this->m_davClient);
+        QObject::connect(probeCommand, &CommandEntity::done, this, [=]() {
+            this->m_compressionProbed = true;
+            this->m_compressionSupported =
+                    probeCommand->resultData().value(QStringLiteral("compressionSupported")).toBool();
+            qInfo() << "Server decodes compressed uploads:" << this->m_compressionSupported;
+        });
+        // A failed probe isn't retried for every upload, they are sent as they are
+        QObject::connect(probeCommand, &CommandEntity::aborted, this, [=]() {
+            this->m_compressionProbed = true;
+            this->m_compressionSupported = false;
+            qWarning() << "Probing for compressed uploads failed, not compressing";
+        });
+    }
+
+    if (!capabilitiesCommand && !probeCommand)
+        return Q_NULLPTR;
+
+    QMap<QString, QVariant> info;
+    info["type"] = QStringLiteral("capabilities");
+
+    CommandUnit* commandUnit = new CommandUnit(this,
+    {capabilitiesCommand, probeCommand}, CommandEntityInfo(info));
+    if (enqueue)
+        enqueueCommand(commandUnit);
+    return commandUnit;
+}
+
+NcBulkUploadCommandEntity* WebDavCommandQueue::bulkUploadRequest(const bool enqueue)
+{
+    if (!this->m_bulkUploadSupported)
+        return Q_NULLPTR;
+
+    NcBulkUploadCommandEntity* command =
+            new NcBulkUploadCommandEntity(this, this->m_davClient);
+    command->setRateLimiter(this->m_uploadLimiter);
+
+    // Files can still be added until the queue gets to it
+    if (enqueue)
+        enqueueTransfer(command, -1);
     return command;
 }
 
@@ -151,8 +365,10 @@ CommandEntity* WebDavCommandQueue::fileDownloadRequest(const QString remotePath,
     QString destination = FilePathUtil::destination(this->settings()) + remotePath;
 
 #ifndef GHOSTCLOUD_UBUNTU_TOUCH
-    downloadCommand = new FileDownloadCommandEntity(this, remotePath,
-                                                    destination, this->getWebdav());
+    FileDownloadCommandEntity* webdavDownloadCommand =
+            new FileDownloadCommandEntity(this, remotePath, destination, this->getWebdav());
+    webdavDownloadCommand->setRateLimiter(this->m_downloadLimiter);
+    downloadCommand = webdavDownloadCommand;
 #else
     downloadCommand = new UtFileDownloadCommandEntity(this, remotePath,
                                                       destination, this->settings());
@@ -176,16 +392,16 @@ CommandEntity* WebDavCommandQueue::fileDownloadRequest(const QString remotePath,
 
     CommandUnit* commandUnit = new CommandUnit(this,
     {downloadCommand, lastModifiedCommand}, unitInfo);
-    if (enqueue) {
-        this->enqueue(commandUnit);
-    }
+    if (enqueue)
+        enqueueTransfer(commandUnit, -1);
     return commandUnit;
 }
 
 CommandEntity* WebDavCommandQueue::fileUploadRequest(const QString localPath,
                                                      const QString remotePath,
                                                      const QDateTime lastModified,
-                                                     const bool enqueue)
+                                                     const bool enqueue,
+                                                     const bool createOnly)
 {
 #ifdef Q_OS_ANDROID
     const QStringList requiredPermissions =
@@ -209,8 +425,28 @@ CommandEntity* WebDavCommandQueue::fileUploadRequest(const QString localPath,
     const QString fileName = newLocalPath.mid(newLocalPath.lastIndexOf('/') + 1);
 
     qDebug() << "upload requested";
-    FileUploadCommandEntity* uploadCommand =
-            new FileUploadCommandEntity(this, newLocalPath, remotePath, this->getWebdav());
+    const qint64 fileSize = QFileInfo(newLocalPath).size();
+    WebDavCommandEntity* uploadCommand = Q_NULLPTR;
+
+    // Large files are uploaded in resumable chunks where the server supports it,
+    // which also avoids running into the server's request size limits
+    if (this->settings() &&
+            this->settings()->providerType() == AccountBase::Nextcloud &&
+            fileSize > NCCHUNKEDUPLOAD_DEFAULT_CHUNK_SIZE) {
+        uploadCommand = new NcChunkedUploadCommandEntity(this, newLocalPath, remotePath,
+                                                         this->settings()->username(),
+                                                         this->m_davClient, this->m_syncDb,
+                                                         lastModified,
+                                                         NCCHUNKEDUPLOAD_DEFAULT_CHUNK_SIZE,
+                                                         NCCHUNKEDUPLOAD_DEFAULT_PARALLEL_CHUNKS,
+                                                         createOnly);
+    } else {
+        const bool compress = this->m_uploadCompression && this->m_compressionSupported;
+        uploadCommand = new FileUploadCommandEntity(this, newLocalPath, remotePath,
+                                                    this->getWebdav(), lastModified, compress,
+                                                    createOnly);
+    }
+    uploadCommand->setRateLimiter(this->m_uploadLimiter);
     CommandEntity* lastModifiedCommand = Q_NULLPTR;
 
     // if lastModified has been provided update the remote lastModified information afterwards
@@ -226,12 +462,14 @@ CommandEntity* WebDavCommandQueue::fileUploadRequest(const QString localPath,
     info["fileName"] = fileName;
     info["remoteFile"] = remotePath + fileName;
 
-    CommandUnit* commandUnit = new CommandUnit(this,
-    {uploadCommand, lastModifiedCommand}, CommandEntityInfo(info));
+    // The PROPPATCH only follows if the server didn't apply the time along with the upload
+    CommandUnit* commandUnit = new FileUploadCommandUnit(this, uploadCommand,
+                                                         lastModifiedCommand,
+                                                         CommandEntityInfo(info));
 
     if (enqueue)
-        this->enqueue(commandUnit);
-    return uploadCommand;
+        enqueueTransfer(commandUnit, fileSize);
+    return commandUnit;
 }
 
 CommandEntity* WebDavCommandQueue::localLastModifiedRequest(const QString &destination,
@@ -2,11 +2,17 @@
 #define WEBDAVCOMMANDQUEUE_H
 
 #include <QObject>
+#include <QPointer>
+#include <QNetworkConfigurationManager>
 #include "cloudstorageprovider.h"
 #include "commandqueue.h"
 
 #include <settings/nextcloudsettingsbase.h>
 #include <qwebdav.h>
+#include <commands/transferlanescommandentity.h>
+#include <util/transferratelimiter.h>
+
+class SyncDb;
 
 
 class WebDavCommandQueue : public CloudStorageProvider
@@ -17,6 +23,27 @@ public:
     explicit WebDavCommandQueue(QObject* parent = Q_NULLPTR,
                                 AccountBase* settings = Q_NULLPTR);
 
+    // Lets up to lanes consecutive uploads and downloads run at once,
+    // at most maxTransfersPerHost of them against the same host.
+    // The default of 1 keeps the queue strictly serial, queues created
+    // through ProviderUtils and the daemon's run TRANSFERLANES_DEFAULT_LANES.
+    void setTransferLanes(int lanes,
+                          int maxTransfersPerHost = TRANSFERLANES_DEFAULT_PER_HOST);
+    int transferLanes() const;
+
+    // Lets interrupted chunked uploads resume, also across restarts
+    void setSyncDb(SyncDb* syncDb);
+
+    // Sends compressible files gzip encoded once a probe showed
+    // that the server decodes them. Off by default.
+    void setUploadCompression(bool enabled);
+    bool uploadCompression() const;
+
+    // Shared by all uploads and all downloads respectively, following
+    // the account's limits for the bearer currently in use
+    TransferRateLimiter* uploadRateLimiter() const;
+    TransferRateLimiter* downloadRateLimiter() const;
+
 public slots:
     virtual CommandEntity* fileDownloadRequest(const QString from,
                                                const QString mimeType = QStringLiteral(""),
@@ -24,10 +51,14 @@ public slots:
                                                const QDateTime lastModified = QDateTime(),
                                                const bool enqueue = true) Q_DECL_OVERRIDE;
 
+    // With createOnly the upload fails instead of replacing an existing remote file.
+    // Returns the unit of the upload and the following PROPPATCH, which reports
+    // the progress and result data of the upload.
     virtual CommandEntity* fileUploadRequest(const QString from,
                                              const QString to,
                                              const QDateTime lastModified = QDateTime(),
-                                             const bool enqueue = true) Q_DECL_OVERRIDE;
+                                             const bool enqueue = true,
+                                             const bool createOnly = false) Q_DECL_OVERRIDE;
 
     virtual CommandEntity* makeDirectoryRequest(const QString dirName,
                                                 const bool enqueue = true) Q_DECL_OVERRIDE;
@@ -47,6 +78,13 @@ public slots:
                                                    const bool refresh,
                                                    const bool enqueue = true) Q_DECL_OVERRIDE;
 
+    virtual CommandEntity* treeListingRequest(const QString path,
+                                              const bool enqueue = true) Q_DECL_OVERRIDE;
+
+    virtual CommandEntity* capabilitiesRequest(const bool enqueue = true) Q_DECL_OVERRIDE;
+
+    virtual NcBulkUploadCommandEntity* bulkUploadRequest(const bool enqueue = true) Q_DECL_OVERRIDE;
+
     virtual bool supportsQFile() Q_DECL_OVERRIDE {
         return false;
     }
@@ -64,9 +102,38 @@ private:
                                             const QDateTime& lastModified);
 
     void updateConnectionSettings();
+    void updateTransferLimits();
+
+    void enqueueCommand(CommandEntity* command);
+    void enqueueTransfer(CommandEntity* transfer, qint64 bytes);
 
     QWebdav* m_client = Q_NULLPTR;
 
+    // Rooted at remote.php/dav for the Nextcloud chunking API
+    QWebdav* m_davClient = Q_NULLPTR;
+    SyncDb* m_syncDb = Q_NULLPTR;
+
+    // Set once the server refused a "Depth: infinity" PROPFIND
+    bool m_treeListingRefused = false;
+
+    // Capabilities of the server, fetched once per connection
+    bool m_capabilitiesKnown = false;
+    bool m_bulkUploadSupported = false;
+    bool m_compressionProbed = false;
+    bool m_compressionSupported = false;
+
+    bool m_uploadCompression = false;
+
+    TransferRateLimiter* m_uploadLimiter = Q_NULLPTR;
+    TransferRateLimiter* m_downloadLimiter = Q_NULLPTR;
+    QNetworkConfigurationManager m_configManager;
+
+    int m_transferLanes = 1;
+    int m_maxTransfersPerHost = TRANSFERLANES_DEFAULT_PER_HOST;
+
+    // Lanes new transfers can still join, cleared by any other command
+    QPointer<TransferLanesCommandEntity> m_currentTransferLanes;
+
 signals:
     void sslErrorOccured(QString md5Digest, QString sha1Digest);
 
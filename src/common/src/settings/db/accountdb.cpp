@@ -10,7 +10,7 @@
 #include <QtSql/QSqlRecord>
 #include <QVariant>
 
-const int MAX_CURRENT_DB_VERSION = 1;
+const int MAX_CURRENT_DB_VERSION = 2;
 
 AccountDb::AccountDb(QObject *parent) : AccountsDbInterface(parent)
 {
@@ -71,7 +71,7 @@ void AccountDb::createDatabase()
                            "PRIMARY KEY(versionNumber));");
     const QString versionInsert =
             QStringLiteral("INSERT or REPLACE INTO version "
-                           "values(1);");
+                           "values(%1);").arg(MAX_CURRENT_DB_VERSION);
     const QString accounts =
             QStringLiteral("CREATE table accounts ("
                            "username TEXT,"
@@ -82,6 +82,10 @@ void AccountDb::createDatabase()
                            "providerType INTEGER,"
                            "uploadAutomatically INTEGER,"
                            "mobileUpload INTEGER,"
+                           "uploadLimitWlan INTEGER DEFAULT 0,"
+                           "uploadLimitCellular INTEGER DEFAULT 0,"
+                           "downloadLimitWlan INTEGER DEFAULT 0,"
+                           "downloadLimitCellular INTEGER DEFAULT 0,"
                            "certMd5 TEXT,"
                            "certSha1 TEXT,"
                            "PRIMARY KEY(hoststring, username, providerType));");
@@ -141,11 +145,37 @@ void AccountDb::upgradeDatabase()
     qDebug() << Q_FUNC_INFO << "current version"
              << currentDbVersion;
 
-    if (MAX_CURRENT_DB_VERSION == currentDbVersion)
+    if (currentDbVersion < 0 || MAX_CURRENT_DB_VERSION == currentDbVersion)
         return;
 
     qInfo() << "Upgrading database tables";
-    // TODO: New tables, columns, etc.
+
+    // Version 2 added the transfer rate limits
+    if (currentDbVersion == 1) {
+        const QStringList limitColumns = {
+            QStringLiteral("uploadLimitWlan"), QStringLiteral("uploadLimitCellular"),
+            QStringLiteral("downloadLimitWlan"), QStringLiteral("downloadLimitCellular")
+        };
+        for (const QString& limitColumn : limitColumns) {
+            const QSqlQuery alterQuery =
+                    this->m_database.exec(QStringLiteral("ALTER table accounts "
+                                                         "ADD COLUMN %1 INTEGER DEFAULT 0;")
+                                          .arg(limitColumn));
+            if (alterQuery.lastError().type() != QSqlError::NoError) {
+                qWarning() << "Failed to extend accounts table, error:"
+                           << alterQuery.lastError().text();
+                return;
+            }
+        }
+    }
+
+    const QSqlQuery versionQuery =
+            this->m_database.exec(QStringLiteral("UPDATE version SET versionNumber=%1;")
+                                  .arg(MAX_CURRENT_DB_VERSION));
+    if (versionQuery.lastError().type() != QSqlError::NoError) {
+        qWarning() << "Failed to update version table, error:"
+                   << versionQuery.lastError().text();
+    }
 }
 
 void AccountDb::cleanup()
@@ -177,7 +207,9 @@ QVector<AccountBase*> AccountDb::accounts()
     const QString queryString =
             QStringLiteral("SELECT username, password, hoststring, autologin,"
                            "notifications, providerType, uploadAutomatically,"
-                           "mobileUpload, certMd5, certSha1 from accounts;");
+                           "mobileUpload, uploadLimitWlan, uploadLimitCellular,"
+                           "downloadLimitWlan, downloadLimitCellular,"
+                           "certMd5, certSha1 from accounts;");
 
     QSqlQuery selectQuery = this->m_database.exec(queryString);
     if (selectQuery.lastError().type() != QSqlError::NoError) {
@@ -195,6 +227,10 @@ QVector<AccountBase*> AccountDb::accounts()
         const int providerType = selectQuery.value("providerType").toInt();
         const bool uploadAutomatically = selectQuery.value("uploadAutomatically").toBool();
         const bool mobileUpload = selectQuery.value("mobileUpload").toBool();
+        const int uploadLimitWlan = selectQuery.value("uploadLimitWlan").toInt();
+        const int uploadLimitCellular = selectQuery.value("uploadLimitCellular").toInt();
+        const int downloadLimitWlan = selectQuery.value("downloadLimitWlan").toInt();
+        const int downloadLimitCellular = selectQuery.value("downloadLimitCellular").toInt();
         const QString certMd5 = selectQuery.value("certMd5").toString();
         const QString certSha1 = selectQuery.value("certSha1").toString();
 
@@ -207,6 +243,10 @@ QVector<AccountBase*> AccountDb::accounts()
         account->setProviderType(providerType);
         account->setUploadAutomatically(uploadAutomatically);
         account->setMobileUpload(mobileUpload);
+        account->setUploadLimitWlan(uploadLimitWlan);
+        account->setUploadLimitCellular(uploadLimitCellular);
+        account->setDownloadLimitWlan(downloadLimitWlan);
+        account->setDownloadLimitCellular(downloadLimitCellular);
         account->setMd5Hex(certMd5);
         account->setSha1Hex(certSha1);
         tmpAccounts.push_back(account);
@@ -274,11 +314,13 @@ bool AccountDb::insertAccountIntoDatabase(AccountBase *account)
             QStringLiteral("INSERT or REPLACE INTO accounts"
                            " (username, password, hoststring, autologin,"
                            " notifications, providerType, uploadAutomatically,"
-                           " mobileUpload, certMd5, certSha1)"
+                           " mobileUpload, uploadLimitWlan, uploadLimitCellular,"
+                           " downloadLimitWlan, downloadLimitCellular, certMd5, certSha1)"
                            "values("
                            " :username, :password, :hoststring, :autologin,"
                            " :notifcations, :providerType, :uploadAutomatically,"
-                           " :mobileUpload, :certMD5, :certSHA1);");
+                           " :mobileUpload, :uploadLimitWlan, :uploadLimitCellular,"
+                           " :downloadLimitWlan, :downloadLimitCellular, :certMD5, :certSHA1);");
 
     const QString placeHolderPattern = QStringLiteral(":%1");
 
@@ -300,6 +342,14 @@ bool AccountDb::insertAccountIntoDatabase(AccountBase *account)
                                  account->uploadAutomatically());
     accountInsertQuery.bindValue(placeHolderPattern.arg(NEXTCLOUD_SETTINGS_KEY_MOBILEUPLOAD),
                                  account->mobileUpload());
+    accountInsertQuery.bindValue(placeHolderPattern.arg(NEXTCLOUD_SETTINGS_KEY_UPLOADLIMITWLAN),
+                                 account->uploadLimitWlan());
+    accountInsertQuery.bindValue(placeHolderPattern.arg(NEXTCLOUD_SETTINGS_KEY_UPLOADLIMITCELLULAR),
+                                 account->uploadLimitCellular());
+    accountInsertQuery.bindValue(placeHolderPattern.arg(NEXTCLOUD_SETTINGS_KEY_DOWNLOADLIMITWLAN),
+                                 account->downloadLimitWlan());
+    accountInsertQuery.bindValue(placeHolderPattern.arg(NEXTCLOUD_SETTINGS_KEY_DOWNLOADLIMITCELLULAR),
+                                 account->downloadLimitCellular());
     accountInsertQuery.bindValue(placeHolderPattern.arg(NEXTCLOUD_SETTINGS_KEY_CERTMD5),
                                  account->md5Hex());
     accountInsertQuery.bindValue(placeHolderPattern.arg(NEXTCLOUD_SETTINGS_KEY_CERTSHA1),
@@ -7,6 +7,88 @@
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlError>
 #include <QStandardPaths>
+#include <QVariant>
+
+#include <commands/sync/ncdirtreecommandunit.h>
+
+const int MAX_CURRENT_DB_VERSION = 7;
+
+// Column layout of the files table starting with version 2
+const QString FILES_TABLE_CREATE =
+        QStringLiteral("CREATE table files "
+                       "(remotePath TEXT," // root of the synced remote tree
+                       "parentPath TEXT," // relative to remotePath, ends with a separator
+                       "name TEXT,"
+                       "isDirectory INTEGER,"
+                       "fileId INTEGER," // used by the Nextcloud/ownCloud storage provider
+                       "uniqueId BLOB,"
+                       "size INTEGER,"
+                       "lastModified INTEGER,"
+                       "mimeType INTEGER,"
+                       "PRIMARY KEY(remotePath, parentPath, name));");
+
+// State of each file when it has last been in sync, added with version 3
+const QString JOURNAL_TABLE_CREATE =
+        QStringLiteral("CREATE table journal "
+                       "(localPath TEXT," // root of the synced local directory
+                       "relativePath TEXT,"
+                       "inode INTEGER,"
+                       "size INTEGER,"
+                       "lastModified INTEGER,"
+                       "fileId INTEGER,"
+                       "uniqueId BLOB,"
+                       "PRIMARY KEY(localPath, relativePath));");
+
+// Fingerprints of uploaded files, added with version 4
+const QString FINGERPRINTS_TABLE_CREATE =
+        QStringLiteral("CREATE table fingerprints "
+                       "(localPath TEXT," // root of the synced local directory
+                       "relativePath TEXT,"
+                       "size INTEGER,"
+                       "lastModified INTEGER,"
+                       "contentHash BLOB,"
+                       "PRIMARY KEY(localPath, relativePath));");
+const QString FINGERPRINTS_INDEX_CREATE =
+        QStringLiteral("CREATE INDEX fingerprints_content ON fingerprints "
+                       "(localPath, size, contentHash);");
+
+// Chunked uploads in progress and their completed chunks, added with version 5
+const QString CHUNKEDUPLOADS_TABLE_CREATE =
+        QStringLiteral("CREATE table chunkeduploads "
+                       "(localFile TEXT,"
+                       "remoteFile TEXT,"
+                       "transferId TEXT,"
+                       "size INTEGER,"
+                       "lastModified INTEGER,"
+                       "chunkSize INTEGER,"
+                       "reusedBytes INTEGER DEFAULT 0," // added with version 6
+                       "PRIMARY KEY(localFile, remoteFile));");
+const QString UPLOADEDCHUNKS_TABLE_CREATE =
+        QStringLiteral("CREATE table uploadedchunks "
+                       "(transferId TEXT,"
+                       "chunkNumber INTEGER,"
+                       "PRIMARY KEY(transferId, chunkNumber));");
+
+// Block checksums of the last uploaded version of large files, added with version 6
+const QString BLOCKMANIFESTS_TABLE_CREATE =
+        QStringLiteral("CREATE table blockmanifests "
+                       "(localFile TEXT,"
+                       "remoteFile TEXT,"
+                       "size INTEGER,"
+                       "blockSize INTEGER,"
+                       "remoteEntityTag TEXT,"
+                       "hashes BLOB,"
+                       "PRIMARY KEY(localFile, remoteFile));");
+
+// Local state of every watched file as of the last successful sync, added with version 7
+const QString FILESNAPSHOTS_TABLE_CREATE =
+        QStringLiteral("CREATE table filesnapshots "
+                       "(localPath TEXT," // root of the watched local directory
+                       "relativePath TEXT,"
+                       "inode INTEGER,"
+                       "size INTEGER,"
+                       "lastModified INTEGER,"
+                       "PRIMARY KEY(localPath, relativePath));");
 
 SyncDb::SyncDb(QObject *parent, QString userName) : QObject(parent)
 {
@@ -35,6 +117,7 @@ SyncDb::SyncDb(QObject *parent, QString userName) : QObject(parent)
 
     this->m_database.setDatabaseName(dbFilePath);
     createDatabase();
+    upgradeDatabase();
 }
 
 SyncDb::~SyncDb()
@@ -55,18 +138,12 @@ void SyncDb::createDatabase()
                            "(localPath TEXT,"
                            "remotePath TEXT,"
                            "PRIMARY KEY(localPath, remotePath));");
-    const QString files =
-            QStringLiteral("CREATE table files "
-                           "(fileId TEXT," // used by the Nextcloud/ownCloud storage provider
-                           "uniqueId TEXT,"
-                           "relativePath TEXT,"
-                           "PRIMARY KEY(fileId));");
     const QString version =
             QStringLiteral("CREATE table version (versionNumber INTEGER, "
                            "PRIMARY KEY(versionNumber));");
     const QString versionInsert =
             QStringLiteral("INSERT or REPLACE INTO version "
-                           "values(1);");
+                           "values(%1);").arg(MAX_CURRENT_DB_VERSION);
 
     const QStringList existingTables = this->m_database.tables();
     qDebug() << "existing tables:" << existingTables;
@@ -97,8 +174,69 @@ void SyncDb::createDatabase()
         }
     }
 
+    if (!existingTables.contains("journal")) {
+        QSqlQuery journalCreateQuery = this->m_database.exec(JOURNAL_TABLE_CREATE);
+        if (journalCreateQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create journal table, error:"
+                       << journalCreateQuery.lastError().text();
+            return;
+        }
+    }
+
+    if (!existingTables.contains("fingerprints")) {
+        QSqlQuery fingerprintsCreateQuery = this->m_database.exec(FINGERPRINTS_TABLE_CREATE);
+        if (fingerprintsCreateQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create fingerprints table, error:"
+                       << fingerprintsCreateQuery.lastError().text();
+            return;
+        }
+
+        QSqlQuery fingerprintsIndexQuery = this->m_database.exec(FINGERPRINTS_INDEX_CREATE);
+        if (fingerprintsIndexQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create fingerprints index, error:"
+                       << fingerprintsIndexQuery.lastError().text();
+            return;
+        }
+    }
+
+    if (!existingTables.contains("chunkeduploads")) {
+        QSqlQuery chunkedUploadsCreateQuery = this->m_database.exec(CHUNKEDUPLOADS_TABLE_CREATE);
+        if (chunkedUploadsCreateQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create chunkeduploads table, error:"
+                       << chunkedUploadsCreateQuery.lastError().text();
+            return;
+        }
+    }
+
+    if (!existingTables.contains("uploadedchunks")) {
+        QSqlQuery uploadedChunksCreateQuery = this->m_database.exec(UPLOADEDCHUNKS_TABLE_CREATE);
+        if (uploadedChunksCreateQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create uploadedchunks table, error:"
+                       << uploadedChunksCreateQuery.lastError().text();
+            return;
+        }
+    }
+
+    if (!existingTables.contains("blockmanifests")) {
+        QSqlQuery blockManifestsCreateQuery = this->m_database.exec(BLOCKMANIFESTS_TABLE_CREATE);
+        if (blockManifestsCreateQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create blockmanifests table, error:"
+                       << blockManifestsCreateQuery.lastError().text();
+            return;
+        }
+    }
+
+    if (!existingTables.contains("filesnapshots")) {
+        QSqlQuery fileSnapshotsCreateQuery = this->m_database.exec(FILESNAPSHOTS_TABLE_CREATE);
+        if (fileSnapshotsCreateQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create filesnapshots table, error:"
+                       << fileSnapshotsCreateQuery.lastError().text();
+            return;
+        }
+    }
+
     if (!existingTables.contains("files")) {
-        QSqlQuery filesCreateQuery = this->m_database.exec(files);
+        QSqlQuery filesCreateQuery = this->m_database.exec(FILES_TABLE_CREATE);
         if (filesCreateQuery.lastError().type() != QSqlError::NoError) {
             qWarning() << "Failed to create files table, error:"
                        << filesCreateQuery.lastError().text();
@@ -106,3 +244,744 @@ void SyncDb::createDatabase()
         }
     }
 }
+
+int SyncDb::currentDatabaseVersion()
+{
+    const QString statement =
+            QStringLiteral("SELECT versionNumber from version;");
+    QSqlQuery query = this->m_database.exec(statement);
+
+    // There's supposed to be only one row in the table
+    if (query.first()) {
+        bool parseOk = false;
+        const int currentVersion = query.value(0).toInt(&parseOk);
+        if (parseOk)
+            return currentVersion;
+    }
+
+    return -1;
+}
+
+void SyncDb::upgradeDatabase()
+{
+    const int currentDbVersion = currentDatabaseVersion();
+    qDebug() << Q_FUNC_INFO << "current version" << currentDbVersion;
+
+    if (currentDbVersion < 0 || currentDbVersion == MAX_CURRENT_DB_VERSION)
+        return;
+
+    qInfo() << "Upgrading sync database tables";
+
+    // The journal (version 3), fingerprints (version 4), chunked upload
+    // (version 5), block manifest (version 6) and file snapshot (version 7)
+    // tables have been created by createDatabase() already.
+    // Version 1 never had any rows written to the files table,
+    // replace it with the layout capable of holding the remote tree.
+    if (currentDbVersion == 1) {
+        const QSqlQuery dropQuery = this->m_database.exec(QStringLiteral("DROP table files;"));
+        if (dropQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to drop files table, error:"
+                       << dropQuery.lastError().text();
+            return;
+        }
+
+        const QSqlQuery createQuery = this->m_database.exec(FILES_TABLE_CREATE);
+        if (createQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to create files table, error:"
+                       << createQuery.lastError().text();
+            return;
+        }
+    }
+
+    // Chunked uploads of version 5 didn't reuse anything of a previous upload
+    if (currentDbVersion == 5) {
+        const QSqlQuery alterQuery =
+                this->m_database.exec(QStringLiteral("ALTER table chunkeduploads "
+                                                     "ADD COLUMN reusedBytes INTEGER DEFAULT 0;"));
+        if (alterQuery.lastError().type() != QSqlError::NoError) {
+            qWarning() << "Failed to extend chunkeduploads table, error:"
+                       << alterQuery.lastError().text();
+            return;
+        }
+    }
+
+    const QSqlQuery versionQuery =
+            this->m_database.exec(QStringLiteral("UPDATE version SET versionNumber=%1;")
+                                  .arg(MAX_CURRENT_DB_VERSION));
+    if (versionQuery.lastError().type() != QSqlError::NoError) {
+        qWarning() << "Failed to update version table, error:"
+                   << versionQuery.lastError().text();
+    }
+}
+
+QSharedPointer<NcDirNode> SyncDb::loadTree(const QString& localPath,
+                                           const QString& remotePath)
+{
+    if (!this->m_database.isOpen()) {
+        qWarning() << "SyncDb database isn't open";
+        return QSharedPointer<NcDirNode>();
+    }
+
+    QSqlQuery tangleQuery(this->m_database);
+    tangleQuery.prepare(QStringLiteral("SELECT localPath from tangledescriptions "
+                                       "WHERE localPath=:localPath AND remotePath=:remotePath;"));
+    tangleQuery.bindValue(QStringLiteral(":localPath"), localPath);
+    tangleQuery.bindValue(QStringLiteral(":remotePath"), remotePath);
+    if (!tangleQuery.exec() || !tangleQuery.first())
+        return QSharedPointer<NcDirNode>();
+
+    // Parents are guaranteed to be created before their children
+    QSqlQuery selectQuery(this->m_database);
+    selectQuery.setForwardOnly(true);
+    selectQuery.prepare(QStringLiteral("SELECT parentPath, name, isDirectory, fileId, uniqueId,"
+                                       " size, lastModified, mimeType from files "
+                                       "WHERE remotePath=:remotePath "
+                                       "ORDER BY length(parentPath);"));
+    selectQuery.bindValue(QStringLiteral(":remotePath"), remotePath);
+    if (!selectQuery.exec()) {
+        qWarning() << "Failed to read remote tree for" << remotePath
+                   << ", error:" << selectQuery.lastError().text();
+        return QSharedPointer<NcDirNode>();
+    }
+
+    QSharedPointer<NcDirNode> tree(new NcDirNode);
+    const QStringList rootCrumbs = remotePath.split(NODE_PATH_SEPARATOR, QString::SkipEmptyParts);
+    tree->name = rootCrumbs.isEmpty() ? NODE_PATH_SEPARATOR : rootCrumbs.last();
+
+    QHash<QString, NcDirNode*> nodesByPath;
+    nodesByPath.insert(QStringLiteral(""), tree.data());
+    int entryCount = 0;
+
+    while (selectQuery.next()) {
+        const QString parentPath = selectQuery.value(0).toString();
+        NcDirNode* parentNode = nodesByPath.value(parentPath, nullptr);
+        if (!parentNode)
+            continue;
+
+        RemoteEntry entry;
+        entry.name = selectQuery.value(1).toString();
+        entry.fileId = selectQuery.value(3).toULongLong();
+        entry.entityTag = RemoteEntry::EntityTag::fromByteArray(selectQuery.value(4).toByteArray());
+        entry.size = selectQuery.value(5).toLongLong();
+        entry.lastModified = selectQuery.value(6).toLongLong();
+        entry.mimeType = static_cast<RemoteEntry::MimeType>(selectQuery.value(7).toInt());
+        entryCount++;
+
+        if (!selectQuery.value(2).toBool()) {
+            parentNode->addFile(entry);
+            continue;
+        }
+
+        NcDirNode* node = new NcDirNode;
+        node->name = entry.name;
+        node->uniqueId = entry.entityTag;
+        parentNode->addDirectory(node);
+        nodesByPath.insert(parentPath + entry.name + NODE_PATH_SEPARATOR, node);
+    }
+
+    qInfo() << "Restored" << entryCount << "remote entries for" << remotePath;
+    return tree;
+}
+
+bool SyncDb::storeTree(const QString& localPath,
+                       const QString& remotePath,
+                       QSharedPointer<NcDirNode> tree)
+{
+    if (!tree || !this->m_database.isOpen())
+        return false;
+
+    QSqlQuery tangleQuery(this->m_database);
+    tangleQuery.prepare(QStringLiteral("INSERT or REPLACE INTO tangledescriptions "
+                                       "(localPath, remotePath) values(:localPath, :remotePath);"));
+    tangleQuery.bindValue(QStringLiteral(":localPath"), localPath);
+    tangleQuery.bindValue(QStringLiteral(":remotePath"), remotePath);
+    if (!tangleQuery.exec()) {
+        qWarning() << "Failed to store tangle description, error:"
+                   << tangleQuery.lastError().text();
+        return false;
+    }
+
+    // Prepared once and reused for every directory
+    QSqlQuery insertQuery(this->m_database);
+    insertQuery.prepare(QStringLiteral("INSERT or REPLACE INTO files "
+                                       "(remotePath, parentPath, name, isDirectory, fileId,"
+                                       " uniqueId, size, lastModified, mimeType) "
+                                       "values(:remotePath, :parentPath, :name, :isDirectory, :fileId,"
+                                       " :uniqueId, :size, :lastModified, :mimeType);"));
+
+    bool success = true;
+    QVector<QPair<QString, NcDirNode*> > pendingNodes;
+    pendingNodes.append(qMakePair(QStringLiteral(""), tree.data()));
+
+    while (!pendingNodes.isEmpty()) {
+        const QPair<QString, NcDirNode*> pendingNode = pendingNodes.takeLast();
+        NcDirNode* node = pendingNode.second;
+
+        if (node->dirty) {
+            if (storeDirectory(remotePath, pendingNode.first, node, insertQuery))
+                node->dirty = false;
+            else
+                success = false;
+        }
+
+        for (NcDirNode* directory : node->directories) {
+            pendingNodes.append(qMakePair(pendingNode.first + directory->name + NODE_PATH_SEPARATOR,
+                                          directory));
+        }
+    }
+
+    return success;
+}
+
+bool SyncDb::storeDirectory(const QString& remotePath,
+                            const QString& parentPath,
+                            NcDirNode* node,
+                            QSqlQuery& insertQuery)
+{
+    if (!this->m_database.transaction()) {
+        qWarning() << "Failed to start transaction:" << this->m_database.lastError().text();
+        return false;
+    }
+
+    // Subtrees of directories which don't exist anymore have to go as well
+    QSqlQuery childrenQuery(this->m_database);
+    childrenQuery.prepare(QStringLiteral("SELECT name from files "
+                                         "WHERE remotePath=:remotePath AND parentPath=:parentPath "
+                                         "AND isDirectory=1;"));
+    childrenQuery.bindValue(QStringLiteral(":remotePath"), remotePath);
+    childrenQuery.bindValue(QStringLiteral(":parentPath"), parentPath);
+    QStringList vanishedDirectories;
+    if (childrenQuery.exec()) {
+        while (childrenQuery.next()) {
+            const QString name = childrenQuery.value(0).toString();
+            if (!node->directory(name))
+                vanishedDirectories.append(parentPath + name + NODE_PATH_SEPARATOR);
+        }
+    }
+
+    QSqlQuery deleteSubtreeQuery(this->m_database);
+    deleteSubtreeQuery.prepare(QStringLiteral("DELETE from files WHERE remotePath=:remotePath "
+                                              "AND substr(parentPath, 1, length(:prefix))=:prefix;"));
+    for (const QString& vanishedDirectory : vanishedDirectories) {
+        deleteSubtreeQuery.bindValue(QStringLiteral(":remotePath"), remotePath);
+        deleteSubtreeQuery.bindValue(QStringLiteral(":prefix"), vanishedDirectory);
+        if (!deleteSubtreeQuery.exec()) {
+            qWarning() << "Failed to remove" << vanishedDirectory
+                       << ", error:" << deleteSubtreeQuery.lastError().text();
+            this->m_database.rollback();
+            return false;
+        }
+    }
+
+    QSqlQuery deleteQuery(this->m_database);
+    deleteQuery.prepare(QStringLiteral("DELETE from files WHERE remotePath=:remotePath "
+                                       "AND parentPath=:parentPath;"));
+    deleteQuery.bindValue(QStringLiteral(":remotePath"), remotePath);
+    deleteQuery.bindValue(QStringLiteral(":parentPath"), parentPath);
+    if (!deleteQuery.exec()) {
+        qWarning() << "Failed to clear" << parentPath
+                   << ", error:" << deleteQuery.lastError().text();
+        this->m_database.rollback();
+        return false;
+    }
+
+    auto insertEntry = [&](const RemoteEntry& entry, bool isDirectory) {
+        insertQuery.bindValue(QStringLiteral(":remotePath"), remotePath);
+        insertQuery.bindValue(QStringLiteral(":parentPath"), parentPath);
+        insertQuery.bindValue(QStringLiteral(":name"), entry.name);
+        insertQuery.bindValue(QStringLiteral(":isDirectory"), isDirectory);
+        insertQuery.bindValue(QStringLiteral(":fileId"), static_cast<qulonglong>(entry.fileId));
+        insertQuery.bindValue(QStringLiteral(":uniqueId"), entry.entityTag.toByteArray());
+        insertQuery.bindValue(QStringLiteral(":size"), entry.size);
+        insertQuery.bindValue(QStringLiteral(":lastModified"), entry.lastModified);
+        insertQuery.bindValue(QStringLiteral(":mimeType"), static_cast<int>(entry.mimeType));
+        return insertQuery.exec();
+    };
+
+    bool success = true;
+    for (const RemoteEntry& file : node->files) {
+        success = success && insertEntry(file, false);
+    }
+    for (const NcDirNode* directory : node->directories) {
+        RemoteEntry entry;
+        entry.name = directory->name;
+        entry.entityTag = directory->uniqueId;
+        entry.mimeType = RemoteEntry::MimeDirectory;
+        success = success && insertEntry(entry, true);
+    }
+
+    if (!success) {
+        qWarning() << "Failed to store content of" << parentPath
+                   << ", error:" << insertQuery.lastError().text();
+        this->m_database.rollback();
+        return false;
+    }
+
+    if (!this->m_database.commit()) {
+        qWarning() << "Failed to commit content of" << parentPath
+                   << ", error:" << this->m_database.lastError().text();
+        this->m_database.rollback();
+        return false;
+    }
+
+    return true;
+}
+
+QHash<QString, NcSyncJournalEntry> SyncDb::loadJournal(const QString& localPath)
+{
+    QHash<QString, NcSyncJournalEntry> journal;
+    if (!this->m_database.isOpen()) {
+        qWarning() << "SyncDb database isn't open";
+        return journal;
+    }
+
+    QSqlQuery selectQuery(this->m_database);
+    selectQuery.setForwardOnly(true);
+    selectQuery.prepare(QStringLiteral("SELECT relativePath, inode, size, lastModified,"
+                                       " fileId, uniqueId from journal "
+                                       "WHERE localPath=:localPath;"));
+    selectQuery.bindValue(QStringLiteral(":localPath"), localPath);
+    if (!selectQuery.exec()) {
+        qWarning() << "Failed to read journal for" << localPath
+                   << ", error:" << selectQuery.lastError().text();
+        return journal;
+    }
+
+    while (selectQuery.next()) {
+        NcSyncJournalEntry entry;
+        entry.relativePath = selectQuery.value(0).toString();
+        entry.inode = selectQuery.value(1).toULongLong();
+        entry.size = selectQuery.value(2).toLongLong();
+        entry.lastModified = selectQuery.value(3).toLongLong();
+        entry.fileId = selectQuery.value(4).toULongLong();
+        entry.entityTag = RemoteEntry::EntityTag::fromByteArray(selectQuery.value(5).toByteArray());
+        journal.insert(entry.relativePath, entry);
+    }
+
+    return journal;
+}
+
+bool SyncDb::storeJournalEntries(const QString& localPath,
+                                 const QVector<NcSyncJournalEntry>& entries,
+                                 const QStringList& removedPaths)
+{
+    if (!this->m_database.isOpen())
+        return false;
+
+    if (entries.isEmpty() && removedPaths.isEmpty())
+        return true;
+
+    if (!this->m_database.transaction()) {
+        qWarning() << "Failed to start transaction:" << this->m_database.lastError().text();
+        return false;
+    }
+
+    QSqlQuery deleteQuery(this->m_database);
+    deleteQuery.prepare(QStringLiteral("DELETE from journal WHERE localPath=:localPath "
+                                       "AND relativePath=:relativePath;"));
+    for (const QString& removedPath : removedPaths) {
+        deleteQuery.bindValue(QStringLiteral(":localPath"), localPath);
+        deleteQuery.bindValue(QStringLiteral(":relativePath"), removedPath);
+        if (!deleteQuery.exec()) {
+            qWarning() << "Failed to remove journal entry" << removedPath
+                       << ", error:" << deleteQuery.lastError().text();
+            this->m_database.rollback();
+            return false;
+        }
+    }
+
+    QSqlQuery insertQuery(this->m_database);
+    insertQuery.prepare(QStringLiteral("INSERT or REPLACE INTO journal "
+                                       "(localPath, relativePath, inode, size, lastModified,"
+                                       " fileId, uniqueId) "
+                                       "values(:localPath, :relativePath, :inode, :size,"
+                                       " :lastModified, :fileId, :uniqueId);"));
+    for (const NcSyncJournalEntry& entry : entries) {
+        insertQuery.bindValue(QStringLiteral(":localPath"), localPath);
+        insertQuery.bindValue(QStringLiteral(":relativePath"), entry.relativePath);
+        insertQuery.bindValue(QStringLiteral(":inode"), static_cast<qulonglong>(entry.inode));
+        insertQuery.bindValue(QStringLiteral(":size"), entry.size);
+        insertQuery.bindValue(QStringLiteral(":lastModified"), entry.lastModified);
+        insertQuery.bindValue(QStringLiteral(":fileId"), static_cast<qulonglong>(entry.fileId));
+        insertQuery.bindValue(QStringLiteral(":uniqueId"), entry.entityTag.toByteArray());
+        if (!insertQuery.exec()) {
+            qWarning() << "Failed to store journal entry" << entry.relativePath
+                       << ", error:" << insertQuery.lastError().text();
+            this->m_database.rollback();
+            return false;
+        }
+    }
+
+    if (!this->m_database.commit()) {
+        qWarning() << "Failed to commit journal, error:"
+                   << this->m_database.lastError().text();
+        this->m_database.rollback();
+        return false;
+    }
+
+    return true;
+}
+
+FileSnapshot SyncDb::loadFileSnapshot(const QString& localPath)
+{
+    FileSnapshot snapshot;
+    if (!this->m_database.isOpen()) {
+        qWarning() << "SyncDb database isn't open";
+        return snapshot;
+    }
+
+    QSqlQuery selectQuery(this->m_database);
+    selectQuery.setForwardOnly(true);
+    selectQuery.prepare(QStringLiteral("SELECT relativePath, inode, size, lastModified "
+                                       "from filesnapshots WHERE localPath=:localPath;"));
+    selectQuery.bindValue(QStringLiteral(":localPath"), localPath);
+    if (!selectQuery.exec()) {
+        qWarning() << "Failed to read file snapshot for" << localPath
+                   << ", error:" << selectQuery.lastError().text();
+        return snapshot;
+    }
+
+    while (selectQuery.next()) {
+        FileSnapshotEntry entry;
+        entry.inode = selectQuery.value(1).toULongLong();
+        entry.size = selectQuery.value(2).toLongLong();
+        entry.lastModified = selectQuery.value(3).toLongLong();
+        snapshot.insert(selectQuery.value(0).toString(), entry);
+    }
+
+    return snapshot;
+}
+
+bool SyncDb::storeFileSnapshot(const QString& localPath,
+                               const FileSnapshot& entries,
+                               const QStringList& removedPaths)
+{
+    if (!this->m_database.isOpen())
+        return false;
+
+    if (entries.isEmpty() && removedPaths.isEmpty())
+        return true;
+
+    if (!this->m_database.transaction()) {
+        qWarning() << "Failed to start transaction:" << this->m_database.lastError().text();
+        return false;
+    }
+
+    QSqlQuery deleteQuery(this->m_database);
+    deleteQuery.prepare(QStringLiteral("DELETE from filesnapshots WHERE localPath=:localPath "
+                                       "AND relativePath=:relativePath;"));
+    for (const QString& removedPath : removedPaths) {
+        deleteQuery.bindValue(QStringLiteral(":localPath"), localPath);
+        deleteQuery.bindValue(QStringLiteral(":relativePath"), removedPath);
+        if (!deleteQuery.exec()) {
+            qWarning() << "Failed to remove file snapshot entry" << removedPath
+                       << ", error:" << deleteQuery.lastError().text();
+            this->m_database.rollback();
+            return false;
+        }
+    }
+
+    QSqlQuery insertQuery(this->m_database);
+    insertQuery.prepare(QStringLiteral("INSERT or REPLACE INTO filesnapshots "
+                                       "(localPath, relativePath, inode, size, lastModified) "
+                                       "values(:localPath, :relativePath, :inode, :size,"
+                                       " :lastModified);"));
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        insertQuery.bindValue(QStringLiteral(":localPath"), localPath);
+        insertQuery.bindValue(QStringLiteral(":relativePath"), it.key());
+        insertQuery.bindValue(QStringLiteral(":inode"), static_cast<qulonglong>(it.value().inode));
+        insertQuery.bindValue(QStringLiteral(":size"), it.value().size);
+        insertQuery.bindValue(QStringLiteral(":lastModified"), it.value().lastModified);
+        if (!insertQuery.exec()) {
+            qWarning() << "Failed to store file snapshot entry" << it.key()
+                       << ", error:" << insertQuery.lastError().text();
+            this->m_database.rollback();
+            return false;
+        }
+    }
+
+    if (!this->m_database.commit()) {
+        qWarning() << "Failed to commit file snapshot, error:"
+                   << this->m_database.lastError().text();
+        this->m_database.rollback();
+        return false;
+    }
+
+    return true;
+}
+
+QString SyncDb::uploadedPath(const QString& localPath,
+                             const QString& relativePath,
+                             const FileFingerprint& fingerprint)
+{
+    if (!this->m_database.isOpen() || !fingerprint.isValid())
+        return QString();
+
+    QSqlQuery selectQuery(this->m_database);
+    selectQuery.prepare(QStringLiteral("SELECT relativePath, lastModified from fingerprints "
+                                       "WHERE localPath=:localPath AND size=:size "
+                                       "AND contentHash=:contentHash;"));
+    selectQuery.bindValue(QStringLiteral(":localPath"), localPath);
+    selectQuery.bindValue(QStringLiteral(":size"), fingerprint.size);
+    selectQuery.bindValue(QStringLiteral(":contentHash"), fingerprint.contentHash);
+    if (!selectQuery.exec()) {
+        qWarning() << "Failed to look up fingerprint, error:" << selectQuery.lastError().text();
+        return QString();
+    }
+
+    // Prefer the file itself over other copies of the same content. The
+    // sampled hash can miss edits, the file itself only counts as
+    // uploaded while its modification time is unchanged as well.
+    QString uploadedPath;
+    while (selectQuery.next()) {
+        const QString path = selectQuery.value(0).toString();
+        if (path != relativePath) {
+            uploadedPath = path;
+            continue;
+        }
+
+        if (selectQuery.value(1).toLongLong() == fingerprint.lastModified)
+            return path;
+    }
+    return uploadedPath;
+}
+
+bool SyncDb::storeFingerprint(const QString& localPath,
+                              const QString& relativePath,
+                              const FileFingerprint& fingerprint)
+{
+    if (!this->m_database.isOpen() || !fingerprint.isValid())
+        return false;
+
+    QSqlQuery insertQuery(this->m_database);
+    insertQuery.prepare(QStringLiteral("INSERT or REPLACE INTO fingerprints "
+                                       "(localPath, relativePath, size, lastModified, contentHash) "
+                                       "values(:localPath, :relativePath, :size,"
+                                       " :lastModified, :contentHash);"));
+    insertQuery.bindValue(QStringLiteral(":localPath"), localPath);
+    insertQuery.bindValue(QStringLiteral(":relativePath"), relativePath);
+    insertQuery.bindValue(QStringLiteral(":size"), fingerprint.size);
+    insertQuery.bindValue(QStringLiteral(":lastModified"), fingerprint.lastModified);
+    insertQuery.bindValue(QStringLiteral(":contentHash"), fingerprint.contentHash);
+    if (!insertQuery.exec()) {
+        qWarning() << "Failed to store fingerprint of" << relativePath
+                   << ", error:" << insertQuery.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+NcChunkedUploadState SyncDb::loadChunkedUpload(const QString& localFile,
+                                               const QString& remoteFile)
+{
+    NcChunkedUploadState state;
+    if (!this->m_database.isOpen())
+        return state;
+
+    QSqlQuery selectQuery(this->m_database);
+    selectQuery.prepare(QStringLiteral("SELECT transferId, size, lastModified, chunkSize,"
+                                       " reusedBytes from chunkeduploads "
+                                       "WHERE localFile=:localFile AND remoteFile=:remoteFile;"));
+    selectQuery.bindValue(QStringLiteral(":localFile"), localFile);
+    selectQuery.bindValue(QStringLiteral(":remoteFile"), remoteFile);
+    if (!selectQuery.exec() || !selectQuery.first())
+        return state;
+
+    state.transferId = selectQuery.value(0).toString();
+    state.size = selectQuery.value(1).toLongLong();
+    state.lastModified = selectQuery.value(2).toLongLong();
+    state.chunkSize = selectQuery.value(3).toLongLong();
+    state.reusedBytes = selectQuery.value(4).toLongLong();
+
+    QSqlQuery chunksQuery(this->m_database);
+    chunksQuery.setForwardOnly(true);
+    chunksQuery.prepare(QStringLiteral("SELECT chunkNumber from uploadedchunks "
+                                       "WHERE transferId=:transferId;"));
+    chunksQuery.bindValue(QStringLiteral(":transferId"), state.transferId);
+    if (!chunksQuery.exec()) {
+        qWarning() << "Failed to read uploaded chunks, error:" << chunksQuery.lastError().text();
+        return NcChunkedUploadState();
+    }
+
+    while (chunksQuery.next()) {
+        state.uploadedChunks.insert(chunksQuery.value(0).toInt());
+    }
+    return state;
+}
+
+bool SyncDb::storeChunkedUpload(const QString& localFile,
+                                const QString& remoteFile,
+                                const NcChunkedUploadState& state)
+{
+    if (!this->m_database.isOpen() || !state.isValid())
+        return false;
+
+    if (!this->m_database.transaction()) {
+        qWarning() << "Failed to start transaction:" << this->m_database.lastError().text();
+        return false;
+    }
+
+    // A different transfer for the same file replaces the previous one
+    QSqlQuery deleteQuery(this->m_database);
+    deleteQuery.prepare(QStringLiteral("DELETE from uploadedchunks WHERE transferId IN "
+                                       "(SELECT transferId from chunkeduploads "
+                                       "WHERE localFile=:localFile AND remoteFile=:remoteFile "
+                                       "AND transferId!=:transferId);"));
+    deleteQuery.bindValue(QStringLiteral(":localFile"), localFile);
+    deleteQuery.bindValue(QStringLiteral(":remoteFile"), remoteFile);
+    deleteQuery.bindValue(QStringLiteral(":transferId"), state.transferId);
+
+    QSqlQuery insertQuery(this->m_database);
+    insertQuery.prepare(QStringLiteral("INSERT or REPLACE INTO chunkeduploads "
+                                       "(localFile, remoteFile, transferId, size,"
+                                       " lastModified, chunkSize, reusedBytes) "
+                                       "values(:localFile, :remoteFile, :transferId, :size,"
+                                       " :lastModified, :chunkSize, :reusedBytes);"));
+    insertQuery.bindValue(QStringLiteral(":localFile"), localFile);
+    insertQuery.bindValue(QStringLiteral(":remoteFile"), remoteFile);
+    insertQuery.bindValue(QStringLiteral(":transferId"), state.transferId);
+    insertQuery.bindValue(QStringLiteral(":size"), state.size);
+    insertQuery.bindValue(QStringLiteral(":lastModified"), state.lastModified);
+    insertQuery.bindValue(QStringLiteral(":chunkSize"), state.chunkSize);
+    insertQuery.bindValue(QStringLiteral(":reusedBytes"), state.reusedBytes);
+
+    // Chunks the server doesn't have anymore
+    QSqlQuery staleChunksQuery(this->m_database);
+    staleChunksQuery.prepare(QStringLiteral("DELETE from uploadedchunks "
+                                            "WHERE transferId=:transferId;"));
+    staleChunksQuery.bindValue(QStringLiteral(":transferId"), state.transferId);
+
+    const bool staleChunks = state.uploadedChunks.isEmpty();
+    if (!deleteQuery.exec() || !insertQuery.exec() ||
+            (staleChunks && !staleChunksQuery.exec())) {
+        qWarning() << "Failed to store chunked upload of" << localFile << ", error:"
+                   << this->m_database.lastError().text();
+        this->m_database.rollback();
+        return false;
+    }
+
+    return this->m_database.commit();
+}
+
+bool SyncDb::storeUploadedChunk(const QString& transferId, int chunkNumber)
+{
+    if (!this->m_database.isOpen())
+        return false;
+
+    QSqlQuery insertQuery(this->m_database);
+    insertQuery.prepare(QStringLiteral("INSERT or REPLACE INTO uploadedchunks "
+                                       "(transferId, chunkNumber) "
+                                       "values(:transferId, :chunkNumber);"));
+    insertQuery.bindValue(QStringLiteral(":transferId"), transferId);
+    insertQuery.bindValue(QStringLiteral(":chunkNumber"), chunkNumber);
+    if (!insertQuery.exec()) {
+        qWarning() << "Failed to store chunk" << chunkNumber << "of" << transferId
+                   << ", error:" << insertQuery.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SyncDb::removeChunkedUpload(const QString& localFile,
+                                 const QString& remoteFile,
+                                 const QString& transferId)
+{
+    if (!this->m_database.isOpen())
+        return false;
+
+    if (!this->m_database.transaction()) {
+        qWarning() << "Failed to start transaction:" << this->m_database.lastError().text();
+        return false;
+    }
+
+    QSqlQuery chunksQuery(this->m_database);
+    chunksQuery.prepare(QStringLiteral("DELETE from uploadedchunks WHERE transferId=:transferId;"));
+    chunksQuery.bindValue(QStringLiteral(":transferId"), transferId);
+
+    QSqlQuery uploadQuery(this->m_database);
+    uploadQuery.prepare(QStringLiteral("DELETE from chunkeduploads "
+                                       "WHERE localFile=:localFile AND remoteFile=:remoteFile;"));
+    uploadQuery.bindValue(QStringLiteral(":localFile"), localFile);
+    uploadQuery.bindValue(QStringLiteral(":remoteFile"), remoteFile);
+
+    if (!chunksQuery.exec() || !uploadQuery.exec()) {
+        qWarning() << "Failed to remove chunked upload of" << localFile << ", error:"
+                   << this->m_database.lastError().text();
+        this->m_database.rollback();
+        return false;
+    }
+
+    return this->m_database.commit();
+}
+
+BlockManifest SyncDb::loadBlockManifest(const QString& localFile,
+                                        const QString& remoteFile)
+{
+    BlockManifest manifest;
+    if (!this->m_database.isOpen())
+        return manifest;
+
+    QSqlQuery selectQuery(this->m_database);
+    selectQuery.prepare(QStringLiteral("SELECT size, blockSize, remoteEntityTag, hashes "
+                                       "from blockmanifests "
+                                       "WHERE localFile=:localFile AND remoteFile=:remoteFile;"));
+    selectQuery.bindValue(QStringLiteral(":localFile"), localFile);
+    selectQuery.bindValue(QStringLiteral(":remoteFile"), remoteFile);
+    if (!selectQuery.exec() || !selectQuery.first())
+        return manifest;
+
+    manifest.size = selectQuery.value(0).toLongLong();
+    manifest.blockSize = selectQuery.value(1).toLongLong();
+    manifest.remoteEntityTag = selectQuery.value(2).toString();
+    if (!manifest.setHashData(selectQuery.value(3).toByteArray())) {
+        qWarning() << "Invalid block manifest stored for" << localFile;
+        return BlockManifest();
+    }
+    return manifest;
+}
+
+bool SyncDb::storeBlockManifest(const QString& localFile,
+                                const QString& remoteFile,
+                                const BlockManifest& manifest)
+{
+    if (!this->m_database.isOpen() || !manifest.isValid())
+        return false;
+
+    QSqlQuery insertQuery(this->m_database);
+    insertQuery.prepare(QStringLiteral("INSERT or REPLACE INTO blockmanifests "
+                                       "(localFile, remoteFile, size, blockSize,"
+                                       " remoteEntityTag, hashes) "
+                                       "values(:localFile, :remoteFile, :size, :blockSize,"
+                                       " :remoteEntityTag, :hashes);"));
+    insertQuery.bindValue(QStringLiteral(":localFile"), localFile);
+    insertQuery.bindValue(QStringLiteral(":remoteFile"), remoteFile);
+    insertQuery.bindValue(QStringLiteral(":size"), manifest.size);
+    insertQuery.bindValue(QStringLiteral(":blockSize"), manifest.blockSize);
+    insertQuery.bindValue(QStringLiteral(":remoteEntityTag"), manifest.remoteEntityTag);
+    insertQuery.bindValue(QStringLiteral(":hashes"), manifest.hashData());
+    if (!insertQuery.exec()) {
+        qWarning() << "Failed to store block manifest of" << localFile
+                   << ", error:" << insertQuery.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SyncDb::removeBlockManifest(const QString& localFile,
+                                 const QString& remoteFile)
+{
+    if (!this->m_database.isOpen())
+        return false;
+
+    QSqlQuery deleteQuery(this->m_database);
+    deleteQuery.prepare(QStringLiteral("DELETE from blockmanifests "
+                                       "WHERE localFile=:localFile AND remoteFile=:remoteFile;"));
+    deleteQuery.bindValue(QStringLiteral(":localFile"), localFile);
+    deleteQuery.bindValue(QStringLiteral(":remoteFile"), remoteFile);
+    if (!deleteQuery.exec()) {
+        qWarning() << "Failed to remove block manifest of" << localFile
+                   << ", error:" << deleteQuery.lastError().text();
+        return false;
+    }
+    return true;
+}
@@ -2,7 +2,20 @@
 #define SYNCDB_H
 
 #include <QObject>
+#include <QSharedPointer>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
 #include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+
+#include <commands/sync/ncsyncreconciler.h>
+#include <commands/webdav/ncchunkeduploadcommandentity.h>
+#include <util/filefingerprint.h>
+#include <util/blockmanifest.h>
+#include <util/filesnapshot.h>
+
+class NcDirNode;
 
 class SyncDb : public QObject
 {
@@ -12,8 +25,77 @@ public:
                     QString userName = QStringLiteral(""));
     ~SyncDb();
 
+    // Restores the remote tree persisted for the given tangle,
+    // returns a null pointer in case nothing has been stored yet.
+    QSharedPointer<NcDirNode> loadTree(const QString& localPath,
+                                       const QString& remotePath);
+
+    // Writes back all nodes marked as dirty, one transaction per directory.
+    bool storeTree(const QString& localPath,
+                   const QString& remotePath,
+                   QSharedPointer<NcDirNode> tree);
+
+    // Last synced state of every file below localPath, keyed by relative path
+    QHash<QString, NcSyncJournalEntry> loadJournal(const QString& localPath);
+
+    // Applies journal changes in a single transaction
+    bool storeJournalEntries(const QString& localPath,
+                             const QVector<NcSyncJournalEntry>& entries,
+                             const QStringList& removedPaths = QStringList());
+
+    // Local state of the files below localPath as of the last successful sync
+    FileSnapshot loadFileSnapshot(const QString& localPath);
+
+    // Applies snapshot changes in a single transaction
+    bool storeFileSnapshot(const QString& localPath,
+                           const FileSnapshot& entries,
+                           const QStringList& removedPaths = QStringList());
+
+    // Returns the path the given content has been uploaded from before,
+    // preferring relativePath itself as long as its modification time is
+    // unchanged. Empty if it has never been uploaded.
+    QString uploadedPath(const QString& localPath,
+                         const QString& relativePath,
+                         const FileFingerprint& fingerprint);
+
+    bool storeFingerprint(const QString& localPath,
+                          const QString& relativePath,
+                          const FileFingerprint& fingerprint);
+
+    // Chunked upload of localFile to remoteFile which hasn't completed yet,
+    // invalid if there is none.
+    NcChunkedUploadState loadChunkedUpload(const QString& localFile,
+                                           const QString& remoteFile);
+
+    // Records the transfer without its chunks, forgetting earlier transfers of the file.
+    // Recorded chunks are dropped as well if state doesn't list any.
+    bool storeChunkedUpload(const QString& localFile,
+                            const QString& remoteFile,
+                            const NcChunkedUploadState& state);
+    bool storeUploadedChunk(const QString& transferId, int chunkNumber);
+    bool removeChunkedUpload(const QString& localFile,
+                             const QString& remoteFile,
+                             const QString& transferId);
+
+    // Block checksums of the version of localFile last uploaded to remoteFile,
+    // invalid if there are none.
+    BlockManifest loadBlockManifest(const QString& localFile,
+                                    const QString& remoteFile);
+    bool storeBlockManifest(const QString& localFile,
+                            const QString& remoteFile,
+                            const BlockManifest& manifest);
+    bool removeBlockManifest(const QString& localFile,
+                             const QString& remoteFile);
+
 private:
     void createDatabase();
+    int currentDatabaseVersion();
+    void upgradeDatabase();
+
+    bool storeDirectory(const QString& remotePath,
+                        const QString& parentPath,
+                        NcDirNode* node,
+                        QSqlQuery& insertQuery);
 
 private:
     QSqlDatabase m_database;
@@ -104,6 +104,11 @@ bool IniFileSettings::readSettings()
                                                      false).toBool();
     setMobileUpload(mobileUpload);
 
+    setUploadLimitWlan(this->m_settings.value(NEXTCLOUD_SETTINGS_KEY_UPLOADLIMITWLAN, 0).toInt());
+    setUploadLimitCellular(this->m_settings.value(NEXTCLOUD_SETTINGS_KEY_UPLOADLIMITCELLULAR, 0).toInt());
+    setDownloadLimitWlan(this->m_settings.value(NEXTCLOUD_SETTINGS_KEY_DOWNLOADLIMITWLAN, 0).toInt());
+    setDownloadLimitCellular(this->m_settings.value(NEXTCLOUD_SETTINGS_KEY_DOWNLOADLIMITCELLULAR, 0).toInt());
+
     this->m_settings.endGroup();
 
     Q_EMIT settingsChanged();
@@ -19,6 +19,10 @@ AccountBase::AccountBase(QObject *parent) : QObject(parent)
     m_providerType = ProviderType::Nextcloud;
     m_uploadAutomatically = false;
     m_mobileUpload = false;
+    m_uploadLimitWlan = 0;
+    m_uploadLimitCellular = 0;
+    m_downloadLimitWlan = 0;
+    m_downloadLimitCellular = 0;
 
     connect(this, &AccountBase::hoststringChanged, this, &AccountBase::settingsChanged);
     connect(this, &AccountBase::usernameChanged, this, &AccountBase::settingsChanged);
@@ -83,6 +87,10 @@ void AccountBase::resetSettings()
     setAutoLogin(false);
     setUploadAutomatically(false);
     setMobileUpload(false);
+    setUploadLimitWlan(0);
+    setUploadLimitCellular(0);
+    setDownloadLimitWlan(0);
+    setDownloadLimitCellular(0);
     setNotifications(true);
 
     emit settingsChanged();
@@ -276,6 +284,62 @@ void AccountBase::setMobileUpload(bool enabled)
     Q_EMIT mobileUploadChanged();
 }
 
+int AccountBase::uploadLimitWlan() const
+{
+    return m_uploadLimitWlan;
+}
+
+void AccountBase::setUploadLimitWlan(int kibPerSecond)
+{
+    kibPerSecond = qMax(0, kibPerSecond);
+    if (this->m_uploadLimitWlan == kibPerSecond)
+        return;
+    this->m_uploadLimitWlan = kibPerSecond;
+    Q_EMIT transferLimitsChanged();
+}
+
+int AccountBase::uploadLimitCellular() const
+{
+    return m_uploadLimitCellular;
+}
+
+void AccountBase::setUploadLimitCellular(int kibPerSecond)
+{
+    kibPerSecond = qMax(0, kibPerSecond);
+    if (this->m_uploadLimitCellular == kibPerSecond)
+        return;
+    this->m_uploadLimitCellular = kibPerSecond;
+    Q_EMIT transferLimitsChanged();
+}
+
+int AccountBase::downloadLimitWlan() const
+{
+    return m_downloadLimitWlan;
+}
+
+void AccountBase::setDownloadLimitWlan(int kibPerSecond)
+{
+    kibPerSecond = qMax(0, kibPerSecond);
+    if (this->m_downloadLimitWlan == kibPerSecond)
+        return;
+    this->m_downloadLimitWlan = kibPerSecond;
+    Q_EMIT transferLimitsChanged();
+}
+
+int AccountBase::downloadLimitCellular() const
+{
+    return m_downloadLimitCellular;
+}
+
+void AccountBase::setDownloadLimitCellular(int kibPerSecond)
+{
+    kibPerSecond = qMax(0, kibPerSecond);
+    if (this->m_downloadLimitCellular == kibPerSecond)
+        return;
+    this->m_downloadLimitCellular = kibPerSecond;
+    Q_EMIT transferLimitsChanged();
+}
+
 void AccountBase::acceptTlsFingerprints(QString md5, QString sha1)
 {
     if (this->m_md5Hex == md5 && this->m_sha1Hex == sha1)
@@ -18,6 +18,10 @@ const QString NEXTCLOUD_SETTINGS_KEY_MOBILEUPLOAD = QStringLiteral("mobileUpload
 const QString NEXTCLOUD_SETTINGS_KEY_NOTIFICATIONS = QStringLiteral("notifications");
 const QString NEXTCLOUD_SETTINGS_KEY_UPLOADAUTOMATICALLY = QStringLiteral("uploadAutomatically");
 const QString NEXTCLOUD_SETTINGS_KEY_AUTOLOGIN = QStringLiteral("autoLogin");
+const QString NEXTCLOUD_SETTINGS_KEY_UPLOADLIMITWLAN = QStringLiteral("uploadLimitWlan");
+const QString NEXTCLOUD_SETTINGS_KEY_UPLOADLIMITCELLULAR = QStringLiteral("uploadLimitCellular");
+const QString NEXTCLOUD_SETTINGS_KEY_DOWNLOADLIMITWLAN = QStringLiteral("downloadLimitWlan");
+const QString NEXTCLOUD_SETTINGS_KEY_DOWNLOADLIMITCELLULAR = QStringLiteral("downloadLimitCellular");
 const QString NEXTCLOUD_PERMD_REQUESTDENIED = QStringLiteral("requestDenied");
 
 class AccountBase : public QObject
@@ -37,6 +41,12 @@ class AccountBase : public QObject
     Q_PROPERTY(bool uploadAutomatically READ uploadAutomatically WRITE setUploadAutomatically NOTIFY uploadAutomaticallyChanged)
     Q_PROPERTY(bool mobileUpload READ mobileUpload WRITE setMobileUpload NOTIFY mobileUploadChanged)
 
+    // Transfer rate limits in KiB/s, 0 means unlimited
+    Q_PROPERTY(int uploadLimitWlan READ uploadLimitWlan WRITE setUploadLimitWlan NOTIFY transferLimitsChanged)
+    Q_PROPERTY(int uploadLimitCellular READ uploadLimitCellular WRITE setUploadLimitCellular NOTIFY transferLimitsChanged)
+    Q_PROPERTY(int downloadLimitWlan READ downloadLimitWlan WRITE setDownloadLimitWlan NOTIFY transferLimitsChanged)
+    Q_PROPERTY(int downloadLimitCellular READ downloadLimitCellular WRITE setDownloadLimitCellular NOTIFY transferLimitsChanged)
+
     Q_PROPERTY(QString hostname READ hostname)
     Q_PROPERTY(QString path READ path)
     Q_PROPERTY(int port READ port)
@@ -77,6 +87,15 @@ public:
     bool mobileUpload() const;
     void setMobileUpload(bool enabled);
 
+    int uploadLimitWlan() const;
+    void setUploadLimitWlan(int kibPerSecond);
+    int uploadLimitCellular() const;
+    void setUploadLimitCellular(int kibPerSecond);
+    int downloadLimitWlan() const;
+    void setDownloadLimitWlan(int kibPerSecond);
+    int downloadLimitCellular() const;
+    void setDownloadLimitCellular(int kibPerSecond);
+
     QString username() const;
     void setUsername(QString value);
     QString password() const;
@@ -115,6 +134,11 @@ private:
     bool m_uploadAutomatically;
     bool m_mobileUpload;
 
+    int m_uploadLimitWlan;
+    int m_uploadLimitCellular;
+    int m_downloadLimitWlan;
+    int m_downloadLimitCellular;
+
 signals:
     void hostnameChanged();
     void portChanged();
@@ -133,6 +157,7 @@ signals:
     void notificationSettingsChanged();
     void uploadAutomaticallyChanged();
     void mobileUploadChanged();
+    void transferLimitsChanged();
     void localPicturesPathChanged();
 
     void settingsChanged();
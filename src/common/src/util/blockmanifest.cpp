@@ -0,0 +1,155 @@
+#include "blockmanifest.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+
+#include <zlib.h>
+
+quint32 weakBlockHash(const QByteArray& block)
+{
+    return static_cast<quint32>(adler32(adler32(0L, Z_NULL, 0),
+                                        reinterpret_cast<const Bytef*>(block.constData()),
+                                        static_cast<uInt>(block.size())));
+}
+
+QByteArray strongBlockHash(const QByteArray& block)
+{
+    return QCryptographicHash::hash(block, QCryptographicHash::Sha1);
+}
+
+int BlockManifest::blockCount() const
+{
+    if (this->blockSize <= 0)
+        return 0;
+    return static_cast<int>((this->size + this->blockSize - 1) / this->blockSize);
+}
+
+bool BlockManifest::isPrefixOf(const QString& filePath, const BlockManifest& current) const
+{
+    if (!isValid() || !current.isValid() ||
+            this->blockSize != current.blockSize || this->size > current.size) {
+        return false;
+    }
+
+    // Complete blocks line up with the ones of the current file
+    const int completeBlocks = static_cast<int>(this->size / this->blockSize);
+    for (int block = 0; block < completeBlocks; block++) {
+        if (this->weakHashes.at(block) != current.weakHashes.at(block) ||
+                this->strongHashes.at(block) != current.strongHashes.at(block)) {
+            return false;
+        }
+    }
+
+    const qint64 tailOffset = completeBlocks * this->blockSize;
+    if (tailOffset == this->size)
+        return true;
+
+    // The trailing partial block is only part of a block of the current file
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly) || !file.seek(tailOffset))
+        return false;
+
+    const QByteArray tail = file.read(this->size - tailOffset);
+    return weakBlockHash(tail) == this->weakHashes.last() &&
+            strongBlockHash(tail) == this->strongHashes.last();
+}
+
+QByteArray BlockManifest::hashData() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << this->weakHashes << this->strongHashes;
+    return data;
+}
+
+bool BlockManifest::setHashData(const QByteArray& data)
+{
+    QDataStream stream(data);
+    stream >> this->weakHashes >> this->strongHashes;
+    return stream.status() == QDataStream::Ok && isValid();
+}
+
+BlockManifest BlockManifest::fromFile(const QString& filePath, qint64 blockSize)
+{
+    BlockManifest manifest;
+
+    QFile file(filePath);
+    if (blockSize <= 0 || !file.open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open" << filePath << "for block hashing";
+        return manifest;
+    }
+
+    manifest.size = file.size();
+    manifest.blockSize = blockSize;
+    manifest.weakHashes.reserve(manifest.blockCount());
+    manifest.strongHashes.reserve(manifest.blockCount());
+
+    for (int block = 0; block < manifest.blockCount(); block++) {
+        const QByteArray data = file.read(blockSize);
+        if (data.isEmpty()) {
+            qWarning() << "Failed to read" << filePath << "for block hashing";
+            return BlockManifest();
+        }
+
+        manifest.weakHashes.append(weakBlockHash(data));
+        manifest.strongHashes.append(strongBlockHash(data));
+    }
+
+    return manifest;
+}
+
+BlockManifestBuilder::BlockManifestBuilder(const QString& filePath,
+                                           qint64 blockSize,
+                                           QObject* parent) :
+    QObject(parent),
+    m_file(filePath),
+    m_blockSize(blockSize)
+{
+}
+
+void BlockManifestBuilder::start()
+{
+    if (this->m_blockSize <= 0 || !this->m_file.open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open" << this->m_file.fileName() << "for block hashing";
+        QTimer::singleShot(0, this, &BlockManifestBuilder::finish);
+        return;
+    }
+
+    this->m_manifest.size = this->m_file.size();
+    this->m_manifest.blockSize = this->m_blockSize;
+    this->m_manifest.weakHashes.reserve(this->m_manifest.blockCount());
+    this->m_manifest.strongHashes.reserve(this->m_manifest.blockCount());
+
+    // Reported asynchronously even for empty files
+    QTimer::singleShot(0, this, &BlockManifestBuilder::hashNextBlock);
+}
+
+void BlockManifestBuilder::hashNextBlock()
+{
+    if (this->m_manifest.weakHashes.size() >= this->m_manifest.blockCount()) {
+        finish();
+        return;
+    }
+
+    const QByteArray data = this->m_file.read(this->m_blockSize);
+    if (data.isEmpty()) {
+        qWarning() << "Failed to read" << this->m_file.fileName() << "for block hashing";
+        this->m_manifest = BlockManifest();
+        finish();
+        return;
+    }
+
+    this->m_manifest.weakHashes.append(weakBlockHash(data));
+    this->m_manifest.strongHashes.append(strongBlockHash(data));
+    QTimer::singleShot(0, this, &BlockManifestBuilder::hashNextBlock);
+}
+
+void BlockManifestBuilder::finish()
+{
+    this->m_file.close();
+    this->m_finished = true;
+    Q_EMIT finished();
+}
@@ -0,0 +1,76 @@
+#ifndef BLOCKMANIFEST_H
+#define BLOCKMANIFEST_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+const qint64 BLOCKMANIFEST_DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+// Checksums of the fixed size blocks of a file as it has been uploaded:
+// a weak Adler-32, which can be rolled over a file byte by byte to find
+// blocks at any offset, and a SHA-1 confirming a candidate match.
+// Together with the entity tag of the uploaded version it tells which
+// part of a modified file the server has already.
+struct BlockManifest
+{
+    qint64 size = 0;
+    qint64 blockSize = 0;
+    QString remoteEntityTag;
+    QVector<quint32> weakHashes;
+    QVector<QByteArray> strongHashes;
+
+    bool isValid() const
+    {
+        return this->blockSize > 0 &&
+                this->weakHashes.size() == blockCount() &&
+                this->strongHashes.size() == blockCount();
+    }
+
+    int blockCount() const;
+
+    // Whether the file at filePath, described by current, starts with the
+    // complete content this manifest describes, e.g. an appended log.
+    // Only a trailing partial block is read from the file again.
+    bool isPrefixOf(const QString& filePath, const BlockManifest& current) const;
+
+    QByteArray hashData() const;
+    bool setHashData(const QByteArray& data);
+
+    static BlockManifest fromFile(const QString& filePath,
+                                  qint64 blockSize = BLOCKMANIFEST_DEFAULT_BLOCK_SIZE);
+};
+
+// Builds the manifest of a file one block per event loop iteration, so that
+// hashing a large file doesn't stall the transfers running meanwhile.
+class BlockManifestBuilder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BlockManifestBuilder(const QString& filePath,
+                                  qint64 blockSize = BLOCKMANIFEST_DEFAULT_BLOCK_SIZE,
+                                  QObject* parent = Q_NULLPTR);
+
+    void start();
+    bool isFinished() const { return this->m_finished; }
+
+    // Invalid if the file couldn't be read completely
+    const BlockManifest& manifest() const { return this->m_manifest; }
+
+signals:
+    void finished();
+
+private:
+    void hashNextBlock();
+    void finish();
+
+    QFile m_file;
+    qint64 m_blockSize;
+    BlockManifest m_manifest;
+    bool m_finished = false;
+};
+
+#endif // BLOCKMANIFEST_H
@@ -0,0 +1,50 @@
+#include "filefingerprint.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+
+// Files up to FINGERPRINT_SAMPLE_COUNT * FINGERPRINT_BLOCK_SIZE are hashed
+// completely, larger ones by evenly spread blocks including head and tail.
+const qint64 FINGERPRINT_BLOCK_SIZE = 64 * 1024;
+const int FINGERPRINT_SAMPLE_COUNT = 4;
+
+FileFingerprint FileFingerprint::fromFile(const QString& filePath)
+{
+    FileFingerprint fingerprint;
+
+    const QFileInfo fileInfo(filePath);
+    QFile file(filePath);
+    if (!fileInfo.isFile() || !file.open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open" << filePath << "for fingerprinting";
+        return fingerprint;
+    }
+
+    fingerprint.size = fileInfo.size();
+    fingerprint.lastModified = fileInfo.lastModified().toMSecsSinceEpoch() / 1000;
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(QByteArray::number(fingerprint.size));
+
+    if (fingerprint.size <= FINGERPRINT_BLOCK_SIZE * FINGERPRINT_SAMPLE_COUNT) {
+        if (!hash.addData(&file)) {
+            qWarning() << "Failed to read" << filePath << "for fingerprinting";
+            return fingerprint;
+        }
+    } else {
+        const qint64 stride = (fingerprint.size - FINGERPRINT_BLOCK_SIZE) /
+                (FINGERPRINT_SAMPLE_COUNT - 1);
+        for (int sample = 0; sample < FINGERPRINT_SAMPLE_COUNT; sample++) {
+            if (!file.seek(sample * stride)) {
+                qWarning() << "Failed to seek in" << filePath << "for fingerprinting";
+                return fingerprint;
+            }
+            hash.addData(file.read(FINGERPRINT_BLOCK_SIZE));
+        }
+    }
+
+    fingerprint.contentHash = hash.result();
+    return fingerprint;
+}
@@ -0,0 +1,27 @@
+#ifndef FILEFINGERPRINT_H
+#define FILEFINGERPRINT_H
+
+#include <QByteArray>
+#include <QString>
+
+// Cheap content identity of a local file: size, modification time
+// and a hash over a few sampled blocks instead of the whole content.
+// Good enough to recognize already uploaded photos and videos without
+// reading gigabytes on every rescan.
+struct FileFingerprint
+{
+    qint64 size = 0;
+    qint64 lastModified = 0; // seconds since epoch
+    QByteArray contentHash;
+
+    bool isValid() const { return !this->contentHash.isEmpty(); }
+
+    bool sameContent(const FileFingerprint& other) const
+    {
+        return this->size == other.size && this->contentHash == other.contentHash;
+    }
+
+    static FileFingerprint fromFile(const QString& filePath);
+};
+
+#endif // FILEFINGERPRINT_H
@@ -0,0 +1,54 @@
+#include "filehasher.h"
+
+#include <QDebug>
+#include <QTimer>
+
+FileHasher::FileHasher(const QString& filePath,
+                       QCryptographicHash::Algorithm algorithm,
+                       qint64 blockSize,
+                       QObject* parent) :
+    QObject(parent),
+    m_file(filePath),
+    m_hash(algorithm),
+    m_blockSize(blockSize)
+{
+}
+
+void FileHasher::start()
+{
+    if (this->m_blockSize <= 0 || !this->m_file.open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open" << this->m_file.fileName() << "for hashing";
+        QTimer::singleShot(0, this, [=]() { finish(false); });
+        return;
+    }
+
+    // Reported asynchronously even for empty files
+    QTimer::singleShot(0, this, &FileHasher::hashNextBlock);
+}
+
+void FileHasher::hashNextBlock()
+{
+    if (this->m_file.atEnd()) {
+        finish(true);
+        return;
+    }
+
+    const QByteArray data = this->m_file.read(this->m_blockSize);
+    if (data.isEmpty()) {
+        qWarning() << "Failed to read" << this->m_file.fileName() << "for hashing";
+        finish(false);
+        return;
+    }
+
+    this->m_hash.addData(data);
+    QTimer::singleShot(0, this, &FileHasher::hashNextBlock);
+}
+
+void FileHasher::finish(bool success)
+{
+    this->m_file.close();
+    if (success)
+        this->m_result = this->m_hash.result();
+    this->m_finished = true;
+    Q_EMIT finished();
+}
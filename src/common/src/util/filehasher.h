@@ -0,0 +1,45 @@
+#ifndef FILEHASHER_H
+#define FILEHASHER_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QObject>
+#include <QString>
+
+const qint64 FILEHASHER_DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+// Hashes the whole content of a file one block per event loop iteration,
+// so that comparing or checksumming large files doesn't stall the
+// transfers running meanwhile.
+class FileHasher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileHasher(const QString& filePath,
+                        QCryptographicHash::Algorithm algorithm,
+                        qint64 blockSize = FILEHASHER_DEFAULT_BLOCK_SIZE,
+                        QObject* parent = Q_NULLPTR);
+
+    void start();
+    bool isFinished() const { return this->m_finished; }
+
+    // Empty if the file couldn't be read completely
+    const QByteArray& result() const { return this->m_result; }
+
+signals:
+    void finished();
+
+private:
+    void hashNextBlock();
+    void finish(bool success);
+
+    QFile m_file;
+    QCryptographicHash m_hash;
+    qint64 m_blockSize;
+    QByteArray m_result;
+    bool m_finished = false;
+};
+
+#endif // FILEHASHER_H
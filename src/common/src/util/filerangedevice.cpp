@@ -0,0 +1,146 @@
+#include "filerangedevice.h"
+
+#include <QDebug>
+
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
+FileRangeDevice::FileRangeDevice(const QString& fileName,
+                                 qint64 offset,
+                                 qint64 length,
+                                 QObject* parent) :
+    QIODevice(parent),
+    m_file(fileName),
+    m_offset(offset),
+    m_length(length)
+{
+}
+
+FileRangeDevice::~FileRangeDevice()
+{
+    close();
+}
+
+bool FileRangeDevice::open(OpenMode mode)
+{
+    if (mode != QIODevice::ReadOnly) {
+        qWarning() << "FileRangeDevice is read-only";
+        return false;
+    }
+
+    // Unbuffered, the slice is the buffer
+    if (!this->m_file.open(QFile::ReadOnly | QFile::Unbuffered)) {
+        qWarning() << "Failed to open" << this->m_file.fileName();
+        return false;
+    }
+
+    if (this->m_length < 0)
+        this->m_length = this->m_file.size() - this->m_offset;
+
+    if (this->m_length <= 0 || this->m_offset + this->m_length > this->m_file.size()) {
+        this->m_file.close();
+        return false;
+    }
+
+#ifdef Q_OS_UNIX
+    posix_fadvise(this->m_file.handle(), this->m_offset, this->m_length, POSIX_FADV_SEQUENTIAL);
+#endif
+    this->m_slice.clear();
+    this->m_currentSlice = -1;
+
+    return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void FileRangeDevice::close()
+{
+    this->m_slice.clear();
+    this->m_currentSlice = -1;
+    if (this->m_file.isOpen())
+        this->m_file.close();
+
+    if (isOpen())
+        QIODevice::close();
+}
+
+qint64 FileRangeDevice::size() const
+{
+    return qMax<qint64>(0, this->m_length);
+}
+
+qint64 FileRangeDevice::readData(char* data, qint64 maxSize)
+{
+    if (!this->m_file.isOpen())
+        return -1;
+
+    const qint64 position = pos();
+    if (position >= this->m_length)
+        return 0;
+
+    const qint64 slice = position / FILERANGE_SLICE_SIZE;
+    if (slice != this->m_currentSlice && !fillSlice(slice))
+        return -1;
+
+    const qint64 sliceOffset = position - slice * FILERANGE_SLICE_SIZE;
+    const qint64 readSize = qMin(maxSize, this->m_slice.size() - sliceOffset);
+    if (readSize <= 0)
+        return 0;
+
+    memcpy(data, this->m_slice.constData() + sliceOffset, static_cast<size_t>(readSize));
+    return readSize;
+}
+
+qint64 FileRangeDevice::writeData(const char* data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+bool FileRangeDevice::fillSlice(qint64 slice)
+{
+    const qint64 start = slice * FILERANGE_SLICE_SIZE;
+    const qint64 sliceSize = qMin(FILERANGE_SLICE_SIZE, this->m_length - start);
+
+    if (!this->m_file.seek(this->m_offset + start)) {
+        qWarning() << "Failed to seek in" << this->m_file.fileName();
+        setErrorString(this->m_file.errorString());
+        return false;
+    }
+
+    this->m_slice.resize(static_cast<int>(sliceSize));
+    const qint64 bytesRead = this->m_file.read(this->m_slice.data(), sliceSize);
+    if (bytesRead < 0) {
+        qWarning() << "Failed to read" << this->m_file.fileName();
+        setErrorString(this->m_file.errorString());
+        return false;
+    }
+
+    // Shorter than expected if the file has been truncated meanwhile
+    this->m_slice.resize(static_cast<int>(bytesRead));
+
+    // Prefetch the next slice, release the one just left behind
+#ifdef Q_OS_UNIX
+    adviseSlice(slice + 1, POSIX_FADV_WILLNEED);
+    if (slice > this->m_currentSlice && this->m_currentSlice >= 0)
+        adviseSlice(this->m_currentSlice, POSIX_FADV_DONTNEED);
+#endif
+    this->m_currentSlice = slice;
+    return true;
+}
+
+void FileRangeDevice::adviseSlice(qint64 slice, int advice)
+{
+#ifdef Q_OS_UNIX
+    const qint64 start = slice * FILERANGE_SLICE_SIZE;
+    if (start < 0 || start >= this->m_length)
+        return;
+
+    posix_fadvise(this->m_file.handle(), this->m_offset + start,
+                  qMin(FILERANGE_SLICE_SIZE, this->m_length - start), advice);
+#else
+    Q_UNUSED(slice);
+    Q_UNUSED(advice);
+#endif
+}
@@ -0,0 +1,49 @@
+#ifndef FILERANGEDEVICE_H
+#define FILERANGEDEVICE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QFile>
+
+// Amount read from the file at once, and the slices the kernel is asked
+// to read ahead and to drop from the page cache once consumed
+const qint64 FILERANGE_SLICE_SIZE = 1024 * 1024;
+
+// Read-only upload body over (a range of) a file. The file is read in
+// large slices instead of the small reads QNetworkAccessManager issues
+// through QFile's buffer, the kernel is told the access is sequential and
+// gets readahead and release hints slice by slice.
+// A file which shrinks while being read simply ends early, the request
+// then fails on its announced length and is retried later.
+class FileRangeDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit FileRangeDevice(const QString& fileName,
+                             qint64 offset = 0,
+                             qint64 length = -1,
+                             QObject* parent = Q_NULLPTR);
+    ~FileRangeDevice();
+
+    bool open(OpenMode mode) Q_DECL_OVERRIDE;
+    void close() Q_DECL_OVERRIDE;
+    bool isSequential() const Q_DECL_OVERRIDE { return false; }
+    qint64 size() const Q_DECL_OVERRIDE;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 writeData(const char* data, qint64 maxSize) Q_DECL_OVERRIDE;
+
+private:
+    bool fillSlice(qint64 slice);
+    void adviseSlice(qint64 slice, int advice);
+
+    QFile m_file;
+    qint64 m_offset;
+    qint64 m_length;
+    QByteArray m_slice;
+    qint64 m_currentSlice = -1;
+};
+
+#endif // FILERANGEDEVICE_H
@@ -0,0 +1,168 @@
+#include "filesnapshot.h"
+
+#include <QDebug>
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <QDirIterator>
+#include <QFileInfo>
+#endif
+
+#ifdef Q_OS_LINUX
+// Layout returned by the getdents64 system call, glibc only wraps it since 2.30
+struct LinuxDirent64
+{
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+bool statSnapshotEntry(int dirFd, const char* name, bool* isDirectory, FileSnapshotEntry* entry)
+{
+#ifdef STATX_INO
+    struct statx fileStat;
+    if (statx(dirFd, name, 0, STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME, &fileStat) != 0)
+        return false;
+
+    *isDirectory = S_ISDIR(fileStat.stx_mode);
+    entry->inode = fileStat.stx_ino;
+    entry->size = fileStat.stx_size;
+    entry->lastModified = fileStat.stx_mtime.tv_sec;
+#else
+    struct stat fileStat;
+    if (fstatat(dirFd, name, &fileStat, 0) != 0)
+        return false;
+
+    *isDirectory = S_ISDIR(fileStat.st_mode);
+    entry->inode = static_cast<quint64>(fileStat.st_ino);
+    entry->size = fileStat.st_size;
+    entry->lastModified = fileStat.st_mtime;
+#endif
+    return true;
+}
+
+void walkSnapshotDirectory(int dirFd,
+                           const QString& dirPath,
+                           const QString& relativeDir,
+                           FileSnapshot* snapshot,
+                           QStringList* directories)
+{
+    if (directories)
+        directories->append(dirPath);
+
+    char buffer[FILESNAPSHOT_DIRENT_BUFFER_SIZE];
+    for (;;) {
+        const long length = syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+        if (length < 0) {
+            qWarning() << "Failed to list" << dirPath << ":" << strerror(errno);
+            return;
+        }
+        if (length == 0)
+            return;
+
+        for (long position = 0; position < length;) {
+            const LinuxDirent64* dirent = reinterpret_cast<const LinuxDirent64*>(buffer + position);
+            position += dirent->d_reclen;
+
+            // Also skips "." and ".."
+            if (dirent->d_name[0] == '.')
+                continue;
+
+            const QString name = QFile::decodeName(dirent->d_name);
+            const QString relativePath = relativeDir + name;
+
+            // Some file systems don't report the type, only directories can be opened as such
+            if (dirent->d_type == DT_DIR || dirent->d_type == DT_UNKNOWN) {
+                const int subDirFd = openat(dirFd, dirent->d_name,
+                                            O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (subDirFd >= 0) {
+                    walkSnapshotDirectory(subDirFd, dirPath + QStringLiteral("/") + name,
+                                          relativePath + QStringLiteral("/"), snapshot, directories);
+                    close(subDirFd);
+                    continue;
+                }
+                if (dirent->d_type == DT_DIR)
+                    continue;
+            }
+
+            // Regular files as well as symlinks to them, or unknown entry types
+            bool isDirectory = false;
+            FileSnapshotEntry entry;
+            if (!statSnapshotEntry(dirFd, dirent->d_name, &isDirectory, &entry) || isDirectory)
+                continue;
+            snapshot->insert(relativePath, entry);
+        }
+    }
+}
+
+#endif
+
+bool walkFileSnapshot(const QString& rootPath,
+                      FileSnapshot* snapshot,
+                      QStringList* directories)
+{
+#ifndef Q_OS_LINUX
+    // Without getdents64 and inode numbers, changes show up through size and time only
+    if (!QFileInfo(rootPath).isDir())
+        return false;
+
+    if (directories)
+        directories->append(rootPath);
+
+    QDirIterator iterator(rootPath, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot,
+                          QDirIterator::Subdirectories);
+    while (iterator.hasNext()) {
+        const QString path = iterator.next();
+        const QFileInfo info = iterator.fileInfo();
+        if (info.isDir()) {
+            if (directories)
+                directories->append(path);
+            continue;
+        }
+
+        FileSnapshotEntry entry;
+        entry.size = info.size();
+        entry.lastModified = info.lastModified().toMSecsSinceEpoch() / 1000;
+        snapshot->insert(path.mid(rootPath.length() + 1), entry);
+    }
+    return true;
+#else
+    const int rootFd = open(QFile::encodeName(rootPath).constData(),
+                            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        qWarning() << "Failed to open" << rootPath << ":" << strerror(errno);
+        return false;
+    }
+
+    walkSnapshotDirectory(rootFd, rootPath, QString(), snapshot, directories);
+    close(rootFd);
+    return true;
+#endif
+}
+
+bool readFileSnapshotEntry(const QString& filePath, FileSnapshotEntry* entry)
+{
+#ifndef Q_OS_LINUX
+    const QFileInfo info(filePath);
+    if (!info.isFile())
+        return false;
+
+    entry->size = info.size();
+    entry->lastModified = info.lastModified().toMSecsSinceEpoch() / 1000;
+    return true;
+#else
+    bool isDirectory = false;
+    return statSnapshotEntry(AT_FDCWD, QFile::encodeName(filePath).constData(),
+                             &isDirectory, entry) && !isDirectory;
+#endif
+}
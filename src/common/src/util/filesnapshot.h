@@ -0,0 +1,48 @@
+#ifndef FILESNAPSHOT_H
+#define FILESNAPSHOT_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// Buffer the directory entries are read into, a few hundred names at once
+const int FILESNAPSHOT_DIRENT_BUFFER_SIZE = 32 * 1024;
+
+// Local state of a file as cheap to get as a directory listing.
+// A file whose entry is unchanged is assumed to be unchanged.
+struct FileSnapshotEntry
+{
+    quint64 inode = 0;
+    qint64 size = 0;
+    qint64 lastModified = 0; // seconds since epoch
+
+    bool operator==(const FileSnapshotEntry& other) const
+    {
+        return this->inode == other.inode &&
+                this->size == other.size &&
+                this->lastModified == other.lastModified;
+    }
+
+    bool operator!=(const FileSnapshotEntry& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// Keyed by the path relative to the walked directory
+typedef QHash<QString, FileSnapshotEntry> FileSnapshot;
+
+// Walks the tree below rootPath with getdents64, stat-ing only the files
+// relative to their directory's descriptor (statx where available).
+// Hidden entries are skipped like QDir does by default, symlinked
+// directories aren't followed. directories receives the absolute path
+// of every directory including rootPath. Returns false if rootPath
+// can't be read; unreadable subdirectories are skipped.
+bool walkFileSnapshot(const QString& rootPath,
+                      FileSnapshot* snapshot,
+                      QStringList* directories = Q_NULLPTR);
+
+// Snapshot entry of a single file, false if it isn't a readable file
+bool readFileSnapshotEntry(const QString& filePath, FileSnapshotEntry* entry);
+
+#endif // FILESNAPSHOT_H
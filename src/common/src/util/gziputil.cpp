@@ -0,0 +1,214 @@
+#include "gziputil.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QMimeDatabase>
+#include <QMimeType>
+#include <QStringList>
+#include <QTimer>
+
+#include <zlib.h>
+
+const int GZIP_BLOCK_SIZE = 64 * 1024;
+
+// windowBits + 16 makes zlib write a gzip header and trailer
+const int GZIP_WINDOW_BITS = 15 + 16;
+
+bool isCompressedMimeType(const QMimeType& mimeType)
+{
+    // Uncompressed media
+    static const QStringList rawMediaTypes = {
+        QStringLiteral("image/svg+xml"),
+        QStringLiteral("image/bmp"),
+        QStringLiteral("image/x-portable-anymap"),
+        QStringLiteral("audio/x-wav")
+    };
+    for (const QString& rawMediaType : rawMediaTypes) {
+        if (mimeType.inherits(rawMediaType))
+            return false;
+    }
+
+    const QString name = mimeType.name();
+    if (name.startsWith(QStringLiteral("image/")) ||
+            name.startsWith(QStringLiteral("audio/")) ||
+            name.startsWith(QStringLiteral("video/"))) {
+        return true;
+    }
+
+    // Archives, including ZIP based documents like ODF and OOXML
+    static const QStringList compressedTypes = {
+        QStringLiteral("application/zip"),
+        QStringLiteral("application/gzip"),
+        QStringLiteral("application/x-bzip"),
+        QStringLiteral("application/x-xz"),
+        QStringLiteral("application/x-lzma"),
+        QStringLiteral("application/zstd"),
+        QStringLiteral("application/x-7z-compressed"),
+        QStringLiteral("application/vnd.rar"),
+        QStringLiteral("application/x-rar")
+    };
+    for (const QString& compressedType : compressedTypes) {
+        if (mimeType.inherits(compressedType))
+            return true;
+    }
+
+    return false;
+}
+
+QByteArray gzipCompress(const QByteArray& data, int level)
+{
+    z_stream stream = {};
+    if (deflateInit2(&stream, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return QByteArray();
+
+    QByteArray compressed(static_cast<int>(deflateBound(&stream, data.size())), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+
+    const int result = deflate(&stream, Z_FINISH);
+    compressed.resize(static_cast<int>(stream.total_out));
+    deflateEnd(&stream);
+
+    if (result != Z_STREAM_END)
+        return QByteArray();
+    return compressed;
+}
+
+// Reads one block of source and writes what zlib makes of it to target,
+// lastBlock is set once source is exhausted and the stream is finished
+bool deflateNextBlock(z_stream* stream, QIODevice* source, QIODevice* target, bool* lastBlock)
+{
+    QByteArray input(GZIP_BLOCK_SIZE, Qt::Uninitialized);
+    QByteArray output(GZIP_BLOCK_SIZE, Qt::Uninitialized);
+
+    const qint64 bytesRead = source->read(input.data(), input.size());
+    if (bytesRead < 0) {
+        qWarning() << "Failed to read data to compress:" << source->errorString();
+        return false;
+    }
+
+    *lastBlock = source->atEnd() || bytesRead == 0;
+    const int flush = *lastBlock ? Z_FINISH : Z_NO_FLUSH;
+    stream->next_in = reinterpret_cast<Bytef*>(input.data());
+    stream->avail_in = static_cast<uInt>(bytesRead);
+
+    // Drain the output until zlib consumed the whole block
+    do {
+        stream->next_out = reinterpret_cast<Bytef*>(output.data());
+        stream->avail_out = static_cast<uInt>(output.size());
+        if (deflate(stream, flush) == Z_STREAM_ERROR)
+            return false;
+
+        const qint64 bytesCompressed = output.size() - stream->avail_out;
+        if (target->write(output.constData(), bytesCompressed) != bytesCompressed) {
+            qWarning() << "Failed to write compressed data:" << target->errorString();
+            return false;
+        }
+    } while (stream->avail_out == 0);
+
+    return true;
+}
+
+bool gzipCompress(QIODevice* source, QIODevice* target, int level)
+{
+    if (!source || !target)
+        return false;
+
+    z_stream stream = {};
+    if (deflateInit2(&stream, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    bool success = true;
+    bool lastBlock = false;
+    while (success && !lastBlock) {
+        success = deflateNextBlock(&stream, source, target, &lastBlock);
+    }
+
+    deflateEnd(&stream);
+    return success;
+}
+
+GzipCompressor::GzipCompressor(QIODevice* source, QIODevice* target, int level, QObject* parent) :
+    QObject(parent),
+    m_source(source),
+    m_target(target),
+    m_level(level)
+{
+}
+
+GzipCompressor::~GzipCompressor()
+{
+    if (this->m_stream) {
+        deflateEnd(this->m_stream);
+        delete this->m_stream;
+    }
+}
+
+void GzipCompressor::start()
+{
+    this->m_stream = new z_stream();
+    if (!this->m_source || !this->m_target ||
+            deflateInit2(this->m_stream, this->m_level, Z_DEFLATED,
+                         GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        delete this->m_stream;
+        this->m_stream = Q_NULLPTR;
+        QTimer::singleShot(0, this, [=]() { finish(false); });
+        return;
+    }
+
+    QTimer::singleShot(0, this, &GzipCompressor::compressNextBlock);
+}
+
+void GzipCompressor::compressNextBlock()
+{
+    bool lastBlock = false;
+    if (!deflateNextBlock(this->m_stream, this->m_source, this->m_target, &lastBlock)) {
+        finish(false);
+        return;
+    }
+
+    if (lastBlock) {
+        finish(true);
+        return;
+    }
+    QTimer::singleShot(0, this, &GzipCompressor::compressNextBlock);
+}
+
+void GzipCompressor::finish(bool success)
+{
+    if (this->m_stream) {
+        deflateEnd(this->m_stream);
+        delete this->m_stream;
+        this->m_stream = Q_NULLPTR;
+    }
+
+    this->m_succeeded = success;
+    this->m_finished = true;
+    Q_EMIT finished();
+}
+
+bool isCompressibleFile(const QString& filePath)
+{
+    const QMimeType mimeType = QMimeDatabase().mimeTypeForFile(filePath);
+    if (isCompressedMimeType(mimeType))
+        return false;
+
+    // The MIME type doesn't tell for every format, the content does
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    const QByteArray sample = file.read(GZIP_SAMPLE_SIZE);
+    if (sample.isEmpty())
+        return false;
+
+    const QByteArray compressedSample = gzipCompress(sample);
+    if (compressedSample.isEmpty())
+        return false;
+
+    const qreal ratio = (qreal)compressedSample.size() / (qreal)sample.size();
+    qDebug() << filePath << "of type" << mimeType.name() << "compresses to" << ratio;
+    return ratio < GZIP_MAX_RATIO;
+}
@@ -0,0 +1,68 @@
+#ifndef GZIPUTIL_H
+#define GZIPUTIL_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+#include <QString>
+
+// zlib's fastest level already gets most of the gain on text,
+// higher levels cost several times the CPU time for a few percent
+const int GZIP_DEFAULT_LEVEL = 1;
+
+// Bytes sampled to estimate how well a file compresses
+const qint64 GZIP_SAMPLE_SIZE = 64 * 1024;
+
+// Files are only compressed if the sample shrinks below this ratio
+const qreal GZIP_MAX_RATIO = 0.9;
+
+// Compresses data into a single gzip member
+QByteArray gzipCompress(const QByteArray& data, int level = GZIP_DEFAULT_LEVEL);
+
+// Streams source into target as gzip block by block,
+// so files don't have to fit into memory
+bool gzipCompress(QIODevice* source, QIODevice* target, int level = GZIP_DEFAULT_LEVEL);
+
+// Whether sending filePath gzip encoded is worth it: its MIME type mustn't
+// be compressed already (JPEG, MP4, ZIP based formats, ...) and a sample
+// of its content has to shrink noticeably
+bool isCompressibleFile(const QString& filePath);
+
+struct z_stream_s;
+
+// Streams source into target as gzip one block per event loop iteration,
+// so that compressing an upload doesn't stall the transfers running meanwhile.
+// Both devices have to be open and outlive the compressor.
+class GzipCompressor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GzipCompressor(QIODevice* source,
+                            QIODevice* target,
+                            int level = GZIP_DEFAULT_LEVEL,
+                            QObject* parent = Q_NULLPTR);
+    ~GzipCompressor();
+
+    void start();
+    bool isFinished() const { return this->m_finished; }
+
+    // Whether all of source ended up compressed in target
+    bool succeeded() const { return this->m_succeeded; }
+
+signals:
+    void finished();
+
+private:
+    void compressNextBlock();
+    void finish(bool success);
+
+    QIODevice* m_source = Q_NULLPTR;
+    QIODevice* m_target = Q_NULLPTR;
+    int m_level;
+    z_stream_s* m_stream = Q_NULLPTR;
+    bool m_finished = false;
+    bool m_succeeded = false;
+};
+
+#endif // GZIPUTIL_H
@@ -18,8 +18,12 @@ CloudStorageProvider* ProviderUtils::newStorageProviderByType(QObject* parent, A
     switch (settings->providerType()) {
     case AccountBase::Nextcloud:
     case AccountBase::WebDav:
-        provider = new WebDavCommandQueue(parent, settings);
+    {
+        WebDavCommandQueue* webDavQueue = new WebDavCommandQueue(parent, settings);
+        webDavQueue->setTransferLanes(TRANSFERLANES_DEFAULT_LANES);
+        provider = webDavQueue;
         break;
+    }
     default:
         qWarning() << "Unsupported providerType" << settings->providerType();
         break;
@@ -0,0 +1,62 @@
+#include "ratelimiteddevice.h"
+
+#include <QDebug>
+
+#include <util/transferratelimiter.h>
+
+RateLimitedDevice::RateLimitedDevice(QIODevice* source,
+                                     TransferRateLimiter* limiter,
+                                     QObject* parent) :
+    QIODevice(parent),
+    m_source(source),
+    m_limiter(limiter)
+{
+    if (this->m_limiter) {
+        QObject::connect(this->m_limiter, &TransferRateLimiter::tokensAvailable, this, [=]() {
+            if (isOpen() && !atEnd())
+                Q_EMIT readyRead();
+        });
+    }
+}
+
+bool RateLimitedDevice::open(OpenMode mode)
+{
+    if (mode != QIODevice::ReadOnly) {
+        qWarning() << "RateLimitedDevice is read-only";
+        return false;
+    }
+
+    if (!this->m_source || !this->m_source->isOpen() || !this->m_source->seek(0)) {
+        qWarning() << "Source of the rate limited device isn't readable";
+        return false;
+    }
+
+    // Buffering would read ahead of the granted amount
+    return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+qint64 RateLimitedDevice::size() const
+{
+    return this->m_source ? this->m_source->size() : 0;
+}
+
+bool RateLimitedDevice::seek(qint64 pos)
+{
+    return QIODevice::seek(pos) && this->m_source->seek(pos);
+}
+
+qint64 RateLimitedDevice::readData(char* data, qint64 maxSize)
+{
+    const qint64 granted = this->m_limiter ? this->m_limiter->take(maxSize) : maxSize;
+    if (granted <= 0)
+        return 0;
+
+    return this->m_source->read(data, granted);
+}
+
+qint64 RateLimitedDevice::writeData(const char* data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
@@ -0,0 +1,37 @@
+#ifndef RATELIMITEDDEVICE_H
+#define RATELIMITEDDEVICE_H
+
+#include <QIODevice>
+#include <QPointer>
+
+class TransferRateLimiter;
+
+// Read-only upload body passing on the data of an open source device
+// only as fast as the limiter grants it. Reads return nothing while the
+// bucket is empty; readyRead() follows once it has been refilled, which
+// is what QNetworkAccessManager waits for before asking again.
+// The source isn't owned and has to outlive the device.
+class RateLimitedDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit RateLimitedDevice(QIODevice* source,
+                               TransferRateLimiter* limiter,
+                               QObject* parent = Q_NULLPTR);
+
+    bool open(OpenMode mode) Q_DECL_OVERRIDE;
+    bool isSequential() const Q_DECL_OVERRIDE { return false; }
+    qint64 size() const Q_DECL_OVERRIDE;
+    bool seek(qint64 pos) Q_DECL_OVERRIDE;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 writeData(const char* data, qint64 maxSize) Q_DECL_OVERRIDE;
+
+private:
+    QIODevice* m_source;
+    QPointer<TransferRateLimiter> m_limiter;
+};
+
+#endif // RATELIMITEDDEVICE_H
@@ -0,0 +1,75 @@
+#include "transferratelimiter.h"
+
+#include <QDebug>
+
+TransferRateLimiter::TransferRateLimiter(QObject* parent) : QObject(parent)
+{
+    this->m_refillTimer.setSingleShot(true);
+    this->m_refillTimer.setInterval(TRANSFERRATE_REFILL_MSECS);
+    QObject::connect(&this->m_refillTimer, &QTimer::timeout,
+                     this, &TransferRateLimiter::tokensAvailable);
+}
+
+qint64 TransferRateLimiter::rate() const
+{
+    return this->m_rate;
+}
+
+void TransferRateLimiter::setRate(qint64 bytesPerSecond)
+{
+    bytesPerSecond = qMax(Q_INT64_C(0), bytesPerSecond);
+    if (this->m_rate == bytesPerSecond)
+        return;
+
+    qInfo() << "Transfer rate limit set to" << bytesPerSecond << "bytes per second";
+
+    refill();
+    this->m_rate = bytesPerSecond;
+    this->m_tokens = qMin(this->m_tokens, this->m_rate * TRANSFERRATE_BURST_MSECS / 1000);
+
+    // Whoever waits for the previous rate continues right away
+    this->m_refillTimer.stop();
+    Q_EMIT tokensAvailable();
+}
+
+bool TransferRateLimiter::isLimited() const
+{
+    return this->m_rate > 0;
+}
+
+qint64 TransferRateLimiter::take(qint64 wanted)
+{
+    if (!isLimited() || wanted <= 0)
+        return qMax(Q_INT64_C(0), wanted);
+
+    refill();
+
+    const qint64 granted = qMin(qMin(wanted, this->m_tokens), TRANSFERRATE_MAX_GRANT);
+    this->m_tokens -= granted;
+
+    if (granted < wanted && !this->m_refillTimer.isActive())
+        this->m_refillTimer.start();
+
+    return granted;
+}
+
+void TransferRateLimiter::refill()
+{
+    if (!this->m_clock.isValid()) {
+        this->m_clock.start();
+        return;
+    }
+
+    // Capped at a second, which is more than a full bucket anyway
+    const qint64 elapsed = qMin(this->m_clock.nsecsElapsed(), Q_INT64_C(1000000000));
+    const qint64 added = this->m_rate * elapsed / Q_INT64_C(1000000000);
+
+    // Frequent calls would otherwise round every refill down to nothing
+    if (added == 0 && this->m_rate > 0)
+        return;
+    this->m_clock.restart();
+
+    const qint64 burst = qMax(this->m_rate * TRANSFERRATE_BURST_MSECS / 1000,
+                              qMin(this->m_rate, TRANSFERRATE_MAX_GRANT));
+    this->m_tokens = qMin(burst, this->m_tokens + added);
+}
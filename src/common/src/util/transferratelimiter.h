@@ -0,0 +1,50 @@
+#ifndef TRANSFERRATELIMITER_H
+#define TRANSFERRATELIMITER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+
+// Tokens the bucket holds at most, in milliseconds worth of the rate.
+// Bounds the burst after an idle period.
+const int TRANSFERRATE_BURST_MSECS = 250;
+
+// Largest amount granted at once, so that concurrent transfers
+// waiting on the same bucket take turns instead of one draining it
+const qint64 TRANSFERRATE_MAX_GRANT = 16 * 1024;
+
+// Interval at which waiting transfers are woken up again
+const int TRANSFERRATE_REFILL_MSECS = 50;
+
+// Token bucket shared by all transfers of one direction.
+// Transfers take() tokens before passing on data and wait for
+// tokensAvailable() whenever they were granted less than they asked for.
+// A rate of 0 disables the limit. The rate can be changed at any time,
+// running transfers continue at the new one.
+class TransferRateLimiter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TransferRateLimiter(QObject* parent = Q_NULLPTR);
+
+    qint64 rate() const;
+    void setRate(qint64 bytesPerSecond);
+    bool isLimited() const;
+
+    // Returns how many of the wanted bytes may be transferred right now
+    qint64 take(qint64 wanted);
+
+signals:
+    void tokensAvailable();
+
+private:
+    void refill();
+
+    qint64 m_rate = 0;
+    qint64 m_tokens = 0;
+    QElapsedTimer m_clock;
+    QTimer m_refillTimer;
+};
+
+#endif // TRANSFERRATELIMITER_H
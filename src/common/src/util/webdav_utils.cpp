@@ -1,27 +1,27 @@
 #include "webdav_utils.h"
 #include <nextcloudendpointconsts.h>
 
-QWebdav* getNewWebDav(AccountBase *settings, QObject* parent)
+QWebdav* getNewWebDav(AccountBase *settings, QObject* parent, const QString& nextcloudEndpoint)
 {
     // Allocating QWebdav object without settings doesn't make sense.
     if (!settings)
         return Q_NULLPTR;
 
     QWebdav* newWebdav = new QWebdav(parent);
-    applySettingsToWebdav(settings, newWebdav);
+    applySettingsToWebdav(settings, newWebdav, nextcloudEndpoint);
     qDebug() << "Returning webdav for host" << settings->hostname();
 
     return newWebdav;
 }
 
-void applySettingsToWebdav(AccountBase *settings, QWebdav *webdav)
+void applySettingsToWebdav(AccountBase *settings, QWebdav *webdav, const QString& nextcloudEndpoint)
 {
     if (!settings || !webdav)
         return;
 
     const QString apiPath =
             (settings->providerType() == AccountBase::Nextcloud) ?
-                NEXTCLOUD_ENDPOINT_WEBDAV :
+                nextcloudEndpoint :
                 QStringLiteral("");
 
     webdav->setConnectionSettings(settings->isHttps() ? QWebdav::HTTPS : QWebdav::HTTP,
@@ -34,6 +34,19 @@ void applySettingsToWebdav(AccountBase *settings, QWebdav *webdav)
                                   settings->isHttps() ? settings->sha1Hex() : "");
 }
 
+QUrl webdavUrl(QWebdav* webdav, const QString& path)
+{
+    QUrl url;
+    if (!webdav)
+        return url;
+
+    url.setScheme(webdav->isSSL() ? QStringLiteral("https") : QStringLiteral("http"));
+    url.setHost(webdav->hostname());
+    url.setPort(webdav->port());
+    url.setPath(webdav->rootPath() + path);
+    return url;
+}
+
 QMap<QByteArray, QByteArray> prepareOcsHeaders(
          AccountBase* settings, QMap<QByteArray, QByteArray> headers)
 {
@@ -7,12 +7,19 @@
 
 #include <qwebdav.h>
 #include <settings/nextcloudsettingsbase.h>
+#include <nextcloudendpointconsts.h>
 
+// nextcloudEndpoint is only used for Nextcloud accounts
 QWebdav* getNewWebDav(AccountBase *settings,
-                      QObject* parent = Q_NULLPTR);
+                      QObject* parent = Q_NULLPTR,
+                      const QString& nextcloudEndpoint = NEXTCLOUD_ENDPOINT_WEBDAV);
 
 void applySettingsToWebdav(AccountBase *settings,
-                           QWebdav *webdav);
+                           QWebdav *webdav,
+                           const QString& nextcloudEndpoint = NEXTCLOUD_ENDPOINT_WEBDAV);
+
+// URL of path below the root of webdav, for requests QWebdav can't build itself
+QUrl webdavUrl(QWebdav* webdav, const QString& path);
 
 QMap<QByteArray, QByteArray> prepareOcsHeaders(
         AccountBase* settings = Q_NULLPTR,
@@ -6,15 +6,23 @@ QT = dbus network xml
 SOURCES += \
     $$PWD/main.cpp \
     $$PWD/filesystem.cpp \
+    $$PWD/inotifywatcher.cpp \
+    $$PWD/debouncescheduler.cpp \
+    $$PWD/filesnapshottracker.cpp \
     $$PWD/networkmonitor.cpp \
     $$PWD/dbushandler.cpp \
-    $$PWD/uploader.cpp
+    $$PWD/uploader.cpp \
+    $$PWD/uploadscheduler.cpp
 
 HEADERS += \
     $$PWD/filesystem.h \
+    $$PWD/inotifywatcher.h \
+    $$PWD/debouncescheduler.h \
+    $$PWD/filesnapshottracker.h \
     $$PWD/networkmonitor.h \
     $$PWD/dbushandler.h \
-    $$PWD/uploader.h
+    $$PWD/uploader.h \
+    $$PWD/uploadscheduler.h
 
 OTHER_FILES += harbour-owncloud-daemon.service
 
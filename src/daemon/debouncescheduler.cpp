@@ -0,0 +1,118 @@
+#include "debouncescheduler.h"
+
+#include <algorithm>
+#include <functional>
+
+DebounceScheduler::DebounceScheduler(QObject* parent, int quietPeriod, int maxLatency) :
+    QObject(parent),
+    m_quietPeriod(quietPeriod),
+    m_maxLatency(maxLatency)
+{
+    this->m_clock.start();
+    this->m_timer.setSingleShot(true);
+    QObject::connect(&this->m_timer, &QTimer::timeout, this, &DebounceScheduler::expire);
+}
+
+void DebounceScheduler::setQuietPeriod(int msecs)
+{
+    this->m_quietPeriod = msecs;
+}
+
+int DebounceScheduler::quietPeriod() const
+{
+    return this->m_quietPeriod;
+}
+
+void DebounceScheduler::setMaxLatency(int msecs)
+{
+    this->m_maxLatency = msecs;
+}
+
+int DebounceScheduler::maxLatency() const
+{
+    return this->m_maxLatency;
+}
+
+void DebounceScheduler::schedule(const QString& key)
+{
+    const qint64 now = this->m_clock.elapsed();
+
+    Deadlines deadlines;
+    if (this->m_deadlines.contains(key)) {
+        deadlines = this->m_deadlines.value(key);
+    } else {
+        deadlines.latest = now + qMax(this->m_maxLatency, this->m_quietPeriod);
+    }
+
+    // Capped, a stream of writes mustn't postpone the key forever
+    const qint64 due = qMin(now + this->m_quietPeriod, deadlines.latest);
+    if (this->m_deadlines.contains(key) && due == deadlines.due)
+        return;
+
+    deadlines.due = due;
+    this->m_deadlines.insert(key, deadlines);
+    this->m_heap.append(qMakePair(due, key));
+    std::push_heap(this->m_heap.begin(), this->m_heap.end(),
+                   std::greater<QPair<qint64, QString> >());
+    arm();
+}
+
+bool DebounceScheduler::isScheduled(const QString& key) const
+{
+    return this->m_deadlines.contains(key);
+}
+
+int DebounceScheduler::count() const
+{
+    return this->m_deadlines.count();
+}
+
+void DebounceScheduler::clear()
+{
+    this->m_timer.stop();
+    this->m_deadlines.clear();
+    this->m_heap.clear();
+}
+
+QPair<qint64, QString> DebounceScheduler::popHeap()
+{
+    std::pop_heap(this->m_heap.begin(), this->m_heap.end(),
+                  std::greater<QPair<qint64, QString> >());
+    return this->m_heap.takeLast();
+}
+
+bool DebounceScheduler::isStale(const QPair<qint64, QString>& entry) const
+{
+    return !this->m_deadlines.contains(entry.second) ||
+            this->m_deadlines.value(entry.second).due != entry.first;
+}
+
+void DebounceScheduler::expire()
+{
+    while (!this->m_heap.isEmpty() && this->m_heap.first().first <= this->m_clock.elapsed()) {
+        const QPair<qint64, QString> entry = popHeap();
+        if (isStale(entry))
+            continue;
+
+        // Removed first, the key may be scheduled again right away
+        this->m_deadlines.remove(entry.second);
+        Q_EMIT expired(entry.second);
+    }
+
+    arm();
+}
+
+void DebounceScheduler::arm()
+{
+    // Entries left behind by a reschedule would only cause needless wakeups
+    while (!this->m_heap.isEmpty() && isStale(this->m_heap.first()))
+        popHeap();
+
+    if (this->m_heap.isEmpty()) {
+        this->m_timer.stop();
+        return;
+    }
+
+    const qint64 remaining = this->m_heap.first().first - this->m_clock.elapsed();
+    this->m_timer.start(static_cast<int>(qMax<qint64>(0, remaining)));
+}
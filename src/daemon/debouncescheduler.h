@@ -0,0 +1,60 @@
+#ifndef DEBOUNCESCHEDULER_H
+#define DEBOUNCESCHEDULER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+#include <QTimer>
+#include <QVector>
+
+const int DEBOUNCE_DEFAULT_QUIET_PERIOD = 3000;
+const int DEBOUNCE_DEFAULT_MAX_LATENCY = 30000;
+
+// Reports a key once it hasn't been scheduled again for the quiet period,
+// but no later than the maximum latency after it has first been scheduled.
+// All keys share a single timer armed for the earliest deadline. Deadlines
+// live in a min-heap; rescheduling pushes a new entry and leaves the old
+// one behind, it is dropped once it reaches the top.
+class DebounceScheduler : public QObject
+{
+    Q_OBJECT
+
+    struct Deadlines {
+        qint64 due = 0;
+        qint64 latest = 0;
+    };
+
+public:
+    explicit DebounceScheduler(QObject* parent = Q_NULLPTR,
+                               int quietPeriod = DEBOUNCE_DEFAULT_QUIET_PERIOD,
+                               int maxLatency = DEBOUNCE_DEFAULT_MAX_LATENCY);
+
+    void setQuietPeriod(int msecs);
+    int quietPeriod() const;
+    void setMaxLatency(int msecs);
+    int maxLatency() const;
+
+    void schedule(const QString& key);
+    bool isScheduled(const QString& key) const;
+    int count() const;
+    void clear();
+
+signals:
+    void expired(QString key);
+
+private:
+    void expire();
+    void arm();
+    QPair<qint64, QString> popHeap();
+    bool isStale(const QPair<qint64, QString>& entry) const;
+
+    int m_quietPeriod;
+    int m_maxLatency;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    QHash<QString, Deadlines> m_deadlines;
+    QVector<QPair<qint64, QString> > m_heap;
+};
+
+#endif // DEBOUNCESCHEDULER_H
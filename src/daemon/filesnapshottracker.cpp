@@ -0,0 +1,116 @@
+#include "filesnapshottracker.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <settings/db/syncdb.h>
+
+FileSnapshotTracker::FileSnapshotTracker(QObject* parent, SyncDb* syncDb) :
+    QObject(parent),
+    m_syncDb(syncDb)
+{
+}
+
+void FileSnapshotTracker::locationScanned(QString locationDir, QString locationName, FileSnapshot files)
+{
+    QElapsedTimer timer;
+    timer.start();
+    FileSnapshot& stored = storedSnapshot(locationDir);
+    const qint64 loadTime = timer.elapsed();
+
+    // Only what differs from the last successful sync has to be reported
+    FileSnapshot changed;
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        if (!stored.contains(it.key()) || stored.value(it.key()) != it.value())
+            changed.insert(it.key(), it.value());
+    }
+
+    // Forgetting files early only means they are reported again should they come back
+    QStringList removedPaths;
+    for (auto it = stored.constBegin(); it != stored.constEnd(); ++it) {
+        if (!files.contains(it.key()))
+            removedPaths.append(it.key());
+    }
+    for (const QString& removedPath : removedPaths) {
+        stored.remove(removedPath);
+    }
+    if (this->m_syncDb)
+        this->m_syncDb->storeFileSnapshot(locationDir, FileSnapshot(), removedPaths);
+
+    qInfo() << locationDir << ":" << changed.count() << "changed,"
+            << removedPaths.count() << "removed, snapshot loaded in" << loadTime << "ms";
+
+    // Reporting may start a sync right away, which takes over the pending changes
+    this->m_pendingChanges.insert(locationDir, changed);
+    for (auto it = changed.constBegin(); it != changed.constEnd(); ++it) {
+        Q_EMIT fileChanged(locationDir, locationName, locationDir + QStringLiteral("/") + it.key());
+    }
+}
+
+void FileSnapshotTracker::fileFound(QString locationDir, QString locationName, QString filePath)
+{
+    FileSnapshotEntry entry;
+    if (readFileSnapshotEntry(filePath, &entry))
+        this->m_pendingChanges[locationDir].insert(filePath.mid(locationDir.length() + 1), entry);
+
+    Q_EMIT fileChanged(locationDir, locationName, filePath);
+}
+
+FileSnapshot& FileSnapshotTracker::storedSnapshot(const QString& locationDir)
+{
+    if (!this->m_snapshots.contains(locationDir)) {
+        this->m_snapshots.insert(locationDir, this->m_syncDb ?
+                                     this->m_syncDb->loadFileSnapshot(locationDir) :
+                                     FileSnapshot());
+    }
+    return this->m_snapshots[locationDir];
+}
+
+void FileSnapshotTracker::syncStarted(QString locationDir)
+{
+    const FileSnapshot pending = this->m_pendingChanges.take(locationDir);
+    FileSnapshot& syncing = this->m_syncingChanges[locationDir];
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        syncing.insert(it.key(), it.value());
+    }
+}
+
+void FileSnapshotTracker::syncFinished(QString locationDir, bool success)
+{
+    const FileSnapshot syncing = this->m_syncingChanges.take(locationDir);
+
+    // Left for the next sync, unless the files have changed once more in the meantime
+    if (!success) {
+        FileSnapshot& pending = this->m_pendingChanges[locationDir];
+        for (auto it = syncing.constBegin(); it != syncing.constEnd(); ++it) {
+            if (!pending.contains(it.key()))
+                pending.insert(it.key(), it.value());
+        }
+        return;
+    }
+
+    if (syncing.isEmpty())
+        return;
+
+    FileSnapshot& stored = storedSnapshot(locationDir);
+    for (auto it = syncing.constBegin(); it != syncing.constEnd(); ++it) {
+        stored.insert(it.key(), it.value());
+    }
+    if (this->m_syncDb)
+        this->m_syncDb->storeFileSnapshot(locationDir, syncing);
+}
+
+void FileSnapshotTracker::fileSynced(QString locationDir, QString filePath)
+{
+    const QString relativePath = filePath.mid(locationDir.length() + 1);
+    if (!this->m_pendingChanges.contains(locationDir) ||
+            !this->m_pendingChanges[locationDir].contains(relativePath))
+        return;
+
+    FileSnapshot synced;
+    synced.insert(relativePath, this->m_pendingChanges[locationDir].take(relativePath));
+    storedSnapshot(locationDir).insert(relativePath, synced.value(relativePath));
+    if (this->m_syncDb)
+        this->m_syncDb->storeFileSnapshot(locationDir, synced);
+}
@@ -0,0 +1,46 @@
+#ifndef FILESNAPSHOTTRACKER_H
+#define FILESNAPSHOTTRACKER_H
+
+#include <QObject>
+#include <QHash>
+#include <util/filesnapshot.h>
+
+class SyncDb;
+
+// Tells which files of the shared watcher's locations changed since one
+// account last synced them. Changes are committed to the account's snapshot
+// once a sync covering them succeeded, so files unchanged since then
+// aren't reported again on rescans or across daemon restarts.
+class FileSnapshotTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileSnapshotTracker(QObject* parent = Q_NULLPTR,
+                                 SyncDb* syncDb = Q_NULLPTR);
+
+signals:
+    void fileChanged(QString locationDir, QString locationName, QString filePath);
+
+public slots:
+    void locationScanned(QString locationDir, QString locationName, FileSnapshot files);
+    void fileFound(QString locationDir, QString locationName, QString filePath);
+
+    // The sync of locationDir picks up the changes reported until now
+    void syncStarted(QString locationDir);
+    void syncFinished(QString locationDir, bool success);
+    // filePath has been uploaded on its own
+    void fileSynced(QString locationDir, QString filePath);
+
+private:
+    FileSnapshot& storedSnapshot(const QString& locationDir);
+
+    SyncDb* m_syncDb = Q_NULLPTR;
+    // Snapshots as of the last successful sync, loaded once per location
+    QHash<QString, FileSnapshot> m_snapshots;
+    // Changes reported since, committed once a sync covering them succeeded
+    QHash<QString, FileSnapshot> m_pendingChanges;
+    QHash<QString, FileSnapshot> m_syncingChanges;
+};
+
+#endif // FILESNAPSHOTTRACKER_H
@@ -2,26 +2,32 @@
 
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
-#include <QMutexLocker>
 #include <QStandardPaths>
 #include <QStorageInfo>
 #include <QSet>
 
-Filesystem::Filesystem(AccountBase* account) :
-    m_account(account)
+Filesystem::Filesystem(QObject* parent) :
+    QObject(parent),
+    m_scanDelays(Q_NULLPTR, FILESYSTEM_SCAN_QUIET_PERIOD, FILESYSTEM_SCAN_MAX_LATENCY)
 {
-    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &Filesystem::prepareScan);
+    connect(&m_scanDelays, &DebounceScheduler::expired, this, &Filesystem::scanPath);
+
+    // Files are reported once written, directories are scanned for what came along
+    connect(&m_watcher, &InotifyWatcher::fileWritten, this, &Filesystem::prepareScan);
+    connect(&m_watcher, &InotifyWatcher::directoryCreated, this, &Filesystem::prepareScan);
+    connect(&m_watcher, &InotifyWatcher::directoryRemoved, this, &Filesystem::forgetDirectory);
+    connect(&m_watcher, &InotifyWatcher::overflowed, this, &Filesystem::rescanWatched);
+
+    m_pollTimer.setInterval(FILESYSTEM_POLL_INTERVAL);
+    connect(&m_pollTimer, &QTimer::timeout, this, &Filesystem::pollUnwatched);
 }
 
-void Filesystem::prepareScan(QString dirPath)
+void Filesystem::prepareScan(QString path)
 {
-    qDebug() << dirPath;
-    if (isDelayActive(dirPath)) {
-        resetDelay(dirPath);
-    } else {
-        insertDelay(dirPath);
-    }
+    qDebug() << path;
+    m_scanDelays.schedule(path);
 }
 
 void Filesystem::scan(WatchedLocation location, QString dirPath, bool recursive)
@@ -32,11 +38,7 @@ void Filesystem::scan(WatchedLocation location, QString dirPath, bool recursive)
     qDebug() << "scanning" << dirPath;
 
     QDir dir(dirPath);
-
-    if (!m_watcher.directories().contains(dirPath)) {
-        m_watcher.addPath(dirPath);
-        m_watcherLocations[dirPath]=location;
-    }
+    watchDirectory(location, dirPath);
 
     const QFileInfoList entries = dir.entryInfoList(QDir::Dirs |
                                                     QDir::Files |
@@ -45,26 +47,136 @@ void Filesystem::scan(WatchedLocation location, QString dirPath, bool recursive)
 
     for (const QFileInfo &entry : entries) {
         QString path = entry.absoluteFilePath();
-        if (entry.isDir() && recursive) {
-            scan(location, path, recursive);
+        if (entry.isDir()) {
+            // Directories which are new to a targeted scan are taken in as a whole
+            if (recursive || !m_watcherLocations.contains(path))
+                scan(location, path, true);
             continue;
         }
 
-        if (m_existingFiles.contains(path)) {
-            qDebug() << "existing found" << path;
+        reportFile(location, path);
+    }
+}
+
+void Filesystem::watchDirectory(const WatchedLocation& location, const QString& dirPath)
+{
+    if (m_watcherLocations.contains(dirPath))
+        return;
+
+    m_watcherLocations[dirPath] = location;
+    if (m_watcher.addDirectory(dirPath))
+        return;
+
+    // Out of inotify watches, the directory is looked at periodically instead
+    m_unwatchedDirs.insert(dirPath);
+    if (!m_pollTimer.isActive())
+        m_pollTimer.start();
+}
+
+void Filesystem::scanPath(const QString& path)
+{
+    if (this->m_inhibit)
+        return;
+
+    if (m_watcherLocations.contains(path)) {
+        scan(m_watcherLocations[path], path);
+        return;
+    }
+
+    const QFileInfo info(path);
+    const QString parentDir = info.absolutePath();
+    if (!m_watcherLocations.contains(parentDir)) {
+        qWarning() << "Can't found location for path" << path;
+        return;
+    }
+
+    const WatchedLocation location = m_watcherLocations[parentDir];
+    if (info.isDir()) {
+        scan(location, path, true);
+    } else if (info.isFile()) {
+        reportFile(location, path);
+    }
+}
+
+void Filesystem::reportFile(const WatchedLocation& location, const QString& filePath)
+{
+    if (m_existingFiles.contains(filePath)) {
+        qDebug() << "existing found" << filePath;
+        return;
+    }
+
+    qDebug() << "New file: " << filePath;
+    m_existingFiles.insert(filePath);
+    emit fileFound(location.localDir, location.name, filePath);
+}
+
+void Filesystem::rescanLocation(const WatchedLocation& location)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    FileSnapshot files;
+    QStringList directories;
+    if (!walkFileSnapshot(location.localDir, &files, &directories))
+        return;
+
+    for (const QString& dirPath : directories) {
+        watchDirectory(location, dirPath);
+    }
+
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        m_existingFiles.insert(location.localDir + QStringLiteral("/") + it.key());
+    }
+
+    qInfo() << "Walked" << location.localDir << "in" << timer.elapsed() << "ms:"
+            << files.count() << "files in" << directories.count() << "directories";
+
+    // Every account tells on its own which of them changed since its last sync
+    emit locationScanned(location.localDir, location.name, files);
+}
+
+void Filesystem::forgetDirectory(QString dirPath)
+{
+    qDebug() << "no longer watching" << dirPath;
+    m_watcherLocations.remove(dirPath);
+    m_unwatchedDirs.remove(dirPath);
+}
+
+void Filesystem::rescanWatched()
+{
+    // Events have been lost, only the known directories need another look
+    for (const QString& dirPath : m_watcherLocations.keys()) {
+        if (!m_watcherLocations.contains(dirPath))
+            continue;
+
+        if (!QFileInfo(dirPath).isDir()) {
+            m_watcher.removeDirectory(dirPath);
+            forgetDirectory(dirPath);
             continue;
-        } else if (!m_existingFiles.contains(path) && !entry.isDir()) {
-            qDebug() << "New file: " << path;
         }
+        scan(m_watcherLocations[dirPath], dirPath);
+    }
+}
 
-        if(!entry.isDir()) {
-            emit fileFound(location.localDir, location.name, path);
-            m_existingFiles.insert(path);
-        } else if (entry.isDir() && !m_watcher.directories().contains(path)){
-            m_watcher.addPath(path);
-            m_watcherLocations[dirPath]=location;
+void Filesystem::pollUnwatched()
+{
+    for (const QString& dirPath : m_unwatchedDirs.values()) {
+        if (!m_unwatchedDirs.contains(dirPath))
+            continue;
+
+        if (!QFileInfo(dirPath).isDir()) {
+            forgetDirectory(dirPath);
+            continue;
         }
+
+        // Watches might have been released in the meantime
+        if (m_watcher.addDirectory(dirPath))
+            m_unwatchedDirs.remove(dirPath);
+        scan(m_watcherLocations[dirPath], dirPath);
     }
+
+    if (m_unwatchedDirs.isEmpty())
+        m_pollTimer.stop();
 }
 
 void Filesystem::rescan()
@@ -102,7 +214,10 @@ void Filesystem::rescan()
         }
 
         emit locationFound(location.localDir, location.name);
-        scan(location, dirInfo.absoluteFilePath(), true);
+        if (this->m_inhibit)
+            continue;
+
+        rescanLocation(location);
     }
 }
 
@@ -115,73 +230,12 @@ void Filesystem::triggerRescan()
 {
     qDebug() << Q_FUNC_INFO;
 
-    if (!this->m_account)
-        return;
-
-    if (!m_watcher.directories().isEmpty()) {
-        m_watcherLocations.clear();
-        m_watcher.removePaths(m_watcher.directories());
-    }
+    m_watcher.clear();
+    m_watcherLocations.clear();
+    m_unwatchedDirs.clear();
+    m_pollTimer.stop();
     m_existingFiles.clear();
-    clearDelays();
+    m_scanDelays.clear();
 
     rescan();
 }
-
-void Filesystem::resetDelay(QString path)
-{
-    QMutexLocker locker(&this->m_delayLock);
-    for (int i = 0; i < m_delayers.count(); i++) {
-        if(m_delayers.at(i).path == path) {
-            m_delayers.at(i).timer->stop();
-            m_delayers.at(i).timer->start();
-            return;
-        }
-    }
-}
-
-void Filesystem::insertDelay(QString path)
-{
-    WatchDelay delay;
-    delay.path = path;
-    delay.timer = new QTimer(this);
-    delay.timer->setInterval(3000);
-    delay.timer->setSingleShot(true);
-    connect(delay.timer, &QTimer::timeout, [this, path]() {
-        for(int i = 0; i < m_delayers.count(); i++) {
-            if(m_delayers.at(i).path == path)
-                m_delayers.removeAt(i);
-        }
-        if (m_watcherLocations.contains(path)) {
-            scan(m_watcherLocations[path], path);
-        }else{
-            qWarning() << "Can't found location for path" << path;
-        }
-    });
-    delay.timer->start();
-    connect(delay.timer, &QTimer::timeout, delay.timer, &QObject::deleteLater);
-    m_delayers.append(delay);
-}
-
-bool Filesystem::isDelayActive(QString path)
-{
-    QMutexLocker locker(&this->m_delayLock);
-
-    for(int i = 0; i < m_delayers.count(); i++) {
-        if(m_delayers.at(i).path == path) {
-            return true;
-        }
-    }
-    return false;
-}
-
-void Filesystem::clearDelays()
-{
-    QMutexLocker locker(&this->m_delayLock);
-
-    for(int i = 0; i < m_delayers.count(); i++) {
-        m_delayers.at(i).timer->stop();
-        m_delayers.at(i).timer->deleteLater();
-    }
-    m_delayers.clear();
-}
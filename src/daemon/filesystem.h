@@ -2,33 +2,38 @@
 #define FILESYSTEM_H
 
 #include <QObject>
-#include <QFileSystemWatcher>
-#include <QMutex>
 #include <QSet>
 #include <QMap>
 #include <QTimer>
-#include <settings/nextcloudsettingsbase.h>
+#include <util/filesnapshot.h>
+#include "inotifywatcher.h"
+#include "debouncescheduler.h"
+
+// Interval at which directories without an inotify watch are looked at
+const int FILESYSTEM_POLL_INTERVAL = 60 * 1000;
+
+// Paths are scanned once quiet for this long, or at the latest after the cap
+const int FILESYSTEM_SCAN_QUIET_PERIOD = 3000;
+const int FILESYSTEM_SCAN_MAX_LATENCY = 30 * 1000;
 
 class Filesystem : public QObject
 {
     Q_OBJECT
 
-    struct WatchDelay {
-        QString path;
-        QTimer *timer = Q_NULLPTR;
-    };
-
     struct WatchedLocation {
         QString localDir;
         QString name;
     };
 
 public:
-    Filesystem(AccountBase* account = Q_NULLPTR);
+    explicit Filesystem(QObject* parent = Q_NULLPTR);
 
 signals:
+    // A file which has been written while watching
     void fileFound(QString locationDir, QString locationName, QString fullPath);
     void locationFound(QString locationDir, QString locationName);
+    // Every file of the location as of a rescan, keyed by relative path
+    void locationScanned(QString locationDir, QString locationName, FileSnapshot files);
 
 public slots:
     void inhibitScan(bool inhibit);
@@ -36,29 +41,32 @@ public slots:
 
 private slots:
     void scan(WatchedLocation location, QString dirPath, bool recursive = false);
-    void prepareScan(QString dirPath);
+    void prepareScan(QString path);
+    void forgetDirectory(QString dirPath);
+    void rescanWatched();
+    void pollUnwatched();
 
 private:
     void rescan();
+    void watchDirectory(const WatchedLocation& location, const QString& dirPath);
+    void scanPath(const QString& path);
+    void reportFile(const WatchedLocation& location, const QString& filePath);
+    void rescanLocation(const WatchedLocation& location);
 
-    AccountBase* m_account;
-    QFileSystemWatcher m_watcher;
+    InotifyWatcher m_watcher;
+    // Every known directory, also those which couldn't be watched
     QMap<QString, WatchedLocation> m_watcherLocations;
+    QSet<QString> m_unwatchedDirs;
+    QTimer m_pollTimer;
     QSet<QString> m_existingFiles;
     bool m_inhibit = false;
 
     /* Camera creates temporary files before writing out content.
      * This condition can be triggered by having ~/Pictures be a
      * symlink to the SD card, as the SD card write speed is slower.
-     * Delay scan of respective paths with a timer. This also improves
-     * situations where a user shoots multiple pics repeatedly.*/
-    QList<WatchDelay> m_delayers;
-    QMutex m_delayLock;
-
-    bool isDelayActive(QString path);
-    void resetDelay(QString path);
-    void insertDelay(QString path);
-    void clearDelays();
+     * Delay scan of respective paths until they are quiet. This also
+     * improves situations where a user shoots multiple pics repeatedly.*/
+    DebounceScheduler m_scanDelays;
 };
 
 #endif//FILESYSTEM_H
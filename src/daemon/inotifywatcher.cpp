@@ -0,0 +1,149 @@
+#include "inotifywatcher.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Files are reported once complete, directories as soon as they appear
+const uint32_t INOTIFYWATCHER_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+        IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+InotifyWatcher::InotifyWatcher(QObject* parent) : QObject(parent)
+{
+    this->m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->m_fd < 0) {
+        qWarning() << "Failed to initialize inotify:" << strerror(errno);
+        return;
+    }
+
+    this->m_notifier = new QSocketNotifier(this->m_fd, QSocketNotifier::Read, this);
+    QObject::connect(this->m_notifier, &QSocketNotifier::activated,
+                     this, &InotifyWatcher::readEvents);
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+    if (this->m_fd >= 0)
+        close(this->m_fd);
+}
+
+bool InotifyWatcher::isValid() const
+{
+    return this->m_fd >= 0;
+}
+
+bool InotifyWatcher::addDirectory(const QString& dirPath)
+{
+    if (!isValid())
+        return false;
+
+    if (this->m_descriptors.contains(dirPath))
+        return true;
+
+    const int descriptor = inotify_add_watch(this->m_fd, QFile::encodeName(dirPath).constData(),
+                                             INOTIFYWATCHER_EVENTS);
+    if (descriptor < 0) {
+        if (errno == ENOSPC) {
+            qWarning() << "Out of inotify watches, not watching" << dirPath;
+        } else {
+            qWarning() << "Failed to watch" << dirPath << ":" << strerror(errno);
+        }
+        return false;
+    }
+
+    // The same directory through another path, e.g. a symlink, is watched already
+    if (this->m_paths.contains(descriptor))
+        return true;
+
+    this->m_paths.insert(descriptor, dirPath);
+    this->m_descriptors.insert(dirPath, descriptor);
+    return true;
+}
+
+void InotifyWatcher::removeDirectory(const QString& dirPath)
+{
+    if (!this->m_descriptors.contains(dirPath))
+        return;
+
+    const int descriptor = this->m_descriptors.value(dirPath);
+    forgetDescriptor(descriptor);
+    inotify_rm_watch(this->m_fd, descriptor);
+}
+
+bool InotifyWatcher::isWatching(const QString& dirPath) const
+{
+    return this->m_descriptors.contains(dirPath);
+}
+
+void InotifyWatcher::clear()
+{
+    for (const int descriptor : this->m_paths.keys()) {
+        inotify_rm_watch(this->m_fd, descriptor);
+    }
+    this->m_paths.clear();
+    this->m_descriptors.clear();
+}
+
+void InotifyWatcher::forgetDescriptor(int descriptor)
+{
+    this->m_descriptors.remove(this->m_paths.take(descriptor));
+}
+
+void InotifyWatcher::readEvents()
+{
+    alignas(struct inotify_event) char buffer[INOTIFYWATCHER_BUFFER_SIZE];
+    bool overflow = false;
+
+    for (;;) {
+        const ssize_t length = read(this->m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && errno != EAGAIN && errno != EINTR)
+                qWarning() << "Failed to read inotify events:" << strerror(errno);
+            break;
+        }
+
+        const struct inotify_event* event = Q_NULLPTR;
+        for (char* position = buffer; position < buffer + length;
+             position += sizeof(struct inotify_event) + event->len) {
+            event = reinterpret_cast<const struct inotify_event*>(position);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+
+            // Events of watches removed in the meantime
+            if (!this->m_paths.contains(event->wd))
+                continue;
+            const QString dirPath = this->m_paths.value(event->wd);
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                forgetDescriptor(event->wd);
+                if (event->mask & IN_MOVE_SELF)
+                    inotify_rm_watch(this->m_fd, event->wd);
+                Q_EMIT directoryRemoved(dirPath);
+                continue;
+            }
+
+            if (event->len == 0)
+                continue;
+
+            const QString path = dirPath + QStringLiteral("/") + QFile::decodeName(event->name);
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    Q_EMIT directoryCreated(path);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                Q_EMIT fileWritten(path);
+            }
+        }
+    }
+
+    if (overflow) {
+        qWarning() << "inotify event queue overflowed";
+        Q_EMIT overflowed();
+    }
+}
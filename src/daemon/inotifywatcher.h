@@ -0,0 +1,50 @@
+#ifndef INOTIFYWATCHER_H
+#define INOTIFYWATCHER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSocketNotifier>
+
+// Size of the buffer events are read into, holds a few hundred events
+const int INOTIFYWATCHER_BUFFER_SIZE = 64 * 1024;
+
+// Watches directories (not recursively) through inotify and reports
+// the files in them which have been written and closed or moved in,
+// rather than only that something in the directory changed.
+// Watches are kept per directory and looked up by watch descriptor.
+// addDirectory() fails once the user's inotify watches are used up,
+// overflowed() tells that events have been lost; callers have to
+// look at the affected directories themselves in either case.
+class InotifyWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InotifyWatcher(QObject* parent = Q_NULLPTR);
+    ~InotifyWatcher();
+
+    bool isValid() const;
+
+    bool addDirectory(const QString& dirPath);
+    void removeDirectory(const QString& dirPath);
+    bool isWatching(const QString& dirPath) const;
+    void clear();
+
+signals:
+    void fileWritten(QString filePath);
+    void directoryCreated(QString dirPath);
+    // The watched directory itself is gone or has been moved elsewhere
+    void directoryRemoved(QString dirPath);
+    void overflowed();
+
+private:
+    void readEvents();
+    void forgetDescriptor(int descriptor);
+
+    int m_fd = -1;
+    QSocketNotifier* m_notifier = Q_NULLPTR;
+    QHash<int, QString> m_paths;
+    QHash<QString, int> m_descriptors;
+};
+
+#endif // INOTIFYWATCHER_H
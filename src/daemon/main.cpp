@@ -9,10 +9,12 @@
 #include <util/qappprepareutil.h>
 
 #include "filesystem.h"
+#include "filesnapshottracker.h"
 #include "settings/inifilesettings.h"
 #include "dbushandler.h"
 #include "networkmonitor.h"
 #include "uploader.h"
+#include "uploadscheduler.h"
 
 #include <commands/sync/ncdirtreecommandunit.h>
 #include <commands/sync/ncsynccommandunit.h>
@@ -84,6 +86,29 @@ int main(int argc, char *argv[])
     AccountDb accountDatabase;
     generator.setDatabase(&accountDatabase);
 
+    // One watcher and scanner for all accounts, each tells its uploader what it hasn't synced yet.
+    // The accounts take turns with their uploads and share one transfer budget.
+    Filesystem* fsHandler = new Filesystem(&app);
+    UploadScheduler* uploadScheduler = new UploadScheduler(&app);
+    QList<Uploader*> uploaders;
+
+    // Scanning only pays off while any of the accounts syncs
+    auto updateScanInhibit = [fsHandler, &uploaders]() {
+        bool shouldSync = false;
+        for (Uploader* uploader : uploaders) {
+            shouldSync = shouldSync || uploader->shouldSync();
+        }
+        fsHandler->inhibitScan(!shouldSync);
+    };
+
+    auto updateUploading = [dbusHandler, &uploaders]() {
+        bool uploading = false;
+        for (Uploader* uploader : uploaders) {
+            uploading = uploading || uploader->running();
+        }
+        dbusHandler->setUploading(uploading);
+    };
+
     for (const QVariant& accountWorkerVariant : generator.accountWorkers()) {
         QObject* workersReference = qvariant_cast<QObject *>(accountWorkerVariant);
         if (!workersReference) {
@@ -105,41 +130,46 @@ int main(int argc, char *argv[])
         qInfo() << "Photo backup enabled for account" << settings->hoststring();
 
         NetworkMonitor *netMonitor = new NetworkMonitor(workers, settings);
-        Filesystem *fsHandler = new Filesystem(settings);
         Uploader* uploader = new Uploader(&app, targetDirectory, netMonitor, settings);
-
-        // Periodically check for existence of the local pictures path until found.
-        // Don't stop the timer as the external storage could be ejected anytime.
-        // Every 10 minutes should be enough in this specific case.
-        QTimer localPathCheck;
-        localPathCheck.setInterval(60000 * 10);
-        localPathCheck.setSingleShot(false);
-        QObject::connect(&localPathCheck, &QTimer::timeout, &localPathCheck,
-                         [fsHandler]() {
-
-            fsHandler->triggerRescan();
+        uploader->setScheduler(uploadScheduler);
+        uploaders.append(uploader);
+
+        // Only files which changed since the account's last successful sync are reported on rescans,
+        // unchanged locations don't have to be synced at all
+        FileSnapshotTracker* snapshotTracker = new FileSnapshotTracker(uploader, uploader->syncDb());
+        QObject::connect(fsHandler, &Filesystem::locationScanned,
+                         snapshotTracker, &FileSnapshotTracker::locationScanned);
+        QObject::connect(fsHandler, &Filesystem::fileFound,
+                         snapshotTracker, &FileSnapshotTracker::fileFound);
+        QObject::connect(uploader, &Uploader::syncStarted,
+                         snapshotTracker, &FileSnapshotTracker::syncStarted);
+        QObject::connect(uploader, &Uploader::syncFinished,
+                         snapshotTracker, &FileSnapshotTracker::syncFinished);
+        QObject::connect(uploader, &Uploader::fileUploaded,
+                         snapshotTracker, &FileSnapshotTracker::fileSynced);
+
+        QObject::connect(uploader, &Uploader::fileUploaded, dbusHandler,
+                         [dbusHandler](QString localPath, QString filePath) {
+            Q_UNUSED(localPath)
+            emit dbusHandler->fileUploaded(filePath);
         });
-        localPathCheck.start();
 
-        QObject::connect(fsHandler, &Filesystem::locationFound, uploader, &Uploader::triggerSync);
-
-        // listen for new files
-        // NOTE: this signal is triggered for every file on filesystem rescan,
-        QObject::connect(fsHandler, &Filesystem::fileFound, [uploader](QString locationDir, QString locationName, QString fullPath){
-            Q_UNUSED(fullPath)
-            uploader->triggerSync(locationDir, locationName);
-        });
+        // New files are uploaded on their own, locations are reconciled periodically
+        QObject::connect(fsHandler, &Filesystem::locationFound, uploader, &Uploader::addLocation);
+        QObject::connect(snapshotTracker, &FileSnapshotTracker::fileChanged,
+                         uploader, &Uploader::uploadFile);
 
         // DBus connections
         QObject::connect(dbusHandler, &DBusHandler::abortRequested, uploader, &Uploader::stopSync);
 
-        QObject::connect(netMonitor, &NetworkMonitor::shouldSyncChanged, [uploader, fsHandler] (bool shouldSync) {
+        QObject::connect(netMonitor, &NetworkMonitor::shouldSyncChanged,
+                         [uploader, fsHandler, updateScanInhibit] (bool shouldSync) {
             if (!(uploader && fsHandler)) {
                 qCritical() << "Invalid object existance (uploader, fsHandler), bailing out.";
                 return;
             }
 
-            fsHandler->inhibitScan(!uploader->shouldSync());
+            updateScanInhibit();
 
             if (shouldSync) {
                 fsHandler->triggerRescan();
@@ -148,28 +178,32 @@ int main(int argc, char *argv[])
             }
         });
 
-        QObject::connect(uploader, &Uploader::runningChanged, [dbusHandler, uploader]() {
-            if (!(dbusHandler && uploader)) {
-                qCritical() << "Invalid object existance (dbusHandler, uploader), bailing out.";
-                return;
-            }
-            dbusHandler->setUploading(uploader->running());
-        });
+        QObject::connect(uploader, &Uploader::runningChanged, updateUploading);
 
         QObject::connect(settings, &AccountBase::uploadAutomaticallyChanged,
-                         &app, [uploader, fsHandler](){
+                         &app, [uploader, fsHandler, updateScanInhibit](){
             if (!(uploader && fsHandler)) {
                 qCritical() << "Invalid object existance (uploader, fsHandler), bailing out.";
                 return;
             }
-            fsHandler->inhibitScan(!uploader->shouldSync());
+            updateScanInhibit();
             fsHandler->triggerRescan();
         }, Qt::QueuedConnection);
 
         netMonitor->recheckNetworks();
-        fsHandler->inhibitScan(!uploader->shouldSync());
-        fsHandler->triggerRescan();
     }
 
+    // Periodically check for existence of the local pictures path until found.
+    // Don't stop the timer as the external storage could be ejected anytime.
+    // Every 10 minutes should be enough in this specific case.
+    QTimer localPathCheck;
+    localPathCheck.setInterval(60000 * 10);
+    localPathCheck.setSingleShot(false);
+    QObject::connect(&localPathCheck, &QTimer::timeout, fsHandler, &Filesystem::triggerRescan);
+    localPathCheck.start();
+
+    updateScanInhibit();
+    fsHandler->triggerRescan();
+
     return app.exec();
 }
@@ -1,9 +1,10 @@
 #include "uploader.h"
 
 #include <commands/sync/ncsynccommandunit.h>
-#include <commands/webdav/mkdavdircommandentity.h>
+#include <commands/transferlanescommandentity.h>
 
 #include <QDir>
+#include <QFileInfo>
 
 Uploader::Uploader(QObject *parent,
                    const QString& targetDirectory,
@@ -16,8 +17,54 @@ Uploader::Uploader(QObject *parent,
     m_webDavCommandQueue(new WebDavCommandQueue(this, settings))
 {
     this->m_webDavCommandQueue->setImmediate(true);
+    this->m_webDavCommandQueue->setTransferLanes(TRANSFERLANES_DEFAULT_LANES);
+
+    // Document folders are mostly text, the server is probed before it's used
+    this->m_webDavCommandQueue->setUploadCompression(true);
+
+    // Remote trees survive daemon restarts through the per-account SyncDb
+    if (this->m_settings) {
+        const QString accountName = this->m_settings->username()
+                + QStringLiteral("@") + this->m_settings->hostname();
+        this->m_accountName = accountName;
+        this->m_syncDb = new SyncDb(this, accountName);
+        this->m_webDavCommandQueue->setSyncDb(this->m_syncDb);
+    }
     QObject::connect(this->m_webDavCommandQueue, &WebDavCommandQueue::runningChanged,
                      this, &Uploader::runningChanged);
+
+    this->m_coalesceTimer.setInterval(UPLOADER_COALESCE_INTERVAL);
+    this->m_coalesceTimer.setSingleShot(true);
+    QObject::connect(&this->m_coalesceTimer, &QTimer::timeout, this, &Uploader::flushUploads);
+
+    this->m_reconcileTimer.setInterval(UPLOADER_RECONCILE_INTERVAL);
+    QObject::connect(&this->m_reconcileTimer, &QTimer::timeout, this, &Uploader::reconcile);
+    this->m_reconcileTimer.start();
+}
+
+void Uploader::setScheduler(UploadScheduler* scheduler)
+{
+    this->m_scheduler = scheduler;
+}
+
+void Uploader::runJob(std::function<void(int lanes)> start)
+{
+    if (!this->m_scheduler) {
+        start(qMax(1, this->m_webDavCommandQueue->transferLanes()));
+        return;
+    }
+    this->m_scheduler->submit(this->m_accountName, start);
+}
+
+void Uploader::finishJob()
+{
+    if (this->m_scheduler)
+        this->m_scheduler->finish(this->m_accountName);
+}
+
+QString Uploader::remoteDirectory(const QString &remoteSubdir)
+{
+    return this->m_targetDirectory + '/' + remoteSubdir + '/';
 }
 
 void Uploader::triggerSync(const QString &localPath, const QString &remoteSubdir)
@@ -42,26 +89,209 @@ void Uploader::triggerSync(const QString &localPath, const QString &remoteSubdir
         return;
     }
 
-    QString remoteDir = this->m_targetDirectory + '/' + remoteSubdir + '/';
+    QString remoteDir = remoteDirectory(remoteSubdir);
     qInfo() << "Trigger sync" << localPath << "to" << remoteDir;
 
-    // create parent directory
-    // NcSyncCommandUnit dont creating remote directories recursively
-    // TODO: do it properly
-    this->m_webDavCommandQueue->makeDirectoryRequest(this->m_targetDirectory, true);
-
-    NcSyncCommandUnit* syncDirectoriesUnit =
-            new NcSyncCommandUnit(this->m_webDavCommandQueue,
-                                  this->m_webDavCommandQueue,
-                                  localPath,
-                                  remoteDir);
+    // Everything reported until now is picked up by the sync
+    this->m_locations.insert(localPath, remoteSubdir);
+    this->m_pendingUploads.remove(localPath);
 
     m_syncingPaths << localPath;
 
-    connect(syncDirectoriesUnit, &CommandEntity::aborted, [localPath, this](){ m_syncingPaths.remove(localPath); });
-    connect(syncDirectoriesUnit, &CommandEntity::done,    [localPath, this](){ m_syncingPaths.remove(localPath); });
+    const int generation = this->m_jobGeneration;
+    runJob([=](int lanes) {
+        // Called off or offline while waiting for the other accounts
+        if (generation != this->m_jobGeneration || !shouldSync()) {
+            m_syncingPaths.remove(localPath);
+            finishJob();
+            return;
+        }
+
+        // NcSyncCommandUnit creates the remote directory including its parents if necessary
+        // Reuse the remote tree of the previous sync (or the persisted one),
+        // unchanged directories are then skipped based on their entity tags
+        NcSyncCommandUnit* syncDirectoriesUnit =
+                new NcSyncCommandUnit(this->m_webDavCommandQueue,
+                                      this->m_webDavCommandQueue,
+                                      localPath,
+                                      remoteDir,
+                                      this->m_cachedTrees.value(localPath),
+                                      DIRTREE_DEFAULT_PARALLEL_LISTINGS,
+                                      this->m_syncDb,
+                                      lanes);
+
+        connect(syncDirectoriesUnit, &CommandEntity::aborted, [localPath, this](){
+            m_syncingPaths.remove(localPath);
+            Q_EMIT syncFinished(localPath, false);
+            finishJob();
+            if (m_pendingUploads.contains(localPath))
+                m_coalesceTimer.start();
+        });
+        connect(syncDirectoriesUnit, &CommandEntity::done,    [localPath, syncDirectoriesUnit, this](){
+            m_syncingPaths.remove(localPath);
+            if (syncDirectoriesUnit->cachedTree())
+                m_cachedTrees.insert(localPath, syncDirectoriesUnit->cachedTree());
+            Q_EMIT syncFinished(localPath, true);
+            finishJob();
+            if (m_pendingUploads.contains(localPath))
+                m_coalesceTimer.start();
+        });
+
+        Q_EMIT syncStarted(localPath);
+        this->m_webDavCommandQueue->enqueue((CommandEntity*)syncDirectoriesUnit);
+    });
+}
+
+void Uploader::uploadFile(const QString &localPath, const QString &remoteSubdir,
+                          const QString &filePath)
+{
+    this->m_locations.insert(localPath, remoteSubdir);
+
+    // Rescans report files again until their upload has finished
+    if (this->m_uploadingFiles.contains(filePath))
+        return;
+    this->m_pendingUploads[localPath].insert(filePath);
 
-    this->m_webDavCommandQueue->enqueue((CommandEntity*)syncDirectoriesUnit);
+    // Bursts of photos end up in a single round
+    if (!this->m_coalesceTimer.isActive())
+        this->m_coalesceTimer.start();
+}
+
+void Uploader::addLocation(const QString &localPath, const QString &remoteSubdir)
+{
+    this->m_locations.insert(localPath, remoteSubdir);
+}
+
+void Uploader::reconcile()
+{
+    for (auto it = this->m_locations.constBegin(); it != this->m_locations.constEnd(); ++it) {
+        triggerSync(it.key(), it.value());
+    }
+}
+
+void Uploader::flushUploads()
+{
+    if (!shouldSync()) {
+        // Unsynced files are reported again by the next rescan
+        this->m_pendingUploads.clear();
+        return;
+    }
+
+    for (const QString& localPath : this->m_pendingUploads.keys()) {
+        // Waits for the running sync, which might not have seen the files yet
+        if (this->m_syncingPaths.contains(localPath))
+            continue;
+
+        const QString remoteSubdir = this->m_locations.value(localPath);
+        const QSet<QString> filePaths = this->m_pendingUploads.take(localPath);
+        if (!enqueueUploads(localPath, remoteSubdir, filePaths))
+            triggerSync(localPath, remoteSubdir);
+    }
+}
+
+bool Uploader::enqueueUploads(const QString &localPath, const QString &remoteSubdir,
+                              const QSet<QString> &filePaths)
+{
+    const QString remoteDir = remoteDirectory(remoteSubdir);
+
+    QSharedPointer<NcDirNode> tree = this->m_cachedTrees.value(localPath);
+    if (!tree && this->m_syncDb) {
+        tree = this->m_syncDb->loadTree(localPath, remoteDir);
+        if (tree)
+            this->m_cachedTrees.insert(localPath, tree);
+    }
+
+    // The remote directory hasn't been seen yet, it might have to be created
+    if (!tree)
+        return false;
+
+    // Only new files into existing directories are uploaded on their own,
+    // missing directories and files which exist remotely need reconciliation
+    QVector<NcSyncJournalEntry> uploads;
+    for (const QString& filePath : filePaths) {
+        const QFileInfo fileInfo(filePath);
+        if (!fileInfo.isFile())
+            continue;
+
+        const QString relativePath =
+                filePath.mid(localPath.length())
+                .split(NODE_PATH_SEPARATOR, QString::SkipEmptyParts)
+                .join(NODE_PATH_SEPARATOR);
+        const int separatorIndex = relativePath.lastIndexOf(NODE_PATH_SEPARATOR);
+        const QString directoryPath = relativePath.left(separatorIndex + 1);
+
+        NcDirNode* node = directoryPath.isEmpty() ? tree.data() : tree->getNode(directoryPath);
+        if (!node || node->containsFile(relativePath.mid(separatorIndex + 1)))
+            return false;
+
+        uploads.append(NcSyncJournalEntry::fromFileInfo(relativePath, fileInfo));
+    }
+
+    if (uploads.isEmpty())
+        return true;
+
+    for (const NcSyncJournalEntry& entry : uploads) {
+        this->m_uploadingFiles.insert(QDir(localPath).filePath(entry.relativePath));
+    }
+
+    const int generation = this->m_jobGeneration;
+    runJob([=](int lanes) {
+        // Unsynced files are reported again by the next rescan
+        if (generation != this->m_jobGeneration || !shouldSync()) {
+            for (const NcSyncJournalEntry& entry : uploads) {
+                m_uploadingFiles.remove(QDir(localPath).filePath(entry.relativePath));
+            }
+            finishJob();
+            return;
+        }
+
+        // One job per round, the files share the lanes granted to the job
+        const QString host = this->m_settings->hostname();
+        TransferLanesCommandEntity* round =
+                new TransferLanesCommandEntity(this->m_webDavCommandQueue, lanes);
+
+        for (const NcSyncJournalEntry& entry : uploads) {
+            const QString sourcePath = QDir(localPath).filePath(entry.relativePath);
+            const QString targetPath = remoteDir +
+                    entry.relativePath.left(entry.relativePath.lastIndexOf(NODE_PATH_SEPARATOR) + 1);
+            qInfo() << "Uploading" << sourcePath << "to" << targetPath;
+
+            // Without a sync the remote tree might be outdated, never replace a file
+            // another device has uploaded meanwhile
+            CommandEntity* command =
+                    this->m_webDavCommandQueue->fileUploadRequest(sourcePath, targetPath,
+                                                                  QFileInfo(sourcePath).lastModified(),
+                                                                  false, true);
+            if (!command) {
+                m_uploadingFiles.remove(sourcePath);
+                continue;
+            }
+
+            // The journal keeps the next full sync from considering the file again
+            SyncDb* syncDb = this->m_syncDb;
+            connect(command, &CommandEntity::done, this, [=]() {
+                m_uploadingFiles.remove(sourcePath);
+                if (syncDb)
+                    syncDb->storeJournalEntries(localPath, {entry});
+                Q_EMIT fileUploaded(localPath, sourcePath);
+            });
+
+            // The remote tree has been outdated, e.g. the directory is gone or
+            // the file exists already (412), the sync sorts it out
+            connect(command, &CommandEntity::aborted, this, [=]() {
+                m_uploadingFiles.remove(sourcePath);
+                triggerSync(localPath, remoteSubdir);
+            });
+
+            round->addTransfer(command, host, qMax<qint64>(1, entry.size));
+        }
+
+        connect(round, &CommandEntity::done, this, &Uploader::finishJob);
+        connect(round, &CommandEntity::aborted, this, &Uploader::finishJob);
+        this->m_webDavCommandQueue->enqueue(round);
+    });
+
+    return true;
 }
 
 void Uploader::stopSync()
@@ -71,6 +301,9 @@ void Uploader::stopSync()
                     << "bailing out.";
         return;
     }
+
+    // Jobs still waiting for their turn are dropped as well
+    this->m_jobGeneration++;
     this->m_webDavCommandQueue->stop();
 }
 
@@ -94,3 +327,8 @@ bool Uploader::shouldSync()
 
     return (this->m_networkMonitor->shouldSync() && this->m_settings->uploadAutomatically());
 }
+
+SyncDb* Uploader::syncDb()
+{
+    return this->m_syncDb;
+}
@@ -2,9 +2,19 @@
 #define UPLOADER_H
 
 #include <QObject>
+#include <QTimer>
 #include <provider/storage/webdavcommandqueue.h>
+#include <commands/sync/ncdirtreecommandunit.h>
 #include <settings/nextcloudsettingsbase.h>
+#include <settings/db/syncdb.h>
 #include "networkmonitor.h"
+#include "uploadscheduler.h"
+
+// Window in which reported files are collected into one round of uploads
+const int UPLOADER_COALESCE_INTERVAL = 1000;
+
+// Interval of the full reconciliation of every known location
+const int UPLOADER_RECONCILE_INTERVAL = 60 * 60 * 1000;
 
 class Uploader : public QObject
 {
@@ -17,20 +27,59 @@ public:
 public:
     bool running();
     bool shouldSync();
+    SyncDb* syncDb();
+
+    // Shared with the other accounts' uploaders, jobs run right away without
+    void setScheduler(UploadScheduler* scheduler);
 
 public slots:
+    // Full reconciliation of localPath against the remote tree
     void triggerSync(const QString &localPath, const QString &remoteSubdir);
     void stopSync();
 
+    // Uploads filePath on its own into the known remote directory,
+    // falls back to a full sync where the remote tree doesn't tell enough
+    void uploadFile(const QString &localPath, const QString &remoteSubdir,
+                    const QString &filePath);
+
+    // Remembers localPath for the periodic reconciliation without syncing it
+    void addLocation(const QString &localPath, const QString &remoteSubdir);
+    void reconcile();
+
+private slots:
+    void flushUploads();
+
+private:
+    void runJob(std::function<void(int lanes)> start);
+    void finishJob();
+    QString remoteDirectory(const QString &remoteSubdir);
+    bool enqueueUploads(const QString &localPath, const QString &remoteSubdir,
+                        const QSet<QString> &filePaths);
+
 private:
     const QString m_targetDirectory;
     NetworkMonitor* m_networkMonitor = Q_NULLPTR;
     AccountBase* m_settings = Q_NULLPTR;
     WebDavCommandQueue* m_webDavCommandQueue = Q_NULLPTR;
     QSet<QString> m_syncingPaths;
+    QHash<QString, QSharedPointer<NcDirNode> > m_cachedTrees;
+    SyncDb* m_syncDb = Q_NULLPTR;
+    // Remote subdirectory of every known location
+    QHash<QString, QString> m_locations;
+    QHash<QString, QSet<QString> > m_pendingUploads;
+    QSet<QString> m_uploadingFiles;
+    QTimer m_coalesceTimer;
+    QTimer m_reconcileTimer;
+    UploadScheduler* m_scheduler = Q_NULLPTR;
+    QString m_accountName;
+    // Increased by stopSync(), jobs of an earlier generation don't start anymore
+    int m_jobGeneration = 0;
 
 signals:
     void runningChanged();
+    void syncStarted(QString localPath);
+    void syncFinished(QString localPath, bool success);
+    void fileUploaded(QString localPath, QString filePath);
 
 };
 
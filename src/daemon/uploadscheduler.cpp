@@ -0,0 +1,83 @@
+#include "uploadscheduler.h"
+
+#include <QDebug>
+
+UploadScheduler::UploadScheduler(QObject* parent, int maxRunning, int transferBudget) :
+    QObject(parent),
+    m_maxRunning(qMax(1, maxRunning)),
+    m_transferBudget(qMax(1, transferBudget))
+{
+}
+
+void UploadScheduler::setMaxRunning(int maxRunning)
+{
+    this->m_maxRunning = qMax(1, maxRunning);
+    dispatch();
+}
+
+int UploadScheduler::maxRunning() const
+{
+    return this->m_maxRunning;
+}
+
+void UploadScheduler::setTransferBudget(int transferBudget)
+{
+    this->m_transferBudget = qMax(1, transferBudget);
+}
+
+int UploadScheduler::transferBudget() const
+{
+    return this->m_transferBudget;
+}
+
+int UploadScheduler::lanesPerJob() const
+{
+    return qMax(1, this->m_transferBudget / this->m_maxRunning);
+}
+
+void UploadScheduler::submit(const QString& account, std::function<void(int lanes)> start)
+{
+    if (!this->m_accounts.contains(account))
+        this->m_accounts.append(account);
+
+    this->m_pendingJobs[account].enqueue(start);
+    dispatch();
+}
+
+void UploadScheduler::finish(const QString& account)
+{
+    if (!this->m_runningAccounts.remove(account)) {
+        qWarning() << "No job of" << account << "is running";
+        return;
+    }
+
+    dispatch();
+}
+
+void UploadScheduler::dispatch()
+{
+    int index = 0;
+    while (this->m_runningAccounts.count() < this->m_maxRunning &&
+           index < this->m_accounts.count()) {
+        const QString account = this->m_accounts.at(index);
+        if (this->m_runningAccounts.contains(account) ||
+                this->m_pendingJobs.value(account).isEmpty()) {
+            index++;
+            continue;
+        }
+
+        // Served accounts queue up behind the others again
+        this->m_accounts.move(index, this->m_accounts.count() - 1);
+        this->m_runningAccounts.insert(account);
+        const std::function<void(int)> start = this->m_pendingJobs[account].dequeue();
+        if (this->m_pendingJobs.value(account).isEmpty())
+            this->m_pendingJobs.remove(account);
+
+        qDebug() << "Starting job of" << account << ","
+                 << this->m_runningAccounts.count() << "running";
+        start(lanesPerJob());
+
+        // start() might have finished right away and changed the order
+        index = 0;
+    }
+}
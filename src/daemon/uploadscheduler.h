@@ -0,0 +1,63 @@
+#ifndef UPLOADSCHEDULER_H
+#define UPLOADSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QStringList>
+#include <functional>
+
+#include <commands/transferlanescommandentity.h>
+
+// Number of accounts transferring at the same time by default
+const int UPLOADSCHEDULER_DEFAULT_MAX_RUNNING = 2;
+
+// Transfers of all accounts together, as many as a single account had on its own
+const int UPLOADSCHEDULER_DEFAULT_TRANSFER_BUDGET = TRANSFERLANES_DEFAULT_LANES;
+
+// Shared by the uploaders of all accounts. Each account runs one job
+// (a sync or a round of uploads) at a time, at most maxRunning accounts
+// run at once. Free slots go round-robin to the accounts with pending
+// jobs, so a long backlog of one account doesn't starve the others.
+// Callers start their job in the granted function and have to call
+// finish() once it is over, whether it succeeded or not.
+//
+// Every job is granted an equal share of the transfer budget as its
+// number of transfer lanes, so all accounts together never run more
+// transfers than the budget. Jobs aren't preempted: a sync with a long
+// backlog keeps its slot until it is done, the other accounts share the
+// remaining slots meanwhile. Uploads of new files come in small rounds
+// and give up their slot after each one.
+class UploadScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UploadScheduler(QObject* parent = Q_NULLPTR,
+                             int maxRunning = UPLOADSCHEDULER_DEFAULT_MAX_RUNNING,
+                             int transferBudget = UPLOADSCHEDULER_DEFAULT_TRANSFER_BUDGET);
+
+    void setMaxRunning(int maxRunning);
+    int maxRunning() const;
+    void setTransferBudget(int transferBudget);
+    int transferBudget() const;
+
+    // Transfer lanes granted to each job
+    int lanesPerJob() const;
+
+    void submit(const QString& account, std::function<void(int lanes)> start);
+    void finish(const QString& account);
+
+private:
+    void dispatch();
+
+    int m_maxRunning;
+    int m_transferBudget;
+    // Accounts in the order they are served, the next one first
+    QStringList m_accounts;
+    QHash<QString, QQueue<std::function<void(int)> > > m_pendingJobs;
+    QSet<QString> m_runningAccounts;
+};
+
+#endif // UPLOADSCHEDULER_H
@@ -23,3 +23,8 @@ contains(CONFIG, noadditionals) {
 !contains(CONFIG, nosharing) {
     SUBDIRS += sharing
 }
+
+# Unit tests of the common library, they need Qt Test
+contains(CONFIG, tests) {
+    SUBDIRS += tests
+}
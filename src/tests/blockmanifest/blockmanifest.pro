@@ -0,0 +1,6 @@
+TARGET = tst_blockmanifest
+
+SOURCES += \
+    $$PWD/tst_blockmanifest.cpp
+
+include($$PWD/../tests.pri)
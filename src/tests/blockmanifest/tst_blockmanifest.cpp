@@ -0,0 +1,170 @@
+#include <QtTest>
+
+#include <util/blockmanifest.h>
+
+const qint64 BLOCK_SIZE = 1024;
+
+// Content which differs in every block, so that a changed block is noticed
+QByteArray fileContent(qint64 size)
+{
+    QByteArray content;
+    content.reserve(size);
+    for (qint64 i = 0; i < size; i++) {
+        content.append(static_cast<char>((i * 7 + i / BLOCK_SIZE) % 251));
+    }
+    return content;
+}
+
+bool writeFile(const QString& filePath, const QByteArray& content)
+{
+    QFile file(filePath);
+    return file.open(QFile::WriteOnly | QFile::Truncate) &&
+            file.write(content) == content.size();
+}
+
+class TestBlockManifest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void fromFileHashesBlocks();
+    void hashDataRoundTrip();
+    void setHashDataRejectsMismatch();
+    void isPrefixOf_data();
+    void isPrefixOf();
+    void builderMatchesFromFile();
+    void builderReportsMissingFile();
+
+private:
+    QString filePath() const { return this->m_directory->path() + QStringLiteral("/file.log"); }
+
+    QScopedPointer<QTemporaryDir> m_directory;
+};
+
+void TestBlockManifest::init()
+{
+    this->m_directory.reset(new QTemporaryDir);
+    QVERIFY(this->m_directory->isValid());
+}
+
+void TestBlockManifest::fromFileHashesBlocks()
+{
+    const QByteArray content = fileContent(2 * BLOCK_SIZE + 500);
+    QVERIFY(writeFile(filePath(), content));
+
+    const BlockManifest manifest = BlockManifest::fromFile(filePath(), BLOCK_SIZE);
+    QVERIFY(manifest.isValid());
+    QCOMPARE(manifest.size, qint64(content.size()));
+    QCOMPARE(manifest.blockCount(), 3);
+    QCOMPARE(manifest.strongHashes.at(0),
+             QCryptographicHash::hash(content.left(BLOCK_SIZE), QCryptographicHash::Sha1));
+    QCOMPARE(manifest.strongHashes.at(2),
+             QCryptographicHash::hash(content.mid(2 * BLOCK_SIZE), QCryptographicHash::Sha1));
+    QVERIFY(manifest.weakHashes.at(0) != manifest.weakHashes.at(1));
+}
+
+void TestBlockManifest::hashDataRoundTrip()
+{
+    QVERIFY(writeFile(filePath(), fileContent(3 * BLOCK_SIZE)));
+    const BlockManifest manifest = BlockManifest::fromFile(filePath(), BLOCK_SIZE);
+
+    // The sizes are stored in columns of their own
+    BlockManifest restored;
+    restored.size = manifest.size;
+    restored.blockSize = manifest.blockSize;
+    QVERIFY(restored.setHashData(manifest.hashData()));
+    QCOMPARE(restored.weakHashes, manifest.weakHashes);
+    QCOMPARE(restored.strongHashes, manifest.strongHashes);
+}
+
+void TestBlockManifest::setHashDataRejectsMismatch()
+{
+    QVERIFY(writeFile(filePath(), fileContent(3 * BLOCK_SIZE)));
+    const QByteArray hashData = BlockManifest::fromFile(filePath(), BLOCK_SIZE).hashData();
+
+    // Stored for a file of a different size
+    BlockManifest larger;
+    larger.size = 4 * BLOCK_SIZE;
+    larger.blockSize = BLOCK_SIZE;
+    QVERIFY(!larger.setHashData(hashData));
+
+    BlockManifest truncated;
+    truncated.size = 3 * BLOCK_SIZE;
+    truncated.blockSize = BLOCK_SIZE;
+    QVERIFY(!truncated.setHashData(hashData.left(hashData.size() / 2)));
+}
+
+void TestBlockManifest::isPrefixOf_data()
+{
+    QTest::addColumn<QByteArray>("previous");
+    QTest::addColumn<QByteArray>("current");
+    QTest::addColumn<qint64>("reusedBytes");
+
+    const QByteArray aligned = fileContent(4 * BLOCK_SIZE);
+    const QByteArray partial = fileContent(4 * BLOCK_SIZE + 300);
+    const QByteArray appended = fileContent(6 * BLOCK_SIZE + 10);
+    QByteArray middleEdit = partial;
+    middleEdit[static_cast<int>(2 * BLOCK_SIZE + 5)] = 'x';
+    QByteArray tailEdit = appended;
+    tailEdit[static_cast<int>(4 * BLOCK_SIZE + 100)] = 'x';
+
+    QTest::newRow("unchanged") << partial << partial << qint64(partial.size());
+    QTest::newRow("appended to complete blocks") << aligned << appended << qint64(aligned.size());
+    QTest::newRow("appended to a partial block") << partial << appended << qint64(partial.size());
+    QTest::newRow("appended to an empty file") << QByteArray() << appended << qint64(0);
+    QTest::newRow("edited in the middle") << partial << middleEdit << qint64(0);
+    QTest::newRow("edited in the partial block") << partial << tailEdit << qint64(0);
+    QTest::newRow("truncated") << appended << partial << qint64(0);
+}
+
+// Bytes the chunked upload copies on the server instead of sending them again
+void TestBlockManifest::isPrefixOf()
+{
+    QFETCH(QByteArray, previous);
+    QFETCH(QByteArray, current);
+    QFETCH(qint64, reusedBytes);
+
+    QVERIFY(writeFile(filePath(), previous));
+    const BlockManifest previousManifest = BlockManifest::fromFile(filePath(), BLOCK_SIZE);
+    QVERIFY(writeFile(filePath(), current));
+    const BlockManifest currentManifest = BlockManifest::fromFile(filePath(), BLOCK_SIZE);
+
+    const bool prefix = previousManifest.isPrefixOf(filePath(), currentManifest);
+    QCOMPARE(prefix ? previousManifest.size : 0, reusedBytes);
+}
+
+void TestBlockManifest::builderMatchesFromFile()
+{
+    QVERIFY(writeFile(filePath(), fileContent(5 * BLOCK_SIZE + 1)));
+
+    BlockManifestBuilder builder(filePath(), BLOCK_SIZE);
+    QSignalSpy finishedSpy(&builder, &BlockManifestBuilder::finished);
+    builder.start();
+    QVERIFY(!builder.isFinished());
+
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(finishedSpy.count(), 1);
+
+    const BlockManifest expected = BlockManifest::fromFile(filePath(), BLOCK_SIZE);
+    QVERIFY(builder.manifest().isValid());
+    QCOMPARE(builder.manifest().size, expected.size);
+    QCOMPARE(builder.manifest().weakHashes, expected.weakHashes);
+    QCOMPARE(builder.manifest().strongHashes, expected.strongHashes);
+}
+
+void TestBlockManifest::builderReportsMissingFile()
+{
+    BlockManifestBuilder builder(filePath(), BLOCK_SIZE);
+    QSignalSpy finishedSpy(&builder, &BlockManifestBuilder::finished);
+    builder.start();
+
+    QVERIFY(finishedSpy.wait());
+    QVERIFY(builder.isFinished());
+    QVERIFY(!builder.manifest().isValid());
+}
+
+QTEST_GUILESS_MAIN(TestBlockManifest)
+
+#include "tst_blockmanifest.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_davmultistatusparser
+
+SOURCES += \
+    $$PWD/tst_davmultistatusparser.cpp
+
+include($$PWD/../tests.pri)
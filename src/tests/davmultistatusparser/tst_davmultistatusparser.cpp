@@ -0,0 +1,203 @@
+#include <QtTest>
+
+#include <commands/webdav/davmultistatusparser.h>
+
+const QByteArray MULTISTATUS_HEAD =
+        QByteArrayLiteral("<?xml version=\"1.0\"?>\n"
+                          "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\""
+                          " xmlns:a=\"http://apache.org/dav/props/\">\n");
+const QByteArray MULTISTATUS_TAIL = QByteArrayLiteral("</d:multistatus>\n");
+
+QByteArray directoryResponse(const QByteArray& href, const QByteArray& entityTag)
+{
+    return QByteArrayLiteral("<d:response><d:href>") + href + QByteArrayLiteral("</d:href>"
+            "<d:propstat><d:prop>"
+            "<d:resourcetype><d:collection/></d:resourcetype>"
+            "<d:getetag>&quot;") + entityTag + QByteArrayLiteral("&quot;</d:getetag>"
+            "<oc:fileid>7</oc:fileid>"
+            "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat>"
+            "<d:propstat><d:prop><d:getcontentlength/><d:getcontenttype/></d:prop>"
+            "<d:status>HTTP/1.1 404 Not Found</d:status></d:propstat>"
+            "</d:response>\n");
+}
+
+QByteArray fileResponse(const QByteArray& href, qint64 size)
+{
+    return QByteArrayLiteral("<d:response><d:href>") + href + QByteArrayLiteral("</d:href>"
+            "<d:propstat><d:prop>"
+            "<d:resourcetype/>"
+            "<d:getetag>&quot;5f0c3d2e1a&quot;</d:getetag>"
+            "<d:getcontentlength>") + QByteArray::number(size) + QByteArrayLiteral("</d:getcontentlength>"
+            "<d:getcontenttype>image/jpeg</d:getcontenttype>"
+            "<d:getlastmodified>Tue, 15 Nov 1994 12:45:26 GMT</d:getlastmodified>"
+            "<oc:fileid>00000042ocabcdef</oc:fileid>"
+            "<a:executable>T</a:executable>"
+            "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat>"
+            "</d:response>\n");
+}
+
+QByteArray listingBody()
+{
+    return MULTISTATUS_HEAD +
+            directoryResponse("/remote.php/dav/files/user/My%20Photos/", "dir1") +
+            fileResponse("/remote.php/dav/files/user/My%20Photos/IMG_0001.jpg", 123456) +
+            MULTISTATUS_TAIL;
+}
+
+class TestDavMultistatusParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parsesProperties();
+    void chunkBoundariesDontMatter_data();
+    void chunkBoundariesDontMatter();
+    void handsOutCompleteResponsesEarly();
+    void rejectsMalformedDocuments();
+
+    void parseListing_data();
+    void parseListing();
+};
+
+void TestDavMultistatusParser::parsesProperties()
+{
+    DavMultistatusParser parser;
+    parser.addData(listingBody());
+
+    QVector<DavMultistatusEntry> entries;
+    QVERIFY(parser.readEntries(entries));
+    QVERIFY(parser.atEnd());
+    QCOMPARE(entries.size(), 2);
+
+    const DavMultistatusEntry& directory = entries.at(0);
+    QCOMPARE(directory.path, QStringLiteral("/remote.php/dav/files/user/My Photos/"));
+    QCOMPARE(directory.name(), QStringLiteral("My Photos"));
+    QVERIFY(directory.isDirectory);
+    QCOMPARE(directory.entityTag, QStringLiteral("\"dir1\""));
+    QCOMPARE(directory.fileId, QStringLiteral("7"));
+
+    // Properties the server reported as missing keep their defaults
+    QCOMPARE(directory.size, qint64(0));
+    QVERIFY(directory.mimeType.isEmpty());
+
+    const DavMultistatusEntry& file = entries.at(1);
+    QCOMPARE(file.name(), QStringLiteral("IMG_0001.jpg"));
+    QVERIFY(!file.isDirectory);
+    QVERIFY(file.isExecutable);
+    QCOMPARE(file.size, qint64(123456));
+    QCOMPARE(file.mimeType, QStringLiteral("image/jpeg"));
+    QCOMPARE(file.lastModified, QDateTime(QDate(1994, 11, 15), QTime(12, 45, 26), Qt::UTC));
+
+    const RemoteEntry remoteFile = file.toRemoteEntry();
+    QCOMPARE(remoteFile.mimeType, RemoteEntry::MimeImage);
+    QCOMPARE(remoteFile.lastModified, qint64(784903526));
+    QCOMPARE(directory.toRemoteEntry().mimeType, RemoteEntry::MimeDirectory);
+}
+
+void TestDavMultistatusParser::chunkBoundariesDontMatter_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("single bytes") << 1;
+    QTest::newRow("7 bytes") << 7;
+    QTest::newRow("1 KiB") << 1024;
+}
+
+// Network reads split the body anywhere, also within tags and entities
+void TestDavMultistatusParser::chunkBoundariesDontMatter()
+{
+    QFETCH(int, chunkSize);
+
+    const QByteArray body = listingBody();
+    DavMultistatusParser parser;
+    QVector<DavMultistatusEntry> entries;
+
+    for (int offset = 0; offset < body.size(); offset += chunkSize) {
+        parser.addData(body.mid(offset, chunkSize));
+        QVERIFY(parser.readEntries(entries));
+    }
+
+    QVERIFY(parser.atEnd());
+    QCOMPARE(entries.size(), 2);
+    QCOMPARE(entries.at(0).entityTag, QStringLiteral("\"dir1\""));
+    QCOMPARE(entries.at(1).size, qint64(123456));
+}
+
+void TestDavMultistatusParser::handsOutCompleteResponsesEarly()
+{
+    DavMultistatusParser parser;
+    QVector<DavMultistatusEntry> entries;
+
+    parser.addData(MULTISTATUS_HEAD + directoryResponse("/files/user/", "root"));
+    QVERIFY(parser.readEntries(entries));
+    QCOMPARE(entries.size(), 1);
+    QVERIFY(!parser.atEnd());
+
+    // Half a response isn't handed out
+    const QByteArray file = fileResponse("/files/user/a.jpg", 1);
+    parser.addData(file.left(file.size() / 2));
+    QVERIFY(parser.readEntries(entries));
+    QCOMPARE(entries.size(), 1);
+
+    parser.addData(file.mid(file.size() / 2) + MULTISTATUS_TAIL);
+    QVERIFY(parser.readEntries(entries));
+    QCOMPARE(entries.size(), 2);
+    QVERIFY(parser.atEnd());
+}
+
+void TestDavMultistatusParser::rejectsMalformedDocuments()
+{
+    DavMultistatusParser parser;
+    parser.addData(MULTISTATUS_HEAD + QByteArrayLiteral("<d:response><d:href>/a</d:response>"));
+
+    QVector<DavMultistatusEntry> entries;
+    QVERIFY(!parser.readEntries(entries));
+    QVERIFY(parser.hasError());
+    QVERIFY(!parser.errorString().isEmpty());
+}
+
+void TestDavMultistatusParser::parseListing_data()
+{
+    QTest::addColumn<int>("entryCount");
+
+    QTest::newRow("10k entries") << 10000;
+    QTest::newRow("100k entries") << 100000;
+}
+
+// Parse time of a Depth: infinity listing, fed in network sized chunks
+void TestDavMultistatusParser::parseListing()
+{
+    QFETCH(int, entryCount);
+
+    QByteArray body = MULTISTATUS_HEAD;
+    for (int i = 0; i < entryCount; i++) {
+        if (i % 100 == 0) {
+            body += directoryResponse("/files/user/dir" + QByteArray::number(i / 100) + "/",
+                                      QByteArray::number(i));
+        } else {
+            body += fileResponse("/files/user/dir" + QByteArray::number(i / 100) +
+                                 "/IMG_" + QByteArray::number(i) + ".jpg", i);
+        }
+    }
+    body += MULTISTATUS_TAIL;
+
+    int parsedEntries = 0;
+    QBENCHMARK {
+        DavMultistatusParser parser;
+        QVector<DavMultistatusEntry> entries;
+        parsedEntries = 0;
+
+        for (int offset = 0; offset < body.size(); offset += 16 * 1024) {
+            parser.addData(body.mid(offset, 16 * 1024));
+            parser.readEntries(entries);
+            parsedEntries += entries.size();
+            entries.clear();
+        }
+    }
+
+    QCOMPARE(parsedEntries, entryCount);
+}
+
+QTEST_GUILESS_MAIN(TestDavMultistatusParser)
+
+#include "tst_davmultistatusparser.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_filedownload
+
+SOURCES += \
+    $$PWD/tst_filedownload.cpp
+
+include($$PWD/../tests.pri)
@@ -0,0 +1,124 @@
+#include <QtTest>
+#include <algorithm>
+
+#include <commands/webdav/filedownloadcommandentity.h>
+
+typedef QVector<QPair<qint64, qint64> > ByteRanges;
+
+class TestFileDownload : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void splitByteRanges_data();
+    void splitByteRanges();
+    void parseContentRange_data();
+    void parseContentRange();
+    void rangesAssembleInAnyOrder();
+};
+
+void TestFileDownload::splitByteRanges_data()
+{
+    QTest::addColumn<qint64>("size");
+    QTest::addColumn<ByteRanges>("ranges");
+
+    QTest::newRow("even") << qint64(8)
+                          << ByteRanges({{0, 2}, {2, 2}, {4, 2}, {6, 2}});
+    QTest::newRow("remainder") << qint64(10)
+                               << ByteRanges({{0, 3}, {3, 3}, {6, 3}, {9, 1}});
+    // Rounding up the length can leave nothing for the last range
+    QTest::newRow("fewer ranges") << qint64(9)
+                                  << ByteRanges({{0, 3}, {3, 3}, {6, 3}});
+    QTest::newRow("tiny") << qint64(2) << ByteRanges({{0, 1}, {1, 1}});
+    QTest::newRow("empty") << qint64(0) << ByteRanges();
+    QTest::newRow("threshold") << FILEDOWNLOAD_SEGMENTED_THRESHOLD
+                               << ByteRanges({{0, 8 * 1024 * 1024},
+                                              {8 * 1024 * 1024, 8 * 1024 * 1024},
+                                              {16 * 1024 * 1024, 8 * 1024 * 1024},
+                                              {24 * 1024 * 1024, 8 * 1024 * 1024}});
+}
+
+void TestFileDownload::splitByteRanges()
+{
+    QFETCH(qint64, size);
+    QFETCH(ByteRanges, ranges);
+
+    QCOMPARE(::splitByteRanges(size, 4), ranges);
+}
+
+void TestFileDownload::parseContentRange_data()
+{
+    QTest::addColumn<QByteArray>("header");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<qint64>("first");
+    QTest::addColumn<qint64>("last");
+    QTest::addColumn<qint64>("total");
+
+    QTest::newRow("range") << QByteArrayLiteral("bytes 1024-2047/4096")
+                           << true << qint64(1024) << qint64(2047) << qint64(4096);
+    QTest::newRow("last byte") << QByteArrayLiteral("bytes 4095-4095/4096")
+                               << true << qint64(4095) << qint64(4095) << qint64(4096);
+    QTest::newRow("beyond 4 GiB") << QByteArrayLiteral("bytes 4294967296-8589934591/8589934592")
+                                  << true << qint64(4294967296LL) << qint64(8589934591LL)
+                                  << qint64(8589934592LL);
+    QTest::newRow("unsatisfied") << QByteArrayLiteral("bytes */4096")
+                                 << false << qint64(0) << qint64(0) << qint64(0);
+    QTest::newRow("unknown total") << QByteArrayLiteral("bytes 0-1023/*")
+                                   << false << qint64(0) << qint64(0) << qint64(0);
+    QTest::newRow("past the end") << QByteArrayLiteral("bytes 0-4096/4096")
+                                  << false << qint64(0) << qint64(0) << qint64(0);
+    QTest::newRow("other unit") << QByteArrayLiteral("items 0-1/2")
+                                << false << qint64(0) << qint64(0) << qint64(0);
+    QTest::newRow("missing") << QByteArray()
+                             << false << qint64(0) << qint64(0) << qint64(0);
+}
+
+void TestFileDownload::parseContentRange()
+{
+    QFETCH(QByteArray, header);
+    QFETCH(bool, valid);
+
+    qint64 first = -1;
+    qint64 last = -1;
+    qint64 total = -1;
+    QCOMPARE(::parseContentRange(header, &first, &last, &total), valid);
+
+    if (valid) {
+        QTEST(first, "first");
+        QTEST(last, "last");
+        QTEST(total, "total");
+    }
+}
+
+// The segments write through their own handles into the preallocated
+// partial file and may complete in any order
+void TestFileDownload::rangesAssembleInAnyOrder()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+
+    QByteArray content;
+    for (int i = 0; i < 1000; i++) {
+        content += QByteArray::number(i) + ' ';
+    }
+
+    QFile partFile(directory.path() + QStringLiteral("/file.part"));
+    QVERIFY(partFile.open(QFile::ReadWrite));
+    QVERIFY(partFile.resize(content.size()));
+
+    ByteRanges ranges = ::splitByteRanges(content.size(), FILEDOWNLOAD_SEGMENTS);
+    std::reverse(ranges.begin(), ranges.end());
+    for (const QPair<qint64, qint64>& range : ranges) {
+        QFile segmentFile(partFile.fileName());
+        QVERIFY(segmentFile.open(QFile::ReadWrite));
+        QVERIFY(segmentFile.seek(range.first));
+        QCOMPARE(segmentFile.write(content.mid(range.first, range.second)), range.second);
+    }
+
+    QVERIFY(partFile.seek(0));
+    QCOMPARE(partFile.readAll(), content);
+}
+
+QTEST_GUILESS_MAIN(TestFileDownload)
+
+#include "tst_filedownload.moc"
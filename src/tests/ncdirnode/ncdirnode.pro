@@ -0,0 +1,6 @@
+TARGET = tst_ncdirnode
+
+SOURCES += \
+    $$PWD/tst_ncdirnode.cpp
+
+include($$PWD/../tests.pri)
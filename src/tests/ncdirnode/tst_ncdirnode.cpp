@@ -0,0 +1,293 @@
+#include <QtTest>
+
+#include <commands/sync/ncdirtreecommandunit.h>
+
+RemoteEntry fileEntry(const QString& name)
+{
+    RemoteEntry entry;
+    entry.name = name;
+    entry.mimeType = RemoteEntry::MimeImage;
+    return entry;
+}
+
+NcDirNode* directoryNode(const QString& name)
+{
+    NcDirNode* node = new NcDirNode;
+    node->name = name;
+    return node;
+}
+
+RemoteEntry directoryEntry(const QString& name, const QString& entityTag)
+{
+    RemoteEntry entry;
+    entry.name = name;
+    entry.mimeType = RemoteEntry::MimeDirectory;
+    entry.entityTag = RemoteEntry::EntityTag::fromString(entityTag);
+    return entry;
+}
+
+// Every path of the tree with the entity tags of the directories, sorted
+QStringList flattenTree(const NcDirNode* node, const QString& path = QString())
+{
+    QStringList paths;
+    for (const RemoteEntry& file : node->files) {
+        paths.append(path + file.name);
+    }
+    for (const NcDirNode* directory : node->directories) {
+        const QString directoryPath = path + directory->name + NODE_PATH_SEPARATOR;
+        paths.append(directoryPath + QStringLiteral(" ") + directory->uniqueId.toString());
+        paths.append(flattenTree(directory, directoryPath));
+    }
+    paths.sort();
+    return paths;
+}
+
+// A remote tree of depth levels with fanOut directories and files each,
+// as listings by directory path
+QHash<QString, QVector<RemoteEntry> > remoteListings(int depth, int fanOut)
+{
+    QHash<QString, QVector<RemoteEntry> > listings;
+    QStringList paths = {QString()};
+
+    for (int level = 0; level < depth; level++) {
+        QStringList childPaths;
+        for (const QString& path : paths) {
+            QVector<RemoteEntry> listing;
+            for (int i = 0; i < fanOut; i++) {
+                listing.append(fileEntry(QStringLiteral("file%1.txt").arg(i)));
+                if (level + 1 < depth) {
+                    const QString name = QStringLiteral("dir%1").arg(i);
+                    listing.append(directoryEntry(name, QStringLiteral("\"%1%2\"").arg(path).arg(name)));
+                    childPaths.append(path + name + NODE_PATH_SEPARATOR);
+                }
+            }
+            listings.insert(path, listing);
+        }
+        paths = childPaths;
+    }
+    return listings;
+}
+
+// Lists the tree breadth-first with up to window listings in flight,
+// the one started last completing first as the worst case reordering
+void crawl(NcDirNode* root,
+           const QHash<QString, QVector<RemoteEntry> >& listings,
+           int window)
+{
+    QList<QPair<NcDirNode*, QString> > pending = {qMakePair(root, QString())};
+    QList<QPair<NcDirNode*, QString> > running;
+
+    while (!pending.isEmpty() || !running.isEmpty()) {
+        while (running.size() < window && !pending.isEmpty()) {
+            running.append(pending.takeFirst());
+        }
+
+        const QPair<NcDirNode*, QString> listed = running.takeLast();
+        for (NcDirNode* changed : listed.first->applyListing(listings.value(listed.second))) {
+            pending.append(qMakePair(changed, listed.second + changed->name + NODE_PATH_SEPARATOR));
+        }
+    }
+}
+
+// The lookup the index replaced: a scan over the files of the node
+bool containsFileLinear(const NcDirNode& node, const QString& name)
+{
+    for (const RemoteEntry& file : node.files) {
+        if (file.name == name)
+            return true;
+    }
+    return false;
+}
+
+class TestNcDirNode : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void lookupsFollowAdditions();
+    void removedDirectoryLeavesIndex();
+    void clearedFilesLeaveIndex();
+    void getNodeResolvesPaths();
+
+    void applyListingReplacesChildren();
+    void applyListingKeepsUnchangedSubtrees();
+    void parallelCrawlMatchesSerialCrawl_data();
+    void parallelCrawlMatchesSerialCrawl();
+
+    void fileLookup_data();
+    void fileLookup();
+};
+
+void TestNcDirNode::lookupsFollowAdditions()
+{
+    NcDirNode root;
+    root.addFile(fileEntry(QStringLiteral("a.jpg")));
+    root.addDirectory(directoryNode(QStringLiteral("Camera")));
+
+    QVERIFY(root.containsFile(QStringLiteral("a.jpg")));
+    QVERIFY(!root.containsFile(QStringLiteral("b.jpg")));
+    QVERIFY(!root.containsFile(QStringLiteral("Camera")));
+
+    NcDirNode* camera = root.directory(QStringLiteral("Camera"));
+    QVERIFY(camera);
+    QCOMPARE(camera->name, QStringLiteral("Camera"));
+    QCOMPARE(camera->parentNode, &root);
+    QVERIFY(!root.directory(QStringLiteral("a.jpg")));
+}
+
+void TestNcDirNode::removedDirectoryLeavesIndex()
+{
+    NcDirNode root;
+    NcDirNode* camera = directoryNode(QStringLiteral("Camera"));
+    root.addDirectory(camera);
+    root.addDirectory(directoryNode(QStringLiteral("Screenshots")));
+
+    root.removeDirectory(camera);
+
+    QVERIFY(!root.directory(QStringLiteral("Camera")));
+    QVERIFY(root.directory(QStringLiteral("Screenshots")));
+    QCOMPARE(root.directories.size(), 1);
+}
+
+void TestNcDirNode::clearedFilesLeaveIndex()
+{
+    NcDirNode root;
+    RemoteEntry file = fileEntry(QStringLiteral("a.jpg"));
+    file.entityTag = RemoteEntry::EntityTag::fromString(QStringLiteral("\"d41d8cd98f00b204e9800998ecf8427e\""));
+    root.addFile(file);
+    QVERIFY(root.containsFileWithUniqueId(file.entityTag));
+
+    root.clearFiles();
+
+    QVERIFY(!root.containsFile(QStringLiteral("a.jpg")));
+    QVERIFY(!root.containsFileWithUniqueId(file.entityTag));
+    QVERIFY(root.files.isEmpty());
+}
+
+void TestNcDirNode::getNodeResolvesPaths()
+{
+    NcDirNode root;
+    NcDirNode* pictures = directoryNode(QStringLiteral("Pictures"));
+    NcDirNode* camera = directoryNode(QStringLiteral("Camera"));
+    root.addDirectory(pictures);
+    pictures->addDirectory(camera);
+
+    QCOMPARE(root.getNode(QStringLiteral("Pictures/")), pictures);
+    QCOMPARE(root.getNode(QStringLiteral("/Pictures/Camera/")), camera);
+    QCOMPARE(root.getNode(QStringLiteral("Pictures/Camera")), camera);
+    QVERIFY(!root.getNode(QStringLiteral("Pictures/Missing/")));
+    QVERIFY(!root.getNode(QStringLiteral("Camera/")));
+    QVERIFY(!root.getNode(QStringLiteral("/")));
+}
+
+void TestNcDirNode::applyListingReplacesChildren()
+{
+    NcDirNode root;
+    root.addFile(fileEntry(QStringLiteral("gone.jpg")));
+    root.addDirectory(directoryNode(QStringLiteral("Gone")));
+
+    const QVector<NcDirNode*> changed = root.applyListing({
+        fileEntry(QStringLiteral("new.jpg")),
+        directoryEntry(QStringLiteral("Camera"), QStringLiteral("\"1\""))
+    });
+
+    QVERIFY(root.dirty);
+    QVERIFY(root.containsFile(QStringLiteral("new.jpg")));
+    QVERIFY(!root.containsFile(QStringLiteral("gone.jpg")));
+    QVERIFY(!root.directory(QStringLiteral("Gone")));
+    QCOMPARE(changed.size(), 1);
+    QCOMPARE(changed.first(), root.directory(QStringLiteral("Camera")));
+}
+
+void TestNcDirNode::applyListingKeepsUnchangedSubtrees()
+{
+    NcDirNode root;
+    root.applyListing({directoryEntry(QStringLiteral("Camera"), QStringLiteral("\"1\"")),
+                       directoryEntry(QStringLiteral("Music"), QStringLiteral("\"2\""))});
+    NcDirNode* camera = root.directory(QStringLiteral("Camera"));
+    camera->applyListing({fileEntry(QStringLiteral("a.jpg"))});
+
+    // Only the directory with a new entity tag has to be listed again
+    const QVector<NcDirNode*> changed = root.applyListing({
+        directoryEntry(QStringLiteral("Camera"), QStringLiteral("\"1\"")),
+        directoryEntry(QStringLiteral("Music"), QStringLiteral("\"3\""))
+    });
+
+    QCOMPARE(changed.size(), 1);
+    QCOMPARE(changed.first()->name, QStringLiteral("Music"));
+    QCOMPARE(root.directory(QStringLiteral("Camera")), camera);
+    QVERIFY(camera->containsFile(QStringLiteral("a.jpg")));
+}
+
+void TestNcDirNode::parallelCrawlMatchesSerialCrawl_data()
+{
+    QTest::addColumn<int>("window");
+
+    QTest::newRow("2 listings") << 2;
+    QTest::newRow("4 listings") << 4;
+    QTest::newRow("16 listings") << 16;
+}
+
+void TestNcDirNode::parallelCrawlMatchesSerialCrawl()
+{
+    QFETCH(int, window);
+
+    const QHash<QString, QVector<RemoteEntry> > listings = remoteListings(4, 5);
+
+    NcDirNode serialRoot;
+    crawl(&serialRoot, listings, 1);
+    NcDirNode parallelRoot;
+    crawl(&parallelRoot, listings, window);
+
+    const QStringList serialTree = flattenTree(&serialRoot);
+    QCOMPARE(serialTree.size(), 5 + 25 + 125 + 625 + 5 + 25 + 125);
+    QCOMPARE(flattenTree(&parallelRoot), serialTree);
+}
+
+void TestNcDirNode::fileLookup_data()
+{
+    QTest::addColumn<int>("fileCount");
+    QTest::addColumn<bool>("indexed");
+
+    const QList<int> fileCounts = {10000, 100000, 1000000};
+    for (int fileCount : fileCounts) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 files, scan").arg(fileCount)))
+                << fileCount << false;
+        QTest::newRow(qPrintable(QStringLiteral("%1 files, index").arg(fileCount)))
+                << fileCount << true;
+    }
+}
+
+// One camera folder with many photos, looked up the way the sync does for
+// every local file; the missing names cover uploads of new photos
+void TestNcDirNode::fileLookup()
+{
+    QFETCH(int, fileCount);
+    QFETCH(bool, indexed);
+
+    NcDirNode camera;
+    camera.files.reserve(fileCount);
+    for (int i = 0; i < fileCount; i++) {
+        camera.addFile(fileEntry(QStringLiteral("IMG_%1.jpg").arg(i)));
+    }
+
+    QStringList names;
+    for (int i = 0; i < 100; i++) {
+        names.append(QStringLiteral("IMG_%1.jpg").arg(i * 2 * (fileCount / 100)));
+    }
+
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (const QString& name : names) {
+            if (indexed ? camera.containsFile(name) : containsFileLinear(camera, name))
+                found++;
+        }
+    }
+
+    QCOMPARE(found, 50);
+}
+
+QTEST_GUILESS_MAIN(TestNcDirNode)
+
+#include "tst_ncdirnode.moc"
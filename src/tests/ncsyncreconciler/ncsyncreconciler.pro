@@ -0,0 +1,6 @@
+TARGET = tst_ncsyncreconciler
+
+SOURCES += \
+    $$PWD/tst_ncsyncreconciler.cpp
+
+include($$PWD/../tests.pri)
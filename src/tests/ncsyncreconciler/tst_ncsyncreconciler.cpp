@@ -0,0 +1,241 @@
+#include <QtTest>
+
+#include <commands/sync/ncsyncreconciler.h>
+#include <commands/sync/ncdirtreecommandunit.h>
+
+typedef NcSyncReconciler::Operation Operation;
+
+const qint64 LAST_MODIFIED = 1500000000;
+
+NcSyncJournalEntry localEntry(const QString& relativePath, quint64 inode, qint64 size,
+                              qint64 lastModified = LAST_MODIFIED)
+{
+    NcSyncJournalEntry entry;
+    entry.relativePath = relativePath;
+    entry.inode = inode;
+    entry.size = size;
+    entry.lastModified = lastModified;
+    return entry;
+}
+
+NcSyncJournalEntry journalEntry(const QString& relativePath, quint64 inode, qint64 size,
+                                quint64 fileId, const QString& entityTag)
+{
+    NcSyncJournalEntry entry = localEntry(relativePath, inode, size);
+    entry.fileId = fileId;
+    entry.entityTag = RemoteEntry::EntityTag::fromString(entityTag);
+    return entry;
+}
+
+RemoteEntry remoteFile(const QString& name, quint64 fileId, const QString& entityTag)
+{
+    RemoteEntry entry;
+    entry.name = name;
+    entry.fileId = fileId;
+    entry.entityTag = RemoteEntry::EntityTag::fromString(entityTag);
+    entry.mimeType = RemoteEntry::MimeImage;
+    return entry;
+}
+
+class TestNcSyncReconciler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void unchangedFileNeedsNothing();
+    void newFileIsUploaded();
+    void modifiedFileIsUploaded();
+    void remoteChangeIsAdopted();
+    void serverWinsConflicts();
+    void existingRemoteFileIsAdopted();
+    void localDeletionIsntPropagated();
+    void localMoveIsReplayed();
+    void moveOfChangedSourceIsUploaded();
+    void copyNeedsContentCheck();
+
+private:
+    void reconcile();
+
+    QHash<QString, NcSyncJournalEntry> m_journal;
+    QHash<QString, NcSyncJournalEntry> m_localFiles;
+    QScopedPointer<NcDirNode> m_remoteTree;
+    NcDirNode* m_camera = Q_NULLPTR;
+
+    QVector<Operation> m_operations;
+    QVector<NcSyncJournalEntry> m_journalUpdates;
+    QStringList m_journalRemovals;
+};
+
+// Every case starts from Camera/a.jpg being in sync on both sides
+void TestNcSyncReconciler::init()
+{
+    this->m_journal.clear();
+    this->m_localFiles.clear();
+    this->m_remoteTree.reset(new NcDirNode);
+    this->m_camera = new NcDirNode;
+    this->m_camera->name = QStringLiteral("Camera");
+    this->m_remoteTree->addDirectory(this->m_camera);
+
+    const QString path = QStringLiteral("Camera/a.jpg");
+    this->m_journal.insert(path, journalEntry(path, 5, 1000, 42, QStringLiteral("\"v1\"")));
+    this->m_localFiles.insert(path, localEntry(path, 5, 1000));
+    this->m_camera->addFile(remoteFile(QStringLiteral("a.jpg"), 42, QStringLiteral("\"v1\"")));
+}
+
+void TestNcSyncReconciler::reconcile()
+{
+    NcSyncReconciler reconciler(this->m_journal, this->m_localFiles, this->m_remoteTree.data());
+    reconciler.reconcile();
+    this->m_operations = reconciler.operations();
+    this->m_journalUpdates = reconciler.journalUpdates();
+    this->m_journalRemovals = reconciler.journalRemovals();
+}
+
+void TestNcSyncReconciler::unchangedFileNeedsNothing()
+{
+    reconcile();
+
+    QVERIFY(this->m_operations.isEmpty());
+    QVERIFY(this->m_journalUpdates.isEmpty());
+    QVERIFY(this->m_journalRemovals.isEmpty());
+}
+
+void TestNcSyncReconciler::newFileIsUploaded()
+{
+    const QString path = QStringLiteral("Camera/b.jpg");
+    this->m_localFiles.insert(path, localEntry(path, 6, 2000));
+
+    reconcile();
+
+    QCOMPARE(this->m_operations.size(), 1);
+    QCOMPARE(this->m_operations.first().type, Operation::Upload);
+    QCOMPARE(this->m_operations.first().relativePath, path);
+    QVERIFY(!this->m_operations.first().modified);
+    QVERIFY(this->m_journalUpdates.isEmpty());
+}
+
+void TestNcSyncReconciler::modifiedFileIsUploaded()
+{
+    const QString path = QStringLiteral("Camera/a.jpg");
+    this->m_localFiles.insert(path, localEntry(path, 5, 1500, LAST_MODIFIED + 60));
+
+    reconcile();
+
+    QCOMPARE(this->m_operations.size(), 1);
+    QCOMPARE(this->m_operations.first().type, Operation::Upload);
+    QVERIFY(this->m_operations.first().modified);
+    QCOMPARE(this->m_operations.first().journalEntry.size, qint64(1500));
+}
+
+void TestNcSyncReconciler::remoteChangeIsAdopted()
+{
+    this->m_camera->clearFiles();
+    this->m_camera->addFile(remoteFile(QStringLiteral("a.jpg"), 42, QStringLiteral("\"v2\"")));
+
+    reconcile();
+
+    QVERIFY(this->m_operations.isEmpty());
+    QCOMPARE(this->m_journalUpdates.size(), 1);
+    QCOMPARE(this->m_journalUpdates.first().entityTag,
+             RemoteEntry::EntityTag::fromString(QStringLiteral("\"v2\"")));
+}
+
+// Changed on both sides, the local change is left alone
+void TestNcSyncReconciler::serverWinsConflicts()
+{
+    const QString path = QStringLiteral("Camera/a.jpg");
+    this->m_localFiles.insert(path, localEntry(path, 5, 1500, LAST_MODIFIED + 60));
+    this->m_camera->clearFiles();
+    this->m_camera->addFile(remoteFile(QStringLiteral("a.jpg"), 42, QStringLiteral("\"v2\"")));
+
+    reconcile();
+
+    QVERIFY(this->m_operations.isEmpty());
+    QVERIFY(this->m_journalUpdates.isEmpty());
+    QVERIFY(this->m_journalRemovals.isEmpty());
+}
+
+void TestNcSyncReconciler::existingRemoteFileIsAdopted()
+{
+    const QString path = QStringLiteral("Camera/b.jpg");
+    this->m_localFiles.insert(path, localEntry(path, 6, 2000));
+    this->m_camera->addFile(remoteFile(QStringLiteral("b.jpg"), 43, QStringLiteral("\"b1\"")));
+
+    reconcile();
+
+    QVERIFY(this->m_operations.isEmpty());
+    QCOMPARE(this->m_journalUpdates.size(), 1);
+    QCOMPARE(this->m_journalUpdates.first().relativePath, path);
+    QCOMPARE(this->m_journalUpdates.first().fileId, quint64(43));
+}
+
+// The daemon only uploads, a file removed locally stays on the server
+void TestNcSyncReconciler::localDeletionIsntPropagated()
+{
+    this->m_localFiles.clear();
+
+    reconcile();
+
+    QVERIFY(this->m_operations.isEmpty());
+    QCOMPARE(this->m_journalRemovals, QStringList({QStringLiteral("Camera/a.jpg")}));
+}
+
+void TestNcSyncReconciler::localMoveIsReplayed()
+{
+    const QString path = QStringLiteral("Camera/renamed.jpg");
+    this->m_localFiles.clear();
+    this->m_localFiles.insert(path, localEntry(path, 5, 1000));
+
+    reconcile();
+
+    QCOMPARE(this->m_operations.size(), 1);
+    const Operation& move = this->m_operations.first();
+    QCOMPARE(move.type, Operation::Move);
+    QCOMPARE(move.sourcePath, QStringLiteral("Camera/a.jpg"));
+    QCOMPARE(move.relativePath, path);
+    QVERIFY(!move.verifyContent);
+
+    // The moved file keeps its remote identity
+    QCOMPARE(move.journalEntry.fileId, quint64(42));
+    QVERIFY(this->m_journalRemovals.isEmpty());
+}
+
+void TestNcSyncReconciler::moveOfChangedSourceIsUploaded()
+{
+    const QString path = QStringLiteral("Camera/renamed.jpg");
+    this->m_localFiles.clear();
+    this->m_localFiles.insert(path, localEntry(path, 5, 1000));
+    this->m_camera->clearFiles();
+    this->m_camera->addFile(remoteFile(QStringLiteral("a.jpg"), 42, QStringLiteral("\"v2\"")));
+
+    reconcile();
+
+    QCOMPARE(this->m_operations.size(), 1);
+    QCOMPARE(this->m_operations.first().type, Operation::Upload);
+    QCOMPARE(this->m_operations.first().relativePath, path);
+    QCOMPARE(this->m_journalRemovals, QStringList({QStringLiteral("Camera/a.jpg")}));
+}
+
+// Size and modification time only make it a candidate, e.g. for burst shots
+void TestNcSyncReconciler::copyNeedsContentCheck()
+{
+    const QString path = QStringLiteral("Camera/copy.jpg");
+    this->m_localFiles.insert(path, localEntry(path, 6, 1000));
+
+    reconcile();
+
+    QCOMPARE(this->m_operations.size(), 1);
+    const Operation& copy = this->m_operations.first();
+    QCOMPARE(copy.type, Operation::Copy);
+    QCOMPARE(copy.sourcePath, QStringLiteral("Camera/a.jpg"));
+    QVERIFY(copy.verifyContent);
+
+    // The copy gets a remote identity of its own
+    QCOMPARE(copy.journalEntry.fileId, quint64(0));
+}
+
+QTEST_GUILESS_MAIN(TestNcSyncReconciler)
+
+#include "tst_ncsyncreconciler.moc"
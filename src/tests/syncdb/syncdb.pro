@@ -0,0 +1,6 @@
+TARGET = tst_syncdb
+
+SOURCES += \
+    $$PWD/tst_syncdb.cpp
+
+include($$PWD/../tests.pri)
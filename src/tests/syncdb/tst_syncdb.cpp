@@ -0,0 +1,233 @@
+#include <QtTest>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+#include <settings/db/syncdb.h>
+#include <commands/sync/ncdirtreecommandunit.h>
+
+const QString FIXTURE_CONNECTION = QStringLiteral("fixture");
+
+// Where SyncDb keeps the database of userName
+QString databasePath(const QString& userName)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) +
+            QStringLiteral("/%1/%2/sync.db").arg(qApp->applicationName(), userName);
+}
+
+// Writes a database the way an older release left it behind
+bool createDatabase(const QString& userName, const QStringList& statements)
+{
+    const QString path = databasePath(userName);
+    if (!QDir().mkpath(QFileInfo(path).absolutePath()))
+        return false;
+
+    bool success = true;
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"),
+                                                          FIXTURE_CONNECTION);
+        database.setDatabaseName(path);
+        success = database.open();
+        for (const QString& statement : statements) {
+            if (!success)
+                break;
+            success = database.exec(statement).lastError().type() == QSqlError::NoError;
+        }
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(FIXTURE_CONNECTION);
+    return success;
+}
+
+int databaseVersion(const QString& userName)
+{
+    QSqlQuery query = QSqlDatabase::database(QStringLiteral("sync_%1").arg(userName))
+            .exec(QStringLiteral("SELECT versionNumber from version;"));
+    return query.first() ? query.value(0).toInt() : -1;
+}
+
+NcChunkedUploadState chunkedUploadState(const QString& transferId, qint64 reusedBytes)
+{
+    NcChunkedUploadState state;
+    state.transferId = transferId;
+    state.size = 100 * 1024 * 1024;
+    state.lastModified = 1500000000;
+    state.chunkSize = 10 * 1024 * 1024;
+    state.reusedBytes = reusedBytes;
+    return state;
+}
+
+class TestSyncDb : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void createsCurrentVersion();
+    void upgradesVersion1();
+    void upgradesVersion5();
+    void chunkedUploadResumes();
+    void newTransferDropsOldChunks();
+
+private:
+    // The tables added after version 1 can be written and read back
+    void verifyCurrentLayout(SyncDb& syncDb);
+};
+
+void TestSyncDb::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QCoreApplication::setApplicationName(QStringLiteral("tst_syncdb"));
+    QDir(QFileInfo(databasePath(QString())).absolutePath()).removeRecursively();
+}
+
+void TestSyncDb::cleanupTestCase()
+{
+    QDir(QFileInfo(databasePath(QString())).absolutePath()).removeRecursively();
+}
+
+void TestSyncDb::verifyCurrentLayout(SyncDb& syncDb)
+{
+    QSharedPointer<NcDirNode> tree(new NcDirNode);
+    RemoteEntry file;
+    file.name = QStringLiteral("a.jpg");
+    file.size = 42;
+    RemoteEntry directory;
+    directory.name = QStringLiteral("Camera");
+    directory.mimeType = RemoteEntry::MimeDirectory;
+    tree->applyListing({file, directory});
+    QVERIFY(syncDb.storeTree(QStringLiteral("/home/user/Pictures"), QStringLiteral("/Pictures/"), tree));
+
+    QSharedPointer<NcDirNode> loadedTree =
+            syncDb.loadTree(QStringLiteral("/home/user/Pictures"), QStringLiteral("/Pictures/"));
+    QVERIFY(loadedTree);
+    QVERIFY(loadedTree->containsFile(QStringLiteral("a.jpg")));
+    QVERIFY(loadedTree->directory(QStringLiteral("Camera")));
+
+    NcSyncJournalEntry journalEntry;
+    journalEntry.relativePath = QStringLiteral("a.jpg");
+    journalEntry.inode = 7;
+    journalEntry.size = 42;
+    QVERIFY(syncDb.storeJournalEntries(QStringLiteral("/home/user/Pictures"), {journalEntry}));
+    QVERIFY(syncDb.loadJournal(QStringLiteral("/home/user/Pictures"))
+            .value(QStringLiteral("a.jpg")).sameLocalState(journalEntry));
+
+    QVERIFY(syncDb.storeChunkedUpload(QStringLiteral("/home/user/video.mp4"),
+                                      QStringLiteral("/Videos/video.mp4"),
+                                      chunkedUploadState(QStringLiteral("transfer"), 1024)));
+    QCOMPARE(syncDb.loadChunkedUpload(QStringLiteral("/home/user/video.mp4"),
+                                      QStringLiteral("/Videos/video.mp4")).reusedBytes,
+             qint64(1024));
+
+    FileSnapshot snapshot;
+    FileSnapshotEntry snapshotEntry;
+    snapshotEntry.inode = 7;
+    snapshotEntry.size = 42;
+    snapshot.insert(QStringLiteral("a.jpg"), snapshotEntry);
+    QVERIFY(syncDb.storeFileSnapshot(QStringLiteral("/home/user/Pictures"), snapshot));
+    QCOMPARE(syncDb.loadFileSnapshot(QStringLiteral("/home/user/Pictures")), snapshot);
+}
+
+void TestSyncDb::createsCurrentVersion()
+{
+    SyncDb syncDb(Q_NULLPTR, QStringLiteral("fresh"));
+    QCOMPARE(databaseVersion(QStringLiteral("fresh")), 7);
+    verifyCurrentLayout(syncDb);
+}
+
+// Version 1 had a files table keyed by fileId which never got any rows
+void TestSyncDb::upgradesVersion1()
+{
+    QVERIFY(createDatabase(QStringLiteral("version1"), {
+        QStringLiteral("CREATE table tangledescriptions (localPath TEXT, remotePath TEXT,"
+                       " PRIMARY KEY(localPath, remotePath));"),
+        QStringLiteral("CREATE table files (fileId TEXT, uniqueId TEXT, relativePath TEXT,"
+                       " PRIMARY KEY(fileId));"),
+        QStringLiteral("CREATE table version (versionNumber INTEGER, PRIMARY KEY(versionNumber));"),
+        QStringLiteral("INSERT INTO version values(1);")
+    }));
+
+    SyncDb syncDb(Q_NULLPTR, QStringLiteral("version1"));
+    QCOMPARE(databaseVersion(QStringLiteral("version1")), 7);
+    verifyCurrentLayout(syncDb);
+}
+
+// Chunked uploads recorded by version 5 have to resume without reusing anything
+void TestSyncDb::upgradesVersion5()
+{
+    QVERIFY(createDatabase(QStringLiteral("version5"), {
+        QStringLiteral("CREATE table chunkeduploads (localFile TEXT, remoteFile TEXT,"
+                       " transferId TEXT, size INTEGER, lastModified INTEGER, chunkSize INTEGER,"
+                       " PRIMARY KEY(localFile, remoteFile));"),
+        QStringLiteral("CREATE table uploadedchunks (transferId TEXT, chunkNumber INTEGER,"
+                       " PRIMARY KEY(transferId, chunkNumber));"),
+        QStringLiteral("INSERT INTO chunkeduploads values('/home/user/old.mp4', '/old.mp4',"
+                       " 'old', 104857600, 1500000000, 10485760);"),
+        QStringLiteral("INSERT INTO uploadedchunks values('old', 1);"),
+        QStringLiteral("CREATE table version (versionNumber INTEGER, PRIMARY KEY(versionNumber));"),
+        QStringLiteral("INSERT INTO version values(5);")
+    }));
+
+    SyncDb syncDb(Q_NULLPTR, QStringLiteral("version5"));
+    QCOMPARE(databaseVersion(QStringLiteral("version5")), 7);
+
+    const NcChunkedUploadState state =
+            syncDb.loadChunkedUpload(QStringLiteral("/home/user/old.mp4"), QStringLiteral("/old.mp4"));
+    QCOMPARE(state.transferId, QStringLiteral("old"));
+    QCOMPARE(state.reusedBytes, qint64(0));
+    QCOMPARE(state.uploadedChunks, QSet<int>({1}));
+
+    verifyCurrentLayout(syncDb);
+}
+
+void TestSyncDb::chunkedUploadResumes()
+{
+    SyncDb syncDb(Q_NULLPTR, QStringLiteral("resume"));
+    const QString localFile = QStringLiteral("/home/user/video.mp4");
+    const QString remoteFile = QStringLiteral("/Videos/video.mp4");
+
+    QVERIFY(syncDb.storeChunkedUpload(localFile, remoteFile,
+                                      chunkedUploadState(QStringLiteral("transfer"), 0)));
+    QVERIFY(syncDb.storeUploadedChunk(QStringLiteral("transfer"), 1));
+    QVERIFY(syncDb.storeUploadedChunk(QStringLiteral("transfer"), 3));
+
+    // Recording the same transfer again keeps the chunks it lists
+    NcChunkedUploadState state = syncDb.loadChunkedUpload(localFile, remoteFile);
+    QCOMPARE(state.uploadedChunks, QSet<int>({1, 3}));
+    QVERIFY(syncDb.storeChunkedUpload(localFile, remoteFile, state));
+    QCOMPARE(syncDb.loadChunkedUpload(localFile, remoteFile).uploadedChunks, QSet<int>({1, 3}));
+
+    QVERIFY(syncDb.removeChunkedUpload(localFile, remoteFile, QStringLiteral("transfer")));
+    QVERIFY(!syncDb.loadChunkedUpload(localFile, remoteFile).isValid());
+}
+
+void TestSyncDb::newTransferDropsOldChunks()
+{
+    SyncDb syncDb(Q_NULLPTR, QStringLiteral("restart"));
+    const QString localFile = QStringLiteral("/home/user/video.mp4");
+    const QString remoteFile = QStringLiteral("/Videos/video.mp4");
+
+    QVERIFY(syncDb.storeChunkedUpload(localFile, remoteFile,
+                                      chunkedUploadState(QStringLiteral("first"), 0)));
+    QVERIFY(syncDb.storeUploadedChunk(QStringLiteral("first"), 1));
+
+    // The file changed, its upload starts over under a new transfer
+    QVERIFY(syncDb.storeChunkedUpload(localFile, remoteFile,
+                                      chunkedUploadState(QStringLiteral("second"), 0)));
+    QVERIFY(syncDb.storeUploadedChunk(QStringLiteral("second"), 2));
+
+    const NcChunkedUploadState state = syncDb.loadChunkedUpload(localFile, remoteFile);
+    QCOMPARE(state.transferId, QStringLiteral("second"));
+    QCOMPARE(state.uploadedChunks, QSet<int>({2}));
+
+    QSqlQuery staleChunks = QSqlDatabase::database(QStringLiteral("sync_restart"))
+            .exec(QStringLiteral("SELECT count(*) from uploadedchunks WHERE transferId='first';"));
+    QVERIFY(staleChunks.first());
+    QCOMPARE(staleChunks.value(0).toInt(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestSyncDb)
+
+#include "tst_syncdb.moc"
@@ -0,0 +1,20 @@
+TEMPLATE = app
+
+CONFIG += qt c++11 testcase
+QT += testlib network xml sql
+
+DEFINES += QWEBDAVITEM_EXTENDED_PROPERTIES
+
+INCLUDEPATH += $$PWD/../common/src
+DEPENDPATH += $$PWD/../common/src
+INCLUDEPATH += $$PWD/../../3rdparty/libqtcommandqueue/src
+DEPENDPATH += $$PWD/../../3rdparty/libqtcommandqueue/src
+INCLUDEPATH += $$PWD/../../3rdparty/qwebdavlib/qwebdavlib
+DEPENDPATH += $$PWD/../../3rdparty/qwebdavlib/qwebdavlib
+
+# The tests run on the build host, each one in a directory of its own below this one
+linux:!android {
+    QT += dbus
+    LIBS += $$OUT_PWD/../../../3rdparty/qwebdavlib/qwebdavlib/libqwebdav.so.1
+    LIBS += $$OUT_PWD/../../common/libharbourowncloudcommon.so.1
+}
@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    ncdirnode \
+    davmultistatusparser \
+    syncdb \
+    filedownload \
+    blockmanifest \
+    ncsyncreconciler